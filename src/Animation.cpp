@@ -1,5 +1,13 @@
 #include "Animation.hpp"
 #include <algorithm>
+#include "Metrics.hpp"
+#include "Trace.hpp"
+
+// The time the update callbacks take on the animation timer ticks
+static Histogram& animationTick = GetMetrics().GetHistogram("animation_tick_us", "Time taken by the update callback of an animation variable on a tick");
+
+// The times the animation timer reported that it could not keep up with its frame rate threshold
+static Counter& renderingTooSlow = GetMetrics().GetCounter("animation_rendering_too_slow_total", "Times the animation timer fell below its frame rate threshold");
 
 ///==============================================================
 ///= Transition
@@ -63,6 +71,47 @@ void AnimationHandle::Cancel()
     }
 }
 
+///==============================================================
+///= AnimationVariable
+///==============================================================
+AnimationVariable::AnimationVariable()
+{
+}
+
+AnimationVariable::~AnimationVariable()
+{
+    Detach();
+}
+
+bool AnimationVariable::IsValid() const
+{
+    return mVar != nullptr;
+}
+
+double AnimationVariable::GetFinalValue() const
+{
+    DOUBLE val = 0;
+    if (mVar)
+        mVar->GetFinalValue(&val);
+    return val;
+}
+
+void AnimationVariable::Detach()
+{
+    // Abandoning a storyboard that already finished is a harmless no op
+    if (mStoryboard)
+    {
+        mStoryboard->Abandon();
+        mStoryboard.Release();
+    }
+
+    if (mVar)
+    {
+        mVar->SetVariableChangeHandler(nullptr);
+        mVar.Release();
+    }
+}
+
 ///==============================================================
 ///= Animator
 ///==============================================================
@@ -76,6 +125,14 @@ Animator::Animator()
     if (FAILED(hr))
         return;
 
+    // =- Retargeting
+    // Let newly scheduled storyboards cancel the pending and trim the running storyboards that animate
+    // the same variables, so that a variable can be sent to a new value in the middle of a transition
+    RetargetPriorityComparison* retargetCmp = new RetargetPriorityComparison;
+    pAnimMgr->SetCancelPriorityComparison(retargetCmp);
+    pAnimMgr->SetTrimPriorityComparison(retargetCmp);
+    retargetCmp->Release();
+
     // =- UIAnimationTimer
     // CoCreate the IUIAnimationTimer.
     hr = pAnimTmr.CoCreateInstance(CLSID_UIAnimationTimer, 0, CLSCTX_INPROC_SERVER);
@@ -94,6 +151,19 @@ Animator::Animator()
         return;
     pTmrUpdater->Release();
 
+    // =- Frame timing
+    // Bracket every tick of the timer to time the frames, the tick intervals are compared against the refresh
+    // period of the primary display, the 60Hz default is kept when the driver does not report one
+    HDC screenDc = GetDC(nullptr);
+    int refreshRate = GetDeviceCaps(screenDc, VREFRESH);
+    ReleaseDC(nullptr, screenDc);
+    if (refreshRate > 1)
+        mFrameTiming.SetRefreshPeriod(std::chrono::microseconds(1000000 / refreshRate));
+
+    FrameTimingEventHandler* frameTimingHandler = new FrameTimingEventHandler(mFrameTiming, pAnimMgr);
+    pAnimTmr->SetTimerEventHandler(frameTimingHandler);
+    frameTimingHandler->Release();
+
     // =- UIAnimationTransitionLibrary
     // CoCreate the IUIAnimationTransitionLibrary.
     hr = pTransLib.CoCreateInstance(CLSID_UIAnimationTransitionLibrary, 0, CLSCTX_INPROC_SERVER);
@@ -113,6 +183,7 @@ Animator::~Animator()
 // Animates given window with a custom transition
 AnimationHandle Animator::DoSampleAnimation(const Animation& animation)
 {
+    TRACE_SCOPE("Animator::DoSampleAnimation");
     HRESULT hr;
 
     // Create all the animation variables by calling IUIAnimationManager::CreateAnimationVariable().
@@ -178,6 +249,61 @@ AnimationHandle Animator::DoSampleAnimation(const Animation& animation)
     return AnimationHandle(aliveAnim);
 }
 
+void Animator::CreateVariable(AnimationVariable& v, double initVal, UpdateCallback updateCb)
+{
+    v.Detach();
+
+    // Create the variable, it keeps living between transitions
+    CComPtr<IUIAnimationVariable> pAnimVar;
+    HRESULT hr = pAnimMgr->CreateAnimationVariable(initVal, &pAnimVar);
+    if (FAILED(hr))
+        return;
+
+    // Create and assosiate the event handler for the animation variable
+    NotificationAnimationVariableChangeHandler* animVarEvHandler = new NotificationAnimationVariableChangeHandler;
+    animVarEvHandler->SetUpdateCallbackAction(updateCb);
+    pAnimVar->SetVariableChangeHandler(animVarEvHandler);
+    animVarEvHandler->Release();
+
+    v.mVar = pAnimVar;
+}
+
+void Animator::Retarget(AnimationVariable& v, double finalVal, unsigned long duration)
+{
+    TRACE_SCOPE("Animator::Retarget");
+    if (!v.IsValid())
+        return;
+
+    HRESULT hr;
+    CComPtr<IUIAnimationStoryboard> pStoryboard;
+    hr = pAnimMgr->CreateStoryboard(&pStoryboard);
+    if (FAILED(hr))
+        return;
+
+    // Smooth stop transitions start with the current velocity of the variable, so retargeting a variable
+    // in the middle of a transition bends its motion instead of restarting it. The running storyboard
+    // is trimmed by the RetargetPriorityComparison once the new one is scheduled.
+    CComPtr<IUIAnimationTransition> pTransition;
+    hr = pTransLib->CreateSmoothStopTransition(duration / 1000.0, finalVal, &pTransition);
+    if (FAILED(hr))
+        return;
+    pStoryboard->AddTransition(v.mVar, pTransition);
+
+    UI_ANIMATION_SECONDS secs = 0;
+    pAnimTmr->GetTime(&secs);
+    pStoryboard->Schedule(secs);
+    v.mStoryboard = pStoryboard;
+
+    // If animation timer was deactivated, activate him again
+    if (pAnimTmr->IsEnabled() != S_OK)
+        pAnimTmr->Enable();
+}
+
+const FrameTiming& Animator::GetFrameTiming() const
+{
+    return mFrameTiming;
+}
+
 ///==============================================================
 ///= NotificationAnimationEventHandler
 ///==============================================================
@@ -275,7 +401,12 @@ HRESULT __stdcall NotificationAnimationVariableChangeHandler::OnValueChanged(
     UNREFERENCED_PARAMETER(previousValue);
 
     if (updateCb)
-        updateCb(newValue); 
+    {
+        TRACE_SCOPE("Animation::Update");
+        ScopedTimer timer(animationTick);
+        FrameTiming::CountTween();
+        updateCb(newValue);
+    }
     return S_OK;
 }
 
@@ -283,3 +414,101 @@ void NotificationAnimationVariableChangeHandler::SetUpdateCallbackAction(UpdateC
 {
     this->updateCb = updateCb;
 }
+
+///==============================================================
+///= RetargetPriorityComparison
+///==============================================================
+RetargetPriorityComparison::RetargetPriorityComparison() { ref = 1; }
+ULONG __stdcall RetargetPriorityComparison::AddRef() { return ++ref; }
+ULONG __stdcall RetargetPriorityComparison::Release()
+{
+    ULONG nRef = --ref;
+    if (nRef == 0)
+        delete this;
+    return nRef;
+}
+
+HRESULT __stdcall RetargetPriorityComparison::QueryInterface(const IID& id, void** p)
+{
+    if (id == __uuidof(IUnknown) ||
+        id == __uuidof(IUIAnimationPriorityComparison))
+    {
+        *p = this;
+        AddRef();
+        return NOERROR;
+    }
+
+    *p = nullptr;
+    return E_NOINTERFACE;
+}
+
+HRESULT __stdcall RetargetPriorityComparison::HasPriority(
+    IUIAnimationStoryboard* scheduledStoryboard,
+    IUIAnimationStoryboard* newStoryboard,
+    UI_ANIMATION_PRIORITY_EFFECT priorityEffect
+)
+{
+    UNREFERENCED_PARAMETER(scheduledStoryboard);
+    UNREFERENCED_PARAMETER(newStoryboard);
+    UNREFERENCED_PARAMETER(priorityEffect);
+
+    // The most recently scheduled storyboard always wins
+    return S_OK;
+}
+
+///==============================================================
+///= FrameTimingEventHandler
+///==============================================================
+FrameTimingEventHandler::FrameTimingEventHandler(FrameTiming& timing, IUIAnimationManager* animMgr)
+    : mTiming(timing),
+      mAnimMgr(animMgr)
+{
+    ref = 1;
+}
+
+ULONG __stdcall FrameTimingEventHandler::AddRef() { return ++ref; }
+ULONG __stdcall FrameTimingEventHandler::Release()
+{
+    ULONG nRef = --ref;
+    if (nRef == 0)
+        delete this;
+    return nRef;
+}
+
+HRESULT __stdcall FrameTimingEventHandler::QueryInterface(const IID& id, void** p)
+{
+    if (id == __uuidof(IUnknown) ||
+        id == __uuidof(IUIAnimationTimerEventHandler))
+    {
+        *p = this;
+        AddRef();
+        return NOERROR;
+    }
+
+    *p = nullptr;
+    return E_NOINTERFACE;
+}
+
+HRESULT __stdcall FrameTimingEventHandler::OnPreUpdate()
+{
+    mTiming.BeginFrame();
+    return S_OK;
+}
+
+HRESULT __stdcall FrameTimingEventHandler::OnPostUpdate()
+{
+    mTiming.EndFrame();
+
+    // The timer stops once the animations are over, the wait for the next one is not a missed frame
+    UI_ANIMATION_MANAGER_STATUS status;
+    if (SUCCEEDED(mAnimMgr->GetStatus(&status)) && status == UI_ANIMATION_MANAGER_IDLE)
+        mTiming.Restart();
+    return S_OK;
+}
+
+HRESULT __stdcall FrameTimingEventHandler::OnRenderingTooSlow(UINT32 framesPerSecond)
+{
+    UNREFERENCED_PARAMETER(framesPerSecond);
+    renderingTooSlow.Add();
+    return S_OK;
+}
@@ -37,6 +37,7 @@
 #include <vector>
 #include <functional>
 #include <memory>
+#include "FrameTiming.hpp"
 
 // Alias of the update callback signature for convenience
 using UpdateCallback = std::function<void(double)>;
@@ -132,6 +133,38 @@ class AnimationHandle
         std::weak_ptr<CComPtr<IUIAnimationStoryboard>> w;
 };
 
+class AnimationVariable
+{
+    public:
+        /// Constructor, the variable is unbound until passed to Animator::CreateVariable
+        AnimationVariable();
+
+        /// Destructor, detaches the variable
+        ~AnimationVariable();
+
+        /// Disable copying
+        AnimationVariable(const AnimationVariable&) = delete;
+        AnimationVariable& operator=(const AnimationVariable&) = delete;
+
+        /// Checks if the variable is bound to an Animator
+        bool IsValid() const;
+
+        /// Retrieves the value the variable is heading to
+        double GetFinalValue() const;
+
+        /// Stops the running transition and the update callbacks of the variable
+        void Detach();
+
+    private:
+        friend class Animator;
+
+        /// The underlying animation variable
+        CComPtr<IUIAnimationVariable> mVar;
+
+        /// The storyboard of the latest scheduled transition
+        CComPtr<IUIAnimationStoryboard> mStoryboard;
+};
+
 class Animator
 {
     public:
@@ -148,6 +181,15 @@ class Animator
         /// Schedules a sample animation
         AnimationHandle DoSampleAnimation(const Animation& a);
 
+        /// Binds the given variable to the animator, updateCb is called every time the variable value changes
+        void CreateVariable(AnimationVariable& v, double initVal, UpdateCallback updateCb);
+
+        /// Moves the given variable towards a new final value, picking up from its current value and velocity
+        void Retarget(AnimationVariable& v, double finalVal, unsigned long duration);
+
+        /// Retrieves the timing of the animation frames ticked so far
+        const FrameTiming& GetFrameTiming() const;
+
     private:
         // The holder of the UIAnimationManager
         CComPtr<IUIAnimationManager> pAnimMgr;
@@ -160,6 +202,9 @@ class Animator
 
         // Keeps the alive animation instances as handles
         std::vector<std::shared_ptr<CComPtr<IUIAnimationStoryboard>>> mAliveAnimations;
+
+        // Times the ticks of the animation timer
+        FrameTiming mFrameTiming;
 };
 
 using FinishCallback = std::function<void()>;
@@ -226,4 +271,54 @@ class NotificationAnimationVariableChangeHandler : public IUIAnimationVariableCh
         unsigned long ref;
 };
 
+class RetargetPriorityComparison : public IUIAnimationPriorityComparison
+{
+    public:
+        /// Constructor
+        RetargetPriorityComparison();
+
+        /// IUnknown Interface implementation
+        ULONG __stdcall AddRef();
+        ULONG __stdcall Release();
+        HRESULT __stdcall QueryInterface(const IID& id, void** p);
+
+        /// IUIAnimationPriorityComparison Interface implementation
+        HRESULT __stdcall HasPriority(
+            IUIAnimationStoryboard* scheduledStoryboard,
+            IUIAnimationStoryboard* newStoryboard,
+            UI_ANIMATION_PRIORITY_EFFECT priorityEffect
+        );
+
+    private:
+        /// Reference counter of current object
+        unsigned long ref;
+};
+
+class FrameTimingEventHandler : public IUIAnimationTimerEventHandler
+{
+    public:
+        /// Constructor, the timing must outlive the handler registration
+        FrameTimingEventHandler(FrameTiming& timing, IUIAnimationManager* animMgr);
+
+        /// IUnknown Interface implementation
+        ULONG __stdcall AddRef();
+        ULONG __stdcall Release();
+        HRESULT __stdcall QueryInterface(const IID& id, void** p);
+
+        /// IUIAnimationTimerEventHandler Interface implementation
+        HRESULT __stdcall OnPreUpdate();
+        HRESULT __stdcall OnPostUpdate();
+        HRESULT __stdcall OnRenderingTooSlow(UINT32 framesPerSecond);
+
+    private:
+        /// The timing the ticks are recorded to
+        FrameTiming& mTiming;
+
+        /// The manager whose status tells when the animations go idle
+        CComPtr<IUIAnimationManager> mAnimMgr;
+
+        /// Reference counter of current object
+        unsigned long ref;
+};
+
 #endif // ! _ANIMATION_HPP_
@@ -0,0 +1,209 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _BUCKET_QUEUE_HPP_
+#define _BUCKET_QUEUE_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+//
+// Priority queue over a small fixed number of priority levels, one FIFO
+// bucket per level plus a bitmask of the non empty buckets. Pushing and
+// popping are O(1), and values of the same level keep their arrival order.
+// The values never move while queued, so references to them stay valid
+// until they are popped.
+//
+
+template<typename T, std::size_t Levels>
+class BucketQueue
+{
+    static_assert(Levels > 0 && Levels <= 32, "BucketQueue supports 1 to 32 priority levels");
+
+    public:
+        /// Constructor
+        BucketQueue();
+
+        /// Appends a value to the given level
+        void Push(std::size_t level, T v);
+
+        /// Prepends a value to the given level, making it the next one popped from that level
+        void PushFront(std::size_t level, T v);
+
+        /// Removes and returns the oldest value of the highest non empty level, the queue must not be empty
+        T PopHighest();
+
+        /// Removes the oldest value of the given level, the level must not be empty
+        void PopFront(std::size_t level);
+
+        /// Retrieves the values of the given level, oldest first
+        const std::deque<T>& Bucket(std::size_t level) const;
+
+        /// Retrieves the oldest value of the given level, the level must not be empty
+        T& Front(std::size_t level);
+
+        /// Retrieves the newest value of the given level, the level must not be empty
+        T& Back(std::size_t level);
+
+        /// Retrieves the highest non empty level or -1 if the queue is empty
+        int HighestLevel() const;
+
+        /// Retrieves the lowest non empty level or -1 if the queue is empty
+        int LowestLevel() const;
+
+        /// Checks if the queue is empty
+        bool Empty() const;
+
+        /// Retrieves the number of queued values
+        std::size_t Size() const;
+
+        /// Removes all the values
+        void Clear();
+
+    private:
+        /// Updates the non empty mask bit of the given level
+        void UpdateMask(std::size_t level);
+
+        /// The per level FIFOs
+        std::array<std::deque<T>, Levels> mBuckets;
+
+        /// Bit n is set when level n is not empty
+        std::uint32_t mMask;
+
+        /// Number of queued values
+        std::size_t mSize;
+};
+
+template<typename T, std::size_t Levels>
+BucketQueue<T, Levels>::BucketQueue() : mMask(0), mSize(0)
+{
+}
+
+template<typename T, std::size_t Levels>
+void BucketQueue<T, Levels>::Push(std::size_t level, T v)
+{
+    mBuckets[level].push_back(std::move(v));
+    mMask |= 1u << level;
+    ++mSize;
+}
+
+template<typename T, std::size_t Levels>
+void BucketQueue<T, Levels>::PushFront(std::size_t level, T v)
+{
+    mBuckets[level].push_front(std::move(v));
+    mMask |= 1u << level;
+    ++mSize;
+}
+
+template<typename T, std::size_t Levels>
+T BucketQueue<T, Levels>::PopHighest()
+{
+    std::size_t level = static_cast<std::size_t>(HighestLevel());
+    T v = std::move(mBuckets[level].front());
+    PopFront(level);
+    return v;
+}
+
+template<typename T, std::size_t Levels>
+void BucketQueue<T, Levels>::PopFront(std::size_t level)
+{
+    mBuckets[level].pop_front();
+    UpdateMask(level);
+    --mSize;
+}
+
+template<typename T, std::size_t Levels>
+const std::deque<T>& BucketQueue<T, Levels>::Bucket(std::size_t level) const
+{
+    return mBuckets[level];
+}
+
+template<typename T, std::size_t Levels>
+T& BucketQueue<T, Levels>::Front(std::size_t level)
+{
+    return mBuckets[level].front();
+}
+
+template<typename T, std::size_t Levels>
+T& BucketQueue<T, Levels>::Back(std::size_t level)
+{
+    return mBuckets[level].back();
+}
+
+template<typename T, std::size_t Levels>
+int BucketQueue<T, Levels>::HighestLevel() const
+{
+    for (int l = static_cast<int>(Levels) - 1; l >= 0; --l)
+        if (mMask & (1u << l))
+            return l;
+    return -1;
+}
+
+template<typename T, std::size_t Levels>
+int BucketQueue<T, Levels>::LowestLevel() const
+{
+    for (int l = 0; l < static_cast<int>(Levels); ++l)
+        if (mMask & (1u << l))
+            return l;
+    return -1;
+}
+
+template<typename T, std::size_t Levels>
+bool BucketQueue<T, Levels>::Empty() const
+{
+    return mSize == 0;
+}
+
+template<typename T, std::size_t Levels>
+std::size_t BucketQueue<T, Levels>::Size() const
+{
+    return mSize;
+}
+
+template<typename T, std::size_t Levels>
+void BucketQueue<T, Levels>::Clear()
+{
+    for (auto& b : mBuckets)
+        b.clear();
+    mMask = 0;
+    mSize = 0;
+}
+
+template<typename T, std::size_t Levels>
+void BucketQueue<T, Levels>::UpdateMask(std::size_t level)
+{
+    if (mBuckets[level].empty())
+        mMask &= ~(1u << level);
+}
+
+#endif // ! _BUCKET_QUEUE_HPP_
@@ -0,0 +1,121 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _BUFFER_POOL_HPP_
+#define _BUFFER_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/// Allocator that leaves the elements it constructs without arguments uninitialized, so that growing a byte buffer
+/// that is about to be read into does not clear it first
+template<typename T>
+struct DefaultInitAllocator : std::allocator<T>
+{
+    template<typename U>
+    struct rebind { typedef DefaultInitAllocator<U> other; };
+
+    DefaultInitAllocator() = default;
+
+    template<typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) {}
+
+    template<typename U>
+    void construct(U* p) { ::new (static_cast<void*>(p)) U; }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+};
+
+/// A growable byte buffer that is not cleared on resize
+typedef std::vector<char, DefaultInitAllocator<char>> ByteBuffer;
+
+//
+// Free list of receive buffers shared by the connections of an io_service.
+// A connection holds a buffer only while it has received data that is not
+// handled yet, so idle connections cost no buffer memory and the buffers
+// that are in use stay warm in the cache. Not thread safe.
+//
+
+class BufferPool
+{
+    public:
+        /// Constructor, takes the size of a buffer and the number of free buffers kept for reuse
+        BufferPool(std::size_t blockSize = 4096, std::size_t maxFree = 256)
+            : mBlockSize(blockSize), mMaxFree(maxFree) {}
+
+        /// Disable copying
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+        /// Retrieves an empty buffer with room for at least a block
+        ByteBuffer Acquire()
+        {
+            if (mFree.empty())
+            {
+                ByteBuffer b;
+                b.reserve(mBlockSize);
+                return b;
+            }
+            ByteBuffer b = std::move(mFree.back());
+            mFree.pop_back();
+            return b;
+        }
+
+        /// Gives a buffer back, buffers grown well over a block by a large request are freed instead of kept
+        void Release(ByteBuffer b)
+        {
+            if (b.capacity() < mBlockSize || b.capacity() > 4 * mBlockSize || mFree.size() >= mMaxFree)
+                return;
+            b.clear();
+            mFree.push_back(std::move(b));
+        }
+
+        /// Retrieves the size of a block, the amount read at once
+        std::size_t GetBlockSize() const { return mBlockSize; }
+
+        /// Retrieves the number of free buffers
+        std::size_t GetFreeCount() const { return mFree.size(); }
+
+    private:
+        /// The size of a block
+        std::size_t mBlockSize;
+
+        /// The number of free buffers kept for reuse
+        std::size_t mMaxFree;
+
+        /// The free buffers
+        std::vector<ByteBuffer> mFree;
+};
+
+#endif // ! _BUFFER_POOL_HPP_
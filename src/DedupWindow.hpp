@@ -0,0 +1,218 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _DEDUP_WINDOW_HPP_
+#define _DEDUP_WINDOW_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+//
+// Remembers the keys seen during the last time window, together with a
+// value for each key, so that repeated keys can be detected and merged.
+// A key stays remembered for the window duration since it was inserted
+// or last refreshed, and the number of remembered keys never exceeds the
+// capacity: when it is reached the least recently used key is forgotten
+// first.
+//
+
+template<typename V>
+class DedupWindow
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /// Constructor, a zero window disables the detection
+        DedupWindow(std::chrono::milliseconds window, std::size_t capacity);
+
+        /// Changes the time window and the maximum number of remembered keys
+        void Configure(std::chrono::milliseconds window, std::size_t capacity);
+
+        /// Retrieves the value of the given key if it was inserted within the window
+        V* Find(const std::string& key, Clock::time_point now);
+
+        /// Remembers the given key with the given value, replacing any previous value
+        void Insert(const std::string& key, V value, Clock::time_point now);
+
+        /// Restarts the window of the given key, if it is remembered
+        void Refresh(const std::string& key, Clock::time_point now);
+
+        /// Forgets the given key
+        void Erase(const std::string& key);
+
+        /// Forgets all the keys
+        void Clear();
+
+        /// Retrieves the number of remembered keys
+        std::size_t Size() const;
+
+    private:
+        struct Entry
+        {
+            V value;
+            Clock::time_point inserted;
+            std::uint64_t seq;
+        };
+
+        /// Forgets the keys that fell out of the window or exceed the capacity
+        void Evict(Clock::time_point now);
+
+        /// Drops the stale order items
+        void Compact();
+
+        /// The remembered keys
+        std::unordered_map<std::string, Entry> mEntries;
+
+        /// The keys in insertion or refresh order, paired with the sequence number that tells stale items apart
+        std::deque<std::pair<std::string, std::uint64_t>> mOrder;
+
+        /// The time window and the maximum number of remembered keys
+        std::chrono::milliseconds mWindow;
+        std::size_t mCapacity;
+
+        /// The insertion sequence number generator
+        std::uint64_t mSeq;
+};
+
+template<typename V>
+DedupWindow<V>::DedupWindow(std::chrono::milliseconds window, std::size_t capacity)
+    : mWindow(window),
+      mCapacity(capacity),
+      mSeq(0)
+{
+    mEntries.reserve(capacity);
+}
+
+template<typename V>
+void DedupWindow<V>::Configure(std::chrono::milliseconds window, std::size_t capacity)
+{
+    mWindow = window;
+    mCapacity = capacity;
+    Evict(Clock::now());
+}
+
+template<typename V>
+V* DedupWindow<V>::Find(const std::string& key, Clock::time_point now)
+{
+    if (mWindow.count() == 0)
+        return nullptr;
+
+    Evict(now);
+    auto e = mEntries.find(key);
+    return e != std::end(mEntries) ? &e->second.value : nullptr;
+}
+
+template<typename V>
+void DedupWindow<V>::Insert(const std::string& key, V value, Clock::time_point now)
+{
+    if (mWindow.count() == 0 || mCapacity == 0)
+        return;
+
+    Entry e = { std::move(value), now, mSeq++ };
+    mEntries[key] = std::move(e);
+    mOrder.emplace_back(key, mSeq - 1);
+    Evict(now);
+}
+
+template<typename V>
+void DedupWindow<V>::Refresh(const std::string& key, Clock::time_point now)
+{
+    auto e = mEntries.find(key);
+    if (e == std::end(mEntries))
+        return;
+
+    // The previous order item of the key goes stale, the new one moves the key to the back
+    e->second.inserted = now;
+    e->second.seq = mSeq++;
+    mOrder.emplace_back(key, e->second.seq);
+    Evict(now);
+}
+
+template<typename V>
+void DedupWindow<V>::Erase(const std::string& key)
+{
+    // The order item is left behind and skipped as stale once it reaches the front
+    mEntries.erase(key);
+}
+
+template<typename V>
+void DedupWindow<V>::Clear()
+{
+    mEntries.clear();
+    mOrder.clear();
+}
+
+template<typename V>
+std::size_t DedupWindow<V>::Size() const
+{
+    return mEntries.size();
+}
+
+template<typename V>
+void DedupWindow<V>::Evict(Clock::time_point now)
+{
+    // A key refreshed over and over piles up stale items behind the live front, so they are dropped all at once
+    // before they outnumber the keys, rather than by evicting live keys to make room
+    if (mOrder.size() > 2 * mCapacity)
+        Compact();
+
+    while (!mOrder.empty())
+    {
+        auto e = mEntries.find(mOrder.front().first);
+        bool live = e != std::end(mEntries) && e->second.seq == mOrder.front().second;
+
+        // Stale order items are dropped, live ones only when too old or too many
+        if (live && now - e->second.inserted < mWindow && mEntries.size() <= mCapacity)
+            break;
+        if (live)
+            mEntries.erase(e);
+        mOrder.pop_front();
+    }
+}
+
+template<typename V>
+void DedupWindow<V>::Compact()
+{
+    // Leaves at most one item per key, so the next compaction is at least a capacity of insertions away
+    std::deque<std::pair<std::string, std::uint64_t>> live;
+    for (auto& item : mOrder)
+    {
+        auto e = mEntries.find(item.first);
+        if (e != std::end(mEntries) && e->second.seq == item.second)
+            live.push_back(std::move(item));
+    }
+    mOrder.swap(live);
+}
+
+#endif // ! _DEDUP_WINDOW_HPP_
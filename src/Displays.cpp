@@ -0,0 +1,74 @@
+#include "Displays.hpp"
+#include <tchar.h>
+#include <Windows.h>
+
+// Loaded dynamically as they are not available before Windows 8.1
+typedef HRESULT (WINAPI* SetProcessDpiAwarenessFn)(int);
+typedef HRESULT (WINAPI* GetDpiForMonitorFn)(HMONITOR, int, UINT*, UINT*);
+
+// Values of the PROCESS_DPI_AWARENESS and MONITOR_DPI_TYPE enums
+static const int processPerMonitorDpiAware = 2;
+static const int mdtEffectiveDpi = 0;
+
+// Retrieves the given shcore.dll function or nullptr if the running system does not provide it
+template<typename Fn>
+static Fn GetShcoreProc(const char* name)
+{
+    static HMODULE shcore = LoadLibrary(_T("shcore.dll"));
+    if (!shcore)
+        return nullptr;
+    return reinterpret_cast<Fn>(GetProcAddress(shcore, name));
+}
+
+void EnableDpiAwareness()
+{
+    auto setAwareness = GetShcoreProc<SetProcessDpiAwarenessFn>("SetProcessDpiAwareness");
+    if (setAwareness && SUCCEEDED(setAwareness(processPerMonitorDpiAware)))
+        return;
+
+    // Fall back to system dpi awareness
+    SetProcessDPIAware();
+}
+
+static BOOL CALLBACK CollectDisplay(HMONITOR hMon, HDC hdc, LPRECT rc, LPARAM ll)
+{
+    UNREFERENCED_PARAMETER(hdc);
+    UNREFERENCED_PARAMETER(rc);
+    auto displays = reinterpret_cast<std::vector<DisplayInfo>*>(ll);
+
+    MONITORINFO mi = {};
+    mi.cbSize = sizeof(MONITORINFO);
+    if (!GetMonitorInfo(hMon, &mi))
+        return TRUE;
+
+    DisplayInfo d;
+    d.workArea.left = mi.rcWork.left;
+    d.workArea.top = mi.rcWork.top;
+    d.workArea.right = mi.rcWork.right;
+    d.workArea.bottom = mi.rcWork.bottom;
+
+    // Use the per monitor dpi if the system provides it, or the system dpi otherwise
+    UINT dpiX = 0, dpiY = 0;
+    auto getDpi = GetShcoreProc<GetDpiForMonitorFn>("GetDpiForMonitor");
+    if (!getDpi || FAILED(getDpi(hMon, mdtEffectiveDpi, &dpiX, &dpiY)))
+    {
+        HDC screen = GetDC(0);
+        dpiX = GetDeviceCaps(screen, LOGPIXELSX);
+        ReleaseDC(0, screen);
+    }
+    d.dpi = dpiX;
+
+    // Keep the primary display in front
+    if (mi.dwFlags & MONITORINFOF_PRIMARY)
+        displays->insert(displays->begin(), d);
+    else
+        displays->push_back(d);
+    return TRUE;
+}
+
+std::vector<DisplayInfo> QueryDisplays()
+{
+    std::vector<DisplayInfo> displays;
+    EnumDisplayMonitors(0, nullptr, CollectDisplay, reinterpret_cast<LPARAM>(&displays));
+    return displays;
+}
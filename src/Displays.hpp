@@ -0,0 +1,13 @@
+#ifndef _DISPLAYS_HPP_
+#define _DISPLAYS_HPP_
+
+#include <vector>
+#include "StackLayout.hpp"
+
+/// Makes the process per monitor dpi aware where supported, must be called before any window is created
+void EnableDpiAwareness();
+
+/// Retrieves the work areas and dpi of the attached displays, primary display first
+std::vector<DisplayInfo> QueryDisplays();
+
+#endif // ! _DISPLAYS_HPP_
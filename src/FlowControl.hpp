@@ -0,0 +1,144 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _FLOW_CONTROL_HPP_
+#define _FLOW_CONTROL_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+//
+// Tracks the depth of a queue between a producer and a consumer thread
+// and tells the producer to pause once the depth reaches the high
+// watermark. The pause lasts until the consumer drains the queue down to
+// the low watermark, at which point the resume callback is called from
+// the consumer thread, so it must only hand the work over to the
+// producer thread.
+//
+
+class FlowControl
+{
+    public:
+        /// Constructor, takes as arguments the high and low watermarks
+        FlowControl(std::size_t high = 512, std::size_t low = 128);
+
+        /// Disable copy construction
+        FlowControl(const FlowControl& rhs) = delete;
+        FlowControl& operator=(const FlowControl& rhs) = delete;
+
+        /// Sets the depth that pauses the producer and the depth that resumes it
+        void SetWatermarks(std::size_t high, std::size_t low);
+
+        /// Sets the function called from the consumer thread when the producer may resume
+        void SetResumeCallback(std::function<void()> cb);
+
+        /// Called by the producer for every item it queues
+        void OnQueued();
+
+        /// Called by the consumer for every item it takes off the queue
+        void OnDrained();
+
+        /// Checks whether the producer should stop queueing
+        bool IsPaused() const;
+
+        /// Retrieves the number of queued items
+        std::size_t GetDepth() const;
+
+        /// Retrieves the number of times the producer was paused
+        std::size_t GetPauseCount() const;
+
+    private:
+        /// The watermarks
+        std::atomic<std::size_t> mHigh, mLow;
+
+        /// The number of queued items
+        std::atomic<std::size_t> mDepth;
+
+        /// Set from the moment the high watermark is reached until the low one is
+        std::atomic<bool> mPaused;
+
+        /// The number of times the producer was paused
+        std::atomic<std::size_t> mPauses;
+
+        /// Called when the producer may resume
+        std::function<void()> mResumeCallback;
+};
+
+inline FlowControl::FlowControl(std::size_t high, std::size_t low)
+    : mHigh(high),
+      mLow(low),
+      mDepth(0),
+      mPaused(false),
+      mPauses(0)
+{
+}
+
+inline void FlowControl::SetWatermarks(std::size_t high, std::size_t low)
+{
+    mHigh = high;
+    mLow = low;
+}
+
+inline void FlowControl::SetResumeCallback(std::function<void()> cb)
+{
+    mResumeCallback = cb;
+}
+
+inline void FlowControl::OnQueued()
+{
+    std::size_t depth = mDepth.fetch_add(1) + 1;
+    if (depth >= mHigh.load() && !mPaused.exchange(true))
+        ++mPauses;
+}
+
+inline void FlowControl::OnDrained()
+{
+    std::size_t depth = mDepth.fetch_sub(1) - 1;
+    if (depth <= mLow.load() && mPaused.exchange(false) && mResumeCallback)
+        mResumeCallback();
+}
+
+inline bool FlowControl::IsPaused() const
+{
+    return mPaused.load();
+}
+
+inline std::size_t FlowControl::GetDepth() const
+{
+    return mDepth.load();
+}
+
+inline std::size_t FlowControl::GetPauseCount() const
+{
+    return mPauses.load();
+}
+
+#endif // ! _FLOW_CONTROL_HPP_
@@ -0,0 +1,130 @@
+#include "FrameTiming.hpp"
+#include <algorithm>
+#include <limits>
+#include "Metrics.hpp"
+#include "Trace.hpp"
+
+// The frame time, the time the variable updates of a tick take, and the tick to tick time
+static Histogram& frameTime = GetMetrics().GetHistogram("animation_frame_us", "Time taken by the variable updates of an animation frame");
+static Histogram& frameInterval = GetMetrics().GetHistogram("animation_frame_interval_us", "Time between the starts of consecutive animation frames");
+static Counter& framesTotal = GetMetrics().GetCounter("animation_frames_total", "Animation frames ticked");
+static Counter& jankTotal = GetMetrics().GetCounter("animation_jank_frames_total", "Animation frames that came after a missed refresh deadline");
+static Counter& missedTotal = GetMetrics().GetCounter("animation_missed_deadlines_total", "Refresh periods that passed without an animation frame while animating");
+
+// The frame in progress on the calling thread, the target of the tween and window update counts
+static thread_local FrameRecord* currentFrame = nullptr;
+
+// Converts the given duration to whole microseconds, clamped to the record fields
+static std::uint32_t ToMicroseconds(FrameTiming::Clock::duration d)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    if (us <= 0)
+        return 0;
+    return static_cast<std::uint32_t>(std::min<decltype(us)>(us, std::numeric_limits<std::uint32_t>::max()));
+}
+
+FrameTiming::FrameTiming(Clock::duration refreshPeriod)
+    : mRefreshPeriod(refreshPeriod),
+      mHasLast(false),
+      mFrame(),
+      mTraceStart(0),
+      mFrameCount(0),
+      mJankCount(0)
+{
+}
+
+void FrameTiming::SetRefreshPeriod(Clock::duration refreshPeriod)
+{
+    if (refreshPeriod > Clock::duration::zero())
+        mRefreshPeriod = refreshPeriod;
+}
+
+auto FrameTiming::GetRefreshPeriod() const -> Clock::duration
+{
+    return mRefreshPeriod;
+}
+
+void FrameTiming::BeginFrame(Clock::time_point now)
+{
+    mFrame = FrameRecord();
+    mFrame.start = now;
+    mTraceStart = IsTracing() ? GetTraceTime() : 0;
+
+    // A tick is due every refresh period, one that comes more than half a period late missed the vsync
+    // deadlines in between. The first tick after idle has nothing to be late against.
+    if (mHasLast)
+    {
+        Clock::duration interval = now - mLast;
+        mFrame.interval = ToMicroseconds(interval);
+        if (interval > mRefreshPeriod + mRefreshPeriod / 2)
+            mFrame.missedDeadlines = static_cast<std::uint32_t>((interval + mRefreshPeriod / 2) / mRefreshPeriod - 1);
+    }
+    mLast = now;
+    mHasLast = true;
+
+    currentFrame = &mFrame;
+}
+
+const FrameRecord& FrameTiming::EndFrame(Clock::time_point now)
+{
+    currentFrame = nullptr;
+    mFrame.updateTime = ToMicroseconds(now - mFrame.start);
+    if (mTraceStart != 0)
+        TraceComplete("Animation::Frame", mTraceStart, GetTraceTime());
+
+    frameTime.Record(mFrame.updateTime);
+    if (mFrame.interval != 0)
+        frameInterval.Record(mFrame.interval);
+    framesTotal.Add();
+    if (mFrame.missedDeadlines != 0)
+    {
+        jankTotal.Add();
+        missedTotal.Add(mFrame.missedDeadlines);
+        ++mJankCount;
+    }
+
+    // The history is allocated on the first frame, the animator of a process that never animates keeps none
+    if (mHistory.empty())
+        mHistory.resize(FrameHistorySize);
+    FrameRecord& slot = mHistory[mFrameCount % FrameHistorySize];
+    slot = mFrame;
+    ++mFrameCount;
+    return slot;
+}
+
+void FrameTiming::Restart()
+{
+    mHasLast = false;
+}
+
+std::vector<FrameRecord> FrameTiming::GetRecentFrames() const
+{
+    std::vector<FrameRecord> frames;
+    std::uint64_t count = std::min<std::uint64_t>(mFrameCount, FrameHistorySize);
+    frames.reserve(static_cast<std::size_t>(count));
+    for (std::uint64_t i = mFrameCount - count; i < mFrameCount; ++i)
+        frames.push_back(mHistory[i % FrameHistorySize]);
+    return frames;
+}
+
+std::uint64_t FrameTiming::GetFrameCount() const
+{
+    return mFrameCount;
+}
+
+std::uint64_t FrameTiming::GetJankCount() const
+{
+    return mJankCount;
+}
+
+void FrameTiming::CountTween()
+{
+    if (currentFrame)
+        ++currentFrame->tweens;
+}
+
+void FrameTiming::CountWindowUpdate()
+{
+    if (currentFrame)
+        ++currentFrame->windowUpdates;
+}
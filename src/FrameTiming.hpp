@@ -0,0 +1,134 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _FRAME_TIMING_HPP_
+#define _FRAME_TIMING_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+//
+// Frame timing of the animation loop. The animation timer brackets every
+// tick with BeginFrame and EndFrame, and the variable update callbacks and
+// the window commits they cause report themselves in between, so a frame
+// record tells when the tick started, how long its updates took, how many
+// tweens and window updates it did, and how many refresh periods passed
+// since the previous tick without a frame. Every frame feeds the frame time
+// histograms and a late one the jank counter, so that the animation path
+// shows up in the metrics on screen and in headless benchmarks alike.
+//
+
+/// The number of frames kept by a FrameTiming for inspection
+static const std::size_t FrameHistorySize = 256;
+
+/// The timing of a single animation frame
+struct FrameRecord
+{
+    /// The time the tick started
+    std::chrono::steady_clock::time_point start;
+
+    /// The time the variable updates of the tick took, in microseconds
+    std::uint32_t updateTime;
+
+    /// The time since the start of the previous tick in microseconds, zero for the first tick of an animation
+    std::uint32_t interval;
+
+    /// The number of animation variable updates of the tick
+    std::uint32_t tweens;
+
+    /// The number of geometry and opacity changes pushed to the windows during the tick
+    std::uint32_t windowUpdates;
+
+    /// The number of refresh periods that passed without a tick before this one
+    std::uint32_t missedDeadlines;
+};
+
+class FrameTiming
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /// Constructor, the default refresh period is the one of a 60Hz display
+        explicit FrameTiming(Clock::duration refreshPeriod = std::chrono::microseconds(16667));
+
+        /// Disable copying, the frame in progress is bound to the instance
+        FrameTiming(const FrameTiming&) = delete;
+        FrameTiming& operator=(const FrameTiming&) = delete;
+
+        /// Sets the display refresh period the tick intervals are compared against
+        void SetRefreshPeriod(Clock::duration refreshPeriod);
+
+        /// Retrieves the display refresh period
+        Clock::duration GetRefreshPeriod() const;
+
+        /// Starts a frame on the calling thread, the tweens and window updates of the thread are counted to it until EndFrame
+        void BeginFrame(Clock::time_point now = Clock::now());
+
+        /// Ends the frame in progress, records it to the metrics and returns it
+        const FrameRecord& EndFrame(Clock::time_point now = Clock::now());
+
+        /// Forgets the previous tick, so that the idle time before the next animation is not taken as missed frames
+        void Restart();
+
+        /// Retrieves the most recent frames, oldest first
+        std::vector<FrameRecord> GetRecentFrames() const;
+
+        /// Retrieves the number of frames recorded so far
+        std::uint64_t GetFrameCount() const;
+
+        /// Retrieves the number of frames recorded so far that came after a missed deadline
+        std::uint64_t GetJankCount() const;
+
+        /// Counts an animation variable update to the frame in progress on the calling thread, if any
+        static void CountTween();
+
+        /// Counts a window update to the frame in progress on the calling thread, if any
+        static void CountWindowUpdate();
+
+    private:
+        /// The display refresh period
+        Clock::duration mRefreshPeriod;
+
+        /// The start of the previous tick, meaningful only while mHasLast is set
+        Clock::time_point mLast;
+        bool mHasLast;
+
+        /// The frame in progress and the trace time it started at, zero when tracing was off
+        FrameRecord mFrame;
+        std::uint64_t mTraceStart;
+
+        /// The ring of the recent frames, mFrameCount tells the next slot
+        std::vector<FrameRecord> mHistory;
+        std::uint64_t mFrameCount;
+        std::uint64_t mJankCount;
+};
+
+#endif // ! _FRAME_TIMING_HPP_
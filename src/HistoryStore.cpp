@@ -0,0 +1,886 @@
+#include "HistoryStore.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Trace.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Identifies a segment file
+static const std::uint32_t segmentMagic = 0x5348464E;
+
+// The segment layout version
+static const std::uint32_t segmentVersion = 1;
+
+// The size of the segment header, the first record follows it
+static const std::uint32_t segmentHeaderSize = 64;
+
+// The offset of the used bytes in the segment header
+static const std::size_t usedOffset = 20;
+
+// Marks the end of the record links
+static const std::uint32_t noRecord = 0xFFFFFFFF;
+
+// The id of a source that is not in the history
+static const std::uint32_t noSource = 0xFFFFFFFF;
+
+// Every this many records of a segment the time index gets an entry
+static const std::uint32_t markInterval = 64;
+
+// The segment size limits, a segment must hold the longest source and key and the offsets are 32 bits
+static const std::size_t minSegmentBytes = 256 * 1024;
+static const std::size_t maxSegmentBytes = 1024 * 1024 * 1024;
+
+struct SegmentHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t id;
+    std::uint32_t capacity;
+    std::uint32_t used;
+};
+
+struct RecordHeader
+{
+    std::uint32_t size;
+    std::uint32_t prev;
+    std::uint32_t prevSource;
+    std::uint8_t priority;
+    std::uint8_t reserved0;
+    std::uint16_t sourceLength;
+    std::int64_t time;
+    std::uint16_t keyLength;
+    std::uint16_t reserved1;
+    std::uint32_t textLength;
+};
+
+static_assert(sizeof(SegmentHeader) <= segmentHeaderSize, "The segment header does not fit");
+static_assert(sizeof(RecordHeader) == 32, "The record header must be packed");
+
+static std::uint32_t Align8(std::size_t n)
+{
+    return static_cast<std::uint32_t>((n + 7) & ~static_cast<std::size_t>(7));
+}
+
+static std::int64_t NowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// The name of the file of the given segment, zero padded so that the names sort like the ids
+static std::string SegmentName(std::uint64_t id)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "history-%016llx.seg", static_cast<unsigned long long>(id));
+    return name;
+}
+
+// Parses the id out of a segment file name, returns zero if it is not one
+static std::uint64_t ParseSegmentName(const char* name)
+{
+    static const std::size_t nameLength = 8 + 16 + 4;
+    if (std::strlen(name) != nameLength || std::strncmp(name, "history-", 8) != 0 || std::strcmp(name + 24, ".seg") != 0)
+        return 0;
+    char* end = nullptr;
+    std::uint64_t id = std::strtoull(name + 8, &end, 16);
+    return end == name + 24 ? id : 0;
+}
+
+// Creates the given directory if it does not exist and lists the segment ids in it
+static bool ListSegments(const std::string& directory, std::vector<std::uint64_t>& ids)
+{
+#if defined(_WIN32)
+    if (!CreateDirectoryA(directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+        return false;
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA((directory + "\\history-*.seg").c_str(), &fd);
+    if (h == INVALID_HANDLE_VALUE)
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    do
+    {
+        std::uint64_t id = ParseSegmentName(fd.cFileName);
+        if (id != 0)
+            ids.push_back(id);
+    } while (FindNextFileA(h, &fd));
+    FindClose(h);
+#else
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+        return false;
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+        return false;
+    while (dirent* e = readdir(dir))
+    {
+        std::uint64_t id = ParseSegmentName(e->d_name);
+        if (id != 0)
+            ids.push_back(id);
+    }
+    closedir(dir);
+#endif
+    std::sort(ids.begin(), ids.end());
+    return true;
+}
+
+// Cuts the given file down to the given size
+static bool ResizeFile(const std::string& path, std::size_t size)
+{
+#if defined(_WIN32)
+    HANDLE f = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (f == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER li;
+    li.QuadPart = static_cast<LONGLONG>(size);
+    bool ok = SetFilePointerEx(f, li, nullptr, FILE_BEGIN) && SetEndOfFile(f);
+    CloseHandle(f);
+    return ok;
+#else
+    return truncate(path.c_str(), static_cast<off_t>(size)) == 0;
+#endif
+}
+
+// Reads the header of the record at the given offset, returns false if there is no sound record there
+static bool ReadRecord(const char* base, std::uint32_t used, std::uint32_t off, RecordHeader& r)
+{
+    if (off < segmentHeaderSize || off % 8 != 0 || off > used || used - off < sizeof(RecordHeader))
+        return false;
+    std::memcpy(&r, base + off, sizeof(r));
+    std::size_t content = sizeof(RecordHeader) + r.sourceLength + r.keyLength + std::size_t(r.textLength);
+    return content <= used - off && r.priority < PriorityLevels;
+}
+
+// Adds the record at the given offset to the page of the query. Returns false if the page is full,
+// the record is then where the next page starts
+static bool AddEntry(const HistoryQuery& q, std::uint64_t segment, const char* base, std::uint32_t off,
+                     const RecordHeader& r, HistoryPage& page)
+{
+    if (page.entries.size() >= std::min(std::max<std::size_t>(q.limit, 1), HistoryMaxQueryLimit))
+    {
+        page.next = (segment << 32) | off;
+        return false;
+    }
+
+    const char* p = base + off + sizeof(RecordHeader);
+    HistoryEntry e;
+    e.time = r.time;
+    e.priority = static_cast<Priority>(r.priority);
+    e.source.assign(p, r.sourceLength);
+    e.dedupKey.assign(p + r.sourceLength, r.keyLength);
+    e.msg.assign(p + r.sourceLength + r.keyLength, r.textLength);
+    page.entries.push_back(std::move(e));
+    return true;
+}
+
+///==============================================================
+///= MappedFile
+///==============================================================
+
+// A whole file mapped into memory, the file and mapping handles are closed as soon as the view exists
+class MappedFile
+{
+    public:
+        MappedFile() : mData(nullptr), mSize(0) {}
+        ~MappedFile() { Close(); }
+
+        MappedFile(const MappedFile& rhs) = delete;
+        MappedFile& operator=(const MappedFile& rhs) = delete;
+
+        // Maps the given file, a writable file is created if needed and sized to the given size,
+        // a read only file is mapped as big as it is
+        bool Open(const std::string& path, std::size_t size, bool writable)
+        {
+            Close();
+#if defined(_WIN32)
+            HANDLE f = CreateFileA(path.c_str(), GENERIC_READ | (writable ? GENERIC_WRITE : 0),
+                                   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                   writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (f == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER li;
+            bool sized;
+            if (writable)
+            {
+                li.QuadPart = static_cast<LONGLONG>(size);
+                sized = SetFilePointerEx(f, li, nullptr, FILE_BEGIN) && SetEndOfFile(f);
+            }
+            else
+            {
+                sized = GetFileSizeEx(f, &li) != 0;
+                size = static_cast<std::size_t>(li.QuadPart);
+            }
+            HANDLE m = sized && size != 0
+                ? CreateFileMappingA(f, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr)
+                : nullptr;
+            CloseHandle(f);
+            if (!m)
+                return false;
+            void* view = MapViewOfFile(m, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+            CloseHandle(m);
+            if (!view)
+                return false;
+#else
+            int fd = open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            bool sized = writable ? ftruncate(fd, static_cast<off_t>(size)) == 0 : fstat(fd, &st) == 0;
+            if (!writable && sized)
+                size = static_cast<std::size_t>(st.st_size);
+            void* view = sized && size != 0
+                ? mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0)
+                : MAP_FAILED;
+            close(fd);
+            if (view == MAP_FAILED)
+                return false;
+#endif
+            mData = static_cast<char*>(view);
+            mSize = size;
+            return true;
+        }
+
+        void Close()
+        {
+            if (!mData)
+                return;
+#if defined(_WIN32)
+            UnmapViewOfFile(mData);
+#else
+            munmap(mData, mSize);
+#endif
+            mData = nullptr;
+            mSize = 0;
+        }
+
+        bool IsOpen() const { return mData != nullptr; }
+        char* Data() const { return mData; }
+        std::size_t Size() const { return mSize; }
+
+    private:
+        char* mData;
+        std::size_t mSize;
+};
+
+// The documents of a search term, the union of the lists of the words it matches
+class TermCursor
+{
+    public:
+        explicit TermCursor(const std::vector<const PostingList*>& lists)
+            : mSize(0),
+              mStarted(false)
+        {
+            mCursors.reserve(lists.size());
+            for (const PostingList* l : lists)
+            {
+                mCursors.emplace_back(*l);
+                mSize += l->Size();
+            }
+        }
+
+        // Finds the largest document of any of the lists that is not above the given one,
+        // the given documents must never grow between calls
+        bool SeekDown(std::uint32_t bound, std::uint32_t& id)
+        {
+            // The lists are kept in a heap by their largest document not above the last bound
+            if (!mStarted)
+            {
+                mStarted = true;
+                for (std::size_t i = 0; i < mCursors.size(); ++i)
+                {
+                    std::uint32_t x;
+                    if (mCursors[i].SeekDown(bound, x))
+                        mHeap.emplace_back(x, i);
+                }
+                std::make_heap(mHeap.begin(), mHeap.end());
+            }
+
+            // Only the lists past the new bound move, the rest are still at their largest document under it
+            while (!mHeap.empty() && mHeap.front().first > bound)
+            {
+                std::pop_heap(mHeap.begin(), mHeap.end());
+                auto& top = mHeap.back();
+                if (mCursors[top.second].SeekDown(bound, top.first))
+                    std::push_heap(mHeap.begin(), mHeap.end());
+                else
+                    mHeap.pop_back();
+            }
+            if (mHeap.empty())
+                return false;
+            id = mHeap.front().first;
+            return true;
+        }
+
+        std::size_t Size() const { return mSize; }
+
+    private:
+        std::vector<PostingList::Cursor> mCursors;
+        std::vector<std::pair<std::uint32_t, std::size_t>> mHeap;
+        std::size_t mSize;
+        bool mStarted;
+};
+
+// The pseudo word of the records of a source, words never have control characters
+static std::string SourceWord(Slice source)
+{
+    return '\x01' + source.ToString();
+}
+
+///==============================================================
+///= HistoryStore
+///==============================================================
+
+// A time index entry, the time of the record at the offset
+struct TimeMark
+{
+    std::int64_t time;
+    std::uint32_t offset;
+};
+
+// The records of a source in a segment
+struct SourceIndex
+{
+    /// The offset of the last record
+    std::uint32_t last;
+
+    /// The number of records
+    std::uint32_t count;
+
+    /// The time of every markInterval-th record
+    std::vector<TimeMark> marks;
+};
+
+struct HistoryStore::Segment
+{
+    std::uint64_t id;
+    std::string path;
+
+    /// The mapping of the segment file, closed while the segment is cold
+    MappedFile file;
+
+    /// Set for the segment that is written to, it stays mapped
+    bool writable = false;
+
+    /// The size of the file and the end of its last record
+    std::uint32_t capacity = 0;
+    std::uint32_t used = segmentHeaderSize;
+
+    /// The offset of the last record
+    std::uint32_t last = noRecord;
+
+    /// The number of records
+    std::uint32_t count = 0;
+
+    /// The times of the first and the last record
+    std::int64_t firstTime = 0;
+    std::int64_t lastTime = 0;
+
+    /// The time of every markInterval-th record
+    std::vector<TimeMark> marks;
+
+    /// The records of each source, by source id
+    std::unordered_map<std::uint32_t, SourceIndex> sources;
+
+    /// The words of the records, the document ids are the record offsets in 8 byte units
+    SearchIndex index;
+
+    /// When the segment was last used, by the hot segment eviction
+    std::uint64_t lastUse = 0;
+};
+
+HistoryStore::HistoryStore(std::string directory, HistoryOptions options)
+    : mDirectory(std::move(directory)),
+      mOptions(options),
+      mBytes(0),
+      mRecords(0),
+      mHot(0),
+      mUseClock(0),
+      mLastTime(0),
+      mNextId(1)
+{
+    mOptions.segmentBytes = std::min(std::max(mOptions.segmentBytes, minSegmentBytes), maxSegmentBytes);
+    mOptions.hotSegments = std::max<std::size_t>(mOptions.hotSegments, 1);
+}
+
+HistoryStore::~HistoryStore()
+{
+    // Cut the segment that was written to down to its records
+    if (!mSegments.empty() && mSegments.back()->writable)
+    {
+        Segment& s = *mSegments.back();
+        s.file.Close();
+        ResizeFile(s.path, s.used);
+    }
+}
+
+bool HistoryStore::Open()
+{
+    std::vector<std::uint64_t> ids;
+    if (!ListSegments(mDirectory, ids))
+        return false;
+
+    for (std::uint64_t id : ids)
+    {
+        auto s = std::make_unique<Segment>();
+        s->id = id;
+        s->path = mDirectory + "/" + SegmentName(id);
+        mNextId = std::max(mNextId, id + 1);
+
+        // A segment that cannot be read is left alone, the next segments still can
+        if (!Load(*s))
+            continue;
+        mBytes += s->capacity;
+        mRecords += s->count;
+        mLastTime = std::max(mLastTime, s->lastTime);
+        mSegments.push_back(std::move(s));
+    }
+
+    // The records of the previous run are never written to again, the first record starts a new segment
+    Retire(NowMs());
+    if (!mSegments.empty())
+        Touch(*mSegments.back());
+    return true;
+}
+
+bool HistoryStore::Load(Segment& s)
+{
+    if (!s.file.Open(s.path, 0, false))
+        return false;
+
+    SegmentHeader h;
+    const char* base = s.file.Data();
+    std::size_t size = s.file.Size();
+    if (size >= segmentHeaderSize)
+        std::memcpy(&h, base, sizeof(h));
+    if (size < segmentHeaderSize || size > maxSegmentBytes
+     || h.magic != segmentMagic || h.version != segmentVersion || h.id != s.id)
+    {
+        s.file.Close();
+        return false;
+    }
+    ++mHot;
+    s.lastUse = ++mUseClock;
+
+    // Index the records up to the used bytes, a record that does not make sense ends the segment
+    std::uint32_t used = std::min(std::max(h.used, segmentHeaderSize), static_cast<std::uint32_t>(size));
+    std::uint32_t off = segmentHeaderSize;
+    while (used - off >= sizeof(RecordHeader))
+    {
+        RecordHeader r;
+        std::memcpy(&r, base + off, sizeof(r));
+        std::size_t content = sizeof(RecordHeader) + r.sourceLength + r.keyLength + std::size_t(r.textLength);
+        if (r.size % 8 != 0 || r.size > used - off || content > r.size || r.priority >= PriorityLevels)
+            break;
+
+        const char* p = base + off + sizeof(RecordHeader);
+        Slice source(p, r.sourceLength);
+        Index(s, SourceId(source.ToString(), true), r.time, off, source, Slice(p + r.sourceLength, r.keyLength),
+              Slice(p + r.sourceLength + r.keyLength, r.textLength));
+        off += r.size;
+    }
+    s.used = off;
+    s.capacity = static_cast<std::uint32_t>(size);
+    s.index.Seal();
+    return true;
+}
+
+void HistoryStore::Record(const NotificationData& data)
+{
+    Record(data, NowMs());
+}
+
+void HistoryStore::Record(const NotificationData& data, std::int64_t timeMs)
+{
+    TRACE_SCOPE("HistoryStore::Record");
+
+    // The links and the time index rely on the records being in time order
+    std::int64_t time = std::max(timeMs, mLastTime);
+
+    // Overlong fields are cut, the text so that the record fits in an empty segment
+    std::size_t sourceLength = std::min<std::size_t>(data.source.size(), 0xFFFF);
+    std::size_t keyLength = std::min<std::size_t>(data.dedupKey.size(), 0xFFFF);
+    std::size_t textLength = std::min<std::size_t>(data.msg.size(),
+        mOptions.segmentBytes - segmentHeaderSize - sizeof(RecordHeader) - sourceLength - keyLength - 8);
+    std::uint32_t size = Align8(sizeof(RecordHeader) + sourceLength + keyLength + textLength);
+
+    if (mSegments.empty() || !mSegments.back()->writable || mSegments.back()->capacity - mSegments.back()->used < size)
+    {
+        if (!Roll(time))
+            return;
+    }
+    Segment& s = *mSegments.back();
+    std::uint32_t sid = SourceId(data.source.substr(0, sourceLength), true);
+    auto source = s.sources.find(sid);
+
+    RecordHeader r = {};
+    r.size = size;
+    r.prev = s.last;
+    r.prevSource = source != s.sources.end() ? source->second.last : noRecord;
+    r.priority = static_cast<std::uint8_t>(data.priority);
+    r.sourceLength = static_cast<std::uint16_t>(sourceLength);
+    r.time = time;
+    r.keyLength = static_cast<std::uint16_t>(keyLength);
+    r.textLength = static_cast<std::uint32_t>(textLength);
+
+    char* p = s.file.Data() + s.used;
+    std::memcpy(p, &r, sizeof(r));
+    p += sizeof(r);
+    std::memcpy(p, data.source.data(), sourceLength);
+    p += sourceLength;
+    std::memcpy(p, data.dedupKey.data(), keyLength);
+    p += keyLength;
+    std::memcpy(p, data.msg.data(), textLength);
+    p += textLength;
+    std::memset(p, 0, s.file.Data() + s.used + size - p);
+
+    Index(s, sid, time, s.used, Slice(data.source.data(), sourceLength), Slice(data.dedupKey.data(), keyLength),
+          Slice(data.msg.data(), textLength));
+    s.used += size;
+
+    // The record counts once the used bytes cover it
+    std::memcpy(s.file.Data() + usedOffset, &s.used, sizeof(s.used));
+    mLastTime = time;
+    ++mRecords;
+}
+
+void HistoryStore::Index(Segment& s, std::uint32_t sid, std::int64_t time, std::uint32_t off, Slice source, Slice key,
+                         Slice text)
+{
+    s.index.Add(off / 8, text);
+    s.index.Add(off / 8, key);
+    s.index.AddWord(off / 8, SourceWord(source));
+
+    if (s.count % markInterval == 0)
+        s.marks.push_back(TimeMark{time, off});
+    if (s.count == 0)
+        s.firstTime = time;
+    s.lastTime = std::max(s.lastTime, time);
+    s.last = off;
+    ++s.count;
+
+    auto it = s.sources.find(sid);
+    if (it == s.sources.end())
+        it = s.sources.emplace(sid, SourceIndex{noRecord, 0, std::vector<TimeMark>()}).first;
+    SourceIndex& bySource = it->second;
+    if (bySource.count % markInterval == 0)
+        bySource.marks.push_back(TimeMark{time, off});
+    bySource.last = off;
+    ++bySource.count;
+}
+
+bool HistoryStore::Roll(std::int64_t now)
+{
+    // Seal the current segment, its file is cut to its records and mapped read only while it is hot
+    if (!mSegments.empty() && mSegments.back()->writable)
+    {
+        Segment& cur = *mSegments.back();
+        cur.file.Close();
+        cur.writable = false;
+        cur.index.Seal();
+        if (ResizeFile(cur.path, cur.used))
+        {
+            mBytes -= cur.capacity - cur.used;
+            cur.capacity = cur.used;
+        }
+        if (!cur.file.Open(cur.path, 0, false))
+            --mHot;
+    }
+
+    auto s = std::make_unique<Segment>();
+    s->id = mNextId++;
+    s->path = mDirectory + "/" + SegmentName(s->id);
+    if (!s->file.Open(s->path, mOptions.segmentBytes, true))
+        return false;
+    s->writable = true;
+    s->capacity = static_cast<std::uint32_t>(mOptions.segmentBytes);
+
+    SegmentHeader h = {};
+    h.magic = segmentMagic;
+    h.version = segmentVersion;
+    h.id = s->id;
+    h.capacity = s->capacity;
+    h.used = segmentHeaderSize;
+    std::memset(s->file.Data(), 0, segmentHeaderSize);
+    std::memcpy(s->file.Data(), &h, sizeof(h));
+
+    ++mHot;
+    mBytes += s->capacity;
+    mSegments.push_back(std::move(s));
+    Retire(now);
+    return Touch(*mSegments.back());
+}
+
+void HistoryStore::Retire(std::int64_t now)
+{
+    std::int64_t oldest = now - std::chrono::duration_cast<std::chrono::milliseconds>(mOptions.maxAge).count();
+    while (mSegments.size() > 1)
+    {
+        Segment& s = *mSegments.front();
+        if (mBytes <= mOptions.maxBytes && s.lastTime >= oldest)
+            break;
+        if (s.file.IsOpen())
+        {
+            s.file.Close();
+            --mHot;
+        }
+        std::remove(s.path.c_str());
+        mBytes -= s.capacity;
+        mRecords -= s.count;
+        mSegments.erase(mSegments.begin());
+    }
+}
+
+bool HistoryStore::Touch(Segment& s)
+{
+    s.lastUse = ++mUseClock;
+    if (!s.file.IsOpen())
+    {
+        if (!s.file.Open(s.path, 0, false) || s.file.Size() < s.used)
+        {
+            s.file.Close();
+            return false;
+        }
+        ++mHot;
+    }
+
+    // Unmap the least recently used segments, never the one written to
+    while (mHot > mOptions.hotSegments)
+    {
+        Segment* lru = nullptr;
+        for (auto& other : mSegments)
+            if (other->file.IsOpen() && !other->writable && other.get() != &s && (!lru || other->lastUse < lru->lastUse))
+                lru = other.get();
+        if (!lru)
+            break;
+        lru->file.Close();
+        --mHot;
+    }
+    return true;
+}
+
+std::uint32_t HistoryStore::Seek(const Segment& s, std::int64_t until) const
+{
+    // Start from the last time index entry at or before the time and read on from there
+    auto mark = std::upper_bound(s.marks.begin(), s.marks.end(), until,
+        [](std::int64_t t, const TimeMark& m) { return t < m.time; });
+    if (mark == s.marks.begin())
+        return noRecord;
+
+    std::uint32_t found = noRecord;
+    for (std::uint32_t off = (mark - 1)->offset; off < s.used; )
+    {
+        RecordHeader r;
+        std::memcpy(&r, s.file.Data() + off, sizeof(r));
+        if (r.time > until)
+            break;
+        found = off;
+        off += r.size;
+    }
+    return found;
+}
+
+std::size_t HistoryStore::Find(std::uint64_t id) const
+{
+    auto it = std::lower_bound(mSegments.begin(), mSegments.end(), id,
+        [](const std::unique_ptr<Segment>& s, std::uint64_t id) { return s->id < id; });
+    return it != mSegments.end() && (*it)->id == id ? static_cast<std::size_t>(it - mSegments.begin()) : mSegments.size();
+}
+
+std::uint32_t HistoryStore::SourceId(const std::string& source, bool add)
+{
+    auto it = mSources.find(source);
+    if (it != mSources.end())
+        return it->second;
+    if (!add)
+        return noSource;
+    std::uint32_t id = static_cast<std::uint32_t>(mSources.size());
+    mSources.emplace(source, id);
+    return id;
+}
+
+HistoryPage HistoryStore::Query(const HistoryQuery& q)
+{
+    HistoryPage page;
+    std::uint32_t sid = noSource;
+    if (!q.source.empty())
+    {
+        sid = SourceId(q.source, false);
+        if (sid == noSource)
+            return page;
+    }
+
+    // A text query looks for the source like for one more word
+    std::vector<SearchTerm> terms = ParseSearch(q.text);
+    if (!terms.empty() && sid != noSource)
+        terms.push_back(SearchTerm{SourceWord(Slice(q.source.data(), q.source.size())), false});
+
+    // The cursor is the segment id and the offset of the record the page starts with
+    std::size_t i = mSegments.size();
+    std::uint32_t off = noRecord;
+    bool resume = false;
+    if (q.cursor != 0)
+    {
+        i = Find(q.cursor >> 32);
+        if (i == mSegments.size())
+            return page;
+        off = static_cast<std::uint32_t>(q.cursor & 0xFFFFFFFF);
+        resume = true;
+        ++i;
+    }
+
+    while (i-- > 0)
+    {
+        Segment& s = *mSegments[i];
+        if (s.count == 0 || (!resume && s.firstTime > q.until))
+        {
+            resume = false;
+            continue;
+        }
+        if (s.lastTime < q.since)
+            break;
+
+        // The words are looked up before the segment is mapped, most cold segments do not have them all
+        if (!terms.empty())
+        {
+            bool more = Search(s, terms, resume ? off : noRecord, q, page);
+            resume = false;
+            if (!more)
+                return page;
+            continue;
+        }
+        if (!Touch(s))
+            break;
+
+        if (!resume)
+        {
+            if (sid != noSource)
+            {
+                // The walk starts at the first time index entry of the source past the time, or at its last record
+                auto source = s.sources.find(sid);
+                if (source == s.sources.end())
+                    continue;
+                const std::vector<TimeMark>& marks = source->second.marks;
+                auto mark = std::upper_bound(marks.begin(), marks.end(), q.until,
+                    [](std::int64_t t, const TimeMark& m) { return t < m.time; });
+                off = mark != marks.end() ? mark->offset : source->second.last;
+            }
+            else
+            {
+                off = s.lastTime <= q.until ? s.last : Seek(s, q.until);
+            }
+        }
+        resume = false;
+
+        // Walk back along the links, they always point to earlier offsets of the segment
+        const char* base = s.file.Data();
+        RecordHeader r;
+        while (ReadRecord(base, s.used, off, r))
+        {
+            if (r.time < q.since)
+                return page;
+            if (r.time <= q.until && !AddEntry(q, s.id, base, off, r, page))
+                return page;
+
+            std::uint32_t next = sid != noSource ? r.prevSource : r.prev;
+            if (next != noRecord && next >= off)
+                break;
+            off = next;
+        }
+    }
+    return page;
+}
+
+bool HistoryStore::Search(Segment& s, const std::vector<SearchTerm>& terms, std::uint32_t start,
+                          const HistoryQuery& q, HistoryPage& page)
+{
+    // A segment without one of the words has no matches
+    std::vector<TermCursor> cursors;
+    cursors.reserve(terms.size());
+    for (const auto& t : terms)
+    {
+        std::vector<const PostingList*> lists = s.index.Find(t);
+        if (lists.empty())
+            return true;
+        cursors.emplace_back(lists);
+    }
+
+    // Without a cursor the search starts at the last record up to the end of the time range
+    if (!Touch(s))
+        return true;
+    if (start == noRecord)
+        start = s.lastTime <= q.until ? s.last : Seek(s, q.until);
+    if (start == noRecord)
+        return true;
+
+    // The records are the documents that every term has, found by leapfrogging down from the rarest term.
+    // The document ids are the record offsets in 8 byte units
+    std::sort(cursors.begin(), cursors.end(), [](const TermCursor& a, const TermCursor& b) { return a.Size() < b.Size(); });
+    const char* base = s.file.Data();
+    std::uint32_t bound = start / 8;
+    for (;;)
+    {
+        std::uint32_t id;
+        if (!cursors[0].SeekDown(bound, id))
+            return true;
+
+        bool all = true;
+        for (std::size_t k = 1; k < cursors.size() && all; ++k)
+        {
+            std::uint32_t other;
+            if (!cursors[k].SeekDown(id, other))
+                return true;
+            if (other != id)
+            {
+                bound = other;
+                all = false;
+            }
+        }
+        if (!all)
+            continue;
+
+        std::uint32_t off = id * 8;
+        RecordHeader r;
+        if (!ReadRecord(base, s.used, off, r))
+            return true;
+        if (r.time < q.since)
+            return false;
+        if (r.time <= q.until && !AddEntry(q, s.id, base, off, r, page))
+            return false;
+        if (id == 0)
+            return true;
+        bound = id - 1;
+    }
+}
+
+std::uint64_t HistoryStore::GetRecordCount() const
+{
+    return mRecords;
+}
+
+std::size_t HistoryStore::GetSearchMemoryUsage() const
+{
+    std::size_t usage = 0;
+    for (const auto& s : mSegments)
+        usage += s->index.GetMemoryUsage();
+    return usage;
+}
+
+std::size_t HistoryStore::GetSegmentCount() const
+{
+    return mSegments.size();
+}
+
+std::size_t HistoryStore::GetHotCount() const
+{
+    return mHot;
+}
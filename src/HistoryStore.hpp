@@ -0,0 +1,237 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _HISTORY_STORE_HPP_
+#define _HISTORY_STORE_HPP_
+
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "NotificationData.hpp"
+#include "SearchIndex.hpp"
+
+/// The history segment and retention settings
+struct HistoryOptions
+{
+    /// The size of a segment file, the records of a segment are written through a mapping of the whole file
+    std::size_t segmentBytes = 16 * 1024 * 1024;
+
+    /// The number of segments kept mapped, the newest ones and the ones recently read by queries
+    std::size_t hotSegments = 4;
+
+    /// The oldest segments are deleted once all of them together are bigger than this
+    std::uint64_t maxBytes = 512 * 1024 * 1024;
+
+    /// Segments whose newest record is older than this are deleted
+    std::chrono::hours maxAge = std::chrono::hours(24 * 7);
+};
+
+/// The largest number of entries returned by a single query
+static const std::size_t HistoryMaxQueryLimit = 1000;
+
+/// A query of the history, the entries are returned newest first
+struct HistoryQuery
+{
+    /// The accepted time range in ms since the epoch, both ends inclusive
+    std::int64_t since = 0;
+    std::int64_t until = std::numeric_limits<std::int64_t>::max();
+
+    /// Only the notifications of this source, all of them if empty
+    std::string source;
+
+    /// Only the notifications whose text or key has all these words, see ParseSearch. All of them if empty
+    std::string text;
+
+    /// The maximum number of entries of the page
+    std::size_t limit = 100;
+
+    /// Where the page starts, the next value of the previous page or zero for the newest entry
+    std::uint64_t cursor = 0;
+
+    /// The client chosen request id echoed in the reply
+    std::uint32_t requestId = 0;
+    bool hasRequestId = false;
+};
+
+/// A notification of the history
+struct HistoryEntry
+{
+    /// The accepted time in ms since the epoch
+    std::int64_t time;
+    std::string source;
+    std::string dedupKey;
+    std::string msg;
+    Priority priority;
+};
+
+/// A page of query results
+struct HistoryPage
+{
+    std::vector<HistoryEntry> entries;
+
+    /// The cursor of the next page, zero if there are no more entries
+    std::uint64_t next = 0;
+};
+
+//
+// Record of the accepted notifications, kept after they are gone from
+// the screen so that the operators can ask what they missed.
+//
+// The history is a directory of segment files that are written through
+// memory mappings. Records are appended to the newest segment until it
+// is full, then a new one is started and the oldest segments are deleted
+// if the history is over its size or age limit. Only the newest segments
+// and the ones recently read by queries stay mapped, the rest are mapped
+// again when a query reaches them.
+//
+// Every record links to the previous record of the segment and to the
+// previous record of the same source, so a query walks back from the
+// newest matching record and only touches the records it returns. The
+// in memory indexes are small: the time of every 64th record of each
+// segment and of each source in each segment, where the walks start from.
+// They are rebuilt by scanning the segments when the history is opened,
+// along with the inverted index of the words of each segment that text
+// queries look up, see SearchIndex.hpp.
+//
+// Segment layout, host byte order since the files never leave the machine:
+//   header: u32 magic | u32 version | u64 segment id | u32 capacity | u32 used bytes | reserved up to 64 bytes
+//   record: u32 size | u32 previous | u32 previous of the source | u8 priority | u8 reserved | u16 source length |
+//           i64 time | u16 key length | u16 reserved | u32 text length | source | key | text | padding to 8 bytes
+// The used bytes are updated after a record is written, a crash loses the last records at most.
+//
+// Records and queries must come from one thread at a time, the message server calls both from its io_service.
+//
+
+class HistoryStore
+{
+    public:
+        /// Constructor, the directory is not touched before Open
+        explicit HistoryStore(std::string directory, HistoryOptions options = HistoryOptions());
+
+        /// Destructor
+        ~HistoryStore();
+
+        /// Disable copy construction
+        HistoryStore(const HistoryStore& rhs) = delete;
+        HistoryStore& operator=(const HistoryStore& rhs) = delete;
+
+        /// Creates the directory if needed and indexes the segments in it, returns false if the directory is unusable
+        bool Open();
+
+        /// Appends the given notification accepted now
+        void Record(const NotificationData& data);
+
+        /// Appends the given notification accepted at the given time in ms since the epoch. The times of the records
+        /// never go back, an earlier time is recorded as the time of the previous record
+        void Record(const NotificationData& data, std::int64_t timeMs);
+
+        /// Retrieves a page of the notifications that match the given query
+        HistoryPage Query(const HistoryQuery& q);
+
+        /// Retrieves the number of records in the history
+        std::uint64_t GetRecordCount() const;
+
+        /// Retrieves the approximate bytes used by the inverted indexes of the segments
+        std::size_t GetSearchMemoryUsage() const;
+
+        /// Retrieves the number of segments and the number of mapped ones
+        std::size_t GetSegmentCount() const;
+        std::size_t GetHotCount() const;
+
+    private:
+        struct Segment;
+
+        /// Starts a new segment, deleting the segments that are over the retention limits
+        bool Roll(std::int64_t now);
+
+        /// Deletes the oldest segments while they are over the retention limits, the newest one is always kept
+        void Retire(std::int64_t now);
+
+        /// Makes sure the given segment is mapped, unmapping the least recently used ones over the hot limit
+        bool Touch(Segment& s);
+
+        /// Reads the records of a segment file to rebuild its indexes
+        bool Load(Segment& s);
+
+        /// Adds the record at the given offset to the indexes of its segment
+        void Index(Segment& s, std::uint32_t sid, std::int64_t time, std::uint32_t off, Slice source, Slice key,
+                   Slice text);
+
+        /// Adds the records of the given segment that have all the given words to the page, newest first, starting at
+        /// the given offset or the end of the time range. Returns false once the page is complete or the records are
+        /// older than the query
+        bool Search(Segment& s, const std::vector<SearchTerm>& terms, std::uint32_t start, const HistoryQuery& q,
+                    HistoryPage& page);
+
+        /// Finds the last record of the given segment accepted at or before the given time
+        std::uint32_t Seek(const Segment& s, std::int64_t until) const;
+
+        /// Finds the segment with the given id, returns its index or the segment count if it is gone
+        std::size_t Find(std::uint64_t id) const;
+
+        /// Retrieves the id of the given source, adding it if asked to
+        std::uint32_t SourceId(const std::string& source, bool add);
+
+        /// The directory of the segment files
+        std::string mDirectory;
+
+        /// The segment and retention settings
+        HistoryOptions mOptions;
+
+        /// The segments, oldest first, the last one is written to
+        std::vector<std::unique_ptr<Segment>> mSegments;
+
+        /// The size of all the segment files
+        std::uint64_t mBytes;
+
+        /// The number of records of all the segments
+        std::uint64_t mRecords;
+
+        /// The number of mapped segments
+        std::size_t mHot;
+
+        /// Orders the segment uses for the hot segment eviction
+        std::uint64_t mUseClock;
+
+        /// The time of the newest record
+        std::int64_t mLastTime;
+
+        /// The id of the next segment
+        std::uint64_t mNextId;
+
+        /// The source ids, a source keeps its id for the lifetime of the store
+        std::unordered_map<std::string, std::uint32_t> mSources;
+};
+
+#endif // ! _HISTORY_STORE_HPP_
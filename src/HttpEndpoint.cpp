@@ -0,0 +1,459 @@
+#include "HttpEndpoint.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include "Logger.hpp"
+#include "Trace.hpp"
+
+// A simple logger
+static Logger<ConsoleAppender, SimpleFormatter> CLogger;
+
+// The endpoint metrics
+static Counter& httpRequests = GetMetrics().GetCounter("http_requests_total", "Requests answered by the HTTP endpoint");
+
+// The largest accepted request head, the scrapers send a few hundred bytes
+static const std::size_t maxRequestHead = 8 * 1024;
+
+// How long a kept alive connection may wait for its next request
+static const std::chrono::seconds keepAliveTimeout(60);
+
+// The histogram bucket bounds exposed to Prometheus, in the unit of the histograms
+static const std::uint64_t prometheusBounds[] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000
+};
+
+// Appends a metric value line
+template<typename T>
+static void AppendSample(std::string& out, const std::string& name, const char* labels, T value)
+{
+    out += name;
+    out += labels;
+    out += ' ';
+    out += std::to_string(value);
+    out += '\n';
+}
+
+// Appends the HELP and TYPE lines of a metric, the help text is escaped as the format asks
+static void AppendHeader(std::string& out, const std::string& name, const std::string& help, const char* type)
+{
+    out += "# HELP " + name + ' ';
+    for (char c : help)
+    {
+        if (c == '\\')
+            out += "\\\\";
+        else if (c == '\n')
+            out += "\\n";
+        else
+            out += c;
+    }
+    out += "\n# TYPE " + name + ' ' + type + '\n';
+}
+
+std::string EncodePrometheus(const MetricsSnapshot& s)
+{
+    std::string out;
+    out.reserve(4096);
+    for (const auto& c : s.counters)
+    {
+        AppendHeader(out, c.name, c.help, "counter");
+        AppendSample(out, c.name, "", c.value);
+    }
+    for (const auto& g : s.gauges)
+    {
+        AppendHeader(out, g.name, g.help, "gauge");
+        AppendSample(out, g.name, "", g.value);
+    }
+    for (const auto& h : s.histograms)
+    {
+        AppendHeader(out, h.name, h.help, "histogram");
+
+        // The buckets are cumulative, a histogram bucket counts under a bound once all its values are within it
+        std::string bucket = h.name + "_bucket";
+        std::uint64_t cumulative = 0;
+        auto it = h.buckets.begin();
+        for (std::uint64_t bound : prometheusBounds)
+        {
+            for (; it != h.buckets.end() && it->first <= bound; ++it)
+                cumulative += it->second;
+            std::string labels = "{le=\"" + std::to_string(bound) + "\"}";
+            AppendSample(out, bucket, labels.c_str(), cumulative);
+        }
+        AppendSample(out, bucket, "{le=\"+Inf\"}", h.count);
+        AppendSample(out, h.name + "_sum", "", h.sum);
+        AppendSample(out, h.name + "_count", "", h.count);
+    }
+    return out;
+}
+
+// Compares the given text with a lowercase one, ignoring the case of the text
+static bool EqualsLower(const std::string& text, const char* lower)
+{
+    std::size_t i = 0;
+    for (; i < text.size() && lower[i] != '\0'; ++i)
+        if (std::tolower(static_cast<unsigned char>(text[i])) != lower[i])
+            return false;
+    return i == text.size() && lower[i] == '\0';
+}
+
+// Removes the leading and trailing whitespace of the given header value
+static std::string Trim(const std::string& s)
+{
+    std::size_t b = s.find_first_not_of(" \t");
+    if (b == std::string::npos)
+        return std::string();
+    return s.substr(b, s.find_last_not_of(" \t") - b + 1);
+}
+
+// Retrieves the reason phrase of the status codes the endpoint uses
+static const char* GetReason(int status)
+{
+    switch (status)
+    {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 431: return "Request Header Fields Too Large";
+        default:  return "Internal Server Error";
+    }
+}
+
+///==============================================================
+///= HttpConnection
+///==============================================================
+
+class HttpConnection : public std::enable_shared_from_this<HttpConnection>
+{
+    public:
+        /// Constructor, takes the accepted socket
+        HttpConnection(asio::ip::tcp::socket socket, HttpEndpoint& endpoint)
+            : mSocket(std::move(socket)),
+              mTimer(mSocket.get_io_service()),
+              mEndpoint(endpoint),
+              mClosing(false)
+        {
+        }
+
+        /// Starts reading the requests
+        void Start()
+        {
+            DoRead();
+        }
+
+        /// Closes the socket, cancelling the outstanding operations
+        void Stop()
+        {
+            asio::error_code ec;
+            mTimer.cancel(ec);
+            mSocket.close(ec);
+        }
+
+    private:
+        /// Waits for more of the request, up to the keep alive timeout
+        void DoRead()
+        {
+            auto self(shared_from_this());
+            mTimer.expires_from_now(keepAliveTimeout);
+            mTimer.async_wait(
+                [this, self](const asio::error_code& ec)
+                {
+                    if (!ec)
+                        Close();
+                }
+            );
+            mSocket.async_read_some(asio::buffer(mRvBuf),
+                [this, self](const asio::error_code& ec, std::size_t bytes)
+                {
+                    if (!mSocket.is_open())
+                        return;
+                    if (ec)
+                    {
+                        Close();
+                        return;
+                    }
+                    mIn.append(mRvBuf, bytes);
+                    ProcessInput();
+                }
+            );
+        }
+
+        /// Answers the complete requests in the input, then writes the responses or reads the rest
+        void ProcessInput()
+        {
+            for (;;)
+            {
+                std::size_t end = mIn.find("\r\n\r\n");
+                if (end == std::string::npos)
+                {
+                    if (mIn.size() > maxRequestHead)
+                        Answer(431, "text/plain", "Request head too large\n", false, true);
+                    break;
+                }
+                HandleRequest(mIn.substr(0, end));
+                mIn.erase(0, end + 4);
+                if (mClosing)
+                    break;
+            }
+
+            if (!mOut.empty())
+                DoWrite();
+            else if (!mClosing)
+                DoRead();
+        }
+
+        /// Answers the given request head
+        void HandleRequest(const std::string& head)
+        {
+            // The request line is the method, the target and the version
+            std::size_t lineEnd = head.find("\r\n");
+            std::string line = head.substr(0, lineEnd);
+            std::size_t sp1 = line.find(' ');
+            std::size_t sp2 = sp1 == std::string::npos ? sp1 : line.find(' ', sp1 + 1);
+            if (sp2 == std::string::npos)
+            {
+                Answer(400, "text/plain", "Bad request\n", false, true);
+                return;
+            }
+            std::string method = line.substr(0, sp1);
+            std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+            std::string version = line.substr(sp2 + 1);
+
+            // HTTP/1.1 keeps the connection by default and HTTP/1.0 closes it
+            bool close = version != "HTTP/1.1";
+            bool hasBody = false;
+            std::size_t pos = lineEnd;
+            while (pos != std::string::npos && pos < head.size())
+            {
+                std::size_t next = head.find("\r\n", pos + 2);
+                std::string field = head.substr(pos + 2, next == std::string::npos ? std::string::npos : next - pos - 2);
+                pos = next;
+
+                std::size_t colon = field.find(':');
+                if (colon == std::string::npos)
+                    continue;
+                std::string name = Trim(field.substr(0, colon));
+                std::string value = Trim(field.substr(colon + 1));
+                if (EqualsLower(name, "connection"))
+                {
+                    if (EqualsLower(value, "close"))
+                        close = true;
+                    else if (EqualsLower(value, "keep-alive"))
+                        close = false;
+                }
+                else if ((EqualsLower(name, "content-length") && value != "0") || EqualsLower(name, "transfer-encoding"))
+                {
+                    hasBody = true;
+                }
+            }
+
+            // The body would have to be skipped to find the next request, nobody sends one to these endpoints
+            if (hasBody)
+            {
+                Answer(400, "text/plain", "Request bodies are not supported\n", false, true);
+                return;
+            }
+
+            bool headOnly = method == "HEAD";
+            if (method != "GET" && !headOnly)
+            {
+                Answer(405, "text/plain", "Only GET and HEAD are supported\n", false, close);
+                return;
+            }
+
+            std::string path = target.substr(0, target.find('?'));
+            std::string contentType, body;
+            int status = mEndpoint.Respond(path, contentType, body);
+            Answer(status, contentType, body, headOnly, close);
+        }
+
+        /// Queues the response to the current request, a closing response is the last one of the connection
+        void Answer(int status, const std::string& contentType, const std::string& body, bool headOnly, bool close)
+        {
+            char line[64];
+            std::snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", status, GetReason(status));
+            mOut += line;
+            mOut += "Content-Type: " + contentType + "\r\n";
+            mOut += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+            if (status == 405)
+                mOut += "Allow: GET, HEAD\r\n";
+            mOut += close ? "Connection: close\r\n\r\n" : "Connection: keep-alive\r\n\r\n";
+            if (!headOnly)
+                mOut += body;
+            httpRequests.Add();
+            mClosing = mClosing || close;
+        }
+
+        /// Writes the queued responses, then answers the requests behind them or closes the connection.
+        /// Nothing is read while a write is in flight, so a client cannot queue up responses faster than it takes them
+        void DoWrite()
+        {
+            auto self(shared_from_this());
+            mOutFlight.swap(mOut);
+            mOut.clear();
+            asio::async_write(mSocket, asio::buffer(mOutFlight),
+                [this, self](const asio::error_code& ec, std::size_t)
+                {
+                    mOutFlight.clear();
+                    if (ec || mClosing)
+                    {
+                        Close();
+                        return;
+                    }
+
+                    // Requests that arrived behind the answered ones are already buffered
+                    ProcessInput();
+                }
+            );
+        }
+
+        /// Closes the connection and removes it from the endpoint
+        void Close()
+        {
+            Stop();
+            mEndpoint.Remove(shared_from_this());
+        }
+
+        asio::ip::tcp::socket mSocket;
+
+        /// Closes the connection once it waited too long for a request
+        asio::steady_timer mTimer;
+
+        /// The endpoint that owns the connection
+        HttpEndpoint& mEndpoint;
+
+        /// The receive buffer and the received data that is not handled yet
+        char mRvBuf[2048];
+        std::string mIn;
+
+        /// The responses queued for the next write and the ones of the write in flight
+        std::string mOut;
+        std::string mOutFlight;
+
+        /// Set once a response closes the connection
+        bool mClosing;
+};
+
+///==============================================================
+///= HttpEndpoint
+///==============================================================
+
+HttpEndpoint::HttpEndpoint(asio::io_service& ios, const std::string& address, unsigned short port, HealthCallback health)
+    : mAcceptor(ios),
+      mSocket(ios),
+      mConnectionCount(0),
+      mMaxConnections(16),
+      mHealth(health)
+{
+    asio::error_code ec;
+    asio::ip::tcp::endpoint endpoint(asio::ip::address::from_string(address, ec), port);
+    if (!ec)
+        mAcceptor.open(endpoint.protocol(), ec);
+    if (!ec)
+        mAcceptor.set_option(asio::ip::tcp::acceptor::reuse_address(true), ec);
+    if (!ec)
+        mAcceptor.bind(endpoint, ec);
+    if (!ec)
+        mAcceptor.listen(asio::socket_base::max_connections, ec);
+    if (ec)
+    {
+        CLogger.Info("Could not listen for HTTP on " + address + " port " + std::to_string(port) + ": " + ec.message());
+        asio::error_code ignored;
+        mAcceptor.close(ignored);
+    }
+}
+
+bool HttpEndpoint::IsOpen() const
+{
+    return mAcceptor.is_open();
+}
+
+unsigned short HttpEndpoint::GetPort() const
+{
+    asio::error_code ec;
+    return mAcceptor.local_endpoint(ec).port();
+}
+
+void HttpEndpoint::Start()
+{
+    asio::error_code ec;
+    asio::ip::tcp::endpoint local = mAcceptor.local_endpoint(ec);
+    CLogger.Info("Serving metrics over HTTP on " + local.address().to_string() + " port " + std::to_string(local.port()));
+    DoAccept();
+}
+
+void HttpEndpoint::Stop()
+{
+    asio::error_code ec;
+    mAcceptor.close(ec);
+    for (auto& c : mConnections)
+        c->Stop();
+    mConnections.clear();
+    mConnectionCount = 0;
+}
+
+void HttpEndpoint::SetMaxConnections(std::size_t max)
+{
+    mMaxConnections = max;
+}
+
+std::size_t HttpEndpoint::GetConnectionCount() const
+{
+    return mConnectionCount;
+}
+
+void HttpEndpoint::DoAccept()
+{
+    mAcceptor.async_accept(mSocket,
+        [this](const asio::error_code& ec)
+        {
+            if (!mAcceptor.is_open())
+                return;
+
+            // A scraper that opens connections without closing them must not take the io_service down with it
+            if (!ec && mConnections.size() >= mMaxConnections)
+            {
+                asio::error_code cec;
+                mSocket.close(cec);
+            }
+            else if (!ec)
+            {
+                auto c = std::make_shared<HttpConnection>(std::move(mSocket), *this);
+                mConnections.insert(c);
+                mConnectionCount = mConnections.size();
+                c->Start();
+            }
+            DoAccept();
+        }
+    );
+}
+
+void HttpEndpoint::Remove(const std::shared_ptr<HttpConnection>& c)
+{
+    mConnections.erase(c);
+    mConnectionCount = mConnections.size();
+}
+
+int HttpEndpoint::Respond(const std::string& path, std::string& contentType, std::string& body)
+{
+    if (path == "/metrics")
+    {
+        contentType = "text/plain; version=0.0.4; charset=utf-8";
+        body = EncodePrometheus(GetMetrics().Snapshot());
+        return 200;
+    }
+    if (path == "/health")
+    {
+        contentType = "application/json";
+        body = mHealth ? mHealth() : std::string("{\"status\":\"ok\"}");
+        return 200;
+    }
+    if (path == "/trace")
+    {
+        contentType = "application/json";
+        body = DumpTrace();
+        return 200;
+    }
+    contentType = "text/plain";
+    body = "Not found\n";
+    return 404;
+}
@@ -0,0 +1,132 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _HTTP_ENDPOINT_HPP_
+#define _HTTP_ENDPOINT_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "WarnGuard.hpp"
+WARN_GUARD_ON
+#include <asio.hpp>
+WARN_GUARD_OFF
+#include "Metrics.hpp"
+
+//
+// A minimal HTTP/1.1 server for the monitoring scrapers, running on the
+// io_service of the message server. It answers GET and HEAD requests for
+//
+//   /metrics  the metrics in the Prometheus text format
+//   /health   a JSON summary of the server state
+//   /trace    the recorded trace events as Chrome trace JSON, see Trace.hpp
+//
+// Connections are kept alive between requests unless the client asks
+// otherwise, and pipelined requests are answered with a single write.
+// The metrics are read from their atomics, so a scrape never waits on
+// the notification path and the notification path never waits on it.
+// Request bodies are not supported, a request with one closes the
+// connection. Nothing is authenticated, so the endpoint listens on the
+// loopback interface unless it is given another address.
+//
+
+/// Renders the given metrics in the Prometheus text format. The histograms are exposed with a fixed set of bucket
+/// bounds, so their series stay the same between scrapes, and each bound counts the values up to it at the precision
+/// of the histogram buckets
+std::string EncodePrometheus(const MetricsSnapshot& s);
+
+class HttpConnection;
+
+class HttpEndpoint
+{
+    public:
+        /// Produces the JSON body of the health endpoint, called on the io_service
+        using HealthCallback = std::function<std::string()>;
+
+        /// Constructor, listens on the given address and TCP port. An address that does not parse or a port that is
+        /// taken is logged and leaves the endpoint closed
+        HttpEndpoint(asio::io_service& ios, const std::string& address, unsigned short port, HealthCallback health);
+
+        /// Disable copy construction
+        HttpEndpoint(const HttpEndpoint& rhs) = delete;
+        HttpEndpoint& operator=(const HttpEndpoint& rhs) = delete;
+
+        /// Checks whether the endpoint is listening
+        bool IsOpen() const;
+
+        /// Retrieves the TCP port the endpoint listens on, the one the system picked if it was given port 0
+        unsigned short GetPort() const;
+
+        /// Starts accepting connections
+        void Start();
+
+        /// Stops accepting and closes all the connections
+        void Stop();
+
+        /// Sets the maximum number of connections, the connections over it are closed right away
+        void SetMaxConnections(std::size_t max);
+
+        /// Retrieves the number of connections, may be called from any thread
+        std::size_t GetConnectionCount() const;
+
+    private:
+        friend class HttpConnection;
+
+        /// Perform an asynchronous accept operation
+        void DoAccept();
+
+        /// Forgets the given connection once it is closed
+        void Remove(const std::shared_ptr<HttpConnection>& c);
+
+        /// Builds the response to a GET request for the given path, returns its status code
+        int Respond(const std::string& path, std::string& contentType, std::string& body);
+
+        /// The acceptor and the next socket to be accepted
+        asio::ip::tcp::acceptor mAcceptor;
+        asio::ip::tcp::socket mSocket;
+
+        /// The open connections
+        std::set<std::shared_ptr<HttpConnection>> mConnections;
+
+        /// The size of mConnections for readers outside the io_service
+        std::atomic<std::size_t> mConnectionCount;
+
+        /// The maximum number of connections
+        std::size_t mMaxConnections;
+
+        /// Produces the health endpoint body
+        HealthCallback mHealth;
+};
+
+#endif // ! _HTTP_ENDPOINT_HPP_
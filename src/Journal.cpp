@@ -0,0 +1,395 @@
+#include "Journal.hpp"
+#include <algorithm>
+#include <array>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// The record types
+static const char recordAdd = 1;
+static const char recordRetire = 2;
+
+// The size of the record header, the payload length and crc
+static const std::size_t recordHeaderSize = 8;
+
+// The size of the add payload up to the key
+static const std::size_t addFixedSize = 1 + 8 + 8 + 4 + 1 + 4;
+
+// Payloads longer than this can only be garbage
+static const std::uint32_t maxRecordPayload = 16 * 1024 * 1024;
+
+static std::array<std::uint32_t, 256> MakeCrcTable()
+{
+    std::array<std::uint32_t, 256> table;
+    for (std::uint32_t i = 0; i < 256; ++i)
+    {
+        std::uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}
+
+static std::uint32_t Crc32(const char* data, std::size_t size)
+{
+    static const std::array<std::uint32_t, 256> table = MakeCrcTable();
+    std::uint32_t crc = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static void WriteU32(std::string& out, std::uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+static void WriteU64(std::string& out, std::uint64_t v)
+{
+    for (int i = 0; i < 8; ++i)
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+static std::uint32_t ReadU32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<std::uint32_t>(u[0]) | (static_cast<std::uint32_t>(u[1]) << 8)
+         | (static_cast<std::uint32_t>(u[2]) << 16) | (static_cast<std::uint32_t>(u[3]) << 24);
+}
+
+static std::uint64_t ReadU64(const char* p)
+{
+    return static_cast<std::uint64_t>(ReadU32(p)) | (static_cast<std::uint64_t>(ReadU32(p + 4)) << 32);
+}
+
+// Frames the given payload as a record
+static std::string MakeRecord(const std::string& payload)
+{
+    std::string record;
+    record.reserve(recordHeaderSize + payload.size());
+    WriteU32(record, static_cast<std::uint32_t>(payload.size()));
+    WriteU32(record, Crc32(payload.data(), payload.size()));
+    record += payload;
+    return record;
+}
+
+static std::int64_t NowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+static std::string EncodeAdd(const NotificationData& data, std::uint64_t seq, std::int64_t acceptedMs)
+{
+    std::string p;
+    p.reserve(addFixedSize + data.dedupKey.size() + data.msg.size());
+    p.push_back(recordAdd);
+    WriteU64(p, seq);
+    WriteU64(p, static_cast<std::uint64_t>(acceptedMs));
+    WriteU32(p, data.lifetime);
+    p.push_back(static_cast<char>(data.priority));
+    WriteU32(p, static_cast<std::uint32_t>(data.dedupKey.size()));
+    p += data.dedupKey;
+    p += data.msg;
+    return p;
+}
+
+static bool DecodeAdd(const char* p, std::size_t size, NotificationData& data, std::int64_t& acceptedMs)
+{
+    if (size < addFixedSize || p[0] != recordAdd)
+        return false;
+    unsigned int priority = static_cast<unsigned char>(p[21]);
+    std::uint32_t keyLength = ReadU32(p + 22);
+    if (priority >= PriorityLevels || keyLength > size - addFixedSize)
+        return false;
+
+    data.journalSeq = ReadU64(p + 1);
+    acceptedMs = static_cast<std::int64_t>(ReadU64(p + 9));
+    data.lifetime = ReadU32(p + 17);
+    data.priority = static_cast<Priority>(priority);
+    data.dedupKey.assign(p + addFixedSize, keyLength);
+    data.msg.assign(p + addFixedSize + keyLength, size - addFixedSize - keyLength);
+    return true;
+}
+
+// Pushes the buffered writes of the given file down to the disk
+static bool SyncFile(std::FILE* f)
+{
+    if (std::fflush(f) != 0)
+        return false;
+#if defined(_WIN32)
+    return _commit(_fileno(f)) == 0;
+#else
+    return fsync(fileno(f)) == 0;
+#endif
+}
+
+// Replaces the file at the given path with another one in a single step
+static bool ReplaceFile(const std::string& from, const std::string& to)
+{
+#if defined(_WIN32)
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+Journal::Journal(std::string path, JournalOptions options)
+    : mPath(std::move(path)),
+      mOptions(options),
+      mFile(nullptr),
+      mFileBytes(0),
+      mQueuedCount(0),
+      mQueuedTotal(0),
+      mCommittedTotal(0),
+      mLiveBytes(0),
+      mNextSeq(1),
+      mCompactPending(false),
+      mFlushRequested(false),
+      mStopping(false),
+      mCommits(0),
+      mCompactions(0)
+{
+}
+
+Journal::~Journal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWake.notify_all();
+    if (mWriter.joinable())
+        mWriter.join();
+    if (mFile)
+        std::fclose(mFile);
+}
+
+bool Journal::Open(std::vector<NotificationData>& replay)
+{
+    // Read the whole journal, the compactions keep it small
+    std::string content;
+    if (std::FILE* in = std::fopen(mPath.c_str(), "rb"))
+    {
+        char buf[64 * 1024];
+        std::size_t n;
+        while ((n = std::fread(buf, 1, sizeof(buf), in)) > 0)
+            content.append(buf, n);
+        std::fclose(in);
+    }
+
+    std::size_t pos = 0;
+    std::uint64_t maxSeq = 0;
+    while (content.size() - pos >= recordHeaderSize)
+    {
+        std::uint32_t length = ReadU32(&content[pos]);
+        std::uint32_t crc = ReadU32(&content[pos + 4]);
+        if (length < 9 || length > maxRecordPayload || length > content.size() - pos - recordHeaderSize)
+            break;
+        const char* payload = &content[pos + recordHeaderSize];
+        if (Crc32(payload, length) != crc)
+            break;
+
+        std::uint64_t seq = ReadU64(payload + 1);
+        if (payload[0] == recordAdd)
+            mLive[seq] = content.substr(pos, recordHeaderSize + length);
+        else if (payload[0] == recordRetire)
+            mLive.erase(seq);
+        maxSeq = std::max(maxSeq, seq);
+        pos += recordHeaderSize + length;
+    }
+
+    // The live notifications that are too old to matter or whose lifetime ran out while the server was down are
+    // forgotten
+    std::int64_t now = NowMs();
+    std::int64_t oldest = now - std::chrono::duration_cast<std::chrono::milliseconds>(mOptions.maxAge).count();
+    for (auto it = std::begin(mLive); it != std::end(mLive);)
+    {
+        NotificationData data;
+        std::int64_t accepted;
+        const std::string& r = it->second;
+        if (!DecodeAdd(r.data() + recordHeaderSize, r.size() - recordHeaderSize, data, accepted) || accepted < oldest
+         || accepted + data.lifetime <= now)
+        {
+            it = mLive.erase(it);
+            continue;
+        }
+        mLiveBytes += r.size();
+        replay.push_back(std::move(data));
+        ++it;
+    }
+    std::sort(std::begin(replay), std::end(replay),
+        [](const NotificationData& a, const NotificationData& b) { return a.journalSeq < b.journalSeq; });
+    mNextSeq = maxSeq + 1;
+
+    mFile = std::fopen(mPath.c_str(), "ab");
+    if (!mFile)
+        return false;
+    mFileBytes = content.size();
+
+    // The retired records are dropped in the background. A torn record at the end must go before anything is
+    // appended after it, the compaction is the first thing the writer does
+    mCompactPending = mLiveBytes != content.size();
+    mWriter = std::thread(&Journal::WriterLoop, this);
+    return true;
+}
+
+std::uint64_t Journal::Append(const NotificationData& data)
+{
+    std::int64_t now = NowMs();
+    std::lock_guard<std::mutex> lock(mMutex);
+    std::uint64_t seq = mNextSeq++;
+    std::string record = MakeRecord(EncodeAdd(data, seq, now));
+    Queue(record);
+    mLiveBytes += record.size();
+    mLive.emplace(seq, std::move(record));
+    return seq;
+}
+
+void Journal::Retire(std::uint64_t seq)
+{
+    std::string payload;
+    payload.push_back(recordRetire);
+    WriteU64(payload, seq);
+    std::string record = MakeRecord(payload);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mLive.find(seq);
+    if (it == std::end(mLive))
+        return;
+    mLiveBytes -= it->second.size();
+    mLive.erase(it);
+    Queue(record);
+}
+
+void Journal::Queue(const std::string& record)
+{
+    mQueued += record;
+    ++mQueuedCount;
+    ++mQueuedTotal;
+
+    // The first record starts the commit interval, a full group ends it early
+    if (mQueuedCount == 1 || mQueuedCount == mOptions.commitRecords)
+        mWake.notify_one();
+}
+
+void Journal::Sync()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    std::uint64_t target = mQueuedTotal;
+    if (mCommittedTotal >= target || !mWriter.joinable())
+        return;
+    mFlushRequested = true;
+    mWake.notify_one();
+    mCommitted.wait(lock, [this, target]() { return mCommittedTotal >= target; });
+}
+
+void Journal::WriterLoop()
+{
+    std::string group;
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;)
+    {
+        if (mCompactPending)
+            Compact(lock);
+
+        // Wait for the first record of a group, then give the group the commit interval to fill up
+        mWake.wait(lock, [this]() { return mStopping || mQueuedCount != 0; });
+        if (mQueuedCount == 0)
+            break;
+        if (!mStopping && !mFlushRequested)
+            mWake.wait_for(lock, mOptions.commitInterval,
+                [this]() { return mStopping || mFlushRequested || mQueuedCount >= mOptions.commitRecords; });
+        mFlushRequested = false;
+
+        group.swap(mQueued);
+        mQueuedCount = 0;
+        std::uint64_t total = mQueuedTotal;
+        lock.unlock();
+        bool written = Write(group);
+        lock.lock();
+
+        // A failed write loses its group, the compaction rewrites every live record and makes up for it
+        if (written)
+            mFileBytes += group.size();
+        else
+            mCompactPending = true;
+        mCommittedTotal = total;
+        ++mCommits;
+        mCommitted.notify_all();
+
+        // Keep the buffer of the group for the next one
+        group.clear();
+        if (mQueued.empty())
+            mQueued.swap(group);
+
+        if (mFileBytes > mOptions.compactBytes && mLiveBytes * 2 < mFileBytes)
+            mCompactPending = true;
+    }
+}
+
+bool Journal::Write(const std::string& records)
+{
+    if (!mFile)
+        return false;
+    return std::fwrite(records.data(), 1, records.size(), mFile) == records.size() && SyncFile(mFile);
+}
+
+void Journal::Compact(std::unique_lock<std::mutex>& lock)
+{
+    mCompactPending = false;
+
+    // The records queued meanwhile go to the new file with the next commit, a retire of a record that is already
+    // left out and a second copy of an add record are both harmless on replay
+    std::string live;
+    live.reserve(mLiveBytes);
+    for (const auto& r : mLive)
+        live += r.second;
+    lock.unlock();
+
+    std::string tmpPath = mPath + ".tmp";
+    bool replaced = false;
+    if (std::FILE* out = std::fopen(tmpPath.c_str(), "wb"))
+    {
+        bool written = std::fwrite(live.data(), 1, live.size(), out) == live.size() && SyncFile(out);
+        if (std::fclose(out) == 0 && written)
+        {
+            if (mFile)
+                std::fclose(mFile);
+            replaced = ReplaceFile(tmpPath, mPath);
+            mFile = std::fopen(mPath.c_str(), "ab");
+        }
+    }
+    if (!replaced)
+        std::remove(tmpPath.c_str());
+
+    lock.lock();
+    if (replaced && mFile)
+    {
+        mFileBytes = live.size();
+        ++mCompactions;
+    }
+}
+
+std::uint64_t Journal::GetCommitCount() const
+{
+    return mCommits.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Journal::GetCompactionCount() const
+{
+    return mCompactions.load(std::memory_order_relaxed);
+}
+
+std::size_t Journal::GetLiveCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mLive.size();
+}
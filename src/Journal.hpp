@@ -0,0 +1,185 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _JOURNAL_HPP_
+#define _JOURNAL_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "NotificationData.hpp"
+
+/// The journal commit and compaction settings
+struct JournalOptions
+{
+    /// The longest a record waits for the flush of its group
+    std::chrono::milliseconds commitInterval = std::chrono::milliseconds(10);
+
+    /// The number of waiting records that flushes the group before the interval is up
+    std::size_t commitRecords = 256;
+
+    /// Notifications accepted longer ago than this are not replayed
+    std::chrono::seconds maxAge = std::chrono::hours(1);
+
+    /// The journal size that triggers a compaction, if at most half of it is live records
+    std::size_t compactBytes = 4 * 1024 * 1024;
+};
+
+//
+// Append only journal of the accepted notifications, so that the queued
+// and visible ones survive a restart or a crash. Every notification gets
+// an add record when it is accepted and a retire record once it is done
+// with: expired on screen, dropped or merged into another notification.
+// The records of a notification that was never retired are replayed on
+// the next start, unless its lifetime has run out since it was accepted.
+//
+// Appending only queues the record; a writer thread flushes and syncs
+// the queued records as a group, so a burst of notifications costs one
+// fsync per commit interval. A notification is durable once its group
+// is committed. The writer thread also compacts the journal by rewriting
+// the live records once the retired ones make up most of it.
+//
+// Record layout, little endian:
+//   u32 payload length | u32 crc32 of the payload | payload
+// Add payload:
+//   u8 type = 1 | u64 seq | i64 accepted time in ms since the epoch | u32 lifetime | u8 priority | u32 key length | key | text
+// Retire payload:
+//   u8 type = 2 | u64 seq
+// Replay stops at the first record that is cut short or fails its crc,
+// the remains of a crash during a write.
+//
+
+class Journal
+{
+    public:
+        /// Constructor, the journal is not touched before Open
+        explicit Journal(std::string path, JournalOptions options = JournalOptions());
+
+        /// Destructor, commits the queued records
+        ~Journal();
+
+        /// Disable copy construction
+        Journal(const Journal& rhs) = delete;
+        Journal& operator=(const Journal& rhs) = delete;
+
+        /// Opens or creates the journal and starts the writer thread. Fills replay with the notifications that were
+        /// not retired and are younger than the maximum age, they keep their journal sequence numbers.
+        /// Returns false if the journal file cannot be opened
+        bool Open(std::vector<NotificationData>& replay);
+
+        /// Queues the add record of an accepted notification and returns its sequence number, may be called from any thread
+        std::uint64_t Append(const NotificationData& data);
+
+        /// Queues the retire record of the notification with the given sequence number, may be called from any thread
+        void Retire(std::uint64_t seq);
+
+        /// Waits until every record queued so far is committed
+        void Sync();
+
+        /// Retrieves the number of group commits
+        std::uint64_t GetCommitCount() const;
+
+        /// Retrieves the number of compactions
+        std::uint64_t GetCompactionCount() const;
+
+        /// Retrieves the number of notifications that are not retired
+        std::size_t GetLiveCount() const;
+
+    private:
+        /// Flushes the queued records in groups until the journal is destroyed
+        void WriterLoop();
+
+        /// Writes and syncs the given records, called from the writer thread without the lock
+        bool Write(const std::string& records);
+
+        /// Rewrites the journal with the live records only, called from the writer thread with the lock
+        void Compact(std::unique_lock<std::mutex>& lock);
+
+        /// Appends the given record to the queued records, called with the lock
+        void Queue(const std::string& record);
+
+        /// The journal path
+        std::string mPath;
+
+        /// The commit and compaction settings
+        JournalOptions mOptions;
+
+        /// The journal file, only used by Open and the writer thread
+        std::FILE* mFile;
+
+        /// The size of the journal file
+        std::size_t mFileBytes;
+
+        /// Guards everything below
+        mutable std::mutex mMutex;
+
+        /// Wakes the writer thread up and tells the waiters of Sync that a group is committed
+        std::condition_variable mWake;
+        std::condition_variable mCommitted;
+
+        /// The records waiting for the next commit and their count
+        std::string mQueued;
+        std::size_t mQueuedCount;
+
+        /// The number of records queued and the number of records committed
+        std::uint64_t mQueuedTotal;
+        std::uint64_t mCommittedTotal;
+
+        /// The add records of the notifications that are not retired, by sequence number
+        std::unordered_map<std::uint64_t, std::string> mLive;
+        std::size_t mLiveBytes;
+
+        /// The next sequence number
+        std::uint64_t mNextSeq;
+
+        /// Set if the journal must be compacted before the next commit
+        bool mCompactPending;
+
+        /// Set by Sync to commit the queued records without waiting for the group to fill up
+        bool mFlushRequested;
+
+        /// Set when the writer thread must exit
+        bool mStopping;
+
+        /// The group commit writer
+        std::thread mWriter;
+
+        /// The counters
+        std::atomic<std::uint64_t> mCommits, mCompactions;
+};
+
+#endif // ! _JOURNAL_HPP_
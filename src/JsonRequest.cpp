@@ -0,0 +1,683 @@
+#include "JsonRequest.hpp"
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The deepest nesting of the skipped values
+static const int maxDepth = 32;
+
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+static char* SkipSpace(char* p, char* end)
+{
+    while (p != end && IsSpace(*p))
+        ++p;
+    return p;
+}
+
+// Finds the first quote or backslash, the characters that end the fast path of a string
+static char* ScanString(char* p, char* end)
+{
+#ifdef JSON_USE_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    while (end - p >= 16)
+    {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+        if (mask != 0)
+        {
+            int i = 0;
+            while ((mask & 1) == 0)
+            {
+                mask >>= 1;
+                ++i;
+            }
+            return p + i;
+        }
+        p += 16;
+    }
+#endif
+    while (p != end && *p != '"' && *p != '\\')
+        ++p;
+    return p;
+}
+
+static int HexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static bool ParseHex4(char*& p, char* end, unsigned int& cp)
+{
+    if (end - p < 4)
+        return false;
+    cp = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+        int v = HexValue(*p++);
+        if (v < 0)
+            return false;
+        cp = (cp << 4) | static_cast<unsigned int>(v);
+    }
+    return true;
+}
+
+// Writes the UTF-8 encoding of the given code point, it is never longer than the escape it replaces
+static char* WriteUtf8(char* w, unsigned int cp)
+{
+    if (cp < 0x80)
+    {
+        *w++ = static_cast<char>(cp);
+    }
+    else if (cp < 0x800)
+    {
+        *w++ = static_cast<char>(0xC0 | (cp >> 6));
+        *w++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+        *w++ = static_cast<char>(0xE0 | (cp >> 12));
+        *w++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *w++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        *w++ = static_cast<char>(0xF0 | (cp >> 18));
+        *w++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *w++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *w++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    return w;
+}
+
+// Parses the string starting at the opening quote, unescaping it in place
+static bool ParseString(char*& p, char* end, Slice& out)
+{
+    if (p == end || *p != '"')
+        return false;
+    char* start = ++p;
+
+    // Fast path, strings without escapes are used as they are
+    p = ScanString(p, end);
+    if (p == end)
+        return false;
+    if (*p == '"')
+    {
+        out = Slice(start, static_cast<std::size_t>(p - start));
+        ++p;
+        return true;
+    }
+
+    // Unescape behind the read position, the output never outgrows the input
+    char* w = p;
+    for (;;)
+    {
+        char* next = ScanString(p, end);
+        if (next == end)
+            return false;
+        if (w != p)
+            std::memmove(w, p, static_cast<std::size_t>(next - p));
+        w += next - p;
+        p = next;
+
+        if (*p == '"')
+            break;
+
+        // Escape sequence
+        if (++p == end)
+            return false;
+        char c = *p++;
+        switch (c)
+        {
+            case '"':  *w++ = '"';  break;
+            case '\\': *w++ = '\\'; break;
+            case '/':  *w++ = '/';  break;
+            case 'b':  *w++ = '\b'; break;
+            case 'f':  *w++ = '\f'; break;
+            case 'n':  *w++ = '\n'; break;
+            case 'r':  *w++ = '\r'; break;
+            case 't':  *w++ = '\t'; break;
+            case 'u':
+            {
+                unsigned int cp;
+                if (!ParseHex4(p, end, cp))
+                    return false;
+
+                // Surrogate pairs make up a single code point
+                if (cp >= 0xD800 && cp <= 0xDBFF)
+                {
+                    unsigned int low;
+                    if (end - p < 2 || p[0] != '\\' || p[1] != 'u')
+                        return false;
+                    p += 2;
+                    if (!ParseHex4(p, end, low) || low < 0xDC00 || low > 0xDFFF)
+                        return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (cp >= 0xDC00 && cp <= 0xDFFF)
+                {
+                    return false;
+                }
+                w = WriteUtf8(w, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    out = Slice(start, static_cast<std::size_t>(w - start));
+    ++p;
+    return true;
+}
+
+// Parses a non negative integer up to the given maximum
+static bool ParseUInt(char*& p, char* end, std::uint64_t max, std::uint64_t& out)
+{
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+
+    std::uint64_t v = 0;
+    while (p != end && *p >= '0' && *p <= '9')
+    {
+        std::uint64_t d = static_cast<std::uint64_t>(*p++ - '0');
+        if (v > (max - d) / 10)
+            return false;
+        v = v * 10 + d;
+    }
+    out = v;
+    return true;
+}
+
+// Parses a non negative integer that fits in 32 bits
+static bool ParseUInt(char*& p, char* end, std::uint32_t& out)
+{
+    std::uint64_t v;
+    if (!ParseUInt(p, end, std::numeric_limits<std::uint32_t>::max(), v))
+        return false;
+    out = static_cast<std::uint32_t>(v);
+    return true;
+}
+
+static bool SkipLiteral(char*& p, char* end, const char* lit)
+{
+    std::size_t len = std::strlen(lit);
+    if (static_cast<std::size_t>(end - p) < len || std::memcmp(p, lit, len) != 0)
+        return false;
+    p += len;
+    return true;
+}
+
+// Skips a value of any type, used for the members that are not part of the request
+static bool SkipValue(char*& p, char* end, int depth)
+{
+    if (depth > maxDepth)
+        return false;
+
+    p = SkipSpace(p, end);
+    if (p == end)
+        return false;
+
+    Slice s;
+    switch (*p)
+    {
+        case '"':
+            return ParseString(p, end, s);
+        case 't':
+            return SkipLiteral(p, end, "true");
+        case 'f':
+            return SkipLiteral(p, end, "false");
+        case 'n':
+            return SkipLiteral(p, end, "null");
+        case '{':
+        case '[':
+        {
+            char close = *p == '{' ? '}' : ']';
+            bool object = *p == '{';
+            p = SkipSpace(p + 1, end);
+            if (p != end && *p == close)
+            {
+                ++p;
+                return true;
+            }
+            for (;;)
+            {
+                if (object)
+                {
+                    p = SkipSpace(p, end);
+                    if (!ParseString(p, end, s))
+                        return false;
+                    p = SkipSpace(p, end);
+                    if (p == end || *p++ != ':')
+                        return false;
+                }
+                if (!SkipValue(p, end, depth + 1))
+                    return false;
+                p = SkipSpace(p, end);
+                if (p == end)
+                    return false;
+                if (*p == close)
+                {
+                    ++p;
+                    return true;
+                }
+                if (*p++ != ',')
+                    return false;
+            }
+        }
+        default:
+        {
+            // Number, only its characters are checked
+            char* start = p;
+            while (p != end && (std::strchr("+-.eE", *p) != nullptr || (*p >= '0' && *p <= '9')))
+                ++p;
+            return p != start;
+        }
+    }
+}
+
+static bool ParsePriorityValue(char*& p, char* end, Priority& out)
+{
+    if (p != end && *p == '"')
+    {
+        Slice name;
+        if (!ParseString(p, end, name))
+            return false;
+        if (name.Equals("low"))
+            out = Priority::Low;
+        else if (name.Equals("normal"))
+            out = Priority::Normal;
+        else if (name.Equals("high"))
+            out = Priority::High;
+        else if (name.Equals("critical"))
+            out = Priority::Critical;
+        else
+            return false;
+        return true;
+    }
+
+    std::uint32_t level;
+    if (!ParseUInt(p, end, level) || level >= PriorityLevels)
+        return false;
+    out = static_cast<Priority>(level);
+    return true;
+}
+
+static bool ParseAckModeValue(char*& p, char* end, AckMode& out)
+{
+    Slice name;
+    if (!ParseString(p, end, name))
+        return false;
+    if (name.Equals("none"))
+        out = AckMode::None;
+    else if (name.Equals("accepted"))
+        out = AckMode::Accepted;
+    else if (name.Equals("displayed"))
+        out = AckMode::Displayed;
+    else
+        return false;
+    return true;
+}
+
+static bool ParseNotification(char*& p, char* end, NotifyFrame& f)
+{
+    f = NotifyFrame();
+    f.lifetime = 3000;
+    f.priority = Priority::Normal;
+    f.ack = AckMode::Accepted;
+
+    p = SkipSpace(p, end);
+    if (p == end || *p++ != '{')
+        return false;
+
+    bool hasMsg = false;
+    p = SkipSpace(p, end);
+    if (p != end && *p == '}')
+        return false;
+    for (;;)
+    {
+        Slice name;
+        p = SkipSpace(p, end);
+        if (!ParseString(p, end, name))
+            return false;
+        p = SkipSpace(p, end);
+        if (p == end || *p++ != ':')
+            return false;
+        p = SkipSpace(p, end);
+
+        bool ok;
+        if (name.Equals("msg"))
+            ok = hasMsg = ParseString(p, end, f.text);
+        else if (name.Equals("lifetime"))
+            ok = ParseUInt(p, end, f.lifetime);
+        else if (name.Equals("priority"))
+            ok = ParsePriorityValue(p, end, f.priority);
+        else if (name.Equals("key"))
+            ok = ParseString(p, end, f.dedupKey);
+        else if (name.Equals("id"))
+            ok = f.hasRequestId = ParseUInt(p, end, f.requestId);
+        else if (name.Equals("ack"))
+            ok = ParseAckModeValue(p, end, f.ack);
+        else
+            ok = SkipValue(p, end, 0);
+        if (!ok)
+            return false;
+
+        p = SkipSpace(p, end);
+        if (p == end)
+            return false;
+        if (*p == '}')
+        {
+            ++p;
+            return hasMsg;
+        }
+        if (*p++ != ',')
+            return false;
+    }
+}
+
+bool IsJsonRequest(Slice in)
+{
+    const char* p = in.begin();
+    while (p != in.end() && IsSpace(*p))
+        ++p;
+    if (p == in.end())
+        return false;
+    if (*p == '{')
+        return true;
+    if (*p != '[')
+        return false;
+
+    // Text requests may start with a [tag] as well
+    ++p;
+    while (p != in.end() && IsSpace(*p))
+        ++p;
+    return p != in.end() && (*p == '{' || *p == ']');
+}
+
+bool IsJsonRequestStart(Slice in)
+{
+    if (IsJsonRequest(in))
+        return true;
+
+    // A lone [ may still open a batch as well as a [tag]
+    const char* p = in.begin();
+    while (p != in.end() && IsSpace(*p))
+        ++p;
+    if (p == in.end() || *p++ != '[')
+        return false;
+    while (p != in.end() && IsSpace(*p))
+        ++p;
+    return p == in.end();
+}
+
+bool ParseJsonRequest(char* begin, char* end, std::vector<NotifyFrame>& out)
+{
+    std::size_t first = out.size();
+    char* p = SkipSpace(begin, end);
+    if (p == end)
+        return false;
+
+    bool ok = true;
+    if (*p == '[')
+    {
+        // Batch
+        p = SkipSpace(p + 1, end);
+        if (p != end && *p == ']')
+        {
+            ++p;
+        }
+        else
+        {
+            for (;;)
+            {
+                NotifyFrame f;
+                if (!ParseNotification(p, end, f))
+                {
+                    ok = false;
+                    break;
+                }
+                out.push_back(f);
+                p = SkipSpace(p, end);
+                if (p != end && *p == ']')
+                {
+                    ++p;
+                    break;
+                }
+                if (p == end || *p++ != ',')
+                {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        NotifyFrame f;
+        ok = ParseNotification(p, end, f);
+        if (ok)
+            out.push_back(f);
+    }
+
+    // Nothing but whitespace may follow the request
+    if (ok && SkipSpace(p, end) != end)
+        ok = false;
+    if (!ok)
+        out.resize(first);
+    return ok;
+}
+
+std::string EncodeJsonAck(const AckTarget& target, AckStatus status)
+{
+    std::string out = "{";
+    if (target.hasRequestId)
+        out += "\"id\":" + std::to_string(target.requestId) + ",";
+    out += "\"status\":\"";
+    out += GetAckStatusName(status);
+    out += "\"}";
+    return out;
+}
+
+bool IsJsonQuery(Slice in)
+{
+    static const char member[] = "\"query\"";
+    const char* p = in.begin();
+    while (p != in.end() && IsSpace(*p))
+        ++p;
+    if (p == in.end() || *p++ != '{')
+        return false;
+    while (p != in.end() && IsSpace(*p))
+        ++p;
+    return static_cast<std::size_t>(in.end() - p) >= sizeof(member) - 1 && std::memcmp(p, member, sizeof(member) - 1) == 0;
+}
+
+static bool ParseTime(char*& p, char* end, std::int64_t& out)
+{
+    std::uint64_t v;
+    if (!ParseUInt(p, end, std::numeric_limits<std::int64_t>::max(), v))
+        return false;
+    out = static_cast<std::int64_t>(v);
+    return true;
+}
+
+bool ParseJsonQuery(char* begin, char* end, QueryKind& kind, HistoryQuery& q)
+{
+    q = HistoryQuery();
+
+    char* p = SkipSpace(begin, end);
+    if (p == end || *p++ != '{')
+        return false;
+
+    bool known = false;
+    for (;;)
+    {
+        Slice name;
+        p = SkipSpace(p, end);
+        if (!ParseString(p, end, name))
+            return false;
+        p = SkipSpace(p, end);
+        if (p == end || *p++ != ':')
+            return false;
+        p = SkipSpace(p, end);
+
+        bool ok;
+        Slice value;
+        std::uint32_t limit;
+        if (name.Equals("query"))
+        {
+            ok = known = ParseString(p, end, value) && (value.Equals("history") || value.Equals("stats"));
+            kind = value.Equals("stats") ? QueryKind::Stats : QueryKind::History;
+        }
+        else if (name.Equals("since"))
+            ok = ParseTime(p, end, q.since);
+        else if (name.Equals("until"))
+            ok = ParseTime(p, end, q.until);
+        else if (name.Equals("source"))
+        {
+            ok = ParseString(p, end, value);
+            q.source = value.ToString();
+        }
+        else if (name.Equals("text"))
+        {
+            ok = ParseString(p, end, value);
+            q.text = value.ToString();
+        }
+        else if (name.Equals("limit"))
+        {
+            ok = ParseUInt(p, end, limit);
+            if (ok)
+                q.limit = limit;
+        }
+        else if (name.Equals("cursor"))
+            ok = ParseUInt(p, end, std::numeric_limits<std::uint64_t>::max(), q.cursor);
+        else if (name.Equals("id"))
+            ok = q.hasRequestId = ParseUInt(p, end, q.requestId);
+        else
+            ok = SkipValue(p, end, 0);
+        if (!ok)
+            return false;
+
+        p = SkipSpace(p, end);
+        if (p == end)
+            return false;
+        if (*p == '}')
+            break;
+        if (*p++ != ',')
+            return false;
+    }
+
+    // Nothing but whitespace may follow the query
+    return known && SkipSpace(p + 1, end) == end;
+}
+
+// Appends the given text as a JSON string
+static void AppendString(std::string& out, const std::string& s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : s)
+    {
+        switch (c)
+        {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n";  break;
+            case '\r': out += "\\r";  break;
+            case '\t': out += "\\t";  break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out += "\\u00";
+                    out += hex[(c >> 4) & 0xF];
+                    out += hex[c & 0xF];
+                }
+                else
+                {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+std::string EncodeJsonHistory(const HistoryQuery& q, const HistoryPage& page)
+{
+    std::string out = "{";
+    if (q.hasRequestId)
+        out += "\"id\":" + std::to_string(q.requestId) + ",";
+    out += "\"status\":\"ok\",\"entries\":[";
+    for (std::size_t i = 0; i < page.entries.size(); ++i)
+    {
+        const HistoryEntry& e = page.entries[i];
+        if (i != 0)
+            out += ',';
+        out += "{\"time\":" + std::to_string(e.time) + ",\"source\":";
+        AppendString(out, e.source);
+        out += ",\"priority\":\"";
+        out += GetPriorityName(e.priority);
+        out += "\",\"key\":";
+        AppendString(out, e.dedupKey);
+        out += ",\"msg\":";
+        AppendString(out, e.msg);
+        out += '}';
+    }
+    out += ']';
+    if (page.next != 0)
+        out += ",\"next\":" + std::to_string(page.next);
+    out += '}';
+    return out;
+}
+
+std::string EncodeJsonStats(const HistoryQuery& q, const MetricsSnapshot& stats)
+{
+    std::string out = "{";
+    if (q.hasRequestId)
+        out += "\"id\":" + std::to_string(q.requestId) + ",";
+    out += "\"status\":\"ok\",\"counters\":{";
+    for (std::size_t i = 0; i < stats.counters.size(); ++i)
+    {
+        if (i != 0)
+            out += ',';
+        AppendString(out, stats.counters[i].name);
+        out += ':' + std::to_string(stats.counters[i].value);
+    }
+    out += "},\"gauges\":{";
+    for (std::size_t i = 0; i < stats.gauges.size(); ++i)
+    {
+        if (i != 0)
+            out += ',';
+        AppendString(out, stats.gauges[i].name);
+        out += ':' + std::to_string(stats.gauges[i].value);
+    }
+    out += "},\"histograms\":{";
+    for (std::size_t i = 0; i < stats.histograms.size(); ++i)
+    {
+        const HistogramSnapshot& h = stats.histograms[i];
+        if (i != 0)
+            out += ',';
+        AppendString(out, h.name);
+        out += ":{\"count\":" + std::to_string(h.count)
+            + ",\"sum\":" + std::to_string(h.sum)
+            + ",\"max\":" + std::to_string(h.max)
+            + ",\"p50\":" + std::to_string(h.GetPercentile(0.5))
+            + ",\"p90\":" + std::to_string(h.GetPercentile(0.9))
+            + ",\"p99\":" + std::to_string(h.GetPercentile(0.99))
+            + ",\"p999\":" + std::to_string(h.GetPercentile(0.999)) + "}";
+    }
+    out += "}}";
+    return out;
+}
@@ -0,0 +1,107 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _JSON_REQUEST_HPP_
+#define _JSON_REQUEST_HPP_
+
+#include <vector>
+#include "Protocol.hpp"
+#include "HistoryStore.hpp"
+#include "Metrics.hpp"
+
+//
+// The JSON request format.
+// A request is a single notification object or an array of them:
+//
+//   {"msg": "Build finished", "lifetime": 5000, "priority": "high", "key": "build", "id": 7, "ack": "displayed"}
+//
+// Only "msg" is required. The priority is either a name or a level
+// number, the ack mode is none, accepted (the default) or displayed,
+// and unknown members are skipped. The parser works in place:
+// the strings are unescaped inside the given buffer and handed out as
+// slices pointing into it, so nothing is allocated per request.
+//
+// Queries are objects whose first member is "query":
+//
+//   {"query": "history", "since": 1700000000000, "source": "10.0.0.7", "limit": 50, "cursor": 42, "id": 8}
+//
+// The history query returns the accepted notifications newest first,
+// optionally only the ones accepted in the since and until range (ms
+// since the epoch, inclusive), sent by one source or with all the words
+// of a "text" search, where "disk* full" matches "Disk-full on /var"
+// and "Full disk". The reply carries
+// a page of them and the cursor of the next page, if there is one:
+//
+//   {"id":8,"status":"ok","entries":[{"time":...,"source":"...","priority":"high","key":"...","msg":"..."}],"next":43}
+//
+// The stats query, {"query": "stats", "id": 9}, returns the values of all
+// the metrics, the histograms summarized by their percentiles:
+//
+//   {"id":9,"status":"ok","counters":{"bytes_received_total":512,...},"gauges":{...},
+//    "histograms":{"window_paint_us":{"count":3,"sum":950,"max":410,"p50":287,"p90":415,"p99":415,"p999":415},...}}
+//
+
+/// The largest accepted JSON request in bytes, connections are dropped rather than buffer a longer one
+static const std::size_t MaxJsonRequest = 1024 * 1024;
+
+/// Checks whether the given text request looks like a JSON request rather than plain text
+bool IsJsonRequest(Slice in);
+
+/// Checks whether the given start of a request is, or may still turn out to be, a JSON request once more of it arrives
+bool IsJsonRequestStart(Slice in);
+
+/// Parses the JSON request in the given buffer appending a NotifyFrame for every notification,
+/// returns false if the request is malformed. The buffer is modified and must outlive the frames
+bool ParseJsonRequest(char* begin, char* end, std::vector<NotifyFrame>& out);
+
+/// Encodes the acknowledgement of a JSON request
+std::string EncodeJsonAck(const AckTarget& target, AckStatus status);
+
+/// Checks whether the given JSON request is a query rather than notifications
+bool IsJsonQuery(Slice in);
+
+/// The kinds of queries
+enum class QueryKind
+{
+    History,
+    Stats
+};
+
+/// Parses the query in the given buffer, filling the history query members of any kind of query, the request id
+/// included. Returns false if the query is malformed or of an unknown kind. The buffer is modified
+bool ParseJsonQuery(char* begin, char* end, QueryKind& kind, HistoryQuery& q);
+
+/// Encodes the reply of a history query
+std::string EncodeJsonHistory(const HistoryQuery& q, const HistoryPage& page);
+
+/// Encodes the reply of a stats query
+std::string EncodeJsonStats(const HistoryQuery& q, const MetricsSnapshot& stats);
+
+#endif // ! _JSON_REQUEST_HPP_
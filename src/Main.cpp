@@ -29,17 +29,17 @@
 /*     '   '  `                                                                                                      */
 /*********************************************************************************************************************/
 #include <thread>
+#include <cstdlib>
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <objbase.h>
 #include "MessageServer.hpp"
 #include "NotificationService.hpp"
+#include "Displays.hpp"
+#include "Trace.hpp"
 
 int main(int argc, char* argv[])
 {
-    (void) argc;
-    (void) argv;
-
     // Initialize COM
     HRESULT hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED);
     if (FAILED(hr))
@@ -58,15 +58,65 @@ int main(int argc, char* argv[])
         return -1;
     }
 
+    // Lay out the notifications in physical pixels
+    EnableDpiAwareness();
+
+    // The trace points record only with --trace, the events are served on /trace by the HTTP endpoint
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--trace")
+            SetTracing(true);
+
     NotificationService ns;
-    auto x = std::bind(&NotificationService::ShowNotification, &ns, std::placeholders::_1, std::placeholders::_2);
+
+    // The notifications are kept across restarts only if a journal is given with --journal <path>
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--journal" && !ns.SetJournal(argv[i + 1]))
+            MessageBox(0, _T("Could not open the notification journal"), _T("Error"), MB_OK);
+
+    auto x = std::bind(&NotificationService::ShowNotification, &ns, std::placeholders::_1);
     SetNotificationEventCallback(x);
 
-    // Spawn the server thread
-    auto st = [&ns]() 
+    // Create the server here, so that it outlives the notification service that sends the acks through it
+    MessageServer srv;
+    srv.SetExitCallback(std::bind(&NotificationService::Stop, &ns));
+    srv.SetFlowControl(ns.GetFlowControl());
+
+    // Clients on the same host may connect through a unix domain socket or a named pipe only with --local
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--local" && !srv.ListenLocal())
+            MessageBox(0, _T("Could not listen for local connections"), _T("Error"), MB_OK);
+
+    // Local producers may push notifications through a shared memory ring only with --shm
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == "--shm" && !srv.ListenSharedMemory())
+            MessageBox(0, _T("Could not create the shared memory ring"), _T("Error"), MB_OK);
+
+    // The accepted notifications can be queried later only if a history directory is given with --history <dir>
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--history" && !srv.KeepHistory(argv[i + 1]))
+            MessageBox(0, _T("Could not open the notification history"), _T("Error"), MB_OK);
+
+    // Notifications are accepted over UDP only if a port is given with --udp <port>
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--udp" && !srv.ListenUdp(static_cast<unsigned short>(std::atoi(argv[i + 1]))))
+            MessageBox(0, _T("Could not listen for notifications over UDP"), _T("Error"), MB_OK);
+
+    // The metrics and health endpoints are served over HTTP only if a port is given with --http <port>, on the
+    // loopback interface unless another address is given with --http-address <address>
+    std::string httpAddress = "127.0.0.1";
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--http-address")
+            httpAddress = argv[i + 1];
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == "--http" && !srv.ServeHttp(static_cast<unsigned short>(std::atoi(argv[i + 1])), httpAddress))
+            MessageBox(0, _T("Could not serve the metrics over HTTP"), _T("Error"), MB_OK);
+    ns.SetAckCallback(std::bind(&MessageServer::PostAck, &srv, std::placeholders::_1, std::placeholders::_2));
+
+    // Spawn the server thread, it only starts accepting notifications once the notification service has the window
+    // they are posted to
+    auto st = [&srv, &ns]()
     {
-        MessageServer srv;
-        srv.SetExitCallback(std::bind(&NotificationService::Stop, &ns));
+        ns.WaitReady();
         srv.Run();
     };
     std::thread t(st);
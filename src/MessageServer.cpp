@@ -1,120 +1,1208 @@
 #include "MessageServer.hpp"
 #include <sstream>
-#include "NotificationWindow.hpp"
+#include <cstring>
+#include <cstdio>
+#include "JsonRequest.hpp"
+#include "Trace.hpp"
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
 
 // A simple logger
 static Logger<ConsoleAppender, SimpleFormatter> CLogger;
 
 // The notification callback holder
-static std::function<void(const std::string&, unsigned int)> notificationCallback;
+static std::function<void(const NotificationData&)> notificationCallback;
 
-void SetNotificationEventCallback(std::function<void(const std::string&, unsigned int)> cb)
+// The server metrics, updated on the io_service
+static Counter& connectionsAccepted = GetMetrics().GetCounter("connections_accepted_total", "Connections accepted on any endpoint");
+static Counter& connectionsRejected = GetMetrics().GetCounter("connections_rejected_total", "Connections closed right away because the connection limit was reached");
+static Gauge& connectionsOpen = GetMetrics().GetGauge("connections_open", "Connections currently open");
+static Counter& bytesReceived = GetMetrics().GetCounter("bytes_received_total", "Bytes received from the connections, datagrams and the shared memory ring");
+static Counter& bytesSent = GetMetrics().GetCounter("bytes_sent_total", "Bytes sent to the connections");
+static Counter& framesParsed = GetMetrics().GetCounter("frames_parsed_total", "Binary, JSON and text requests framed out of the received data");
+static Counter& framesMalformed = GetMetrics().GetCounter("frames_malformed_total", "Requests that could not be parsed");
+static Counter& notificationsAccepted = GetMetrics().GetCounter("notifications_accepted_total", "Notifications handed to the notification service");
+static Histogram& timerWheelLag = GetMetrics().GetHistogram("timer_wheel_lag_us", "How late the ticks of the connection timer wheel run");
+
+void SetNotificationEventCallback(std::function<void(const NotificationData&)> cb)
 {
     notificationCallback = cb;
 }
 
+// Records an accepted notification in the history, if there is one, and hands it to the notification callback
+static void Deliver(ConnectionManager& conMan, const NotificationData& data)
+{
+    if (HistoryStore* history = conMan.GetHistory())
+        history->Record(data);
+    notificationsAccepted.Add();
+    notificationCallback(data);
+}
+
+// Splits the optional leading [priority], [key=...] and [ack=...] tags from the notification text
+static NotificationData ParseTextRequest(const std::string& request)
+{
+    NotificationData data;
+    data.lifetime = 3000;
+    data.priority = Priority::Normal;
+    data.ack.mode = AckMode::Accepted;
+    data.ack.format = AckFormat::Text;
+
+    std::size_t pos = 0;
+    bool tagged = false;
+    while (pos < request.size() && request[pos] == '[')
+    {
+        std::size_t close = request.find(']', pos);
+        if (close == std::string::npos)
+            break;
+
+        // Anything that is not a known tag is part of the text
+        std::string tag = request.substr(pos + 1, close - pos - 1);
+        Priority p;
+        if (tag.compare(0, 4, "key=") == 0)
+            data.dedupKey = tag.substr(4);
+        else if (tag.compare(0, 4, "ack=") == 0)
+        {
+            if (!ParseAckMode(tag.substr(4), data.ack.mode))
+                break;
+        }
+        else if (ParsePriority(tag, p))
+            data.priority = p;
+        else
+            break;
+        pos = close + 1;
+        tagged = true;
+    }
+
+    if (tagged)
+        pos = std::min(request.find_first_not_of(' ', pos), request.size());
+    data.msg = request.substr(pos);
+    return data;
+}
+
+// Encodes an ack in the format of the request, the accepted ack of a text request is the echo of the request
+static std::string EncodeAck(const AckTarget& target, AckStatus status, const std::string& echo)
+{
+    switch (target.format)
+    {
+        case AckFormat::Binary:
+            return EncodeAckFrame(target, status);
+        case AckFormat::Json:
+            return EncodeJsonAck(target, status);
+        default:
+            return status == AckStatus::Accepted ? echo : GetAckStatusName(status);
+    }
+}
+
+// Parses a message that carries whole requests, a datagram or a shared memory record, and passes its notifications to
+// the given function. Returns false if the message is malformed
+template<typename F>
+static bool ParseMessage(char* data, std::size_t size, std::vector<NotifyFrame>& batch, F dispatch)
+{
+    Slice in(data, size);
+    if (IsFrameStart(in))
+    {
+        FrameHeader h;
+        NotifyFrame f;
+        if (ParseFrameHeader(in, h) != FrameStatus::Ready || h.type != FrameType::Notify
+         || !ParseNotifyFrame(in.Skip(FrameHeaderSize).Take(h.length), f))
+        {
+            framesMalformed.Add();
+            return false;
+        }
+        framesParsed.Add();
+        dispatch(ToNotificationData(f, AckFormat::Binary));
+        return true;
+    }
+
+    // The terminating NUL of the stream protocol is optional
+    while (size != 0 && data[size - 1] == '\0')
+        --size;
+    in = Slice(data, size);
+    if (IsJsonRequest(in))
+    {
+        batch.clear();
+        if (!ParseJsonRequest(data, data + size, batch))
+        {
+            framesMalformed.Add();
+            return false;
+        }
+        framesParsed.Add();
+        for (const auto& f : batch)
+            dispatch(ToNotificationData(f, AckFormat::Json));
+        return true;
+    }
+
+    if (size != 0)
+    {
+        framesParsed.Add();
+        dispatch(ParseTextRequest(in.ToString()));
+    }
+    return true;
+}
+
 ///==============================================================
 ///= ClientConnection
 ///==============================================================
 
-ClientConnection::ClientConnection(asio::ip::tcp::socket socket, ConnectionManager& parentConMan) 
-    : mSocket(std::move(socket)),
-      mParentConnectionManager(parentConMan)
+ClientConnection::ClientConnection(std::unique_ptr<Transport> transport, ConnectionManager& parentConMan) 
+    : mTransport(std::move(transport)),
+      mInPos(0),
+      mBatchPos(0),
+      mWriting(false),
+      mFlushPosted(false),
+      mParentConnectionManager(parentConMan),
+      mSlot(NoSlot),
+      mAwaitingRest(false)
 {
-    std::fill(std::begin(mRvBuf), std::end(mRvBuf), 0);
+    mIP = mTransport->GetPeerName();
 }
 
 void ClientConnection::Start()
 {
-    mIP = mSocket.remote_endpoint().address().to_string();
     DoRecv();
 }
 
 void ClientConnection::Stop()
 {
-    mSocket.close();
+    mTransport->Close();
+    mTimeoutTimer.Cancel();
+    mThrottleTimer.Cancel();
+}
+
+void ClientConnection::Resume()
+{
+    if (mTransport->IsOpen())
+        DoRecv();
+}
+
+void ClientConnection::ContinueRecv()
+{
+    // Leaving the socket unread lets TCP flow control push back on the client, the client is not to blame for the wait
+    if (mParentConnectionManager.IsPaused())
+    {
+        mTimeoutTimer.Cancel();
+        mAwaitingRest = false;
+        mParentConnectionManager.Park(shared_from_this());
+    }
+    else
+        DoRecv();
+}
+
+void ClientConnection::ArmTimeout()
+{
+    // The idle timeout restarts with every read, the read timeout runs from the first byte of the partial request
+    bool partial = mInBuf.size() != mInPos;
+    if (partial && mAwaitingRest)
+        return;
+    mAwaitingRest = partial;
+
+    auto timeout = partial ? mParentConnectionManager.GetReadTimeout() : mParentConnectionManager.GetIdleTimeout();
+    if (timeout == TimerWheel::Clock::duration::zero())
+    {
+        mTimeoutTimer.Cancel();
+        return;
+    }
+    mParentConnectionManager.ScheduleTimer(mTimeoutTimer, timeout,
+        [this]()
+        {
+            mParentConnectionManager.Expire(shared_from_this(), mAwaitingRest);
+        }
+    );
+}
+
+const std::string& ClientConnection::GetIP() const
+{
+    return mIP;
+}
+
+TokenBucket& ClientConnection::GetBucket()
+{
+    return mBucket;
+}
+
+void ClientConnection::SetAddressBucket(std::shared_ptr<TokenBucket> bucket)
+{
+    mAddressBucket = std::move(bucket);
+}
+
+const std::shared_ptr<TokenBucket>& ClientConnection::GetAddressBucket() const
+{
+    return mAddressBucket;
+}
+
+std::size_t ClientConnection::GetSlot() const
+{
+    return mSlot;
+}
+
+void ClientConnection::SetSlot(std::size_t slot)
+{
+    mSlot = slot;
 }
 
 void ClientConnection::DoRecv()
 {
+    TRACE_SCOPE("ClientConnection::DoRecv");
+    ArmTimeout();
+
+    // Drop the consumed bytes, whatever is left is the start of a request that is not complete yet.
+    // A connection that has handled all its input gives its buffer back while it waits
+    mInBuf.erase(std::begin(mInBuf), std::begin(mInBuf) + mInPos);
+    mInPos = 0;
+    mBatch.clear();
+    mBatchPos = 0;
+    if (mInBuf.empty() && mInBuf.capacity() != 0)
+    {
+        mParentConnectionManager.GetBufferPool().Release(std::move(mInBuf));
+        mInBuf = ByteBuffer();
+    }
+
     auto self(shared_from_this());
-    mSocket.async_read_some(asio::buffer(mRvBuf),
-        [this, self](const asio::error_code& ec, std::size_t bytes_transferred)
-        {
-            if (!mSocket.is_open())
-                return;
-    
-            if ((ec == asio::error::eof) || (ec == asio::error::connection_reset))
-            {
-                // Client disconnect
-                CLogger.Info("Client with ip " + mIP + " has disconnected.");
-                mParentConnectionManager.Stop(shared_from_this());
-            }
-            else
+    if (mTransport->CanWaitReadable())
+    {
+        // Wait without a buffer, it is only needed once there is something to read
+        mTransport->AsyncWaitReadable(
+            [this, self](const asio::error_code& ec, std::size_t)
             {
-                CLogger.Info("Received " + std::to_string(bytes_transferred) + " bytes of data from client with ip " + mIP);
-                
-                // Do staph with the data
-                std::string request(&mRvBuf[0]);
-                
-                // Clear the old buffer
-                mRvBuf.fill(0);
-
-                // Handle the request
-                HandleMessage(std::move(request));
-
-                // Rescedule receive operation
-                DoRecv();
+                if (!mTransport->IsOpen())
+                    return;
+                if (ec)
+                    OnReceived(ec, mInBuf.size(), 0);
+                else
+                    ReadAvailable();
             }
+        );
+        return;
+    }
+
+    // Streams without readiness hold the buffer for the whole read
+    std::size_t used = PrepareInput();
+    mTransport->AsyncReadSome(asio::buffer(&mInBuf[used], mInBuf.size() - used),
+        [this, self, used](const asio::error_code& ec, std::size_t bytes_transferred)
+        {
+            if (!mTransport->IsOpen())
+                return;
+            OnReceived(ec, used, bytes_transferred);
         }
     );
 }
 
+void ClientConnection::ReadAvailable()
+{
+    TRACE_SCOPE("ClientConnection::ReadAvailable");
+    std::size_t used = PrepareInput();
+    asio::error_code ec;
+    std::size_t bytes = mTransport->ReadSome(asio::buffer(&mInBuf[used], mInBuf.size() - used), ec);
+    OnReceived(ec, used, bytes);
+}
+
+std::size_t ClientConnection::PrepareInput()
+{
+    BufferPool& pool = mParentConnectionManager.GetBufferPool();
+    if (mInBuf.capacity() == 0)
+        mInBuf = pool.Acquire();
+    std::size_t used = mInBuf.size();
+    mInBuf.resize(used + pool.GetBlockSize());
+    return used;
+}
+
+void ClientConnection::OnReceived(const asio::error_code& ec, std::size_t used, std::size_t bytes)
+{
+    TRACE_SCOPE("ClientConnection::OnReceived");
+    mInBuf.resize(used + bytes);
+
+    if (ec == asio::error::would_block || ec == asio::error::try_again)
+    {
+        // The readiness was spurious
+        DoRecv();
+    }
+    else if ((ec == asio::error::eof) || (ec == asio::error::connection_reset))
+    {
+        // Client disconnect
+        CLogger.Info("Client with ip " + mIP + " has disconnected.");
+        mParentConnectionManager.Stop(shared_from_this());
+    }
+    else if (ec)
+    {
+        CLogger.Info("Receive from client with ip " + mIP + " failed: " + ec.message());
+        mParentConnectionManager.Stop(shared_from_this());
+    }
+    else
+    {
+        CLogger.Info("Received " + std::to_string(bytes) + " bytes of data from client with ip " + mIP);
+        bytesReceived.Add(bytes);
+
+        // Requests may span several reads or share one, so they are framed out of the accumulated input
+        ProcessInput();
+    }
+}
+
 void ClientConnection::DoSend(std::string message)
 {
-    std::copy(message.begin(), message.end(), mSdBuf.begin());
+    mOutPending += message;
+
+    // Flush once the handlers that are already queued had their chance to add their replies as well
+    if (mWriting || mFlushPosted)
+        return;
+    mFlushPosted = true;
     auto self(shared_from_this());
-    mSocket.async_write_some(asio::buffer(mSdBuf, message.size()),
-        [this, self](asio::error_code ec, std::size_t sent)
+    mTransport->GetIOService().post(
+        [this, self]()
         {
-            (void) ec;
+            mFlushPosted = false;
+            DoFlush();
+        }
+    );
+}
+
+void ClientConnection::DoFlush()
+{
+    if (mWriting || mOutPending.empty() || !mTransport->IsOpen())
+        return;
+
+    // Everything queued so far goes out with a single write, replies queued meanwhile wait for the next one
+    mOutFlight.swap(mOutPending);
+    mOutPending.clear();
+    mWriting = true;
+
+    auto self(shared_from_this());
+    mTransport->AsyncWrite(asio::buffer(mOutFlight),
+        [this, self](const asio::error_code& ec, std::size_t sent)
+        {
+            mWriting = false;
+            mOutFlight.clear();
+            if (ec)
+                return;
+            bytesSent.Add(sent);
             if (sent != 0)
                 CLogger.Info("Sent " + std::to_string(sent) + " bytes of data to the IP: " + mIP);
+            DoFlush();
         }
     );
 }
 
-void ClientConnection::HandleMessage(std::string msg)
+void ClientConnection::ProcessInput()
+{
+    Request r;
+    for (;;)
+    {
+        ParseResult res = NextRequest(r);
+        if (res == ParseResult::Empty)
+            break;
+        if (res == ParseResult::Broken)
+        {
+            CLogger.Info("Client with ip " + mIP + " sent an invalid frame or an oversized request, disconnecting.");
+            mParentConnectionManager.Stop(shared_from_this());
+            return;
+        }
+
+        // A throttled request resumes the processing once it is admitted
+        if (!AdmitRequest(r))
+            return;
+    }
+
+    // Everything buffered is handled, ask for more
+    ContinueRecv();
+}
+
+ClientConnection::ParseResult ClientConnection::NextRequest(Request& r)
+{
+    TRACE_SCOPE("ClientConnection::NextRequest");
+    // The rest of a JSON batch comes first, its slices point into the input buffer that is kept until the next read
+    if (mBatchPos < mBatch.size())
+    {
+        r.data = ToNotificationData(mBatch[mBatchPos++], AckFormat::Json);
+        r.echo.clear();
+        return ParseResult::Ready;
+    }
+    mBatch.clear();
+    mBatchPos = 0;
+
+    while (mInPos < mInBuf.size())
+    {
+        Slice in(mInBuf.data() + mInPos, mInBuf.size() - mInPos);
+
+        // Binary frame
+        if (IsFrameStart(in))
+        {
+            FrameHeader h;
+            FrameStatus st = ParseFrameHeader(in, h);
+            if (st == FrameStatus::Incomplete)
+                return ParseResult::Empty;
+            if (st == FrameStatus::Invalid)
+            {
+                framesMalformed.Add();
+                return ParseResult::Broken;
+            }
+            mInPos += FrameHeaderSize + h.length;
+
+            // Only notification requests are expected from clients, anything else is skipped
+            if (h.type != FrameType::Notify)
+                continue;
+
+            NotifyFrame f;
+            bool parsed = ParseNotifyFrame(in.Skip(FrameHeaderSize).Take(h.length), f);
+            r.data = ToNotificationData(f, AckFormat::Binary);
+            r.echo.clear();
+            if ((h.flags & FlagNoAck) != 0)
+                r.data.ack.mode = AckMode::None;
+            if (!parsed)
+            {
+                framesMalformed.Add();
+                if (r.data.ack.mode != AckMode::None)
+                    DoSend(EncodeAckFrame(r.data.ack, AckStatus::Malformed));
+                continue;
+            }
+            framesParsed.Add();
+            return ParseResult::Ready;
+        }
+
+        // Text request, up to the terminating NUL. A JSON request is kept buffered until its NUL arrives, like a
+        // partial frame under the read timeout, only the legacy text requests may end with the received data
+        const char* nul = static_cast<const char*>(std::memchr(in.data, '\0', in.size));
+        if (!nul && IsJsonRequestStart(in))
+        {
+            if (in.size <= MaxJsonRequest)
+                return ParseResult::Empty;
+            framesMalformed.Add();
+            return ParseResult::Broken;
+        }
+        std::size_t len = nul ? static_cast<std::size_t>(nul - in.data) : in.size;
+        mInPos += nul ? len + 1 : len;
+        if (len == 0)
+            continue;
+
+        // JSON request, parsed in place
+        if (IsJsonRequest(in.Take(len)))
+        {
+            char* begin = &mInBuf[mInPos - (nul ? len + 1 : len)];
+            if (IsJsonQuery(in.Take(len)))
+            {
+                HandleQuery(begin, begin + len);
+                continue;
+            }
+            if (!ParseJsonRequest(begin, begin + len, mBatch))
+            {
+                framesMalformed.Add();
+                DoSend(EncodeJsonAck(AckTarget(), AckStatus::Malformed));
+                continue;
+            }
+            framesParsed.Add();
+            return NextRequest(r);
+        }
+
+        framesParsed.Add();
+        r.echo.assign(in.data, len);
+        r.data = ParseTextRequest(r.echo);
+        return ParseResult::Ready;
+    }
+    return ParseResult::Empty;
+}
+
+bool ClientConnection::AdmitRequest(Request& r)
+{
+    auto wait = mParentConnectionManager.Throttle(*this, r.data.priority);
+    if (wait == TokenBucket::Clock::duration::zero())
+    {
+        Dispatch(r);
+        return true;
+    }
+
+    if (mParentConnectionManager.GetThrottleAction() == ThrottleAction::Reply)
+    {
+        if (r.data.ack.mode != AckMode::None)
+            DoSend(EncodeAck(r.data.ack, AckStatus::Throttled, r.echo));
+        return true;
+    }
+
+    // Leave the socket unread while waiting, so that TCP flow control slows the client down.
+    // The wait is ours, so the timeouts do not run meanwhile
+    mTimeoutTimer.Cancel();
+    mAwaitingRest = false;
+    auto held = std::make_shared<Request>(std::move(r));
+    mParentConnectionManager.ScheduleTimer(mThrottleTimer, wait,
+        [this, held]()
+        {
+            if (!mTransport->IsOpen())
+                return;
+            if (AdmitRequest(*held))
+                ProcessInput();
+        }
+    );
+    return false;
+}
+
+void ClientConnection::HandleQuery(char* begin, char* end)
 {
-    notificationCallback(msg, 3000);
+    TRACE_SCOPE("ClientConnection::HandleQuery");
+    QueryKind kind;
+    HistoryQuery q;
+    if (!ParseJsonQuery(begin, end, kind, q))
+    {
+        framesMalformed.Add();
+        AckTarget target;
+        target.requestId = q.requestId;
+        target.hasRequestId = q.hasRequestId;
+        DoSend(EncodeJsonAck(target, AckStatus::Malformed));
+        return;
+    }
+    framesParsed.Add();
+
+    if (kind == QueryKind::Stats)
+    {
+        DoSend(EncodeJsonStats(q, GetMetrics().Snapshot()));
+        return;
+    }
+
+    // A server without a history has nothing to report
+    HistoryStore* history = mParentConnectionManager.GetHistory();
+    DoSend(EncodeJsonHistory(q, history ? history->Query(q) : HistoryPage()));
+}
+
+void ClientConnection::Dispatch(Request& r)
+{
+    TRACE_SCOPE("ClientConnection::Dispatch");
+    // The displayed ack comes back from the notification thread through the connection handle
+    if (r.data.ack.mode == AckMode::Displayed)
+        r.data.ack.connection = shared_from_this();
+    r.data.source = mIP;
+    Deliver(mParentConnectionManager, r.data);
 
     // Send back the responce
-    DoSend(msg);
+    if (r.data.ack.mode == AckMode::Accepted)
+        DoSend(EncodeAck(r.data.ack, AckStatus::Accepted, r.echo));
+}
+
+void ClientConnection::HandleMessage(std::string msg)
+{
+    TRACE_SCOPE("ClientConnection::HandleMessage");
+    Request r;
+    r.data = ParseTextRequest(msg);
+    r.echo = std::move(msg);
+    Dispatch(r);
+}
+
+void ClientConnection::SendAck(const AckTarget& target, AckStatus status)
+{
+    if (mTransport->IsOpen())
+        DoSend(EncodeAck(target, status, std::string()));
 }
 
 ///==============================================================
 ///= ConnectionManager
 ///==============================================================
 
+ConnectionManager::ConnectionManager(asio::io_service& ios)
+    : mConnectionCount(0),
+      mMaxConnections(1024),
+      mTickTimer(ios),
+      mTicking(false),
+      mIdleTimeout(std::chrono::minutes(5)),
+      mReadTimeout(std::chrono::seconds(30)),
+      mIdleTimeouts(0),
+      mReadTimeouts(0),
+      mConnectionLimit{50.0, 100.0},
+      mAddressLimit{200.0, 400.0},
+      mThrottleAction(ThrottleAction::Pause),
+      mThrottled(0),
+      mFlowControl(nullptr),
+      mPausedCount(0),
+      mHistory(nullptr)
+{
+}
+
 void ConnectionManager::Start(ClientConnectionPtr c)
 {
-    mConnections.insert(c);
+    // The connections of the same client ip share a bucket, so that opening more connections does not raise the limit
+    c->GetBucket().SetLimit(mConnectionLimit);
+    auto& bucket = mAddressBuckets[c->GetIP()];
+    if (!bucket)
+        bucket = std::make_shared<TokenBucket>(mAddressLimit);
+    c->SetAddressBucket(bucket);
+
+    c->SetSlot(mConnections.size());
+    mConnections.push_back(c);
+    mConnectionCount = mConnections.size();
+    connectionsAccepted.Add();
+    connectionsOpen.Add(1);
     c->Start();
 }
 
 void ConnectionManager::Stop(ClientConnectionPtr c)
 {
-    mConnections.erase(c);
+    // A connection may be stopped more than once, by an error after a timeout for example
+    std::size_t slot = c->GetSlot();
+    if (slot == ClientConnection::NoSlot || slot >= mConnections.size() || mConnections[slot] != c)
+    {
+        c->Stop();
+        return;
+    }
+    bool wasFull = IsFull();
+    mConnections[slot] = std::move(mConnections.back());
+    mConnections[slot]->SetSlot(slot);
+    mConnections.pop_back();
+    c->SetSlot(ClientConnection::NoSlot);
+    mConnectionCount = mConnections.size();
+    connectionsOpen.Add(-1);
+
+    if (mParked.erase(c) != 0)
+        mPausedCount = mParked.size();
     c->Stop();
+
+    // Forget the bucket of the client ip along with its last connection
+    auto bucket = mAddressBuckets.find(c->GetIP());
+    if (bucket != std::end(mAddressBuckets) && bucket->second == c->GetAddressBucket() && bucket->second.use_count() == 2)
+        mAddressBuckets.erase(bucket);
+    c->SetAddressBucket(nullptr);
+
+    if (wasFull && mCapacityCallback)
+        mCapacityCallback();
 }
 
 void ConnectionManager::StopAll()
 {
     size_t aliveConnections = mConnections.size();
     for (auto& c : mConnections)
+    {
+        c->SetSlot(ClientConnection::NoSlot);
         c->Stop();
+    }
+    connectionsOpen.Add(-static_cast<std::int64_t>(mConnections.size()));
     mConnections.clear();
+    mConnectionCount = 0;
+    mParked.clear();
+    mPausedCount = 0;
+    mAddressBuckets.clear();
     CLogger.Info("Terminated " + std::to_string(aliveConnections) + " alive connections.");
+
+    // Let the io_service run out of work
+    asio::error_code ec;
+    mTickTimer.cancel(ec);
+    mTicking = false;
+}
+
+void ConnectionManager::Expire(ClientConnectionPtr c, bool partialRequest)
+{
+    if (partialRequest)
+    {
+        ++mReadTimeouts;
+        CLogger.Info("Client with ip " + c->GetIP() + " did not complete its request in time, disconnecting.");
+    }
+    else
+    {
+        ++mIdleTimeouts;
+        CLogger.Info("Client with ip " + c->GetIP() + " was idle for too long, disconnecting.");
+    }
+    Stop(c);
+}
+
+void ConnectionManager::ScheduleTimer(TimerWheel::Timer& t, TimerWheel::Clock::duration after, std::function<void()> cb)
+{
+    mWheel.Schedule(t, TimerWheel::Clock::now() + after, std::move(cb));
+    if (!mTicking)
+    {
+        mTicking = true;
+        DoTick();
+    }
+}
+
+void ConnectionManager::DoTick()
+{
+    mTickTimer.expires_from_now(mWheel.GetResolution());
+    mTickTimer.async_wait(
+        [this](const asio::error_code& ec)
+        {
+            if (ec || !mTicking)
+                return;
+            auto now = TimerWheel::Clock::now();
+            timerWheelLag.Record(now - mTickTimer.expires_at());
+            mWheel.Advance(now);
+
+            // An empty wheel does not keep the io_service busy
+            if (mWheel.Size() != 0)
+                DoTick();
+            else
+                mTicking = false;
+        }
+    );
+}
+
+void ConnectionManager::SetTimeouts(TimerWheel::Clock::duration idle, TimerWheel::Clock::duration read)
+{
+    mIdleTimeout = idle;
+    mReadTimeout = read;
+}
+
+TimerWheel::Clock::duration ConnectionManager::GetIdleTimeout() const
+{
+    return mIdleTimeout;
+}
+
+TimerWheel::Clock::duration ConnectionManager::GetReadTimeout() const
+{
+    return mReadTimeout;
+}
+
+void ConnectionManager::SetMaxConnections(std::size_t max)
+{
+    mMaxConnections = max;
+}
+
+bool ConnectionManager::IsFull() const
+{
+    return mMaxConnections != 0 && mConnections.size() >= mMaxConnections;
+}
+
+void ConnectionManager::SetCapacityCallback(std::function<void()> cb)
+{
+    mCapacityCallback = cb;
+}
+
+std::size_t ConnectionManager::GetConnectionCount() const
+{
+    return mConnectionCount.load();
+}
+
+std::uint64_t ConnectionManager::GetIdleTimeoutCount() const
+{
+    return mIdleTimeouts.load(std::memory_order_relaxed);
+}
+
+std::uint64_t ConnectionManager::GetReadTimeoutCount() const
+{
+    return mReadTimeouts.load(std::memory_order_relaxed);
+}
+
+BufferPool& ConnectionManager::GetBufferPool()
+{
+    return mBufferPool;
+}
+
+void ConnectionManager::SetRateLimits(RateLimit perConnection, RateLimit perAddress)
+{
+    mConnectionLimit = perConnection;
+    mAddressLimit = perAddress;
+    for (auto& c : mConnections)
+        c->GetBucket().SetLimit(perConnection);
+    for (auto& b : mAddressBuckets)
+        b.second->SetLimit(perAddress);
+}
+
+void ConnectionManager::SetThrottleAction(ThrottleAction action)
+{
+    mThrottleAction = action;
+}
+
+ThrottleAction ConnectionManager::GetThrottleAction() const
+{
+    return mThrottleAction;
+}
+
+TokenBucket::Clock::duration ConnectionManager::Throttle(ClientConnection& c, Priority p)
+{
+    if (p == Priority::Critical)
+        return TokenBucket::Clock::duration::zero();
+
+    // Both buckets must have a token, the connection one is given back if the client ip is over its limit
+    auto now = TokenBucket::Clock::now();
+    auto wait = c.GetBucket().TryConsume(now);
+    if (wait == TokenBucket::Clock::duration::zero() && c.GetAddressBucket())
+    {
+        wait = c.GetAddressBucket()->TryConsume(now);
+        if (wait != TokenBucket::Clock::duration::zero())
+            c.GetBucket().Refund();
+    }
+
+    if (wait != TokenBucket::Clock::duration::zero())
+        mThrottled.fetch_add(1, std::memory_order_relaxed);
+    return wait;
+}
+
+std::uint64_t ConnectionManager::GetThrottledCount() const
+{
+    return mThrottled.load(std::memory_order_relaxed);
+}
+
+void ConnectionManager::SetFlowControl(FlowControl* fc)
+{
+    mFlowControl = fc;
+}
+
+bool ConnectionManager::IsPaused() const
+{
+    return mFlowControl && mFlowControl->IsPaused();
+}
+
+void ConnectionManager::Park(ClientConnectionPtr c)
+{
+    mParked.insert(c);
+    mPausedCount = mParked.size();
+
+    // The queue may have drained while the connection was being parked
+    if (!IsPaused())
+        ResumeAll();
+}
+
+void ConnectionManager::ResumeAll()
+{
+    std::set<ClientConnectionPtr> parked;
+    parked.swap(mParked);
+    mPausedCount = 0;
+    for (auto& c : parked)
+        c->Resume();
+}
+
+std::size_t ConnectionManager::GetPausedCount() const
+{
+    return mPausedCount.load();
+}
+
+void ConnectionManager::SetHistory(HistoryStore* history)
+{
+    mHistory = history;
+}
+
+HistoryStore* ConnectionManager::GetHistory() const
+{
+    return mHistory;
+}
+
+///==============================================================
+///= DatagramListener
+///==============================================================
+
+// The number of datagrams received in a row before the other handlers get their turn
+static const std::size_t datagramBatch = 64;
+
+DatagramListener::DatagramListener(asio::io_service& ios, unsigned short port, ConnectionManager& conMan)
+    : mSocket(ios),
+      mConnectionManager(conMan),
+      mRvBuf(64 * 1024),
+      mParked(false),
+      mReceived(0),
+      mDropped(0)
+{
+    asio::error_code ec;
+    asio::ip::udp::endpoint endpoint(asio::ip::udp::v4(), port);
+    mSocket.open(endpoint.protocol(), ec);
+    if (!ec)
+        mSocket.bind(endpoint, ec);
+    if (!ec)
+        mSocket.non_blocking(true, ec);
+    if (ec)
+    {
+        CLogger.Info("Could not listen for datagrams on UDP port " + std::to_string(port) + ": " + ec.message());
+        asio::error_code ignored;
+        mSocket.close(ignored);
+    }
+}
+
+bool DatagramListener::IsOpen() const
+{
+    return mSocket.is_open();
+}
+
+void DatagramListener::Start()
+{
+    DoWait();
+}
+
+void DatagramListener::Stop()
+{
+    mSocket.close();
+}
+
+void DatagramListener::Resume()
+{
+    if (!mParked || !mSocket.is_open())
+        return;
+    mParked = false;
+    DoWait();
+}
+
+void DatagramListener::SetRateLimit(RateLimit limit)
+{
+    mBucket.SetLimit(limit);
+}
+
+std::uint64_t DatagramListener::GetReceivedCount() const
+{
+    return mReceived.load(std::memory_order_relaxed);
+}
+
+std::uint64_t DatagramListener::GetDroppedCount() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+void DatagramListener::DoWait()
+{
+    // Only wait for readiness, the datagrams are received in batches by Drain
+    mSocket.async_receive(asio::null_buffers(),
+        [this](const asio::error_code& ec, std::size_t)
+        {
+            if (ec || !mSocket.is_open())
+                return;
+            Drain();
+        }
+    );
+}
+
+void DatagramListener::Drain()
+{
+    for (std::size_t i = 0; i < datagramBatch; ++i)
+    {
+        asio::error_code ec;
+        std::size_t size = mSocket.receive_from(asio::buffer(mRvBuf), mSender, 0, ec);
+        if (ec == asio::error::would_block)
+            break;
+        if (ec)
+        {
+            // Errors like an ICMP port unreachable reported on the socket concern a single datagram
+            CLogger.Info("Datagram receive failed: " + ec.message());
+            continue;
+        }
+        ++mReceived;
+        bytesReceived.Add(size);
+        HandleDatagram(mRvBuf.data(), size);
+    }
+
+    // Stop receiving while the notification queue is full, the socket buffer takes the excess
+    if (mConnectionManager.IsPaused())
+        mParked = true;
+    else
+        DoWait();
+}
+
+void DatagramListener::HandleDatagram(char* data, std::size_t size)
+{
+    if (!ParseMessage(data, size, mBatch, [this](NotificationData d) { Dispatch(std::move(d)); }))
+        ++mDropped;
+}
+
+void DatagramListener::Dispatch(NotificationData data)
+{
+    if (data.priority != Priority::Critical && mBucket.TryConsume(TokenBucket::Clock::now()) != TokenBucket::Clock::duration::zero())
+    {
+        ++mDropped;
+        return;
+    }
+
+    // Datagrams have nobody to acknowledge to, so every notification is fire and forget
+    data.ack.mode = AckMode::None;
+    data.source = mSender.address().to_string();
+    Deliver(mConnectionManager, data);
+}
+
+///==============================================================
+///= SharedMemoryListener
+///==============================================================
+
+// The number of records read in a row before the other handlers get their turn
+static const std::size_t sharedMemoryBatch = 256;
+
+#if !defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE) && !defined(__linux__)
+// The poll interval of an empty ring where there is neither a wakeup event nor a futex. The producer is another
+// process that shares nothing with the server but the mapping, and the only portable primitives that work across
+// processes on a word of shared memory are process shared mutexes and condition variables, which a crashed producer
+// can leave locked. A millisecond keeps the latency of the first record of a burst below a frame, and once the
+// records flow the ring is drained in batches without waiting at all
+static const std::chrono::milliseconds sharedMemoryPollInterval(1);
+#endif
+
+SharedMemoryListener::SharedMemoryListener(asio::io_service& ios, const std::string& name, std::uint32_t capacity, ConnectionManager& conMan)
+    : mIOService(ios),
+      mOpen(false),
+#if defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE)
+      mEvent(ios),
+#elif defined(__linux__)
+      mWaitRequested(false),
+      mWaiterExit(false),
+#else
+      mPollTimer(ios),
+#endif
+      mConnectionManager(conMan),
+      mRunning(false),
+      mParked(false),
+      mReceived(0),
+      mDropped(0)
+{
+    mOpen = mRing.Create(name, capacity);
+#if defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE)
+    // The object handle takes over the event and closes it
+    HANDLE e = mOpen ? mRing.GetRegion().ReleaseEvent() : nullptr;
+    if (e)
+        mEvent.assign(e);
+    else
+        mOpen = false;
+#endif
+}
+
+SharedMemoryListener::~SharedMemoryListener()
+{
+#if !defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE) && defined(__linux__)
+    {
+        std::lock_guard<std::mutex> lock(mWaitMutex);
+        mWaiterExit = true;
+    }
+    mWaitRequest.notify_one();
+    if (mOpen)
+        mRing.Wake();
+    if (mWaiter.joinable())
+        mWaiter.join();
+#endif
+}
+
+bool SharedMemoryListener::IsOpen() const
+{
+    return mOpen;
+}
+
+void SharedMemoryListener::Start()
+{
+    if (!IsOpen())
+        return;
+    mRunning = true;
+#if !defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE) && defined(__linux__)
+    if (!mWaiter.joinable())
+        mWaiter = std::thread(&SharedMemoryListener::WaitLoop, this);
+#endif
+    Drain();
+}
+
+void SharedMemoryListener::Stop()
+{
+    mRunning = false;
+    asio::error_code ec;
+#if defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE)
+    mEvent.cancel(ec);
+#elif defined(__linux__)
+    // The waiter posts one last drain, which finds the listener stopped
+    if (IsOpen())
+        mRing.Wake();
+#else
+    mPollTimer.cancel(ec);
+#endif
+}
+
+void SharedMemoryListener::Resume()
+{
+    if (!mParked || !mRunning)
+        return;
+    mParked = false;
+    Drain();
+}
+
+std::uint64_t SharedMemoryListener::GetReceivedCount() const
+{
+    return mReceived.load(std::memory_order_relaxed);
+}
+
+std::uint64_t SharedMemoryListener::GetDroppedCount() const
+{
+    return mDropped.load(std::memory_order_relaxed);
+}
+
+void SharedMemoryListener::DoWait()
+{
+#if defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE)
+    // The producer only signals the event after PrepareWait, so a busy producer never makes a system call
+    if (!mRing.PrepareWait())
+    {
+        mIOService.post([this]() { if (mRunning) Drain(); });
+        return;
+    }
+    mEvent.async_wait(
+        [this](const asio::error_code& ec)
+        {
+            mRing.CancelWait();
+            if (ec || !mRunning)
+                return;
+            Drain();
+        }
+    );
+#elif defined(__linux__)
+    // As with the event, the producer only makes the wake call after PrepareWait
+    if (!mRing.PrepareWait())
+    {
+        mIOService.post([this]() { if (mRunning) Drain(); });
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mWaitMutex);
+        mWaitRequested = true;
+    }
+    mWaitRequest.notify_one();
+#else
+    mPollTimer.expires_from_now(sharedMemoryPollInterval);
+    mPollTimer.async_wait(
+        [this](const asio::error_code& ec)
+        {
+            if (ec || !mRunning)
+                return;
+            Drain();
+        }
+    );
+#endif
+}
+
+#if !defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE) && defined(__linux__)
+void SharedMemoryListener::WaitLoop()
+{
+    std::unique_lock<std::mutex> lock(mWaitMutex);
+    for (;;)
+    {
+        mWaitRequest.wait(lock, [this]() { return mWaiterExit || mWaitRequested; });
+        if (mWaiterExit)
+            return;
+        mWaitRequested = false;
+
+        // The producer clears the waiting flag before it wakes the futex, so the ring is ready to drain on return
+        lock.unlock();
+        mRing.Wait();
+        lock.lock();
+        if (mWaiterExit)
+            return;
+        mIOService.post([this]() { if (mRunning) Drain(); });
+    }
+}
+#endif
+
+void SharedMemoryListener::Drain()
+{
+    std::uint64_t resets = mRing.GetResetCount();
+    std::size_t n = mRing.Drain(
+        [this](char* data, std::size_t size)
+        {
+            ++mReceived;
+            bytesReceived.Add(size);
+            if (!ParseMessage(data, size, mBatch, [this](NotificationData d) { Dispatch(std::move(d)); }))
+                ++mDropped;
+        },
+        sharedMemoryBatch
+    );
+    if (mRing.GetResetCount() != resets)
+    {
+        CLogger.Info("The shared memory producer wrote a malformed record, dropping what the ring held");
+        ++mDropped;
+    }
+
+    // Stop draining while the notification queue is full, the ring takes the excess and the producer sees it full
+    if (mConnectionManager.IsPaused())
+        mParked = true;
+    else if (n == sharedMemoryBatch)
+        mIOService.post([this]() { if (mRunning) Drain(); });
+    else
+        DoWait();
+}
+
+void SharedMemoryListener::Dispatch(NotificationData data)
+{
+    // The ring has no way back to the producer, so every notification is fire and forget
+    data.ack.mode = AckMode::None;
+    data.source = "shm";
+    Deliver(mConnectionManager, data);
 }
 
 ///==============================================================
@@ -124,8 +1212,16 @@ void ConnectionManager::StopAll()
 MessageServer::MessageServer(unsigned short port /* = 7777 */)
      : mAcceptor(mIOService),
        mSignals(mIOService),
-       mAcceptSocket(mIOService)
+       mConnectionManager(mIOService),
+       mAcceptSocket(mIOService),
+       mAcceptPaused(false),
+       mLocalAcceptPaused(false),
+       mStartTime(std::chrono::steady_clock::now())
 {
+#if !defined(ASIO_HAS_LOCAL_SOCKETS) && defined(ASIO_HAS_WINDOWS_STREAM_HANDLE)
+    mLocalPipeCreated = false;
+#endif
+
     // Register to handle the signals that indicate when the server should exit.
     mSignals.add(SIGINT);
     mSignals.add(SIGTERM);
@@ -133,6 +1229,9 @@ MessageServer::MessageServer(unsigned short port /* = 7777 */)
     // Create async operation that listens for interrupt signals
     DoAwaitStop();
 
+    // Accepting pauses at the connection limit and resumes once a connection is gone
+    mConnectionManager.SetCapacityCallback(std::bind(&MessageServer::ResumeAccept, this));
+
     // Open the acceptor with the option to reuse the address
     asio::ip::tcp::endpoint endpoint = asio::ip::tcp::endpoint(asio::ip::tcp::v4(), port);
     mAcceptor.open(endpoint.protocol());
@@ -144,9 +1243,16 @@ MessageServer::MessageServer(unsigned short port /* = 7777 */)
     DoAccept();
 }
 
+unsigned short MessageServer::GetPort() const
+{
+    asio::error_code ec;
+    return mAcceptor.local_endpoint(ec).port();
+}
+
 void MessageServer::Run()
 {
     CLogger.Info("Server is starting...");
+    SetTraceThreadName("MessageServer");
 
     // The io_service::run() call will block until all asynchronous operations
     // have finished. While the server is running, there is always at least one
@@ -160,6 +1266,334 @@ void MessageServer::SetExitCallback(std::function<void()> cb)
     mExitCallback = cb;
 }
 
+void MessageServer::SetRateLimits(RateLimit perConnection, RateLimit perAddress)
+{
+    mConnectionManager.SetRateLimits(perConnection, perAddress);
+}
+
+void MessageServer::SetThrottleAction(ThrottleAction action)
+{
+    mConnectionManager.SetThrottleAction(action);
+}
+
+void MessageServer::SetFlowControl(FlowControl& fc)
+{
+    mConnectionManager.SetFlowControl(&fc);
+
+    // The resume callback runs on the notification thread, the parked connections are resumed on the io_service
+    fc.SetResumeCallback(
+        [this]()
+        {
+            mIOService.post(
+                [this]()
+                {
+                    mConnectionManager.ResumeAll();
+                    if (mDatagramListener)
+                        mDatagramListener->Resume();
+                    if (mSharedMemoryListener)
+                        mSharedMemoryListener->Resume();
+                }
+            );
+        }
+    );
+}
+
+void MessageServer::PostAck(const AckTarget& target, AckStatus status)
+{
+    // Called from the notification thread, the connection is only touched from the io_service
+    mIOService.post(
+        [target, status]()
+        {
+            auto c = std::static_pointer_cast<ClientConnection>(target.connection.lock());
+            if (c)
+                c->SendAck(target, status);
+        }
+    );
+}
+
+std::size_t MessageServer::GetPausedConnectionCount() const
+{
+    return mConnectionManager.GetPausedCount();
+}
+
+void MessageServer::SetTimeouts(TimerWheel::Clock::duration idle, TimerWheel::Clock::duration read)
+{
+    mConnectionManager.SetTimeouts(idle, read);
+}
+
+void MessageServer::SetMaxConnections(std::size_t max)
+{
+    mConnectionManager.SetMaxConnections(max);
+}
+
+const ConnectionManager& MessageServer::GetConnectionManager() const
+{
+    return mConnectionManager;
+}
+
+void MessageServer::ResumeAccept()
+{
+    if (mAcceptPaused)
+    {
+        mAcceptPaused = false;
+        DoAccept();
+    }
+    if (mLocalAcceptPaused)
+    {
+        mLocalAcceptPaused = false;
+        DoAcceptLocal();
+    }
+}
+
+bool MessageServer::ListenUdp(unsigned short port, RateLimit limit)
+{
+    auto listener = std::make_unique<DatagramListener>(mIOService, port, mConnectionManager);
+    if (!listener->IsOpen())
+        return false;
+    mDatagramListener = std::move(listener);
+    mDatagramListener->SetRateLimit(limit);
+    mDatagramListener->Start();
+    return true;
+}
+
+bool MessageServer::ListenSharedMemory(const std::string& name, std::uint32_t capacity)
+{
+    mSharedMemoryListener = std::make_unique<SharedMemoryListener>(mIOService, name, capacity, mConnectionManager);
+    if (!mSharedMemoryListener->IsOpen())
+    {
+        CLogger.Info("Could not create the shared memory ring " + name + ", another server may own it");
+        mSharedMemoryListener.reset();
+        return false;
+    }
+    mSharedMemoryListener->Start();
+    return true;
+}
+
+bool MessageServer::KeepHistory(const std::string& directory, HistoryOptions options)
+{
+    auto history = std::make_unique<HistoryStore>(directory, options);
+    if (!history->Open())
+    {
+        CLogger.Info("Could not open the notification history in " + directory);
+        return false;
+    }
+    mHistory = std::move(history);
+    mConnectionManager.SetHistory(mHistory.get());
+    return true;
+}
+
+MetricsSnapshot MessageServer::GetStats() const
+{
+    return GetMetrics().Snapshot();
+}
+
+bool MessageServer::ServeHttp(unsigned short port, const std::string& address)
+{
+    auto endpoint = std::make_unique<HttpEndpoint>(mIOService, address, port,
+        [this]()
+        {
+            auto uptime = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - mStartTime);
+            return "{\"status\":\"ok\",\"uptime\":" + std::to_string(uptime.count())
+                + ",\"connections\":" + std::to_string(mConnectionManager.GetConnectionCount())
+                + ",\"paused\":" + (mConnectionManager.IsPaused() ? "true" : "false")
+                + ",\"history\":" + (mHistory ? "true" : "false") + "}";
+        }
+    );
+    if (!endpoint->IsOpen())
+        return false;
+    mHttpEndpoint = std::move(endpoint);
+    mHttpEndpoint->Start();
+    return true;
+}
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+
+bool MessageServer::ListenLocal(std::string name)
+{
+    std::string path = name.empty() ? std::string("/tmp/newsflash.sock") : name;
+    if (path.size() >= sizeof(sockaddr_un().sun_path))
+    {
+        CLogger.Info("The local socket path " + path + " is too long");
+        return false;
+    }
+    asio::local::stream_protocol::endpoint endpoint(path);
+
+    // A socket file that still accepts belongs to a running server, only one left behind by a previous run is removed
+    asio::error_code ec;
+    asio::local::stream_protocol::socket probe(mIOService);
+    probe.connect(endpoint, ec);
+    if (!ec)
+    {
+        CLogger.Info("Another server already listens on " + path);
+        return false;
+    }
+    struct stat st;
+    if (ec == asio::error::connection_refused && lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        std::remove(path.c_str());
+
+    auto acceptor = std::make_unique<asio::local::stream_protocol::acceptor>(mIOService);
+    acceptor->open(endpoint.protocol(), ec);
+    if (!ec)
+        acceptor->bind(endpoint, ec);
+    if (!ec)
+        acceptor->listen(asio::socket_base::max_connections, ec);
+    if (ec)
+    {
+        CLogger.Info("Could not listen on " + path + ": " + ec.message());
+        return false;
+    }
+
+    mLocalName = path;
+    mLocalAcceptor = std::move(acceptor);
+    mLocalSocket = std::make_unique<asio::local::stream_protocol::socket>(mIOService);
+    DoAcceptLocal();
+    return true;
+}
+
+void MessageServer::DoAcceptLocal()
+{
+    mLocalAcceptor->async_accept(*mLocalSocket,
+        [this](const asio::error_code& ec)
+        {
+            if (!mLocalAcceptor->is_open())
+                return;
+
+            if (!ec && mConnectionManager.IsFull())
+            {
+                // The other endpoint took the last free connection meanwhile
+                CLogger.Info("Connection limit reached, rejecting local connection");
+                connectionsRejected.Add();
+                mLocalSocket->close();
+            }
+            else if (!ec)
+            {
+                CLogger.Info("Accepted local connection");
+                auto transport = std::make_unique<StreamTransport<asio::local::stream_protocol::socket>>(std::move(*mLocalSocket), "local");
+                mConnectionManager.Start(std::make_shared<ClientConnection>(std::move(transport), mConnectionManager));
+            }
+
+            // Connections over the limit wait in the listen backlog
+            if (mConnectionManager.IsFull())
+                mLocalAcceptPaused = true;
+            else
+                DoAcceptLocal();
+        }
+    );
+}
+
+void MessageServer::StopLocal()
+{
+    if (!mLocalAcceptor)
+        return;
+    mLocalAcceptor->close();
+    std::remove(mLocalName.c_str());
+}
+
+#elif defined(ASIO_HAS_WINDOWS_STREAM_HANDLE)
+
+bool MessageServer::ListenLocal(std::string name)
+{
+    mLocalName = name.empty() ? std::string("\\\\.\\pipe\\NewsFlash") : name;
+    DoAcceptLocal();
+    if (!mLocalPipeCreated)
+    {
+        mLocalName.clear();
+        return false;
+    }
+    return true;
+}
+
+void MessageServer::DoAcceptLocal()
+{
+    if (mLocalName.empty())
+        return;
+
+    // Every client gets its own pipe instance, a new one is created as soon as the previous one is connected.
+    // The first one must create the pipe, so that a pipe of another running server fails it rather than sharing its clients
+    DWORD first = mLocalPipeCreated ? 0 : FILE_FLAG_FIRST_PIPE_INSTANCE;
+    HANDLE h = CreateNamedPipeA(mLocalName.c_str(),
+                                PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | first,
+                                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                PIPE_UNLIMITED_INSTANCES, 4096, 4096, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE)
+    {
+        CLogger.Info("Could not create the pipe " + mLocalName + ", error " + std::to_string(GetLastError()));
+        return;
+    }
+    mLocalPipe = std::make_unique<asio::windows::stream_handle>(mIOService, h);
+    mLocalPipeCreated = true;
+
+    asio::windows::overlapped_ptr ov(mIOService,
+        [this](const asio::error_code& ec, std::size_t)
+        {
+            if (mLocalName.empty())
+                return;
+
+            if (!ec && mConnectionManager.IsFull())
+            {
+                // The other endpoint took the last free connection meanwhile
+                CLogger.Info("Connection limit reached, rejecting local connection");
+                connectionsRejected.Add();
+                mLocalPipe->close();
+            }
+            else if (!ec)
+            {
+                CLogger.Info("Accepted local connection");
+                auto transport = std::make_unique<StreamTransport<asio::windows::stream_handle>>(std::move(*mLocalPipe), "local");
+                mConnectionManager.Start(std::make_shared<ClientConnection>(std::move(transport), mConnectionManager));
+            }
+            mLocalPipe.reset();
+
+            // Without a pipe instance waiting, clients over the limit find the pipe busy
+            if (mConnectionManager.IsFull())
+                mLocalAcceptPaused = true;
+            else
+                DoAcceptLocal();
+        }
+    );
+
+    BOOL connected = ConnectNamedPipe(h, ov.get());
+    DWORD err = GetLastError();
+    if (!connected && err != ERROR_IO_PENDING)
+    {
+        // A client that connected between the creation of the pipe and the call is reported as an error
+        asio::error_code ec;
+        if (err != ERROR_PIPE_CONNECTED)
+            ec = asio::error_code(static_cast<int>(err), asio::error::get_system_category());
+        ov.complete(ec, 0);
+    }
+    else
+    {
+        ov.release();
+    }
+}
+
+void MessageServer::StopLocal()
+{
+    mLocalName.clear();
+    if (mLocalPipe)
+        mLocalPipe->close();
+}
+
+#else
+
+bool MessageServer::ListenLocal(std::string name)
+{
+    (void) name;
+    CLogger.Info("Local connections are not supported on this platform");
+    return false;
+}
+
+void MessageServer::DoAcceptLocal()
+{
+}
+
+void MessageServer::StopLocal()
+{
+}
+
+#endif
+
 void MessageServer::DoAccept()
 {
     CLogger.Info("Preparing interface to for accept...");
@@ -172,16 +1606,29 @@ void MessageServer::DoAccept()
             if (!mAcceptor.is_open())
                 return;
 
-            std::string incomingIp = mAcceptSocket.remote_endpoint().address().to_string();
-            CLogger.Info("Accepted connection from " + incomingIp);
+            if (!ec && mConnectionManager.IsFull())
+            {
+                // The local endpoint took the last free connection meanwhile
+                CLogger.Info("Connection limit reached, rejecting connection");
+                connectionsRejected.Add();
+                mAcceptSocket.close();
+            }
+            else if (!ec)
+            {
+                asio::error_code epec;
+                auto ep = mAcceptSocket.remote_endpoint(epec);
+                std::string incomingIp = epec ? std::string("unknown") : ep.address().to_string();
+                CLogger.Info("Accepted connection from " + incomingIp);
 
-            if (!ec)
-                mConnectionManager.Start(
-                        std::make_shared<ClientConnection>(
-                            std::move(mAcceptSocket), mConnectionManager));
+                auto transport = std::make_unique<StreamTransport<asio::ip::tcp::socket>>(std::move(mAcceptSocket), incomingIp);
+                mConnectionManager.Start(std::make_shared<ClientConnection>(std::move(transport), mConnectionManager));
+            }
 
-            // Rechedule next accept operation
-            DoAccept();
+            // Rechedule next accept operation, connections over the limit wait in the listen backlog
+            if (mConnectionManager.IsFull())
+                mAcceptPaused = true;
+            else
+                DoAccept();
         }
     );
 }
@@ -203,6 +1650,13 @@ void MessageServer::DoAwaitStop()
 
             CLogger.Info("Terminating all current connections...");
             mConnectionManager.StopAll();
+            if (mDatagramListener)
+                mDatagramListener->Stop();
+            if (mSharedMemoryListener)
+                mSharedMemoryListener->Stop();
+            if (mHttpEndpoint)
+                mHttpEndpoint->Stop();
+            StopLocal();
 
             CLogger.Info("Server is shuting down...");
             if (mExitCallback)
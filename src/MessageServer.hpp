@@ -33,18 +33,35 @@
 
 #include <stdint.h>
 #include <memory>
+#include <vector>
 #include <functional>
 #include <set>
 #include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "WarnGuard.hpp"
 WARN_GUARD_ON
 #include <asio.hpp>
 WARN_GUARD_OFF
 #include "Logger.hpp"
+#include "NotificationData.hpp"
+#include "TokenBucket.hpp"
+#include "FlowControl.hpp"
+#include "Protocol.hpp"
+#include "Transport.hpp"
+#include "ShmRing.hpp"
+#include "TimerWheel.hpp"
+#include "BufferPool.hpp"
+#include "HistoryStore.hpp"
+#include "Metrics.hpp"
+#include "HttpEndpoint.hpp"
 
 /// Sets the function that will be called when the message server receives a notification
-void SetNotificationEventCallback(std::function<void(const std::string&, unsigned int)> cb);
+void SetNotificationEventCallback(std::function<void(const NotificationData&)> cb);
 
 ///==============================================================
 ///= ClientConnection
@@ -54,8 +71,8 @@ class ConnectionManager;
 class ClientConnection : public std::enable_shared_from_this<ClientConnection>
 {
     public:
-        /// Constructor
-        explicit ClientConnection(asio::ip::tcp::socket sock, ConnectionManager& parentConMan);
+        /// Constructor, takes ownership of the connected transport
+        explicit ClientConnection(std::unique_ptr<Transport> transport, ConnectionManager& parentConMan);
 
         /// Disable copy construction
         ClientConnection(const ClientConnection& rhs) = delete;
@@ -67,30 +84,141 @@ class ClientConnection : public std::enable_shared_from_this<ClientConnection>
         /// Stop all asynchronous operations associated with the connection.
         void Stop();
 
-        /// Gets, handles the message and returns the responce
+        /// Rearms the reads of a connection parked by the connection manager
+        void Resume();
+
+        /// Queues the given ack of a notification of this connection, must be called from the io_service
+        void SendAck(const AckTarget& target, AckStatus status);
+
+        /// Gets, handles the text message and returns the responce.
+        /// The message is the notification text, optionally prefixed with a priority tag: [low], [normal], [high] or [critical]
+        /// a deduplication key tag: [key=...] and an ack mode tag: [ack=none], [ack=accepted] or [ack=displayed].
+        /// JSON and binary requests are framed by the connection itself
         void HandleMessage(std::string);
 
+        /// Retrieves the ip of the client, or the name of the local transport for local clients
+        const std::string& GetIP() const;
+
+        /// Retrieves the rate limit bucket of the connection
+        TokenBucket& GetBucket();
+
+        /// Sets the rate limit bucket shared by all the connections of the client ip
+        void SetAddressBucket(std::shared_ptr<TokenBucket> bucket);
+
+        /// Retrieves the rate limit bucket shared by all the connections of the client ip
+        const std::shared_ptr<TokenBucket>& GetAddressBucket() const;
+
+        /// Retrieves the index of the connection in the connection manager, NoSlot if it is not managed
+        std::size_t GetSlot() const;
+
+        /// Sets the index of the connection in the connection manager
+        void SetSlot(std::size_t slot);
+
+        /// The slot of a connection that is not managed
+        static const std::size_t NoSlot = static_cast<std::size_t>(-1);
+
     private:
+        /// A framed request
+        struct Request
+        {
+            NotificationData data;
+
+            /// The raw text of a text request, echoed back as its accepted ack
+            std::string echo;
+        };
+
+        /// The outcome of looking for the next request in the input buffer
+        enum class ParseResult
+        {
+            Empty,
+            Ready,
+            Broken
+        };
+
         /// Perform an asynchronous read operation.
         void DoRecv();
 
-        /// Perform an asynchronous write operation.
+        /// Reads the data of a readable stream into the input buffer
+        void ReadAvailable();
+
+        /// Makes room for a block at the end of the input buffer, borrowing it from the pool if needed.
+        /// Returns the size of the data already in the buffer
+        std::size_t PrepareInput();
+
+        /// Handles the completion of a read of the given number of bytes past the given input buffer size
+        void OnReceived(const asio::error_code& ec, std::size_t used, std::size_t bytes);
+
+        /// Perform the next read, unless the notification queue is full and the connection has to be parked
+        void ContinueRecv();
+
+        /// Arms the idle timeout, or the read timeout if a request is partially received
+        void ArmTimeout();
+
+        /// Handles the complete requests in the input buffer and arms the next read once they are all admitted
+        void ProcessInput();
+
+        /// Frames the next text or binary request out of the input buffer, consuming its bytes
+        ParseResult NextRequest(Request& r);
+
+        /// Answers the JSON query in the given buffer
+        void HandleQuery(char* begin, char* end);
+
+        /// Passes the request on if the client is within its rate limits, otherwise applies the throttle action.
+        /// Returns false if the request is held until the client is within its limits again
+        bool AdmitRequest(Request& r);
+
+        /// Hands the notification to the notification callback and sends the reply
+        void Dispatch(Request& r);
+
+        /// Queues the given data for writing, the data queued during an event loop iteration goes out with a single write
         void DoSend(std::string msg);
 
-        /// The socket that is assosiated with the current connection
-        asio::ip::tcp::socket mSocket;
+        /// Perform an asynchronous write operation of the queued data, if one is not in flight already.
+        void DoFlush();
 
-        /// Buffer for incoming data
-        std::array<char, 4096> mRvBuf;
+        /// The stream that is assosiated with the current connection
+        std::unique_ptr<Transport> mTransport;
 
-        /// Buffer for outgoing data
-        std::array<char, 4096> mSdBuf;
+        /// The received data that is not handled yet, starting at mInPos. Borrowed from the buffer pool of the
+        /// connection manager while there is such data or a read into it is in flight
+        ByteBuffer mInBuf;
+        std::size_t mInPos;
+
+        /// The notifications of the last JSON request that are not handled yet, starting at mBatchPos
+        std::vector<NotifyFrame> mBatch;
+        std::size_t mBatchPos;
+
+        /// The data queued for the next write and the data of the write in flight
+        std::string mOutPending;
+        std::string mOutFlight;
+
+        /// Set while a write is in flight and while a flush is posted
+        bool mWriting;
+        bool mFlushPosted;
 
         /// The connection manager that holds this connection
         ConnectionManager& mParentConnectionManager;
 
         /// Stores the ip of the client, used for diagnostic messages
         std::string mIP;
+
+        /// The rate limit bucket of the connection
+        TokenBucket mBucket;
+
+        /// The rate limit bucket shared by all the connections of the client ip
+        std::shared_ptr<TokenBucket> mAddressBucket;
+
+        /// The index of the connection in the connection manager
+        std::size_t mSlot;
+
+        /// Set while the received data ends with a partial request that must be completed before the read timeout
+        bool mAwaitingRest;
+
+        /// Closes the connection once it is idle or a partial request is not completed for too long
+        TimerWheel::Timer mTimeoutTimer;
+
+        /// Delays the next read of a throttled connection
+        TimerWheel::Timer mThrottleTimer;
 };
 
 typedef std::shared_ptr<ClientConnection> ClientConnectionPtr;
@@ -100,9 +228,22 @@ typedef std::shared_ptr<ClientConnection> ClientConnectionPtr;
 ///= ConnectionManager
 ///==============================================================
 
+/// What happens to a message of a client that is over its rate limit
+enum class ThrottleAction
+{
+    /// Hold the message and stop reading from the connection until the client is within its limits again
+    Pause,
+
+    /// Drop the message and reply with "throttled"
+    Reply
+};
+
 class ConnectionManager
 {
     public:
+        /// Constructor, the timers of the connections run on the given io_service
+        explicit ConnectionManager(asio::io_service& ios);
+
         /// Add the specified connection to the manager and start it.
         void Start(ClientConnectionPtr c);
 
@@ -112,9 +253,302 @@ class ConnectionManager
         /// Stop all connections.
         void StopAll();
 
+        /// Stops the given connection because it was idle or did not complete a request for too long
+        void Expire(ClientConnectionPtr c, bool partialRequest);
+
+        /// Schedules the given connection timer, the timers are coarse, their resolution is the tick of a shared wheel
+        void ScheduleTimer(TimerWheel::Timer& t, TimerWheel::Clock::duration after, std::function<void()> cb);
+
+        /// Sets how long a connection may wait for a request and how long a partially received request may take,
+        /// a zero duration disables a timeout
+        void SetTimeouts(TimerWheel::Clock::duration idle, TimerWheel::Clock::duration read);
+
+        /// Retrieves the idle timeout
+        TimerWheel::Clock::duration GetIdleTimeout() const;
+
+        /// Retrieves the read timeout
+        TimerWheel::Clock::duration GetReadTimeout() const;
+
+        /// Sets the maximum number of connections, zero for no limit
+        void SetMaxConnections(std::size_t max);
+
+        /// Checks whether the maximum number of connections is reached
+        bool IsFull() const;
+
+        /// Sets the function that is called when a connection of a full manager stops
+        void SetCapacityCallback(std::function<void()> cb);
+
+        /// Retrieves the number of connections, may be called from any thread
+        std::size_t GetConnectionCount() const;
+
+        /// Retrieves the number of connections closed by the idle timeout
+        std::uint64_t GetIdleTimeoutCount() const;
+
+        /// Retrieves the number of connections closed by the read timeout
+        std::uint64_t GetReadTimeoutCount() const;
+
+        /// Retrieves the pool the connections borrow their receive buffers from
+        BufferPool& GetBufferPool();
+
+        /// Sets the message rate limits per connection and per client ip, a zero rate disables a limit
+        void SetRateLimits(RateLimit perConnection, RateLimit perAddress);
+
+        /// Sets what happens to a message of a client that is over its rate limit
+        void SetThrottleAction(ThrottleAction action);
+
+        /// Retrieves what happens to a message of a client that is over its rate limit
+        ThrottleAction GetThrottleAction() const;
+
+        /// Takes a token from the buckets of the given connection, returns zero if the message is admitted
+        /// or the time to wait until it would be. Critical notifications are always admitted
+        TokenBucket::Clock::duration Throttle(ClientConnection& c, Priority p);
+
+        /// Retrieves the number of messages that were over the rate limits
+        std::uint64_t GetThrottledCount() const;
+
+        /// Sets the flow control of the notification queue, reads are not rearmed while it is paused
+        void SetFlowControl(FlowControl* fc);
+
+        /// Checks whether the connections should stop reading
+        bool IsPaused() const;
+
+        /// Holds the given connection without an outstanding read until ResumeAll
+        void Park(ClientConnectionPtr c);
+
+        /// Rearms the reads of all the parked connections
+        void ResumeAll();
+
+        /// Retrieves the number of parked connections, may be called from any thread
+        std::size_t GetPausedCount() const;
+
+        /// Sets the history the accepted notifications are recorded in, or null for none
+        void SetHistory(HistoryStore* history);
+
+        /// Retrieves the history, null if there is none
+        HistoryStore* GetHistory() const;
+
     private:
-        /// The managed connections.
-        std::set<ClientConnectionPtr> mConnections;
+        /// Ticks the timer wheel while it has timers
+        void DoTick();
+
+        /// The managed connections, each one knows its index so that it is removed by swapping it with the last
+        std::vector<ClientConnectionPtr> mConnections;
+
+        /// The size of mConnections for readers outside the io_service
+        std::atomic<std::size_t> mConnectionCount;
+
+        /// The maximum number of connections, zero for no limit
+        std::size_t mMaxConnections;
+
+        /// Called when a connection of a full manager stops
+        std::function<void()> mCapacityCallback;
+
+        /// The receive buffers of all the connections
+        BufferPool mBufferPool;
+
+        /// The timers of all the connections
+        TimerWheel mWheel;
+
+        /// Advances the wheel, armed only while the wheel has timers
+        asio::steady_timer mTickTimer;
+        bool mTicking;
+
+        /// The connection timeouts
+        TimerWheel::Clock::duration mIdleTimeout;
+        TimerWheel::Clock::duration mReadTimeout;
+
+        /// The number of connections closed by each timeout
+        std::atomic<std::uint64_t> mIdleTimeouts, mReadTimeouts;
+
+        /// The rate limit buckets shared by the connections of each client ip, dropped with the last connection
+        std::unordered_map<std::string, std::shared_ptr<TokenBucket>> mAddressBuckets;
+
+        /// The message rate limits
+        RateLimit mConnectionLimit;
+        RateLimit mAddressLimit;
+
+        /// What happens to a message of a client that is over its rate limit
+        ThrottleAction mThrottleAction;
+
+        /// The number of messages that were over the rate limits, updated from the io_service threads
+        std::atomic<std::uint64_t> mThrottled;
+
+        /// The flow control of the notification queue, or null for none
+        FlowControl* mFlowControl;
+
+        /// The connections that stopped reading because the notification queue is full
+        std::set<ClientConnectionPtr> mParked;
+
+        /// The size of mParked for readers outside the io_service
+        std::atomic<std::size_t> mPausedCount;
+
+        /// The history of the accepted notifications, or null for none
+        HistoryStore* mHistory;
+};
+
+
+///==============================================================
+///= DatagramListener
+///==============================================================
+
+class DatagramListener
+{
+    public:
+        /// Constructor, binds the UDP socket to the given port, a port that is taken is logged and leaves the socket closed
+        DatagramListener(asio::io_service& ios, unsigned short port, ConnectionManager& conMan);
+
+        /// Disable copy construction
+        DatagramListener(const DatagramListener& rhs) = delete;
+        DatagramListener& operator=(const DatagramListener& rhs) = delete;
+
+        /// Checks whether the socket was bound
+        bool IsOpen() const;
+
+        /// Starts waiting for datagrams
+        void Start();
+
+        /// Closes the socket
+        void Stop();
+
+        /// Starts waiting for datagrams again after a pause of the notification queue
+        void Resume();
+
+        /// Sets the message rate limit of all the datagram senders together, a zero rate disables it
+        void SetRateLimit(RateLimit limit);
+
+        /// Retrieves the number of datagrams that were received
+        std::uint64_t GetReceivedCount() const;
+
+        /// Retrieves the number of datagrams that were dropped as malformed or over the rate limit
+        std::uint64_t GetDroppedCount() const;
+
+    private:
+        /// Waits until the socket is readable
+        void DoWait();
+
+        /// Receives the datagrams already queued in the socket, up to a batch, without blocking
+        void Drain();
+
+        /// Parses the given datagram and passes its notifications on
+        void HandleDatagram(char* data, std::size_t size);
+
+        /// Passes the given notification on if the senders are within the rate limit
+        void Dispatch(NotificationData data);
+
+        /// The bound socket
+        asio::ip::udp::socket mSocket;
+
+        /// The sender of the last datagram
+        asio::ip::udp::endpoint mSender;
+
+        /// The connection manager that tells whether the notification queue is paused
+        ConnectionManager& mConnectionManager;
+
+        /// The receive buffer, big enough for any datagram
+        std::vector<char> mRvBuf;
+
+        /// The notifications of the last JSON datagram
+        std::vector<NotifyFrame> mBatch;
+
+        /// The rate limit bucket shared by all the senders, datagrams have no connection to pause
+        TokenBucket mBucket;
+
+        /// Set while the listener stopped waiting because the notification queue is full
+        bool mParked;
+
+        /// The datagram counters
+        std::atomic<std::uint64_t> mReceived, mDropped;
+};
+
+
+///==============================================================
+///= SharedMemoryListener
+///==============================================================
+
+class SharedMemoryListener
+{
+    public:
+        /// Constructor, creates the shared memory ring with the given name and capacity
+        SharedMemoryListener(asio::io_service& ios, const std::string& name, std::uint32_t capacity, ConnectionManager& conMan);
+
+        /// Destructor
+        ~SharedMemoryListener();
+
+        /// Disable copy construction
+        SharedMemoryListener(const SharedMemoryListener& rhs) = delete;
+        SharedMemoryListener& operator=(const SharedMemoryListener& rhs) = delete;
+
+        /// Checks whether the ring was created
+        bool IsOpen() const;
+
+        /// Starts draining the ring
+        void Start();
+
+        /// Stops draining the ring
+        void Stop();
+
+        /// Starts draining the ring again after a pause of the notification queue
+        void Resume();
+
+        /// Retrieves the number of records that were read from the ring
+        std::uint64_t GetReceivedCount() const;
+
+        /// Retrieves the number of records that were dropped as malformed
+        std::uint64_t GetDroppedCount() const;
+
+    private:
+        /// Waits until the producer signals new records
+        void DoWait();
+
+        /// Reads the records in the ring, up to a batch, and waits for more once it is empty
+        void Drain();
+
+#if !defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE) && defined(__linux__)
+        /// Sleeps on the ring for DoWait, then hands the draining back to the io_service
+        void WaitLoop();
+#endif
+
+        /// Passes the given notification on
+        void Dispatch(NotificationData data);
+
+        /// The io_service the ring is drained on
+        asio::io_service& mIOService;
+
+        /// The ring
+        ShmRingConsumer mRing;
+
+        /// Set if the ring was created
+        bool mOpen;
+
+#if defined(ASIO_HAS_WINDOWS_OBJECT_HANDLE)
+        /// The event the producer signals while the listener waits
+        asio::windows::object_handle mEvent;
+#elif defined(__linux__)
+        /// The futex wait blocks, so it has a thread of its own that DoWait hands every wait to
+        std::mutex mWaitMutex;
+        std::condition_variable mWaitRequest;
+        bool mWaitRequested;
+        bool mWaiterExit;
+        std::thread mWaiter;
+#else
+        /// There is no shared wakeup primitive on the other platforms, so the ring is polled
+        asio::steady_timer mPollTimer;
+#endif
+
+        /// The connection manager that tells whether the notification queue is paused
+        ConnectionManager& mConnectionManager;
+
+        /// The notifications of the last JSON record
+        std::vector<NotifyFrame> mBatch;
+
+        /// Set while the listener is draining or waiting
+        bool mRunning;
+
+        /// Set while the listener stopped draining because the notification queue is full
+        bool mParked;
+
+        /// The record counters
+        std::atomic<std::uint64_t> mReceived, mDropped;
 };
 
 
@@ -135,9 +569,65 @@ class MessageServer
         /// Starts the operation of the server synchronously
         void Run();
 
+        /// Retrieves the TCP port the server listens on, the one the system picked if it was constructed with port 0
+        unsigned short GetPort() const;
+
         /// Sets the callback that is called when the server exits (optional)
         void SetExitCallback(std::function<void()> cb);
 
+        /// Sets the message rate limits per connection and per client ip, a zero rate disables a limit
+        void SetRateLimits(RateLimit perConnection, RateLimit perAddress);
+
+        /// Sets what happens to a message of a client that is over its rate limit
+        void SetThrottleAction(ThrottleAction action);
+
+        /// Makes the connections stop reading while the given notification queue is over its high watermark,
+        /// must be called before Run
+        void SetFlowControl(FlowControl& fc);
+
+        /// Retrieves the number of connections that stopped reading because the notification queue is full
+        std::size_t GetPausedConnectionCount() const;
+
+        /// Sets how long a connection may wait for a request and how long a partially received request may take,
+        /// a zero duration disables a timeout
+        void SetTimeouts(TimerWheel::Clock::duration idle, TimerWheel::Clock::duration read);
+
+        /// Sets the maximum number of connections, new connections are not accepted while it is reached. Zero for no limit
+        void SetMaxConnections(std::size_t max);
+
+        /// Retrieves the connection manager for its counters
+        const ConnectionManager& GetConnectionManager() const;
+
+        /// Sends the given ack to the connection the notification came from, may be called from any thread
+        void PostAck(const AckTarget& target, AckStatus status);
+
+        /// Accepts connections from the same host on the given local endpoint as well, a unix domain socket path
+        /// or a named pipe name on Windows, the platform default if empty. Returns false if another server already listens
+        /// there or the endpoint could not be created. Must be called before Run
+        bool ListenLocal(std::string name = std::string());
+
+        /// Accepts one notification per datagram on the given UDP port as well, rate limited as a whole by the given limit.
+        /// Returns false if the port could not be bound. Must be called before Run
+        bool ListenUdp(unsigned short port, RateLimit limit = RateLimit{1000.0, 2000.0});
+
+        /// Accepts notifications from a producer on the same host through a shared memory ring as well, see ShmRing.hpp.
+        /// The records are fire and forget and not rate limited. Returns false if the ring could not be created, such as
+        /// when another server owns it. Must be called before Run
+        bool ListenSharedMemory(const std::string& name = ShmRingDefaultName, std::uint32_t capacity = ShmRingDefaultCapacity);
+
+        /// Records the accepted notifications in a history in the given directory, so that clients can query it
+        /// with a JSON history query. Returns false if the history cannot be opened. Must be called before Run
+        bool KeepHistory(const std::string& directory, HistoryOptions options = HistoryOptions());
+
+        /// Reads the process metrics, the same values a JSON stats query returns. May be called from any thread
+        MetricsSnapshot GetStats() const;
+
+        /// Serves the metrics in the Prometheus text format on /metrics and the server state on /health over HTTP
+        /// on the given port, see HttpEndpoint.hpp. The endpoints are not authenticated, so they are only reachable
+        /// from this host unless another address to listen on is given. Returns false if the port could not be bound.
+        /// Must be called before Run
+        bool ServeHttp(unsigned short port, const std::string& address = "127.0.0.1");
+
     private:
         /// Perform an asynchronous accept operation.
         void DoAccept();
@@ -145,6 +635,15 @@ class MessageServer
         /// Wait for a request to stop the server.
         void DoAwaitStop();
 
+        /// Perform an asynchronous accept operation on the local endpoint.
+        void DoAcceptLocal();
+
+        /// Stops accepting on the local endpoint.
+        void StopLocal();
+
+        /// Restarts the accept operations paused by the connection limit.
+        void ResumeAccept();
+
         /// The io_service used to perform asynchronous operations.
         asio::io_service mIOService;
 
@@ -162,6 +661,40 @@ class MessageServer
 
         /// The optional exit callback
         std::function<void()> mExitCallback;
+
+        /// Set while the accept operations are paused by the connection limit
+        bool mAcceptPaused;
+        bool mLocalAcceptPaused;
+
+        /// The optional UDP listener
+        std::unique_ptr<DatagramListener> mDatagramListener;
+
+        /// The optional shared memory listener
+        std::unique_ptr<SharedMemoryListener> mSharedMemoryListener;
+
+        /// The optional history of the accepted notifications
+        std::unique_ptr<HistoryStore> mHistory;
+
+        /// The optional metrics and health endpoint
+        std::unique_ptr<HttpEndpoint> mHttpEndpoint;
+
+        /// When the server was created, reported by the health endpoint
+        std::chrono::steady_clock::time_point mStartTime;
+
+        /// The local endpoint name, empty if the server does not listen locally
+        std::string mLocalName;
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+        /// Acceptor and next socket of the local endpoint
+        std::unique_ptr<asio::local::stream_protocol::acceptor> mLocalAcceptor;
+        std::unique_ptr<asio::local::stream_protocol::socket> mLocalSocket;
+#elif defined(ASIO_HAS_WINDOWS_STREAM_HANDLE)
+        /// The pipe instance waiting for the next local client
+        std::unique_ptr<asio::windows::stream_handle> mLocalPipe;
+
+        /// Set once the first pipe instance was created, the later ones join the pipe it owns
+        bool mLocalPipeCreated;
+#endif
 };
 
 #endif // ! _MESSAGE_SERVER_HPP_
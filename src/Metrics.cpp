@@ -0,0 +1,204 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Hands out the counter shards to the threads in turn
+static std::atomic<std::size_t> nextShard(0);
+
+std::size_t GetMetricShard()
+{
+    static thread_local std::size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % MetricShards;
+    return shard;
+}
+
+// Retrieves the index of the highest set bit of a non zero value
+static unsigned int HighestBit(std::uint64_t v)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long i;
+    _BitScanReverse64(&i, v);
+    return static_cast<unsigned int>(i);
+#elif defined(__GNUC__)
+    return 63 - static_cast<unsigned int>(__builtin_clzll(v));
+#else
+    unsigned int i = 0;
+    while (v >>= 1)
+        ++i;
+    return i;
+#endif
+}
+
+///==============================================================
+///= Counter
+///==============================================================
+
+Counter::Counter()
+{
+    for (auto& s : mShards)
+        s.value.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t Counter::Get() const
+{
+    std::uint64_t sum = 0;
+    for (const auto& s : mShards)
+        sum += s.value.load(std::memory_order_relaxed);
+    return sum;
+}
+
+///==============================================================
+///= Histogram
+///==============================================================
+
+Histogram::Histogram()
+    : mSum(0),
+      mMax(0)
+{
+    for (auto& b : mBuckets)
+        b.store(0, std::memory_order_relaxed);
+}
+
+std::size_t Histogram::GetBucket(std::uint64_t v)
+{
+    if (v < 2 * HistogramSubBuckets)
+        return static_cast<std::size_t>(v);
+
+    // The top 5 bits of the value pick one of the 16 buckets of its power of two
+    unsigned int shift = HighestBit(v) - 4;
+    return shift * HistogramSubBuckets + static_cast<std::size_t>(v >> shift);
+}
+
+std::uint64_t Histogram::GetBucketLimit(std::size_t bucket)
+{
+    if (bucket < 2 * HistogramSubBuckets)
+        return bucket;
+    unsigned int shift = static_cast<unsigned int>(bucket / HistogramSubBuckets - 1);
+    std::uint64_t first = static_cast<std::uint64_t>(bucket % HistogramSubBuckets + HistogramSubBuckets) << shift;
+    return first + ((std::uint64_t(1) << shift) - 1);
+}
+
+void Histogram::Read(HistogramSnapshot& s) const
+{
+    s.count = 0;
+    s.buckets.clear();
+    for (std::size_t i = 0; i < HistogramBuckets; ++i)
+    {
+        std::uint64_t n = mBuckets[i].load(std::memory_order_relaxed);
+        if (n == 0)
+            continue;
+        s.buckets.emplace_back(GetBucketLimit(i), n);
+        s.count += n;
+    }
+    s.sum = mSum.load(std::memory_order_relaxed);
+    s.max = mMax.load(std::memory_order_relaxed);
+}
+
+std::uint64_t HistogramSnapshot::GetPercentile(double fraction) const
+{
+    if (count == 0)
+        return 0;
+
+    // The rank of the value, the first one for a zero fraction
+    double rank = std::ceil(fraction * static_cast<double>(count));
+    std::uint64_t target = rank <= 1.0 ? 1 : static_cast<std::uint64_t>(rank);
+    std::uint64_t seen = 0;
+    for (const auto& b : buckets)
+    {
+        seen += b.second;
+        if (seen >= target)
+            return std::min(b.first, max);
+    }
+    return max;
+}
+
+///==============================================================
+///= MetricsRegistry
+///==============================================================
+
+// Finds the given metric in the given map and creates it if it is not there
+template<typename T, typename Map>
+static T& Register(Map& metrics, const std::string& name, const std::string& help)
+{
+    auto& e = metrics[name];
+    if (!e.metric)
+    {
+        e.help = help;
+        e.metric = std::make_unique<T>();
+    }
+    return *e.metric;
+}
+
+Counter& MetricsRegistry::GetCounter(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return Register<Counter>(mCounters, name, help);
+}
+
+Gauge& MetricsRegistry::GetGauge(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return Register<Gauge>(mGauges, name, help);
+}
+
+Histogram& MetricsRegistry::GetHistogram(const std::string& name, const std::string& help)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return Register<Histogram>(mHistograms, name, help);
+}
+
+MetricsSnapshot MetricsRegistry::Snapshot() const
+{
+    MetricsSnapshot s;
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& c : mCounters)
+        s.counters.push_back(MetricsSnapshot::CounterValue{c.first, c.second.help, c.second.metric->Get()});
+    for (const auto& g : mGauges)
+        s.gauges.push_back(MetricsSnapshot::GaugeValue{g.first, g.second.help, g.second.metric->Get()});
+    for (const auto& h : mHistograms)
+    {
+        s.histograms.emplace_back();
+        s.histograms.back().name = h.first;
+        s.histograms.back().help = h.second.help;
+        h.second.metric->Read(s.histograms.back());
+    }
+    return s;
+}
+
+MetricsRegistry& GetMetrics()
+{
+    // Never destroyed, the detached threads may still update their metrics while the process exits
+    static MetricsRegistry* registry = new MetricsRegistry;
+    return *registry;
+}
+
+///==============================================================
+///= MetricsSnapshot
+///==============================================================
+
+std::uint64_t MetricsSnapshot::GetCounter(const std::string& name) const
+{
+    for (const auto& c : counters)
+        if (c.name == name)
+            return c.value;
+    return 0;
+}
+
+std::int64_t MetricsSnapshot::GetGauge(const std::string& name) const
+{
+    for (const auto& g : gauges)
+        if (g.name == name)
+            return g.value;
+    return 0;
+}
+
+const HistogramSnapshot* MetricsSnapshot::FindHistogram(const std::string& name) const
+{
+    for (const auto& h : histograms)
+        if (h.name == name)
+            return &h;
+    return nullptr;
+}
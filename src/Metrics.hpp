@@ -0,0 +1,295 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// Process wide instrumentation. Counters, gauges and histograms are
+// registered once by name, usually into a static reference of the module
+// that updates them, and are then updated from any thread without locks.
+// A counter is split in shards that the threads pick by a slot assigned on
+// their first update, so threads on different cores do not fight over a
+// cache line, and the readers sum the shards. A histogram is a fixed array
+// of atomic buckets whose width grows with the value, HDR style, so any
+// recorded value is off by at most 1/16 of itself. Only the registration
+// and the snapshots take the registry lock.
+//
+
+/// The number of shards of a counter
+static const std::size_t MetricShards = 16;
+
+/// The number of sub buckets per power of two of a histogram, the values below twice that have a bucket each
+static const std::size_t HistogramSubBuckets = 16;
+
+/// The number of buckets of a histogram, enough for any 64 bit value: the 32 exact ones and 16 for each higher power of two
+static const std::size_t HistogramBuckets = (64 - 3) * HistogramSubBuckets;
+
+/// Retrieves the counter shard of the calling thread
+std::size_t GetMetricShard();
+
+///==============================================================
+///= Counter
+///==============================================================
+
+/// A monotonic count
+class Counter
+{
+    public:
+        /// Constructor
+        Counter();
+
+        /// Disable copying
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+        /// Adds the given amount, may be called from any thread
+        void Add(std::uint64_t n = 1);
+
+        /// Retrieves the sum of all the additions so far
+        std::uint64_t Get() const;
+
+    private:
+        /// A shard spans two cache lines, so the values of two shards never share one whatever the alignment
+        struct Shard
+        {
+            std::atomic<std::uint64_t> value;
+            char padding[128 - sizeof(std::atomic<std::uint64_t>)];
+        };
+
+        Shard mShards[MetricShards];
+};
+
+inline void Counter::Add(std::uint64_t n)
+{
+    mShards[GetMetricShard()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+///==============================================================
+///= Gauge
+///==============================================================
+
+/// A value that goes up and down, like a queue depth
+class Gauge
+{
+    public:
+        /// Constructor
+        Gauge() : mValue(0) {}
+
+        /// Disable copying
+        Gauge(const Gauge&) = delete;
+        Gauge& operator=(const Gauge&) = delete;
+
+        /// Sets the value
+        void Set(std::int64_t v) { mValue.store(v, std::memory_order_relaxed); }
+
+        /// Adds the given amount to the value, negative to lower it
+        void Add(std::int64_t n) { mValue.fetch_add(n, std::memory_order_relaxed); }
+
+        /// Retrieves the value
+        std::int64_t Get() const { return mValue.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<std::int64_t> mValue;
+};
+
+///==============================================================
+///= Histogram
+///==============================================================
+
+/// The state of a histogram at the time of a snapshot
+struct HistogramSnapshot
+{
+    std::string name;
+    std::string help;
+
+    /// The number, sum and largest of the recorded values
+    std::uint64_t count = 0;
+    std::uint64_t sum = 0;
+    std::uint64_t max = 0;
+
+    /// The non empty buckets in increasing order, as the largest value of the bucket and its number of values
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> buckets;
+
+    /// Retrieves the value that the given fraction (0 to 1) of the recorded values do not exceed,
+    /// rounded up to the end of its bucket. Zero if nothing was recorded
+    std::uint64_t GetPercentile(double fraction) const;
+};
+
+/// A distribution of values, microseconds for the latencies
+class Histogram
+{
+    public:
+        /// Constructor
+        Histogram();
+
+        /// Disable copying
+        Histogram(const Histogram&) = delete;
+        Histogram& operator=(const Histogram&) = delete;
+
+        /// Records the given value, may be called from any thread
+        void Record(std::uint64_t v);
+
+        /// Records the given duration in microseconds
+        void Record(std::chrono::steady_clock::duration d);
+
+        /// Fills the counts of the given snapshot
+        void Read(HistogramSnapshot& s) const;
+
+        /// Retrieves the bucket of the given value
+        static std::size_t GetBucket(std::uint64_t v);
+
+        /// Retrieves the largest value of the given bucket
+        static std::uint64_t GetBucketLimit(std::size_t bucket);
+
+    private:
+        std::atomic<std::uint64_t> mBuckets[HistogramBuckets];
+        std::atomic<std::uint64_t> mSum;
+        std::atomic<std::uint64_t> mMax;
+};
+
+inline void Histogram::Record(std::uint64_t v)
+{
+    mBuckets[GetBucket(v)].fetch_add(1, std::memory_order_relaxed);
+    mSum.fetch_add(v, std::memory_order_relaxed);
+    std::uint64_t max = mMax.load(std::memory_order_relaxed);
+    while (v > max && !mMax.compare_exchange_weak(max, v, std::memory_order_relaxed))
+        ;
+}
+
+inline void Histogram::Record(std::chrono::steady_clock::duration d)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    Record(static_cast<std::uint64_t>(us < 0 ? 0 : us));
+}
+
+/// Records the time from its construction to its destruction in the given histogram
+class ScopedTimer
+{
+    public:
+        explicit ScopedTimer(Histogram& h) : mHistogram(h), mStart(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer() { mHistogram.Record(std::chrono::steady_clock::now() - mStart); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& mHistogram;
+        std::chrono::steady_clock::time_point mStart;
+};
+
+///==============================================================
+///= MetricsRegistry
+///==============================================================
+
+/// The values of all the metrics at one point in time, each list sorted by name
+struct MetricsSnapshot
+{
+    struct CounterValue
+    {
+        std::string name;
+        std::string help;
+        std::uint64_t value;
+    };
+
+    struct GaugeValue
+    {
+        std::string name;
+        std::string help;
+        std::int64_t value;
+    };
+
+    std::vector<CounterValue> counters;
+    std::vector<GaugeValue> gauges;
+    std::vector<HistogramSnapshot> histograms;
+
+    /// Retrieves the value of the given counter, zero if there is no such counter
+    std::uint64_t GetCounter(const std::string& name) const;
+
+    /// Retrieves the value of the given gauge, zero if there is no such gauge
+    std::int64_t GetGauge(const std::string& name) const;
+
+    /// Retrieves the given histogram, null if there is no such histogram
+    const HistogramSnapshot* FindHistogram(const std::string& name) const;
+};
+
+class MetricsRegistry
+{
+    public:
+        /// Constructor
+        MetricsRegistry() = default;
+
+        /// Disable copying
+        MetricsRegistry(const MetricsRegistry&) = delete;
+        MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+        /// Retrieves the counter with the given name, registering it with the given description on first use.
+        /// The reference stays valid for the lifetime of the registry
+        Counter& GetCounter(const std::string& name, const std::string& help);
+
+        /// Retrieves the gauge with the given name, registering it with the given description on first use
+        Gauge& GetGauge(const std::string& name, const std::string& help);
+
+        /// Retrieves the histogram with the given name, registering it with the given description on first use
+        Histogram& GetHistogram(const std::string& name, const std::string& help);
+
+        /// Reads all the metrics, may be called from any thread while they are updated
+        MetricsSnapshot Snapshot() const;
+
+    private:
+        template<typename T>
+        struct Entry
+        {
+            std::string help;
+            std::unique_ptr<T> metric;
+        };
+
+        /// Guards the maps, not the metrics
+        mutable std::mutex mMutex;
+
+        std::map<std::string, Entry<Counter>> mCounters;
+        std::map<std::string, Entry<Gauge>> mGauges;
+        std::map<std::string, Entry<Histogram>> mHistograms;
+};
+
+/// Retrieves the process wide registry
+MetricsRegistry& GetMetrics();
+
+#endif // ! _METRICS_HPP_
@@ -0,0 +1,68 @@
+#include "NotificationData.hpp"
+
+bool ParsePriority(const std::string& name, Priority& p)
+{
+    if (name == "low")
+        p = Priority::Low;
+    else if (name == "normal")
+        p = Priority::Normal;
+    else if (name == "high")
+        p = Priority::High;
+    else if (name == "critical")
+        p = Priority::Critical;
+    else
+        return false;
+    return true;
+}
+
+const char* GetPriorityName(Priority p)
+{
+    switch (p)
+    {
+        case Priority::Low:
+            return "low";
+        case Priority::Normal:
+            return "normal";
+        case Priority::High:
+            return "high";
+        case Priority::Critical:
+            return "critical";
+    }
+    return "unknown";
+}
+
+const std::string& GetDedupKey(const NotificationData& data)
+{
+    return data.dedupKey.empty() ? data.msg : data.dedupKey;
+}
+
+bool ParseAckMode(const std::string& name, AckMode& m)
+{
+    if (name == "none")
+        m = AckMode::None;
+    else if (name == "accepted")
+        m = AckMode::Accepted;
+    else if (name == "displayed")
+        m = AckMode::Displayed;
+    else
+        return false;
+    return true;
+}
+
+const char* GetAckStatusName(AckStatus s)
+{
+    switch (s)
+    {
+        case AckStatus::Accepted:
+            return "accepted";
+        case AckStatus::Throttled:
+            return "throttled";
+        case AckStatus::Malformed:
+            return "malformed";
+        case AckStatus::Displayed:
+            return "displayed";
+        case AckStatus::Dropped:
+            return "dropped";
+    }
+    return "unknown";
+}
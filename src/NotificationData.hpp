@@ -0,0 +1,139 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _NOTIFICATION_DATA_HPP_
+#define _NOTIFICATION_DATA_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <memory>
+
+/// The notification priority levels, higher levels are shown first and may take the slots of lower ones
+enum class Priority
+{
+    Low,
+    Normal,
+    High,
+    Critical
+};
+
+/// The number of priority levels
+static const std::size_t PriorityLevels = 4;
+
+/// Parses a priority name (low, normal, high, critical), returns false if the name is unknown
+bool ParsePriority(const std::string& name, Priority& p);
+
+/// Retrieves the lowercase name of a priority
+const char* GetPriorityName(Priority p);
+
+/// When the client is told about the fate of its notification
+enum class AckMode
+{
+    /// Never, fire and forget
+    None,
+
+    /// Once the notification is queued for display
+    Accepted,
+
+    /// Once the notification window is shown, or the notification is dropped
+    Displayed
+};
+
+/// Parses an ack mode name (none, accepted, displayed), returns false if the name is unknown
+bool ParseAckMode(const std::string& name, AckMode& m);
+
+/// The statuses reported back to the client
+enum class AckStatus : std::uint8_t
+{
+    /// The notification was queued for display
+    Accepted = 0,
+
+    /// The notification was dropped because the client is over its rate limit
+    Throttled = 1,
+
+    /// The request could not be parsed
+    Malformed = 2,
+
+    /// The notification window was shown, on its own or merged into another notification
+    Displayed = 3,
+
+    /// The notification was dropped before it could be shown
+    Dropped = 4
+};
+
+/// Retrieves the lowercase name of an ack status
+const char* GetAckStatusName(AckStatus s);
+
+/// The encoding of the acks, matching the encoding of the request
+enum class AckFormat
+{
+    Text,
+    Json,
+    Binary
+};
+
+/// Where and how the acks of a notification are sent
+struct AckTarget
+{
+    /// The connection the request came from, the ack is discarded if it is gone
+    std::weak_ptr<void> connection;
+
+    std::uint32_t requestId;
+    bool hasRequestId;
+    AckMode mode;
+    AckFormat format;
+
+    AckTarget() : requestId(0), hasRequestId(false), mode(AckMode::None), format(AckFormat::Text) {}
+};
+
+struct NotificationData
+{
+    std::string msg;
+    unsigned int lifetime;
+    Priority priority;
+
+    /// Notifications with the same key are merged while one of them is alive, an empty key means the message itself
+    std::string dedupKey;
+
+    /// Where the display ack is sent
+    AckTarget ack;
+
+    /// The client the notification came from, its ip or the name of its local transport, empty if unknown
+    std::string source;
+
+    /// The sequence number of the journal record of the notification, zero if it is not journaled
+    std::uint64_t journalSeq = 0;
+};
+
+/// Retrieves the key that identifies the duplicates of the given notification
+const std::string& GetDedupKey(const NotificationData& data);
+
+#endif // ! _NOTIFICATION_DATA_HPP_
@@ -1,24 +1,18 @@
 #include "NotificationDrawer.hpp"
-#include <thread>
+#include <algorithm>
+#include "Trace.hpp"
 
-template<typename Callable>
-void runAfter(Callable c, unsigned long millisec)
-{
-    std::thread t(
-        [=]()
-        {
-            std::this_thread::sleep_for(std::chrono::milliseconds(millisec));
-            c();
-        }
-    );
-    t.detach();
-}
+// The number of notifications the containers are initially sized for
+static const std::size_t initialCapacity = 16;
 
-Notification::Notification(const std::string& msg, int initX, int initY)
-    : mAnimator(nullptr)
+Notification::Notification(NotificationWindowPool& pool, NotificationData data, int initX, int initY)
+    : mData(std::move(data)),
+      mWindowPool(pool),
+      mAnimator(nullptr),
+      mCount(1)
 {
-    mNotificationWindow = std::make_unique<NotificationWindow>();
-    mNotificationWindow->SetMessage(msg);
+    mNotificationWindow = mWindowPool.Acquire();
+    mNotificationWindow->SetMessage(mData.msg);
     mNotificationWindow->SetPosition(initX, initY);
     mNotificationWindow->Show(true);
 }
@@ -28,11 +22,31 @@ Notification::~Notification()
     for (auto& p : mAnimMap)
         p.second.Cancel();
     mAnimMap.clear();
+    mPosX.Detach();
+    mPosY.Detach();
+
+    // Hand the window back for reuse
+    mWindowPool.Release(mNotificationWindow);
 }
 
 void Notification::SetAnimator(Animator* a)
 {
     mAnimator = a;
+
+    // Get non owning pointer, for passing to Animator cb
+    NotificationWindow* rNw = mNotificationWindow;
+
+    // Bind the position variables, their update callbacks move the window on every animation tick
+    auto pos = rNw->GetPosition();
+    mAnimator->CreateVariable(mPosX, pos.first,
+        [rNw](double p) { rNw->SetPosition(static_cast<int>(p), rNw->GetPosition().second); });
+    mAnimator->CreateVariable(mPosY, pos.second,
+        [rNw](double p) { rNw->SetPosition(rNw->GetPosition().first, static_cast<int>(p)); });
+}
+
+const NotificationData& Notification::GetData() const
+{
+    return mData;
 }
 
 std::pair<int, int> Notification::GetPosition() const
@@ -42,78 +56,168 @@ std::pair<int, int> Notification::GetPosition() const
 
 void Notification::SetPosition(int newX, int newY)
 {
-    // Cancel all previous active reposition animations and schedule new ones
-    auto prevAnimX = mAnimMap.find("xrepos");
-    if (prevAnimX != std::end(mAnimMap))
+    // Retarget the position variables, a transition that is still running bends smoothly towards
+    // the new position instead of being cancelled and restarted from a standstill
+    if (static_cast<int>(mPosX.GetFinalValue()) != newX)
+        mAnimator->Retarget(mPosX, newX, 1000);
+    if (static_cast<int>(mPosY.GetFinalValue()) != newY)
+        mAnimator->Retarget(mPosY, newY, 1000);
+}
+
+void Notification::SetSize(int width, int height)
+{
+    mNotificationWindow->SetSize(width, height);
+}
+
+unsigned int Notification::GetCount() const
+{
+    return mCount;
+}
+
+void Notification::SetCount(unsigned int count)
+{
+    mCount = count;
+    mNotificationWindow->SetCount(count);
+}
+
+std::chrono::steady_clock::time_point Notification::GetDeadline() const
+{
+    return mDeadline;
+}
+
+void Notification::SetDeadline(std::chrono::steady_clock::time_point deadline)
+{
+    mDeadline = deadline;
+}
+
+bool NotificationDrawer::LaterExpiry(const Expiry& a, const Expiry& b)
+{
+    return a.deadline > b.deadline;
+}
+
+NotificationDrawer::NotificationDrawer(std::size_t windowPoolSize)
+    : mWindowPool(windowPoolSize),
+      mPendingSeq(0),
+      mDropPolicy(DropPolicy::Oldest),
+      mMaxPending(256),
+      mStats(),
+      mRecent(std::chrono::milliseconds(10000), 1024)
+{
+    // Size the containers for the visible stack up front, so steady state spawning does not allocate
+    mNotifications.Reserve(initialCapacity);
+    mStack.Reserve(initialCapacity + 1);
+    mExpiries.reserve(initialCapacity * 4);
+}
+
+void NotificationDrawer::WarmUp()
+{
+    mWindowPool.WarmUp();
+}
+
+void NotificationDrawer::SpawnNotification(NotificationData data)
+{
+    TRACE_SCOPE("NotificationDrawer::SpawnNotification");
+    ++mStats.received;
+    if (Coalesce(data))
+        return;
+
+    // Show right away if there is a free slot and nothing is already waiting for one,
+    // or if a less important notification can give up its slot
+    if ((mPending.Empty() && mStack.Size() < mLayout.GetCapacity()) || Preempt(data.priority))
+        ShowNotification(std::move(data));
+    else
+        Enqueue(std::move(data));
+}
+
+bool NotificationDrawer::Coalesce(const NotificationData& data)
+{
+    auto now = Clock::now();
+    const std::string& key = GetDedupKey(data);
+    CoalesceTarget* t = mRecent.Find(key, now);
+    if (!t)
+        return false;
+
+    // A visible duplicate gets a bigger count and stays on screen for the lifetime of the newcomer,
+    // the expiry heap notices the later deadline when the current one comes up. The key is refreshed
+    // along, so that it lasts as long as the notification keeps being extended
+    if (Notification* n = mNotifications.Get(t->visible))
     {
-        prevAnimX->second.Cancel();
-        mAnimMap.erase(prevAnimX);
+        Ack(data.ack, AckStatus::Displayed);
+        Retire(data);
+        n->SetCount(n->GetCount() + 1);
+        n->SetDeadline(std::max(n->GetDeadline(), now + std::chrono::milliseconds(data.lifetime)));
+        mRecent.Refresh(key, now);
+        ++mStats.coalesced;
+        return true;
     }
-    auto prevAnimY = mAnimMap.find("yrepos");
-    if (prevAnimY != std::end(mAnimMap))
+
+    // A pending duplicate is shown with the merged count once it gets a slot
+    if (t->visible == SlotMap<Notification>::Null && t->pending && t->pending->collapsed == 0)
     {
-        prevAnimY->second.Cancel();
-        mAnimMap.erase(prevAnimY);
+        PendingEntry* e = t->pending;
+        if (data.ack.mode == AckMode::Displayed)
+            e->mergedAcks.push_back(data.ack);
+        Retire(data);
+        ++e->count;
+        e->data.lifetime = std::max(e->data.lifetime, data.lifetime);
+        mRecent.Refresh(key, now);
+        ++mStats.coalesced;
+        return true;
     }
 
-    // Get non owning pointer, for passing to Animator cb
-    NotificationWindow* rNw = mNotificationWindow.get();
+    // The duplicate is gone already
+    mRecent.Erase(key);
+    return false;
+}
 
-    // Schedule move animation on X axis
-    auto fx = [rNw](double p)
-    {
-        auto y = rNw->GetPosition().second;
-        rNw->SetPosition(static_cast<int>(p), y);
-    };
-    Transition tx(1000, rNw->GetPosition().first, newX);
-    Storyboard sx(tx);
-    Animation ax(sx, fx);
-    auto waX = mAnimator->DoSampleAnimation(ax);
-
-    // Add X reposition on AnimationMap
-    mAnimMap.insert(std::make_pair("xrepos", waX));
-
-    // Schedule move animation on Y axis
-    auto fy = [rNw](double p)
-    {
-        auto x = rNw->GetPosition().first;
-        rNw->SetPosition(x, static_cast<int>(p));
-    };
-    Transition ty(1000, rNw->GetPosition().second, newY);
-    Storyboard sy(ty);
-    Animation ay(sy, fy);
-    auto waY = mAnimator->DoSampleAnimation(ay);
+void NotificationDrawer::Ack(const AckTarget& target, AckStatus status)
+{
+    if (target.mode == AckMode::Displayed && mAckCallback)
+        mAckCallback(target, status);
+}
 
-    // Add Y reposition on AnimationMap
-    mAnimMap.insert(std::make_pair("yrepos", waY));
+void NotificationDrawer::AckDropped(const PendingEntry& e)
+{
+    Ack(e.data.ack, AckStatus::Dropped);
+    for (const auto& a : e.mergedAcks)
+        Ack(a, AckStatus::Dropped);
+    Retire(e.data);
 }
 
-NotificationId NotificationDrawer::sNWIdGen = 0;
+void NotificationDrawer::Retire(const NotificationData& data)
+{
+    // The merged duplicates are retired right away, the notification they were merged into stands for them
+    if (data.journalSeq != 0 && mRetireCallback)
+        mRetireCallback(data.journalSeq);
+}
 
-void NotificationDrawer::SpawnNotification(const std::string& msg, unsigned int lifetime)
+void NotificationDrawer::ForgetPending(const PendingEntry& e)
 {
-    (void) msg;
+    // A later notification with the same key may have taken the key over already
+    const std::string& key = GetDedupKey(e.data);
+    CoalesceTarget* t = mRecent.Find(key, Clock::now());
+    if (t && t->pending == &e)
+        mRecent.Erase(key);
+}
 
-    // Create the id for the notification
-    NotificationId id = sNWIdGen++;
+void NotificationDrawer::ShowNotification(NotificationData data, unsigned int count)
+{
+    unsigned int lifetime = data.lifetime;
+    std::string key = GetDedupKey(data);
 
-    // Calculate and set the initial NotificationWindow position
-    int xPos = 1200;
-    int yPos = 0;
-    if (!mVisibleList.empty())
-    {
-        auto fId = mVisibleList.front();
-        auto front = mNotifications.find(fId);
-        if (front != std::end(mNotifications))
-            yPos = front->second->GetPosition().second - 250;
-    }
+    // Acked once, a notification that is sent back to the pending queue and shown again is not acked again
+    Ack(data.ack, AckStatus::Displayed);
+    data.ack.mode = AckMode::None;
 
-    // Create the notification instance
-    std::unique_ptr<Notification> notification = std::make_unique<Notification>(std::to_string(id), xPos, yPos);
-    notification->SetAnimator(&mAnimator);
+    // New notifications start right above the stack and slide in on the next layout pass
+    SlotGeometry entry = mLayout.GetEntrySlot();
 
-    // Add it to the notifications' map
-    mNotifications.insert(std::make_pair(id, std::move(notification)));
+    // Create the notification instance in the notifications' slab
+    NotificationHandle h = mNotifications.Emplace(mWindowPool, std::move(data), entry.x, entry.y);
+    Notification* n = mNotifications.Get(h);
+    n->SetSize(entry.width, entry.height);
+    n->SetAnimator(&mAnimator);
+    n->SetCount(count);
 
     // Schedule spawn animation
     /*
@@ -125,39 +229,306 @@ void NotificationDrawer::SpawnNotification(const std::string& msg, unsigned int
     mNotificationAnimations[id].insert(std::make_pair("spawn", fadeInAnim));
     */
 
-    // Push notification id to the visible list
-    mVisibleList.push_front(id);
+    // Push notification handle to the top of the stack, it has no slot until it is laid out
+    mStack.PushFront(h);
 
-    // Remove the last element of the queue if the size of the queue
-    // reaches the visible notification limit
-    if (mVisibleList.size() > 8)
-        mVisibleList.pop_back();
+    // Schedule the notification killer
+    auto now = Clock::now();
+    Expiry e = { now + std::chrono::milliseconds(lifetime), h };
+    n->SetDeadline(e.deadline);
+    mExpiries.push_back(e);
+    std::push_heap(std::begin(mExpiries), std::end(mExpiries), LaterExpiry);
 
-    // Reschedule the animations according to the new positions
-    for (std::size_t i = 0; i < mVisibleList.size(); ++i)
+    // Later duplicates are merged into this notification
+    CoalesceTarget t = { h, nullptr };
+    mRecent.Insert(key, t, now);
+}
+
+void NotificationDrawer::Enqueue(NotificationData data)
+{
+    std::size_t level = static_cast<std::size_t>(data.priority);
+
+    // Critical notifications are never turned away by admission control
+    if (mPending.Size() < mMaxPending || data.priority == Priority::Critical)
+    {
+        PendingEntry e = { std::move(data), 0, mPendingSeq++, 1 };
+        mPending.Push(level, std::move(e));
+        CoalesceTarget t = { SlotMap<Notification>::Null, &mPending.Back(level) };
+        mRecent.Insert(GetDedupKey(t.pending->data), t, Clock::now());
+        ++mStats.queued;
+        return;
+    }
+
+    bool admit = false;
+    switch (mDropPolicy)
     {
-        auto n = mNotifications.find(mVisibleList[i]);
-        if (n != std::end(mNotifications))
+        case DropPolicy::Oldest:
         {
-            Notification* rN = n->second.get();
-            rN->SetPosition(xPos, i * 250);
+            admit = DropOldestPending();
+            break;
+        }
+        case DropPolicy::LowestPriority:
+        {
+            int lowest = mPending.LowestLevel();
+            if (lowest >= 0 && static_cast<std::size_t>(lowest) < level)
+            {
+                DropPending(static_cast<std::size_t>(lowest));
+                admit = true;
+            }
+            break;
+        }
+        case DropPolicy::Collapse:
+        {
+            // The newest pending entry of the same priority turns into a summary of itself and everything that follows
+            if (!mPending.Bucket(level).empty())
+            {
+                PendingEntry& tail = mPending.Back(level);
+                if (tail.collapsed == 0)
+                    tail.collapsed = 1;
+                ++tail.collapsed;
+                if (data.ack.mode == AckMode::Displayed)
+                    tail.mergedAcks.push_back(data.ack);
+                Retire(data);
+                tail.data.lifetime = std::max(tail.data.lifetime, data.lifetime);
+                ++mStats.collapsed;
+                return;
+            }
+            admit = DropOldestPending();
+            break;
         }
     }
 
-    // Schedule the notification killer
-    runAfter(
-        [this, id]()
+    if (admit)
+    {
+        PendingEntry e = { std::move(data), 0, mPendingSeq++, 1 };
+        mPending.Push(level, std::move(e));
+        CoalesceTarget t = { SlotMap<Notification>::Null, &mPending.Back(level) };
+        mRecent.Insert(GetDedupKey(t.pending->data), t, Clock::now());
+        ++mStats.queued;
+    }
+    else
+    {
+        Ack(data.ack, AckStatus::Dropped);
+        Retire(data);
+        ++mStats.dropped;
+    }
+}
+
+bool NotificationDrawer::DropOldestPending()
+{
+    // The bucket fronts are the oldest entries of each level
+    int oldest = -1;
+    for (std::size_t l = 0; l < static_cast<std::size_t>(Priority::Critical); ++l)
+    {
+        const auto& b = mPending.Bucket(l);
+        if (!b.empty() && (oldest < 0 || b.front().seq < mPending.Bucket(oldest).front().seq))
+            oldest = static_cast<int>(l);
+    }
+    if (oldest < 0)
+        return false;
+
+    DropPending(static_cast<std::size_t>(oldest));
+    return true;
+}
+
+void NotificationDrawer::DropPending(std::size_t level)
+{
+    const PendingEntry& e = mPending.Bucket(level).front();
+    AckDropped(e);
+    ForgetPending(e);
+    mPending.PopFront(level);
+    ++mStats.dropped;
+}
+
+bool NotificationDrawer::Preempt(Priority p)
+{
+    if (mStack.Size() == 0 || mStack.Size() < mLayout.GetCapacity())
+        return false;
+
+    // Find the least important visible notification, the oldest one among equals
+    std::size_t victim = mStack.Size();
+    Priority lowest = p;
+    for (std::size_t i = mStack.Size(); i-- > 0;)
+    {
+        Notification* n = mNotifications.Get(mStack.Get(i));
+        if (n && n->GetData().priority < lowest)
         {
-            auto n = mNotifications.find(id);
-            mNotifications.erase(n);
-        },
-        lifetime
+            lowest = n->GetData().priority;
+            victim = i;
+        }
+    }
+    if (victim == mStack.Size())
+        return false;
+
+    // Send it back to the front of its pending level, it gets the next slot of its level
+    NotificationHandle h = mStack.Get(victim);
+    Notification* n = mNotifications.Get(h);
+    PendingEntry e = { n->GetData(), 0, mPendingSeq++, n->GetCount() };
+    mPending.PushFront(static_cast<std::size_t>(lowest), std::move(e));
+    CoalesceTarget t = { SlotMap<Notification>::Null, &mPending.Front(static_cast<std::size_t>(lowest)) };
+    mRecent.Insert(GetDedupKey(n->GetData()), t, Clock::now());
+    DestroyNotification(h);
+    ++mStats.preempted;
+    return true;
+}
+
+void NotificationDrawer::PromotePending()
+{
+    while (!mPending.Empty() && mStack.Size() < mLayout.GetCapacity())
+    {
+        ForgetPending(mPending.Front(static_cast<std::size_t>(mPending.HighestLevel())));
+        PendingEntry e = mPending.PopHighest();
+        if (e.collapsed != 0)
+            e.data.msg = std::to_string(e.collapsed) + " more notifications";
+        ++mStats.promoted;
+        for (const auto& a : e.mergedAcks)
+            Ack(a, AckStatus::Displayed);
+        ShowNotification(std::move(e.data), e.count);
+    }
+}
+
+void NotificationDrawer::Layout()
+{
+    if (!mStack.IsDirty())
+        return;
+    TRACE_SCOPE("NotificationDrawer::Layout");
+
+    // Only the notifications whose slot actually changed get a new target, however many
+    // spawns and expiries happened since the previous pass
+    mStack.Layout(mLayout,
+        [this](NotificationHandle h, const SlotGeometry& g)
+        {
+            Notification* rN = mNotifications.Get(h);
+            if (rN)
+            {
+                rN->SetSize(g.width, g.height);
+                rN->SetPosition(g.x, g.y);
+            }
+        }
     );
 }
 
-void NotificationDrawer::Clear()
+void NotificationDrawer::SetDisplays(const std::vector<DisplayInfo>& displays)
 {
-    mNotifications.clear();
-    mVisibleList.clear();
+    mLayout.SetDisplays(displays);
+    InvalidateLayout();
 }
 
+void NotificationDrawer::SetLayoutOptions(const LayoutOptions& options)
+{
+    mLayout.SetOptions(options);
+    InvalidateLayout();
+}
+
+void NotificationDrawer::InvalidateLayout()
+{
+    // Send the notifications that no longer fit back to the front of the pending queue, oldest first
+    for (std::size_t i = mLayout.GetCapacity(); i < mStack.Size(); ++i)
+    {
+        NotificationHandle h = mStack.Get(i);
+        Notification* n = mNotifications.Get(h);
+        if (n)
+        {
+            std::size_t level = static_cast<std::size_t>(n->GetData().priority);
+            PendingEntry e = { n->GetData(), 0, mPendingSeq++, n->GetCount() };
+            mPending.PushFront(level, std::move(e));
+            CoalesceTarget t = { SlotMap<Notification>::Null, &mPending.Front(level) };
+            mRecent.Insert(GetDedupKey(n->GetData()), t, Clock::now());
+        }
+        mNotifications.Erase(h);
+    }
+    mStack.Truncate(mLayout.GetCapacity());
+    mStack.Invalidate();
+
+    // Fill the slots that the new layout may have added
+    PromotePending();
+}
+
+void NotificationDrawer::ExpireNotifications()
+{
+    TRACE_SCOPE("NotificationDrawer::ExpireNotifications");
+    auto now = Clock::now();
+    while (!mExpiries.empty() && mExpiries.front().deadline <= now)
+    {
+        NotificationHandle h = mExpiries.front().handle;
+        std::pop_heap(std::begin(mExpiries), std::end(mExpiries), LaterExpiry);
+        mExpiries.pop_back();
+
+        // A merged duplicate pushed the deadline back, schedule it again
+        Notification* n = mNotifications.Get(h);
+        if (n && n->GetDeadline() > now)
+        {
+            Expiry e = { n->GetDeadline(), h };
+            mExpiries.push_back(e);
+            std::push_heap(std::begin(mExpiries), std::end(mExpiries), LaterExpiry);
+            continue;
+        }
+        if (n)
+            Retire(n->GetData());
+        DestroyNotification(h);
+    }
+
+    // Hand the freed slots to the waiting notifications
+    PromotePending();
+}
+
+bool NotificationDrawer::GetNextExpiry(unsigned int& ms) const
+{
+    if (mExpiries.empty())
+        return false;
+
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(mExpiries.front().deadline - Clock::now());
+    ms = left.count() > 0 ? static_cast<unsigned int>(left.count()) : 0;
+    return true;
+}
+
+void NotificationDrawer::DestroyNotification(NotificationHandle h)
+{
+    mStack.Remove(h);
+    mNotifications.Erase(h);
+}
+
+void NotificationDrawer::SetOverflowPolicy(DropPolicy policy, std::size_t maxPending)
+{
+    mDropPolicy = policy;
+    mMaxPending = maxPending;
+}
+
+std::size_t NotificationDrawer::GetPendingCount() const
+{
+    return mPending.Size();
+}
+
+const DrawerStats& NotificationDrawer::GetStats() const
+{
+    return mStats;
+}
+
+void NotificationDrawer::SetCoalescing(std::chrono::milliseconds window, std::size_t capacity)
+{
+    mRecent.Configure(window, capacity);
+}
+
+void NotificationDrawer::SetAckCallback(std::function<void(const AckTarget&, AckStatus)> cb)
+{
+    mAckCallback = cb;
+}
+
+void NotificationDrawer::SetRetireCallback(std::function<void(std::uint64_t)> cb)
+{
+    mRetireCallback = cb;
+}
+
+double NotificationDrawer::GetSuppressionRatio() const
+{
+    return mStats.received != 0 ? static_cast<double>(mStats.coalesced) / mStats.received : 0.0;
+}
+
+void NotificationDrawer::Clear()
+{
+    mNotifications.Clear();
+    mStack.Clear();
+    mExpiries.clear();
+    mPending.Clear();
+    mRecent.Clear();
+}
@@ -34,13 +34,21 @@
 #include <string>
 #include <unordered_map>
 #include <memory>
-#include <deque>
-#include <list>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "NotificationData.hpp"
 #include "NotificationWindow.hpp"
+#include "NotificationWindowPool.hpp"
 #include "Animation.hpp"
+#include "SlotMap.hpp"
+#include "BucketQueue.hpp"
+#include "StackLayout.hpp"
+#include "NotificationStack.hpp"
+#include "DedupWindow.hpp"
 
-// Abstracting the id type
-using NotificationId = unsigned long;
+// Stable reference to a Notification owned by the NotificationDrawer
+using NotificationHandle = SlotHandle;
 
 // Type that holds weak handles to the running animations of a Notification
 using AnimationMap = std::unordered_map<std::string, AnimationHandle>;
@@ -48,8 +56,8 @@ using AnimationMap = std::unordered_map<std::string, AnimationHandle>;
 class Notification
 {
     public:
-        /// Constructor
-        explicit Notification(const std::string& msg, int initX, int initY);
+        /// Constructor, borrows its window from the given pool for as long as it lives
+        explicit Notification(NotificationWindowPool& pool, NotificationData data, int initX, int initY);
 
         /// Destructor
         ~Notification();
@@ -57,44 +65,268 @@ class Notification
         /// Sets the Animator object to use for the various window animations of the Notification
         void SetAnimator(Animator* a);
 
+        /// Retrieves the data the Notification was created with
+        const NotificationData& GetData() const;
+
         /// Retrieves the notification position
         std::pair<int, int> GetPosition() const;
 
         /// Changes notification position gradually using generated animation from animator
         void SetPosition(int newX, int newY);
 
+        /// Changes notification size immediately
+        void SetSize(int width, int height);
+
+        /// Retrieves the number of notifications merged into this one, itself included
+        unsigned int GetCount() const;
+
+        /// Sets the number of notifications merged into this one and shows it on the window badge
+        void SetCount(unsigned int count);
+
+        /// Retrieves the point in time the notification is due to be destroyed
+        std::chrono::steady_clock::time_point GetDeadline() const;
+
+        /// Sets the point in time the notification is due to be destroyed
+        void SetDeadline(std::chrono::steady_clock::time_point deadline);
+
     private:
+        /// The data the Notification was created with
+        NotificationData mData;
+
+        /// The pool that owns the window of the Notification
+        NotificationWindowPool& mWindowPool;
+
         /// The representation of the Notification as a Window
-        std::unique_ptr<NotificationWindow> mNotificationWindow;
+        NotificationWindow* mNotificationWindow;
 
         /// The object that animates the Notification in its various actions
         Animator* mAnimator;
 
         /// Caches various animation weak handles
         AnimationMap mAnimMap;
+
+        /// The animated window coordinates, retargeted every time the Notification moves
+        AnimationVariable mPosX, mPosY;
+
+        /// The number of notifications merged into this one
+        unsigned int mCount;
+
+        /// The point in time the notification is due to be destroyed, pushed back by every merged duplicate
+        std::chrono::steady_clock::time_point mDeadline;
+};
+
+/// What happens to an incoming notification when the pending queue is full
+enum class DropPolicy
+{
+    /// Drop the oldest pending notification to make room
+    Oldest,
+
+    /// Drop the oldest pending notification of the lowest priority, or the incoming one if nothing has lower priority
+    LowestPriority,
+
+    /// Fold the overflowing notifications into a single summary notification
+    Collapse
+};
+
+/// Counters of the drawer admission control
+struct DrawerStats
+{
+    /// Notifications that had to wait for a free slot
+    std::size_t queued;
+
+    /// Notifications dropped because the pending queue was full
+    std::size_t dropped;
+
+    /// Pending notifications that were given a slot
+    std::size_t promoted;
+
+    /// Notifications folded into a summary notification
+    std::size_t collapsed;
+
+    /// Visible notifications sent back to the pending queue to make room for more important ones
+    std::size_t preempted;
+
+    /// Notifications handed to the drawer
+    std::size_t received;
+
+    /// Notifications merged into a visible or pending duplicate instead of being shown on their own
+    std::size_t coalesced;
 };
 
 class NotificationDrawer
 {
     public:
-        /// Creates a notification window with the given properties
-        void SpawnNotification(const std::string& msg, unsigned int lifetime);
+        /// Constructor, takes as argument the number of notification windows kept ready for reuse
+        explicit NotificationDrawer(std::size_t windowPoolSize = 16);
+
+        /// Precreates the pooled notification windows, must be called from the UI thread
+        void WarmUp();
+
+        /// Shows the given notification if there is a free slot or a less important notification to take the slot from,
+        /// or queues it until one frees up. The window placement is deferred to the next Layout
+        void SpawnNotification(NotificationData data);
+
+        /// Moves the visible notifications whose slot changed since the previous layout pass
+        void Layout();
+
+        /// Sets the displays the notification stack spans, to be called again on every display change
+        void SetDisplays(const std::vector<DisplayInfo>& displays);
+
+        /// Sets the notification stack geometry settings
+        void SetLayoutOptions(const LayoutOptions& options);
+
+        /// Destroys the notifications whose lifetime has ended
+        void ExpireNotifications();
+
+        /// Retrieves the milliseconds left until the next notification expires, returns false if none is alive
+        bool GetNextExpiry(unsigned int& ms) const;
+
+        /// Sets what happens to the notifications that do not fit in the pending queue
+        void SetOverflowPolicy(DropPolicy policy, std::size_t maxPending);
+
+        /// Retrieves the number of notifications waiting for a free slot
+        std::size_t GetPendingCount() const;
+
+        /// Retrieves the admission control counters
+        const DrawerStats& GetStats() const;
+
+        /// Sets how long a notification key is remembered for merging duplicates and how many keys are remembered,
+        /// a zero window disables the merging
+        void SetCoalescing(std::chrono::milliseconds window, std::size_t capacity);
+
+        /// Retrieves the fraction of the received notifications that were merged into a duplicate
+        double GetSuppressionRatio() const;
+
+        /// Sets the function called with the displayed and dropped acks of the notifications that asked for them
+        void SetAckCallback(std::function<void(const AckTarget&, AckStatus)> cb);
+
+        /// Sets the function called with the journal sequence number of every journaled notification that is done with:
+        /// expired, dropped or merged into another notification. Clear does not retire the notifications it destroys
+        void SetRetireCallback(std::function<void(std::uint64_t)> cb);
 
         /// Clears drawer from all the notifications
         void Clear();
 
     private:
-        /// The container that holds the notification window instances that are alive
-        std::unordered_map<NotificationId, std::unique_ptr<Notification>> mNotifications;
+        using Clock = std::chrono::steady_clock;
+
+        /// A notification waiting for a free slot, it owns no window
+        struct PendingEntry
+        {
+            NotificationData data;
+
+            /// Number of notifications the entry summarizes, 0 for a plain notification
+            std::size_t collapsed;
+
+            /// Arrival sequence number, orders the entries across priority levels
+            std::uint64_t seq;
+
+            /// Number of duplicates merged into the entry, itself included
+            unsigned int count;
+
+            /// The displayed acks of the notifications merged or collapsed into the entry
+            std::vector<AckTarget> mergedAcks;
+        };
+
+        /// Where the last notification with a given key went. A visible notification is checked for liveness on every
+        /// lookup, a pending entry forgets its key when it leaves the pending queue, so the pointer is always valid
+        struct CoalesceTarget
+        {
+            /// The visible notification, or the null handle if the notification is pending
+            NotificationHandle visible;
+
+            /// The pending entry, its bucket never moves the entries it holds
+            PendingEntry* pending;
+        };
+
+        /// A scheduled notification destruction
+        struct Expiry
+        {
+            Clock::time_point deadline;
+            NotificationHandle handle;
+        };
+
+        /// Creates the window of the given notification and puts it on top of the stack
+        void ShowNotification(NotificationData data, unsigned int count = 1);
+
+        /// Queues the given notification applying the drop policy if the pending queue is full
+        void Enqueue(NotificationData data);
+
+        /// Merges the given notification into a live duplicate, returns false if there is none
+        bool Coalesce(const NotificationData& data);
+
+        /// Forgets the key of the given pending entry if it still leads to it, called before the entry leaves the queue
+        void ForgetPending(const PendingEntry& e);
+
+        /// Sends the given ack if the notification asked for displayed acks
+        void Ack(const AckTarget& target, AckStatus status);
+
+        /// Sends the dropped acks of the given pending entry and retires it
+        void AckDropped(const PendingEntry& e);
+
+        /// Tells the journal that the given notification is done with
+        void Retire(const NotificationData& data);
+
+        /// Sends the least important visible notification back to the pending queue if it is less important than p
+        bool Preempt(Priority p);
 
-        /// The queue that keeps the currently visible notification id, in the order they are visible
-        std::deque<NotificationId> mVisibleList;
+        /// Drops the oldest pending notification below the critical level, returns false if there is none
+        bool DropOldestPending();
+
+        /// Drops the oldest pending notification of the given level, which must not be empty
+        void DropPending(std::size_t level);
+
+        /// Moves pending notifications to the stack while there are free slots
+        void PromotePending();
+
+        /// Removes the given notification from the visible list and destroys it
+        void DestroyNotification(NotificationHandle h);
+
+        /// Forces all the visible notifications to be placed again, sending the ones that no longer fit back to the pending queue
+        void InvalidateLayout();
+
+        /// Orders the expiry heap so that the earliest deadline is on top
+        static bool LaterExpiry(const Expiry& a, const Expiry& b);
+
+        /// The recycled notification windows, declared first so that it outlives the notifications
+        NotificationWindowPool mWindowPool;
+
+        /// The slab that holds the notification instances that are alive
+        SlotMap<Notification> mNotifications;
+
+        /// The currently visible notifications, in the order they are visible, and their slots
+        NotificationStack mStack;
+
+        /// The cached stack geometry
+        StackLayout mLayout;
+
+        /// Min heap of the pending notification destructions ordered by deadline
+        std::vector<Expiry> mExpiries;
+
+        /// The notifications waiting for a free slot, by priority and then arrival order
+        BucketQueue<PendingEntry, PriorityLevels> mPending;
+
+        /// The arrival sequence number generator of the pending entries
+        std::uint64_t mPendingSeq;
+
+        /// The pending queue drop policy and size
+        DropPolicy mDropPolicy;
+        std::size_t mMaxPending;
+
+        /// The admission control counters
+        DrawerStats mStats;
+
+        /// The recently seen notification keys and where their notifications went
+        DedupWindow<CoalesceTarget> mRecent;
+
+        /// Called with the displayed and dropped acks
+        std::function<void(const AckTarget&, AckStatus)> mAckCallback;
+
+        /// Called with the journal sequence numbers of the notifications that are done with
+        std::function<void(std::uint64_t)> mRetireCallback;
 
         /// The Animator that schedules the various animation effects
         Animator mAnimator;
-
-        /// The id value generator
-        static NotificationId sNWIdGen;
 };
 
 #endif // ! _NOTIFICATION_DRAWER_HPP_
@@ -1,13 +1,91 @@
 #include "NotificationService.hpp"
+#include "Displays.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+
+// Not declared when building for Windows versions before 8.1
+#ifndef WM_DPICHANGED
+#define WM_DPICHANGED 0x02E0
+#endif
+
+// The metrics of the spawn queue
+static Gauge& queueDepth = GetMetrics().GetGauge("notification_queue_depth", "Notifications posted to the notification thread and not spawned yet");
+static Histogram& spawnLatency = GetMetrics().GetHistogram("notification_spawn_latency_us", "Time from queueing a notification to having its window spawned");
+
+// Retrieves the time a spawn message is posted at, in microseconds cut to 32 bits so that it fits the WPARAM of any
+// platform. The difference of two stamps is right for up to an hour
+static std::uint32_t GetSpawnStamp()
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+NotificationService::NotificationService()
+    : mHMsgWnd(nullptr),
+      mWindowPoolSize(16),
+      mLayoutPending(false),
+      mDropPolicy(DropPolicy::Oldest),
+      mMaxPending(256),
+      mCoalesceWindow(10000),
+      mCoalesceCapacity(1024),
+      mReady(false)
+{
+}
+
+void NotificationService::SetWindowPoolSize(std::size_t n)
+{
+    mWindowPoolSize = n;
+}
+
+void NotificationService::SetOverflowPolicy(DropPolicy policy, std::size_t maxPending)
+{
+    mDropPolicy = policy;
+    mMaxPending = maxPending;
+}
+
+void NotificationService::SetLayoutOptions(const LayoutOptions& options)
+{
+    mLayoutOptions = options;
+}
+
+void NotificationService::SetCoalescing(std::chrono::milliseconds window, std::size_t capacity)
+{
+    mCoalesceWindow = window;
+    mCoalesceCapacity = capacity;
+}
 
 void NotificationService::Run()
 {
-    // Create the NotificationDrawer
-    mDrawer = std::make_unique<NotificationDrawer>();
+    SetTraceThreadName("NotificationService");
+
+    // Create the NotificationDrawer and have its windows ready before the first notification arrives
+    mDrawer = std::make_unique<NotificationDrawer>(mWindowPoolSize);
+    mDrawer->WarmUp();
+    mDrawer->SetLayoutOptions(mLayoutOptions);
+    mDrawer->SetOverflowPolicy(mDropPolicy, mMaxPending);
+    mDrawer->SetCoalescing(mCoalesceWindow, mCoalesceCapacity);
+    mDrawer->SetAckCallback(mAckCallback);
+    if (mJournal)
+        mDrawer->SetRetireCallback(std::bind(&Journal::Retire, mJournal.get(), std::placeholders::_1));
 
     // Create the message window that will receive the notification create events
     CreateMsgWnd();
 
+    // The display configuration is cached by the drawer until the next display change message
+    RefreshDisplays();
+
+    // Show again what was left over by the previous run, the notifications keep their journal records
+    for (const auto& data : mReplay)
+        ShowNotification(data);
+    mReplay.clear();
+
+    // The producers may post from now on, a window that could not be created leaves them dropping notifications
+    {
+        std::lock_guard<std::mutex> lock(mReadyMutex);
+        mReady = true;
+    }
+    mReadyChanged.notify_all();
+
     // Run the message loop
     MSG msg;
     while (GetMessage(&msg, NULL, 0, 0) > 0)
@@ -26,8 +104,10 @@ void NotificationService::RunAsync()
 
 void NotificationService::Stop()
 {
-    // Destroy all Notification windows
+    // Destroy all Notification windows, the journal keeps the ones that are left for the next run
     mDrawer->Clear();
+    if (mJournal)
+        mJournal->Sync();
 
     // Destroy the NotificationDrawer
     mDrawer.reset(nullptr);
@@ -36,12 +116,56 @@ void NotificationService::Stop()
     SendMessage(mHMsgWnd, WM_DESTROY, 0, 0);
 }
 
-void NotificationService::ShowNotification(const std::string& msg, unsigned int lifetime)
+void NotificationService::WaitReady()
+{
+    std::unique_lock<std::mutex> lock(mReadyMutex);
+    mReadyChanged.wait(lock, [this]() { return mReady; });
+}
+
+void NotificationService::ShowNotification(const NotificationData& d)
+{
+    TRACE_SCOPE("NotificationService::ShowNotification");
+    NotificationData* data = new NotificationData(d);
+    TRACE_FLOW_BEGIN("PostMessage", reinterpret_cast<std::uintptr_t>(data));
+    if (mJournal && data->journalSeq == 0)
+        data->journalSeq = mJournal->Append(*data);
+    mFlowControl.OnQueued();
+    queueDepth.Set(static_cast<std::int64_t>(mFlowControl.GetDepth()));
+    // Posting to no window would post to the queue of this thread, which never reads it
+    if (!mHMsgWnd || !PostMessage(mHMsgWnd, WM_SPAWN_NOTIFICATION, static_cast<WPARAM>(GetSpawnStamp()), reinterpret_cast<LPARAM>(data)))
+    {
+        // The notification will never be shown, so it must not come back on the next start either
+        if (mJournal && data->journalSeq != 0)
+            mJournal->Retire(data->journalSeq);
+        delete data;
+        mFlowControl.OnDrained();
+        queueDepth.Set(static_cast<std::int64_t>(mFlowControl.GetDepth()));
+    }
+}
+
+void NotificationService::SetQueueWatermarks(std::size_t high, std::size_t low)
 {
-    NotificationData* data = new NotificationData;
-    data->msg = msg;
-    data->lifetime = lifetime;
-    PostMessage(mHMsgWnd, WM_SPAWN_NOTIFICATION, 0, reinterpret_cast<LPARAM>(data));
+    mFlowControl.SetWatermarks(high, low);
+}
+
+FlowControl& NotificationService::GetFlowControl()
+{
+    return mFlowControl;
+}
+
+void NotificationService::SetAckCallback(std::function<void(const AckTarget&, AckStatus)> cb)
+{
+    mAckCallback = cb;
+}
+
+bool NotificationService::SetJournal(const std::string& path, JournalOptions options)
+{
+    mReplay.clear();
+    mJournal = std::make_unique<Journal>(path, options);
+    if (mJournal->Open(mReplay))
+        return true;
+    mJournal.reset();
+    return false;
 }
 
 void NotificationService::CreateMsgWnd()
@@ -61,11 +185,40 @@ void NotificationService::CreateMsgWnd()
         RegisterClassEx(&wc);
     }
 
-    // Create the message only window
-    mHMsgWnd = CreateWindowEx(0, dummyWndClassName, _T(""), 0, 0, 0, 0, 0, HWND_MESSAGE, NULL, NULL, this);
+    // Create the hidden window, it is a top level window instead of a message only one
+    // because message only windows do not receive the display change broadcasts
+    mHMsgWnd = CreateWindowEx(WS_EX_TOOLWINDOW, dummyWndClassName, _T(""), WS_POPUP, 0, 0, 0, 0, NULL, NULL, NULL, this);
 }
 
 const UINT NotificationService::WM_SPAWN_NOTIFICATION = WM_USER + 77;
+const UINT NotificationService::WM_LAYOUT_NOTIFICATIONS = WM_USER + 78;
+const UINT_PTR NotificationService::EXPIRY_TIMER_ID = 1;
+
+void NotificationService::ScheduleExpiry()
+{
+    // Setting a timer with an existing id replaces it, so there is only ever one pending
+    unsigned int ms;
+    if (mDrawer->GetNextExpiry(ms))
+        SetTimer(mHMsgWnd, EXPIRY_TIMER_ID, ms, nullptr);
+    else
+        KillTimer(mHMsgWnd, EXPIRY_TIMER_ID);
+}
+
+void NotificationService::RequestLayout()
+{
+    // Posted messages are handled in order, so every spawn that is already queued
+    // is handled before the layout pass and a whole burst shares a single pass
+    if (mLayoutPending)
+        return;
+    mLayoutPending = true;
+    PostMessage(mHMsgWnd, WM_LAYOUT_NOTIFICATIONS, 0, 0);
+}
+
+void NotificationService::RefreshDisplays()
+{
+    mDrawer->SetDisplays(QueryDisplays());
+    RequestLayout();
+}
 
 LRESULT NotificationService::MessageHandler(HWND hh, UINT mm, WPARAM ww, LPARAM ll)
 {
@@ -73,14 +226,56 @@ LRESULT NotificationService::MessageHandler(HWND hh, UINT mm, WPARAM ww, LPARAM
     {
         case WM_SPAWN_NOTIFICATION:
         {
-            // Fetch the notification data
+            // Fetch the notification data, the flow joins the post on the producer thread to this spawn
+            TRACE_SCOPE("NotificationService::Spawn");
             NotificationData* data = reinterpret_cast<NotificationData*>(ll);
+            TRACE_FLOW_END("PostMessage", reinterpret_cast<std::uintptr_t>(data));
 
             // Create and store the notification
-            mDrawer->SpawnNotification(data->msg, data->lifetime);
+            mDrawer->SpawnNotification(std::move(*data));
             
             // Delete unused notification data
             delete data;
+
+            // May resume the paused producers
+            mFlowControl.OnDrained();
+            queueDepth.Set(static_cast<std::int64_t>(mFlowControl.GetDepth()));
+            spawnLatency.Record(static_cast<std::uint64_t>(GetSpawnStamp() - static_cast<std::uint32_t>(ww)));
+
+            // The new notification may expire before the currently scheduled one
+            ScheduleExpiry();
+            RequestLayout();
+            break;
+        }
+        case WM_LAYOUT_NOTIFICATIONS:
+        {
+            mLayoutPending = false;
+            if (mDrawer)
+                mDrawer->Layout();
+            break;
+        }
+        case WM_SETTINGCHANGE:
+        {
+            // Only work area changes affect the stack
+            if (ww == SPI_SETWORKAREA && mDrawer)
+                RefreshDisplays();
+            return DefWindowProc(hh, mm, ww, ll);
+        }
+        case WM_DISPLAYCHANGE:
+        case WM_DPICHANGED:
+        {
+            if (mDrawer)
+                RefreshDisplays();
+            return DefWindowProc(hh, mm, ww, ll);
+        }
+        case WM_TIMER:
+        {
+            if (ww == EXPIRY_TIMER_ID && mDrawer)
+            {
+                mDrawer->ExpireNotifications();
+                ScheduleExpiry();
+                RequestLayout();
+            }
             break;
         }
         case WM_DESTROY:
@@ -35,18 +35,33 @@
 #include <thread>
 #include <unordered_map>
 #include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
 #include "UIElement.hpp"
+#include "NotificationData.hpp"
 #include "NotificationDrawer.hpp"
-
-struct NotificationData
-{
-    std::string msg;
-    unsigned int lifetime;
-};
+#include "FlowControl.hpp"
+#include "Journal.hpp"
 
 class NotificationService : public UIElement
 {
     public:
+        /// Constructor
+        NotificationService();
+
+        /// Sets the number of notification windows kept ready for reuse, must be called before Run
+        void SetWindowPoolSize(std::size_t n);
+
+        /// Sets what happens to the notifications that do not fit in the pending queue, must be called before Run
+        void SetOverflowPolicy(DropPolicy policy, std::size_t maxPending);
+
+        /// Sets the notification stack geometry settings, must be called before Run
+        void SetLayoutOptions(const LayoutOptions& options);
+
+        /// Sets how long and how many notification keys are remembered for merging duplicates, must be called before Run
+        void SetCoalescing(std::chrono::milliseconds window, std::size_t capacity);
+
         /// Starts syncronous operation of the notification service
         void Run();
 
@@ -56,8 +71,26 @@ class NotificationService : public UIElement
         /// Stops the operation of the notification service
         void Stop();
 
-        /// Spawns notification window with the given message and lifetime in milliseconds
-        void ShowNotification(const std::string& msg, unsigned int lifetime);
+        /// Blocks until Run created the message window, the notifications shown before it would be lost. The
+        /// notification producers must not start before it returns
+        void WaitReady();
+
+        /// Spawns notification window with the given message, priority and lifetime in milliseconds
+        void ShowNotification(const NotificationData& data);
+
+        /// Sets the spawn queue depth that pauses the notification producers and the depth that resumes them
+        void SetQueueWatermarks(std::size_t high, std::size_t low);
+
+        /// Retrieves the flow control of the spawn queue, shared with the notification producers
+        FlowControl& GetFlowControl();
+
+        /// Sets the function called from the notification thread with the displayed and dropped acks, must be called before Run
+        void SetAckCallback(std::function<void(const AckTarget&, AckStatus)> cb);
+
+        /// Keeps a journal of the accepted notifications at the given path, so that the ones that were queued or visible
+        /// survive a restart or a crash and are shown again by the next Run. Must be called before Run and before the
+        /// notification producers start, returns false if the journal cannot be opened
+        bool SetJournal(const std::string& path, JournalOptions options = JournalOptions());
 
     private:
         /// Creates the message only window that will assist spawning the notifications
@@ -66,14 +99,63 @@ class NotificationService : public UIElement
         /// WndProc used by the message window that spawns the notifications
         LRESULT CALLBACK MessageHandler(HWND hh, UINT mm, WPARAM ww, LPARAM ll);
 
+        /// Arms the message window timer to fire when the next notification expires
+        void ScheduleExpiry();
+
+        /// Posts a layout pass behind the messages that are already queued, if one is not pending
+        void RequestLayout();
+
+        /// Hands the current display configuration to the drawer
+        void RefreshDisplays();
+
         /// The handle of the message window that is used to spawn the notifications
         HWND mHMsgWnd;
 
         /// The drawer that manages the lifetime, position and animations of the notifications
         std::unique_ptr<NotificationDrawer> mDrawer;
 
+        /// The number of notification windows kept ready for reuse
+        std::size_t mWindowPoolSize;
+
+        /// Set while a layout pass message is queued
+        bool mLayoutPending;
+
+        /// The notification stack geometry settings
+        LayoutOptions mLayoutOptions;
+
+        /// The pending queue drop policy and size
+        DropPolicy mDropPolicy;
+        std::size_t mMaxPending;
+
+        /// Tracks the notifications posted to the message window and not spawned yet
+        FlowControl mFlowControl;
+
+        /// Called with the displayed and dropped acks
+        std::function<void(const AckTarget&, AckStatus)> mAckCallback;
+
+        /// The optional journal of the accepted notifications
+        std::unique_ptr<Journal> mJournal;
+
+        /// The notifications left over by the previous run, shown once the service runs
+        std::vector<NotificationData> mReplay;
+
+        /// The duplicate merging window and number of remembered keys
+        std::chrono::milliseconds mCoalesceWindow;
+        std::size_t mCoalesceCapacity;
+
+        /// Set by Run once the message window exists, guarded by mReadyMutex
+        std::mutex mReadyMutex;
+        std::condition_variable mReadyChanged;
+        bool mReady;
+
         /// The type of the message that is used when spawning a notification
         static const UINT WM_SPAWN_NOTIFICATION;
+
+        /// The type of the message that is used when laying out the notifications
+        static const UINT WM_LAYOUT_NOTIFICATIONS;
+
+        /// The id of the timer that destroys the expired notifications
+        static const UINT_PTR EXPIRY_TIMER_ID;
 };
 
 #endif // ! _NOTIFICATION_HOLDER_HPP_
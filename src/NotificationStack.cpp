@@ -0,0 +1,69 @@
+#include "NotificationStack.hpp"
+
+NotificationStack::NotificationStack()
+    : mDirty(false)
+{
+}
+
+void NotificationStack::Reserve(std::size_t count)
+{
+    mEntries.reserve(count);
+}
+
+void NotificationStack::PushFront(SlotHandle h)
+{
+    Entry e = { h, -1 };
+    mEntries.push_back(e);
+    mDirty = true;
+}
+
+bool NotificationStack::Remove(SlotHandle h)
+{
+    // Notifications mostly go by expiring, the oldest first, so the search starts at the bottom
+    for (std::size_t k = 0; k < mEntries.size(); ++k)
+    {
+        if (mEntries[k].handle == h)
+        {
+            mEntries.erase(mEntries.begin() + k);
+            mDirty = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void NotificationStack::Truncate(std::size_t size)
+{
+    if (size >= mEntries.size())
+        return;
+    mEntries.erase(mEntries.begin(), mEntries.begin() + (mEntries.size() - size));
+    mDirty = true;
+}
+
+std::size_t NotificationStack::Size() const
+{
+    return mEntries.size();
+}
+
+SlotHandle NotificationStack::Get(std::size_t position) const
+{
+    return mEntries[mEntries.size() - 1 - position].handle;
+}
+
+void NotificationStack::Invalidate()
+{
+    for (auto& e : mEntries)
+        e.slot = -1;
+    mDirty = true;
+}
+
+bool NotificationStack::IsDirty() const
+{
+    return mDirty;
+}
+
+void NotificationStack::Clear()
+{
+    mEntries.clear();
+    mDirty = false;
+}
@@ -0,0 +1,122 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _NOTIFICATION_STACK_HPP_
+#define _NOTIFICATION_STACK_HPP_
+
+#include <cstddef>
+#include <vector>
+#include "SlotMap.hpp"
+#include "StackLayout.hpp"
+
+//
+// The order of the visible notifications and the slot each of them was
+// last placed in. A layout pass hands out the slots of a StackLayout and
+// reports only the notifications whose slot changed since the previous
+// pass, so however many spawns and expiries happen in between, a pass
+// moves every window at most once. The entries are kept bottom first, so
+// that a new notification on top is an append. Knows nothing of the
+// windows, so the drawer's slot bookkeeping runs without a display.
+//
+
+class NotificationStack
+{
+    public:
+        /// Constructor
+        NotificationStack();
+
+        /// Reserves room for the given number of notifications
+        void Reserve(std::size_t count);
+
+        /// Puts the given notification on top of the stack, it has no slot until the next layout pass
+        void PushFront(SlotHandle h);
+
+        /// Removes the given notification, returns false if it is not in the stack
+        bool Remove(SlotHandle h);
+
+        /// Removes the notifications from the given position down
+        void Truncate(std::size_t size);
+
+        /// Retrieves the number of notifications
+        std::size_t Size() const;
+
+        /// Retrieves the notification at the given position, 0 being the top of the stack
+        SlotHandle Get(std::size_t position) const;
+
+        /// Forgets the slots of all the notifications, so that the next layout pass places every one of them
+        void Invalidate();
+
+        /// Checks whether the stack changed since the last layout pass
+        bool IsDirty() const;
+
+        /// Calls move(handle, geometry) for every notification whose slot changed since the previous pass, top first,
+        /// and returns the number of moves. The stack must not hold more notifications than the layout has slots
+        template<typename F>
+        std::size_t Layout(const StackLayout& layout, F move);
+
+        /// Removes all the notifications
+        void Clear();
+
+    private:
+        /// A notification and the slot it was last placed in, -1 if none
+        struct Entry
+        {
+            SlotHandle handle;
+            int slot;
+        };
+
+        /// The notifications, the bottom of the stack first
+        std::vector<Entry> mEntries;
+
+        /// Set when the stack changed since the last layout pass
+        bool mDirty;
+};
+
+template<typename F>
+std::size_t NotificationStack::Layout(const StackLayout& layout, F move)
+{
+    if (!mDirty)
+        return 0;
+    mDirty = false;
+
+    std::size_t moves = 0;
+    for (std::size_t k = mEntries.size(), slot = 0; k-- > 0; ++slot)
+    {
+        Entry& e = mEntries[k];
+        if (e.slot == static_cast<int>(slot))
+            continue;
+        move(e.handle, layout.GetSlot(slot));
+        e.slot = static_cast<int>(slot);
+        ++moves;
+    }
+    return moves;
+}
+
+#endif // ! _NOTIFICATION_STACK_HPP_
@@ -1,10 +1,26 @@
 #include "NotificationWindow.hpp"
 #include <thread>
 #include <sstream>
+#include "FrameTiming.hpp"
+#include "Metrics.hpp"
+#include "Trace.hpp"
+
+// The time the WM_PAINT handling takes, cached blits and content renders alike
+static Histogram& paintTime = GetMetrics().GetHistogram("window_paint_us", "Time taken to paint a notification window");
 
 const TCHAR* NotificationWindow::wndClassName = _T("NotificationWndClass");
 
-NotificationWindow::NotificationWindow() : mHwnd(nullptr)
+NotificationWindow::NotificationWindow()
+    : mCount(1),
+      mHwnd(nullptr),
+      mContentBmp(nullptr),
+      mX(0),
+      mY(0),
+      mWidth(200),
+      mHeight(200),
+      mAlpha(50),
+      mDirty(DirtyContent),
+      mContentRepaints(0)
 {
     // Check if window class is registered and register it if it isn't
     WNDCLASS wc;
@@ -13,6 +29,12 @@ NotificationWindow::NotificationWindow() : mHwnd(nullptr)
 
     // Spawn the window instance
     Create();
+
+    // Cache the initial position so that reads never have to query the window
+    RECT rc;
+    GetWindowRect(mHwnd, &rc);
+    mX = rc.left;
+    mY = rc.top;
 }
 
 NotificationWindow::~NotificationWindow()
@@ -36,21 +58,12 @@ bool NotificationWindow::Register()
 
 void NotificationWindow::Create()
 {
-    // Get desktop dimensions
-    RECT desktopRect = {};
-    GetWindowRect(GetDesktopWindow(), &desktopRect);
-
-    // Calculate the window dimensions
-    RECT rect = desktopRect;
+    TRACE_SCOPE("NotificationWindow::Create");
 
     // The window styles that the window will use
     int wStyle = WS_BORDER | WS_VISIBLE;
 
-    // Set the client area to the 80% of the desktop resolution
-    rect.bottom = (LONG)(rect.bottom * 0.1);
-    rect.right = rect.bottom;
-    AdjustWindowRectEx(&rect, wStyle, TRUE, 0);
-
+    // The window is created with its initial size, the layout resizes it to match the display dpi
     mHwnd = CreateWindowEx(
         WS_EX_TOPMOST | WS_EX_LAYERED | WS_EX_TOOLWINDOW,
         wndClassName,
@@ -58,8 +71,8 @@ void NotificationWindow::Create()
         wStyle,
         CW_USEDEFAULT,
         CW_USEDEFAULT,
-        200,
-        200,
+        mWidth,
+        mHeight,
         0,
         0,
         GetModuleHandle(0),
@@ -76,11 +89,33 @@ void NotificationWindow::Destroy()
 {
     DestroyWindow(mHwnd);
     SetWindowLongPtr(mHwnd, GWLP_USERDATA, static_cast<LPARAM>(0));
+
+    // Free the cached content
+    if (mContentBmp)
+    {
+        DeleteObject(mContentBmp);
+        mContentBmp = nullptr;
+    }
 }
 
 void NotificationWindow::SetMessage(const std::string& msg)
 {
+    if (msg == mMessage)
+        return;
+
     mMessage = msg;
+    mDirty |= DirtyContent;
+    Commit();
+}
+
+void NotificationWindow::SetCount(unsigned int count)
+{
+    if (count == mCount)
+        return;
+
+    mCount = count;
+    mDirty |= DirtyContent;
+    Commit();
 }
 
 void NotificationWindow::Show(bool s)
@@ -90,31 +125,93 @@ void NotificationWindow::Show(bool s)
 
 std::pair<int, int> NotificationWindow::GetPosition() const
 {
-    RECT rc;
-    GetWindowRect(mHwnd, &rc);
-    return std::make_pair(rc.left, rc.top);
+    return std::make_pair(mX, mY);
 }
 
 void NotificationWindow::SetPosition(int x, int y)
 {
-    SetWindowPos(mHwnd, 0, x, y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
+    if (x == mX && y == mY)
+        return;
+
+    mX = x;
+    mY = y;
+    mDirty |= DirtyGeometry;
+    Commit();
+}
+
+void NotificationWindow::SetSize(int width, int height)
+{
+    if (width == mWidth && height == mHeight)
+        return;
+
+    mWidth = width;
+    mHeight = height;
+
+    // The cached content no longer matches the window size
+    if (mContentBmp)
+    {
+        DeleteObject(mContentBmp);
+        mContentBmp = nullptr;
+    }
+    mDirty |= DirtyGeometry | DirtyContent;
+    Commit();
 }
 
 unsigned int NotificationWindow::GetAlpha() const
 {
-    BYTE alpha;
-    GetLayeredWindowAttributes(mHwnd, nullptr, &alpha, nullptr);
-    return alpha * 100 / 255;
+    return mAlpha;
 }
 
 void NotificationWindow::SetAlpha(unsigned int alpha)
 {
-    COLORREF col = {0};
-    SetLayeredWindowAttributes(mHwnd, col, static_cast<BYTE>(alpha) * 255 / 100, LWA_ALPHA);
+    if (alpha == mAlpha)
+        return;
+
+    mAlpha = alpha;
+    mDirty |= DirtyOpacity;
+    Commit();
+}
+
+void NotificationWindow::Commit()
+{
+    // Moves only touch the window position, the layered surface is reused by the compositor as is.
+    // Resizes always come with dirty content, so they are the only geometry changes that redraw.
+    if (mDirty & DirtyGeometry)
+    {
+        UINT flags = SWP_NOZORDER | SWP_NOACTIVATE;
+        if (!(mDirty & DirtyContent))
+            flags |= SWP_NOSIZE | SWP_NOREDRAW;
+        SetWindowPos(mHwnd, 0, mX, mY, mWidth, mHeight, flags);
+    }
+
+    // Fades only touch the layered window attributes
+    if (mDirty & DirtyOpacity)
+    {
+        COLORREF col = {0};
+        SetLayeredWindowAttributes(mHwnd, col, static_cast<BYTE>(mAlpha * 255 / 100), LWA_ALPHA);
+    }
+
+    // Only the changes that reach the window count as updates of the animation frame that caused them
+    if (mDirty & (DirtyGeometry | DirtyOpacity))
+        FrameTiming::CountWindowUpdate();
+
+    // Content changes are rendered on the next WM_PAINT, so the flag is cleared there
+    if (mDirty & DirtyContent)
+        InvalidateRect(mHwnd, nullptr, FALSE);
+
+    mDirty &= DirtyContent;
+}
+
+unsigned long NotificationWindow::GetContentRepaintCount() const
+{
+    return mContentRepaints;
 }
 
 void NotificationWindow::OnPaint()
 {
+    TRACE_SCOPE("NotificationWindow::OnPaint");
+    ScopedTimer timer(paintTime);
+
     // Begin Paint
     PAINTSTRUCT ps;
     HDC hdc = BeginPaint(mHwnd, &ps);
@@ -125,13 +222,40 @@ void NotificationWindow::OnPaint()
     int width = clientRect.right - clientRect.left;
     int height = clientRect.bottom - clientRect.top;
 
+    // Render the content only if it changed, plain exposes just copy the cached bitmap
+    if ((mDirty & DirtyContent) || !mContentBmp)
+    {
+        RenderContent(hdc, width, height);
+        mDirty &= ~DirtyContent;
+    }
+
+    // Copy the cached content to the dc obtained by BeginPaint
+    HDC hMemDC = CreateCompatibleDC(hdc);
+    HGDIOBJ oldBmp = SelectObject(hMemDC, mContentBmp);
+    BitBlt(hdc, 0, 0, width, height, hMemDC, 0, 0, SRCCOPY);
+    SelectObject(hMemDC, oldBmp);
+    DeleteDC(hMemDC);
+
+    // End Paint
+    EndPaint(mHwnd, &ps);
+}
+
+void NotificationWindow::RenderContent(HDC hdc, int width, int height)
+{
+    TRACE_SCOPE("NotificationWindow::RenderContent");
+    RECT clientRect;
+    SetRect(&clientRect, 0, 0, width, height);
+
     // Change device mapping mode for better font rendering
     SetMapMode(hdc, MM_TEXT);
 
-    // Create memory bitmap
+    // Create the content bitmap once, it is kept for the whole window lifetime
+    if (!mContentBmp)
+        mContentBmp = CreateCompatibleBitmap(hdc, width, height);
+
+    // Create memory dc
     HDC hMemDC = CreateCompatibleDC(hdc);
-    HBITMAP hBmp = CreateCompatibleBitmap(hdc, width, height);
-    SelectObject(hMemDC, hBmp);
+    HGDIOBJ oldBmp = SelectObject(hMemDC, mContentBmp);
 
     // =
     // Actual draw operations start here
@@ -179,18 +303,29 @@ void NotificationWindow::OnPaint()
     SelectObject(hMemDC, oldFont);
     DeleteObject(font);
 
+    // Draw the duplicate count badge in the top right corner
+    if (mCount > 1)
+    {
+        std::wstring badge = L"x" + std::to_wstring(mCount);
+        RECT badgeRect = clientRect;
+        InflateRect(&badgeRect, -4, -4);
+        HFONT badgeFont = CreateFont(fontHeight / 4, 0, 0, 0, FW_BOLD, 0, 0, 0, DEFAULT_CHARSET, OUT_TT_ONLY_PRECIS, CLIP_DEFAULT_PRECIS, CLEARTYPE_QUALITY, VARIABLE_PITCH, L"Consolas");
+        HGDIOBJ oldBadgeFont = SelectObject(hMemDC, badgeFont);
+        prevBkMode = SetBkMode(hMemDC, TRANSPARENT);
+        DrawText(hMemDC, badge.c_str(), -1, &badgeRect, DT_RIGHT | DT_TOP | DT_SINGLELINE);
+        SetBkMode(hMemDC, prevBkMode);
+        SelectObject(hMemDC, oldBadgeFont);
+        DeleteObject(badgeFont);
+    }
+
     // Actual draw operations end here
     // =
 
-    // Copy memory context to the dc obtained by BeginPaint
-    BitBlt(hdc, 0, 0, width, height, hMemDC, 0, 0, SRCCOPY);
-
     // Free allocated resources
+    SelectObject(hMemDC, oldBmp);
     DeleteDC(hMemDC);
-    DeleteObject(hBmp);
 
-    // End Paint
-    EndPaint(mHwnd, &ps);
+    ++mContentRepaints;
 }
 
 LRESULT CALLBACK NotificationWindow::MessageHandler(HWND hh, UINT mm, WPARAM ww, LPARAM ll)
@@ -204,7 +339,7 @@ LRESULT CALLBACK NotificationWindow::MessageHandler(HWND hh, UINT mm, WPARAM ww,
 
             // Set opacity
             COLORREF col = {0};
-            SetLayeredWindowAttributes(hh, col, 127, LWA_ALPHA);
+            SetLayeredWindowAttributes(hh, col, static_cast<BYTE>(mAlpha * 255 / 100), LWA_ALPHA);
             break;
         }
         case WM_ERASEBKGND:
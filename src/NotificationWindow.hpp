@@ -7,6 +7,15 @@
 class NotificationWindow : public UIElement
 {
     public:
+        /// The parts of the window state that can be invalidated independently
+        enum DirtyFlags : unsigned int
+        {
+            DirtyNone     = 0,
+            DirtyContent  = 1 << 0,
+            DirtyGeometry = 1 << 1,
+            DirtyOpacity  = 1 << 2
+        };
+
         /// Constructor
         NotificationWindow();
 
@@ -16,6 +25,9 @@ class NotificationWindow : public UIElement
         /// Sets the notification message
         void SetMessage(const std::string& msg);
 
+        /// Sets the number of merged duplicates shown in the corner badge, no badge is drawn for 1
+        void SetCount(unsigned int count);
+
         /// Sets the visibility of teh notification window
         void Show(bool s);
 
@@ -25,12 +37,21 @@ class NotificationWindow : public UIElement
         /// Sets the notification window position
         void SetPosition(int x, int y);
 
+        /// Sets the notification window size, invalidating its content
+        void SetSize(int width, int height);
+
         /// Retrieves the notification window alpha value (as a percentage)
         unsigned int GetAlpha() const;
 
         /// Sets the notification window alpha value (as a percentage)
         void SetAlpha(unsigned int alpha);
 
+        /// Pushes the pending geometry and opacity changes to the window and invalidates it if its content changed
+        void Commit();
+
+        /// Retrieves the number of times the window content has been rendered
+        unsigned long GetContentRepaintCount() const;
+
     private:
         /// Registers the window class used to create notification windows
         bool Register();
@@ -44,18 +65,41 @@ class NotificationWindow : public UIElement
         /// Called by WM_PAINT message in the WndProc to do the window drawing
         void OnPaint();
 
+        /// Renders the window content to the cached content bitmap
+        void RenderContent(HDC hdc, int width, int height);
+
         /// The WndProc
         LRESULT CALLBACK MessageHandler(HWND hh, UINT mm, WPARAM ww, LPARAM ll);
 
         /// The message assosiated with the current NotificationWindow
         std::string mMessage;
 
+        /// The number of merged duplicates of the message
+        unsigned int mCount;
+
         /// Handle to current window
         HWND mHwnd;
 
+        /// The last rendered window content, blitted as is while the content is not dirty
+        HBITMAP mContentBmp;
+
+        /// The cached window position
+        int mX, mY;
+
+        /// The cached window size
+        int mWidth, mHeight;
+
+        /// The cached window alpha value (as a percentage)
+        unsigned int mAlpha;
+
+        /// The combination of DirtyFlags that have not been pushed to the window yet
+        unsigned int mDirty;
+
+        /// Counts the content renders, position and alpha changes must never increase it
+        unsigned long mContentRepaints;
+
         /// The class name associated with the notification windows
         static const TCHAR* wndClassName;
 };
 
 #endif
-
@@ -0,0 +1,231 @@
+#include "Protocol.hpp"
+#include <algorithm>
+
+// The first two bytes of every frame
+static const unsigned char frameMagic[2] = { 0xFE, 'N' };
+
+// The default lifetime of the notifications whose request does not have one
+static const std::uint32_t defaultLifetime = 3000;
+
+static std::uint16_t ReadU16(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<std::uint16_t>(u[0] | (u[1] << 8));
+}
+
+static std::uint32_t ReadU32(const char* p)
+{
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<std::uint32_t>(u[0]) | (static_cast<std::uint32_t>(u[1]) << 8)
+         | (static_cast<std::uint32_t>(u[2]) << 16) | (static_cast<std::uint32_t>(u[3]) << 24);
+}
+
+static void WriteU16(std::string& out, std::uint16_t v)
+{
+    out.push_back(static_cast<char>(v & 0xFF));
+    out.push_back(static_cast<char>(v >> 8));
+}
+
+static void WriteU32(std::string& out, std::uint32_t v)
+{
+    for (int i = 0; i < 4; ++i)
+        out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+// The largest value a TLV field can carry, its length is 2 bytes
+static const std::size_t maxFieldSize = 0xFFFF;
+
+// Retrieves how much of the given UTF-8 string fits in the given number of bytes without splitting a character
+static std::size_t FitUtf8(const std::string& s, std::size_t limit)
+{
+    if (s.size() <= limit)
+        return s.size();
+    std::size_t size = limit;
+    while (size != 0 && (static_cast<unsigned char>(s[size]) & 0xC0) == 0x80)
+        --size;
+    return size;
+}
+
+// The value must fit in maxFieldSize, the length would wrap otherwise
+static void WriteField(std::string& out, FieldTag tag, const char* value, std::size_t size)
+{
+    out.push_back(static_cast<char>(tag));
+    WriteU16(out, static_cast<std::uint16_t>(size));
+    out.append(value, size);
+}
+
+static void WriteHeader(std::string& out, FrameType type, std::uint16_t flags)
+{
+    out.push_back(static_cast<char>(frameMagic[0]));
+    out.push_back(static_cast<char>(frameMagic[1]));
+    out.push_back(static_cast<char>(ProtocolVersion));
+    out.push_back(static_cast<char>(type));
+    WriteU16(out, flags);
+    WriteU32(out, 0);
+}
+
+// Patches the payload length into the header once the payload is written
+static void FinishFrame(std::string& out)
+{
+    std::uint32_t length = static_cast<std::uint32_t>(out.size() - FrameHeaderSize);
+    for (int i = 0; i < 4; ++i)
+        out[6 + i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+}
+
+bool IsFrameStart(Slice in)
+{
+    if (in.Empty())
+        return false;
+    if (static_cast<unsigned char>(in[0]) != frameMagic[0])
+        return false;
+    return in.size < 2 || static_cast<unsigned char>(in[1]) == frameMagic[1];
+}
+
+FrameStatus ParseFrameHeader(Slice in, FrameHeader& h)
+{
+    if (in.size < FrameHeaderSize)
+        return IsFrameStart(in) ? FrameStatus::Incomplete : FrameStatus::Invalid;
+    if (!IsFrameStart(in))
+        return FrameStatus::Invalid;
+
+    h.version = static_cast<std::uint8_t>(in[2]);
+    h.type = static_cast<FrameType>(in[3]);
+    h.flags = ReadU16(in.data + 4);
+    h.length = ReadU32(in.data + 6);
+
+    // Newer versions must stay backwards compatible, so only the length has to be sane
+    if (h.version == 0 || h.length > MaxFramePayload)
+        return FrameStatus::Invalid;
+    return in.size - FrameHeaderSize < h.length ? FrameStatus::Incomplete : FrameStatus::Ready;
+}
+
+bool ParseNotifyFrame(Slice payload, NotifyFrame& f)
+{
+    f.text = Slice();
+    f.dedupKey = Slice();
+    f.lifetime = defaultLifetime;
+    f.priority = Priority::Normal;
+    f.requestId = 0;
+    f.hasRequestId = false;
+    f.ack = AckMode::Accepted;
+
+    while (!payload.Empty())
+    {
+        if (payload.size < 3)
+            return false;
+        FieldTag tag = static_cast<FieldTag>(payload[0]);
+        std::uint16_t length = ReadU16(payload.data + 1);
+        if (payload.size - 3 < length)
+            return false;
+        Slice value(payload.data + 3, length);
+        payload = payload.Skip(3 + static_cast<std::size_t>(length));
+
+        switch (tag)
+        {
+            case FieldTag::Text:
+                f.text = value;
+                break;
+            case FieldTag::DedupKey:
+                f.dedupKey = value;
+                break;
+            case FieldTag::Lifetime:
+            {
+                if (value.size != 4)
+                    return false;
+                f.lifetime = ReadU32(value.data);
+                break;
+            }
+            case FieldTag::Priority:
+            {
+                if (value.size != 1 || static_cast<unsigned char>(value[0]) >= PriorityLevels)
+                    return false;
+                f.priority = static_cast<Priority>(value[0]);
+                break;
+            }
+            case FieldTag::RequestId:
+            {
+                if (value.size != 4)
+                    return false;
+                f.requestId = ReadU32(value.data);
+                f.hasRequestId = true;
+                break;
+            }
+            case FieldTag::AckMode:
+            {
+                if (value.size != 1 || static_cast<unsigned char>(value[0]) > static_cast<unsigned char>(AckMode::Displayed))
+                    return false;
+                f.ack = static_cast<AckMode>(value[0]);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+NotificationData ToNotificationData(const NotifyFrame& f, AckFormat format)
+{
+    NotificationData data;
+    data.msg = f.text.ToString();
+    data.lifetime = f.lifetime;
+    data.priority = f.priority;
+    data.dedupKey = f.dedupKey.ToString();
+    data.ack.requestId = f.requestId;
+    data.ack.hasRequestId = f.hasRequestId;
+    data.ack.mode = f.ack;
+    data.ack.format = format;
+    return data;
+}
+
+std::string EncodeNotifyFrame(const NotificationData& data, std::uint32_t requestId, std::uint16_t flags)
+{
+    // The text and then the key are cut to what fits next to the fixed size fields, a frame the server would refuse
+    // as too large, or whose field lengths wrapped, would break the connection for every request behind it
+    const std::size_t fixedSize = 3 + 4 + 3 + 1 + 3 + 4;
+    std::size_t room = MaxFramePayload - fixedSize - 3 - (data.dedupKey.empty() ? 0 : 3);
+    std::size_t textSize = FitUtf8(data.msg, std::min(maxFieldSize, room));
+    std::size_t keySize = FitUtf8(data.dedupKey, std::min(maxFieldSize, room - textSize));
+
+    std::string out;
+    out.reserve(FrameHeaderSize + fixedSize + 3 + textSize + 3 + keySize);
+    WriteHeader(out, FrameType::Notify, flags);
+
+    WriteField(out, FieldTag::Text, data.msg.data(), textSize);
+    if (!data.dedupKey.empty())
+        WriteField(out, FieldTag::DedupKey, data.dedupKey.data(), keySize);
+
+    std::string lifetime;
+    WriteU32(lifetime, data.lifetime);
+    WriteField(out, FieldTag::Lifetime, lifetime.data(), lifetime.size());
+
+    char priority = static_cast<char>(data.priority);
+    WriteField(out, FieldTag::Priority, &priority, 1);
+
+    std::string id;
+    WriteU32(id, requestId);
+    WriteField(out, FieldTag::RequestId, id.data(), id.size());
+
+    FinishFrame(out);
+    return out;
+}
+
+std::string EncodeAckFrame(const AckTarget& target, AckStatus status)
+{
+    std::string out;
+    out.reserve(FrameHeaderSize + 2 * 3 + 5);
+    WriteHeader(out, FrameType::Ack, 0);
+
+    if (target.hasRequestId)
+    {
+        std::string id;
+        WriteU32(id, target.requestId);
+        WriteField(out, FieldTag::RequestId, id.data(), id.size());
+    }
+
+    char s = static_cast<char>(status);
+    WriteField(out, FieldTag::Status, &s, 1);
+
+    FinishFrame(out);
+    return out;
+}
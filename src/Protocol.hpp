@@ -0,0 +1,159 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _PROTOCOL_HPP_
+#define _PROTOCOL_HPP_
+
+#include <cstdint>
+#include <string>
+#include "NotificationData.hpp"
+#include "Slice.hpp"
+
+//
+// The binary wire protocol.
+// Every frame starts with a fixed little endian header:
+//
+//   offset  size  field
+//        0     2  magic, 0xFE 'N' (0xFE never appears in UTF-8 text, so frames and text requests can share a connection)
+//        2     1  version
+//        3     1  frame type
+//        4     2  flags
+//        6     4  payload length
+//
+// The payload is a sequence of TLV fields, each one a 1 byte tag, a 2 byte
+// little endian length and the value. Unknown tags are skipped, so newer
+// clients can add fields without breaking older servers.
+//
+
+/// The frame header size in bytes
+static const std::size_t FrameHeaderSize = 10;
+
+/// The largest accepted frame payload in bytes
+static const std::size_t MaxFramePayload = 64 * 1024;
+
+/// The protocol version spoken by the server
+static const std::uint8_t ProtocolVersion = 1;
+
+/// The frame types
+enum class FrameType : std::uint8_t
+{
+    /// A notification request, client to server
+    Notify = 1,
+
+    /// The acknowledgement of a notification request, server to client
+    Ack = 2
+};
+
+/// The frame header flags
+enum FrameFlags : std::uint16_t
+{
+    /// The client does not want an acknowledgement for the request, same as the none ack mode
+    FlagNoAck = 1 << 0
+};
+
+/// The TLV field tags
+enum class FieldTag : std::uint8_t
+{
+    /// The notification text, UTF-8
+    Text = 1,
+
+    /// The notification lifetime in milliseconds, 4 bytes
+    Lifetime = 2,
+
+    /// The notification priority, 1 byte
+    Priority = 3,
+
+    /// The deduplication key, UTF-8
+    DedupKey = 4,
+
+    /// The client chosen request id echoed in the acknowledgement, 4 bytes
+    RequestId = 5,
+
+    /// The acknowledgement status, 1 byte
+    Status = 6,
+
+    /// The acknowledgement mode, 1 byte, accepted if missing
+    AckMode = 7
+};
+
+/// The result of looking for a frame at the start of a buffer
+enum class FrameStatus
+{
+    /// More bytes are needed to tell
+    Incomplete,
+
+    /// A whole frame is available
+    Ready,
+
+    /// The bytes are not a frame this server can handle
+    Invalid
+};
+
+/// The decoded frame header
+struct FrameHeader
+{
+    std::uint8_t version;
+    FrameType type;
+    std::uint16_t flags;
+    std::uint32_t length;
+};
+
+/// The fields of a notification request, the slices point into the receive buffer
+struct NotifyFrame
+{
+    Slice text;
+    Slice dedupKey;
+    std::uint32_t lifetime;
+    Priority priority;
+    std::uint32_t requestId;
+    bool hasRequestId;
+    AckMode ack;
+};
+
+/// Checks whether the given bytes start like a frame
+bool IsFrameStart(Slice in);
+
+/// Decodes the frame header at the start of the given bytes, Ready means that the whole payload is available as well
+FrameStatus ParseFrameHeader(Slice in, FrameHeader& h);
+
+/// Decodes the TLV fields of a notification request payload, returns false if the payload is malformed
+bool ParseNotifyFrame(Slice payload, NotifyFrame& f);
+
+/// Copies the fields of a decoded notification request to a NotificationData, the ack connection is left empty
+NotificationData ToNotificationData(const NotifyFrame& f, AckFormat format);
+
+/// Encodes a notification request frame. A text or key too long for a frame is cut at a character boundary,
+/// the text first getting its share, so that the frame never exceeds MaxFramePayload
+std::string EncodeNotifyFrame(const NotificationData& data, std::uint32_t requestId, std::uint16_t flags = 0);
+
+/// Encodes the acknowledgement frame of a request
+std::string EncodeAckFrame(const AckTarget& target, AckStatus status);
+
+#endif // ! _PROTOCOL_HPP_
@@ -0,0 +1,216 @@
+#include "SearchIndex.hpp"
+#include <algorithm>
+
+// The number of ids of a posting list block
+static const std::uint32_t blockSize = 64;
+
+static void WriteVarint(std::string& out, std::uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+static std::uint32_t ReadVarint(const char*& p)
+{
+    std::uint32_t v = 0;
+    for (int shift = 0; ; shift += 7)
+    {
+        std::uint32_t b = static_cast<unsigned char>(*p++);
+        v |= (b & 0x7F) << shift;
+        if (b < 0x80)
+            return v;
+    }
+}
+
+std::vector<SearchTerm> ParseSearch(const std::string& search)
+{
+    std::vector<SearchTerm> terms;
+    std::size_t pos = 0;
+    while (pos < search.size())
+    {
+        // Every whitespace separated part may end with a *, that makes its last word a prefix
+        std::size_t end = search.find_first_of(" \t\r\n", pos);
+        if (end == std::string::npos)
+            end = search.size();
+        std::string part = search.substr(pos, end - pos);
+        pos = end + 1;
+
+        bool prefix = !part.empty() && part.back() == '*';
+        std::size_t first = terms.size();
+        ForEachWord(Slice(part.data(), part.size()), [&terms](const std::string& word) { terms.push_back(SearchTerm{word, false}); });
+        if (prefix && terms.size() != first)
+            terms.back().prefix = true;
+    }
+
+    // A repeated word adds nothing
+    std::sort(terms.begin(), terms.end(),
+        [](const SearchTerm& a, const SearchTerm& b) { return a.word < b.word || (a.word == b.word && a.prefix < b.prefix); });
+    terms.erase(std::unique(terms.begin(), terms.end(),
+        [](const SearchTerm& a, const SearchTerm& b) { return a.word == b.word && a.prefix == b.prefix; }), terms.end());
+    return terms;
+}
+
+///==============================================================
+///= PostingList
+///==============================================================
+
+PostingList::PostingList()
+    : mLast(0),
+      mSize(0)
+{
+}
+
+void PostingList::Add(std::uint32_t id)
+{
+    if (mSize != 0 && id <= mLast)
+        return;
+
+    // The first id of a block is kept in the skip list only, the gaps follow it
+    if (mSize % blockSize == 0)
+        mSkips.push_back(Skip{id, static_cast<std::uint32_t>(mBytes.size())});
+    else
+        WriteVarint(mBytes, id - mLast);
+    mLast = id;
+    ++mSize;
+}
+
+void PostingList::Shrink()
+{
+    mBytes.shrink_to_fit();
+    mSkips.shrink_to_fit();
+}
+
+std::uint32_t PostingList::Size() const
+{
+    return mSize;
+}
+
+std::size_t PostingList::GetMemoryUsage() const
+{
+    return sizeof(*this) + mBytes.capacity() + mSkips.capacity() * sizeof(Skip);
+}
+
+PostingList::Cursor::Cursor(const PostingList& list)
+    : mList(list),
+      mBlockIndex(list.mSkips.size())
+{
+    mBlock.reserve(blockSize);
+}
+
+void PostingList::Cursor::Decode(std::size_t block)
+{
+    const auto& skips = mList.mSkips;
+    std::uint32_t count = block + 1 == skips.size() ? (mList.mSize - 1) % blockSize + 1 : blockSize;
+    const char* p = mList.mBytes.data() + skips[block].position;
+    std::uint32_t id = skips[block].first;
+
+    mBlock.clear();
+    mBlock.push_back(id);
+    for (std::uint32_t i = 1; i < count; ++i)
+    {
+        id += ReadVarint(p);
+        mBlock.push_back(id);
+    }
+    mBlockIndex = block;
+}
+
+bool PostingList::Cursor::SeekDown(std::uint32_t bound, std::uint32_t& id)
+{
+    // The block of the bound is the last one that starts at or before it
+    const auto& skips = mList.mSkips;
+    auto skip = std::upper_bound(skips.begin(), skips.end(), bound,
+        [](std::uint32_t b, const Skip& s) { return b < s.first; });
+    if (skip == skips.begin())
+        return false;
+
+    std::size_t block = static_cast<std::size_t>(skip - skips.begin()) - 1;
+    if (block != mBlockIndex)
+        Decode(block);
+    id = *(std::upper_bound(mBlock.begin(), mBlock.end(), bound) - 1);
+    return true;
+}
+
+///==============================================================
+///= SearchIndex
+///==============================================================
+
+SearchIndex::SearchIndex()
+    : mMemoryUsage(0)
+{
+}
+
+void SearchIndex::Add(std::uint32_t id, Slice text)
+{
+    ForEachWord(text, [this, id](const std::string& word) { AddWord(id, word); });
+}
+
+void SearchIndex::AddWord(std::uint32_t id, const std::string& word)
+{
+    auto it = mWords.find(word);
+    if (it == mWords.end())
+    {
+        it = mWords.emplace(word, PostingList()).first;
+        mMemoryUsage += sizeof(WordMap::value_type) + word.capacity() + sizeof(void*) * 2;
+    }
+    it->second.Add(id);
+}
+
+void SearchIndex::Seal()
+{
+    mSorted.clear();
+    mSorted.reserve(mWords.size());
+    for (auto& w : mWords)
+    {
+        w.second.Shrink();
+        mSorted.push_back(&w);
+    }
+    std::sort(mSorted.begin(), mSorted.end(),
+        [](const WordMap::value_type* a, const WordMap::value_type* b) { return a->first < b->first; });
+}
+
+std::vector<const PostingList*> SearchIndex::Find(const SearchTerm& term) const
+{
+    std::vector<const PostingList*> lists;
+    if (!term.prefix)
+    {
+        auto it = mWords.find(term.word);
+        if (it != mWords.end())
+            lists.push_back(&it->second);
+        return lists;
+    }
+
+    auto matches = [&term](const std::string& word) { return word.compare(0, term.word.size(), term.word) == 0; };
+    if (!mSorted.empty() || mWords.empty())
+    {
+        auto it = std::lower_bound(mSorted.begin(), mSorted.end(), term.word,
+            [](const WordMap::value_type* w, const std::string& word) { return w->first < word; });
+        for (; it != mSorted.end() && matches((*it)->first) && lists.size() < SearchMaxExpansions; ++it)
+            lists.push_back(&(*it)->second);
+        return lists;
+    }
+
+    for (const auto& w : mWords)
+        if (matches(w.first))
+            lists.push_back(&w.second);
+
+    if (lists.size() > SearchMaxExpansions)
+        lists.resize(SearchMaxExpansions);
+    return lists;
+}
+
+std::size_t SearchIndex::GetWordCount() const
+{
+    return mWords.size();
+}
+
+std::size_t SearchIndex::GetMemoryUsage() const
+{
+    std::size_t usage = mMemoryUsage + mWords.bucket_count() * sizeof(void*) + mSorted.capacity() * sizeof(void*);
+    for (const auto& w : mWords)
+        usage += w.second.GetMemoryUsage() - sizeof(PostingList);
+    return usage;
+}
@@ -0,0 +1,199 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _SEARCH_INDEX_HPP_
+#define _SEARCH_INDEX_HPP_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Slice.hpp"
+
+/// The longest indexed word in bytes, longer words are cut
+static const std::size_t SearchMaxWordLength = 32;
+
+/// The largest number of words a prefix may stand for in a segment, the words past it are ignored
+static const std::size_t SearchMaxExpansions = 4096;
+
+/// A word of a search, matching the words that start with it if it is a prefix
+struct SearchTerm
+{
+    std::string word;
+    bool prefix;
+};
+
+/// Splits the given text into lowercase words, letters and digits of ASCII and any byte of a multibyte UTF-8 sequence
+/// make up the words, everything else separates them
+template<typename F>
+void ForEachWord(Slice text, F f);
+
+/// Splits a search into its words, a word followed by * is a prefix
+std::vector<SearchTerm> ParseSearch(const std::string& search);
+
+//
+// Sorted list of document ids, the documents that contain a word. The
+// ids are stored as varint encoded gaps, so the frequent words take a
+// byte or so per document. Every 64th id is kept in a skip list along
+// with the position of the gaps that follow it, so a cursor can jump
+// to the block of any id and decode only that block.
+//
+
+class PostingList
+{
+    public:
+        /// Constructor
+        PostingList();
+
+        /// Appends an id, ids must come in increasing order and repeated ids are ignored
+        void Add(std::uint32_t id);
+
+        /// Releases the spare capacity once no more ids are added
+        void Shrink();
+
+        /// Retrieves the number of ids
+        std::uint32_t Size() const;
+
+        /// Retrieves the bytes used by the list
+        std::size_t GetMemoryUsage() const;
+
+        /// Walks a list from its largest id down
+        class Cursor
+        {
+            public:
+                /// Constructor
+                explicit Cursor(const PostingList& list);
+
+                /// Finds the largest id of the list that is not above the given id, returns false if there is none.
+                /// Cheapest when the given ids only go down, so that a decoded block serves several calls
+                bool SeekDown(std::uint32_t bound, std::uint32_t& id);
+
+            private:
+                /// Decodes the given block into mBlock
+                void Decode(std::size_t block);
+
+                const PostingList& mList;
+                std::vector<std::uint32_t> mBlock;
+                std::size_t mBlockIndex;
+        };
+
+    private:
+        /// The first id of a block and the position of the gaps after it
+        struct Skip
+        {
+            std::uint32_t first;
+            std::uint32_t position;
+        };
+
+        /// The varint encoded gaps
+        std::string mBytes;
+
+        /// The first id of every block
+        std::vector<Skip> mSkips;
+
+        /// The last id and the number of ids
+        std::uint32_t mLast;
+        std::uint32_t mSize;
+};
+
+//
+// Inverted index of a set of documents, the records of a history
+// segment. Documents are added in increasing id order as they come.
+// Once sealed the words are sorted, so that a prefix finds its words
+// with a binary search; until then a prefix looks at every word.
+//
+
+class SearchIndex
+{
+    public:
+        /// Constructor
+        SearchIndex();
+
+        /// Indexes the words of the given text under the given document id
+        void Add(std::uint32_t id, Slice text);
+
+        /// Indexes the given word as it is under the given document id
+        void AddWord(std::uint32_t id, const std::string& word);
+
+        /// Sorts the words once no more documents are added
+        void Seal();
+
+        /// Retrieves the lists of the words the given term matches, empty if none does
+        std::vector<const PostingList*> Find(const SearchTerm& term) const;
+
+        /// Retrieves the number of distinct words
+        std::size_t GetWordCount() const;
+
+        /// Retrieves the approximate bytes used by the index
+        std::size_t GetMemoryUsage() const;
+
+    private:
+        typedef std::unordered_map<std::string, PostingList> WordMap;
+
+        /// The posting list of every word
+        WordMap mWords;
+
+        /// The words in order, filled by Seal
+        std::vector<const WordMap::value_type*> mSorted;
+
+        /// The bytes used by the words and their lists
+        std::size_t mMemoryUsage;
+};
+
+template<typename F>
+void ForEachWord(Slice text, F f)
+{
+    std::string word;
+    word.reserve(SearchMaxWordLength);
+    for (char c : text)
+    {
+        unsigned char u = static_cast<unsigned char>(c);
+        bool letter = (u >= '0' && u <= '9') || (u >= 'a' && u <= 'z') || u >= 0x80;
+        if (u >= 'A' && u <= 'Z')
+        {
+            u = static_cast<unsigned char>(u - 'A' + 'a');
+            letter = true;
+        }
+        if (letter)
+        {
+            if (word.size() < SearchMaxWordLength)
+                word.push_back(static_cast<char>(u));
+        }
+        else if (!word.empty())
+        {
+            f(word);
+            word.clear();
+        }
+    }
+    if (!word.empty())
+        f(word);
+}
+
+#endif // ! _SEARCH_INDEX_HPP_
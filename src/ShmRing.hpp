@@ -0,0 +1,555 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _SHM_RING_HPP_
+#define _SHM_RING_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//
+// Single producer single consumer ring buffer in shared memory, the
+// transport of the local producers that send too many notifications
+// for a socket. This header is all a producer needs:
+//
+//   ShmRingProducer ring;
+//   if (ring.Open())
+//       ring.TryPush("[high] Build finished");
+//
+// Every record is one request in any of the server formats (text, JSON
+// or a binary frame), stored as a 4 byte length and the request bytes,
+// padded to 8 bytes. The producer owns the head counter and the consumer
+// the tail counter, both are byte positions that only grow, so the ring
+// is empty when they are equal. A record never wraps: when it does not
+// fit before the end of the ring, a padding record fills the rest.
+//
+// The consumer sets the waiting flag before it goes to sleep and checks
+// the ring once more, the producer checks the flag after publishing a
+// record, so the wakeup is a system call only when the consumer sleeps.
+// On Windows the wakeup is a named auto reset event. On Linux it is a
+// futex on the waiting flag itself: the futex is keyed by the shared
+// page rather than by the process, so a producer wakes a consumer in
+// another process, and the producer that clears the flag is the only one
+// that makes the wake call. Elsewhere the consumer polls.
+//
+// The consumer never trusts the shared memory: it keeps its own copy of
+// the capacity and the tail, and a head or a record length that points
+// outside the published bytes resets the ring, dropping what it held.
+// Only one consumer may own a ring name, a second server fails to create
+// it while the first one runs.
+//
+
+/// Identifies an initialized ring
+static const std::uint32_t ShmRingMagic = 0x5253464E;
+
+/// The ring layout version
+static const std::uint32_t ShmRingVersion = 1;
+
+/// The default ring data size in bytes, a power of two
+static const std::uint32_t ShmRingDefaultCapacity = 1 << 20;
+
+/// The default ring name
+static const char* const ShmRingDefaultName = "NewsFlashRing";
+
+/// The length that marks the padding record at the end of the ring
+static const std::uint32_t ShmRingPadding = 0xFFFFFFFF;
+
+/// The shared ring header, the data follows at ShmRingDataOffset
+struct ShmRingHeader
+{
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t capacity;
+    std::uint32_t reserved;
+
+    /// The producer position, on its own cache line so that the two sides do not share one
+    alignas(64) std::atomic<std::uint64_t> head;
+
+    /// The consumer position
+    alignas(64) std::atomic<std::uint64_t> tail;
+
+    /// Set while the consumer sleeps
+    alignas(64) std::atomic<std::uint32_t> consumerWaiting;
+
+    /// Set while a producer is attached, there may only be one
+    std::atomic<std::uint32_t> producerAttached;
+};
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "the waiting flag must be a plain word to be a futex");
+
+/// The offset of the ring data from the start of the shared memory
+static const std::size_t ShmRingDataOffset = (sizeof(ShmRingHeader) + 63) & ~static_cast<std::size_t>(63);
+
+/// The shared memory that holds a ring, created by the consumer and opened by the producer
+class ShmRegion
+{
+    public:
+        /// Constructor
+        ShmRegion() : mBase(nullptr), mSize(0)
+#if defined(_WIN32)
+            , mMapping(nullptr), mEvent(nullptr)
+#else
+            , mLockFd(-1)
+#endif
+        {}
+
+        /// Destructor
+        ~ShmRegion() { Close(); }
+
+        /// Disable copy construction
+        ShmRegion(const ShmRegion& rhs) = delete;
+        ShmRegion& operator=(const ShmRegion& rhs) = delete;
+
+        /// Creates the region and initializes an empty ring of the given capacity, a power of two of at least 8 bytes.
+        /// Fails if a running consumer owns a region of the same name
+        bool Create(const std::string& name, std::uint32_t capacity)
+        {
+            if (capacity < 8 || (capacity & (capacity - 1)) != 0)
+                return false;
+            if (!Map(name, ShmRingDataOffset + capacity, true))
+                return false;
+
+            ShmRingHeader* h = GetHeader();
+            h->capacity = capacity;
+            h->version = ShmRingVersion;
+            h->head.store(0);
+            h->tail.store(0);
+            h->consumerWaiting.store(0);
+            h->producerAttached.store(0);
+            std::atomic_thread_fence(std::memory_order_release);
+            h->magic = ShmRingMagic;
+            return true;
+        }
+
+        /// Opens a region created by Create
+        bool Open(const std::string& name)
+        {
+            // Map the header first to learn the capacity
+            if (!Map(name, ShmRingDataOffset, false))
+                return false;
+            ShmRingHeader* h = GetHeader();
+            std::uint32_t capacity = h->capacity;
+            bool valid = h->magic == ShmRingMagic && h->version == ShmRingVersion;
+            Close();
+            return valid && Map(name, ShmRingDataOffset + capacity, false);
+        }
+
+        /// Unmaps the region
+        void Close()
+        {
+#if defined(_WIN32)
+            if (mBase)
+                UnmapViewOfFile(mBase);
+            if (mMapping)
+                CloseHandle(mMapping);
+            if (mEvent)
+                CloseHandle(mEvent);
+            mMapping = nullptr;
+            mEvent = nullptr;
+#else
+            if (mBase)
+                munmap(mBase, mSize);
+            // The name is removed by its creator, the producers that are still attached keep their mapping
+            if (!mUnlinkName.empty())
+                shm_unlink(mUnlinkName.c_str());
+            mUnlinkName.clear();
+            if (mLockFd >= 0)
+                close(mLockFd);
+            mLockFd = -1;
+#endif
+            mBase = nullptr;
+            mSize = 0;
+        }
+
+        /// Checks whether the region is mapped
+        bool IsOpen() const { return mBase != nullptr; }
+
+        /// Retrieves the ring header
+        ShmRingHeader* GetHeader() const { return static_cast<ShmRingHeader*>(mBase); }
+
+        /// Retrieves the ring data
+        char* GetData() const { return static_cast<char*>(mBase) + ShmRingDataOffset; }
+
+        /// Wakes up the consumer
+        void Signal()
+        {
+#if defined(_WIN32)
+            SetEvent(mEvent);
+#elif defined(__linux__)
+            std::atomic<std::uint32_t>& waiting = GetHeader()->consumerWaiting;
+            if (waiting.exchange(0) != 0)
+                syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&waiting), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+        }
+
+#if defined(__linux__)
+        /// Sleeps until Signal clears the waiting flag, returns at once if it is clear
+        void Wait()
+        {
+            // The flag is shared with the producer, so any value it writes only ends the wait early, never spins it
+            std::atomic<std::uint32_t>& waiting = GetHeader()->consumerWaiting;
+            std::uint32_t value;
+            while ((value = waiting.load(std::memory_order_acquire)) != 0)
+                syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&waiting), FUTEX_WAIT, value, nullptr, nullptr, 0);
+        }
+#endif
+
+#if defined(_WIN32)
+        /// Hands the wakeup event over to the caller, who becomes responsible for closing it
+        HANDLE ReleaseEvent()
+        {
+            HANDLE e = mEvent;
+            mEvent = nullptr;
+            return e;
+        }
+#endif
+
+    private:
+        bool Map(const std::string& name, std::size_t size, bool create)
+        {
+#if defined(_WIN32)
+            std::string mappingName = "Local\\" + name;
+            std::string eventName = mappingName + "Event";
+            if (create)
+            {
+                // The mapping lives as long as a handle to it, so an existing one belongs to a running server
+                mMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, static_cast<DWORD>(size), mappingName.c_str());
+                if (mMapping && GetLastError() == ERROR_ALREADY_EXISTS)
+                {
+                    Close();
+                    return false;
+                }
+                mEvent = CreateEventA(nullptr, FALSE, FALSE, eventName.c_str());
+            }
+            else
+            {
+                mMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+                mEvent = OpenEventA(EVENT_MODIFY_STATE, FALSE, eventName.c_str());
+            }
+            if (mMapping)
+                mBase = MapViewOfFile(mMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+            std::string shmName = "/" + name;
+            int fd = create ? CreateObject(shmName) : shm_open(shmName.c_str(), O_RDWR, 0600);
+            if (fd < 0)
+                return false;
+            if (create)
+            {
+                mUnlinkName = shmName;
+                mLockFd = fd;
+                if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+                {
+                    Close();
+                    return false;
+                }
+            }
+            void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (!create)
+                close(fd);
+            mBase = p != MAP_FAILED ? p : nullptr;
+#endif
+            if (!mBase)
+            {
+                Close();
+                return false;
+            }
+            mSize = size;
+            return true;
+        }
+
+#if !defined(_WIN32)
+        /// Creates the shared memory object, locked for as long as the returned descriptor is open. Shared memory
+        /// objects outlive their processes here, so one whose lock is free was left behind by a server that is gone
+        /// and is replaced, while a locked one belongs to a running server and fails the call
+        static int CreateObject(const std::string& shmName)
+        {
+            for (int attempt = 0; attempt < 2; ++attempt)
+            {
+                int fd = shm_open(shmName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+                if (fd >= 0)
+                {
+                    if (flock(fd, LOCK_EX | LOCK_NB) == 0)
+                        return fd;
+                    close(fd);
+                    return -1;
+                }
+                if (errno != EEXIST)
+                    return -1;
+
+                fd = shm_open(shmName.c_str(), O_RDWR, 0600);
+                if (fd < 0)
+                    return -1;
+                bool stale = flock(fd, LOCK_EX | LOCK_NB) == 0;
+                close(fd);
+                if (!stale)
+                    return -1;
+                shm_unlink(shmName.c_str());
+            }
+            return -1;
+        }
+#endif
+
+        /// The mapped region
+        void* mBase;
+        std::size_t mSize;
+
+#if defined(_WIN32)
+        /// The mapping and the wakeup event handles
+        HANDLE mMapping;
+        HANDLE mEvent;
+#else
+        /// The name of the shared memory object and its locked descriptor if this region created it
+        std::string mUnlinkName;
+        int mLockFd;
+#endif
+};
+
+/// The writing side of a ring
+class ShmRingProducer
+{
+    public:
+        /// Destructor
+        ~ShmRingProducer() { Close(); }
+
+        /// Attaches to the ring with the given name, fails if it does not exist or has a producer already
+        bool Open(const std::string& name = ShmRingDefaultName)
+        {
+            if (!mRegion.Open(name))
+                return false;
+            std::uint32_t expected = 0;
+            if (!mRegion.GetHeader()->producerAttached.compare_exchange_strong(expected, 1))
+            {
+                mRegion.Close();
+                return false;
+            }
+            return true;
+        }
+
+        /// Detaches from the ring
+        void Close()
+        {
+            if (!mRegion.IsOpen())
+                return;
+            mRegion.GetHeader()->producerAttached.store(0);
+            mRegion.Close();
+        }
+
+        /// Appends a request to the ring, returns false if it does not fit until the consumer catches up
+        bool TryPush(const char* data, std::size_t size)
+        {
+            ShmRingHeader* h = mRegion.GetHeader();
+            std::uint64_t capacity = h->capacity;
+            std::uint64_t need = (4 + size + 7) & ~static_cast<std::uint64_t>(7);
+            if (need > capacity / 2)
+                return false;
+
+            std::uint64_t head = h->head.load(std::memory_order_relaxed);
+            std::uint64_t tail = h->tail.load(std::memory_order_acquire);
+            std::uint64_t offset = head & (capacity - 1);
+            std::uint64_t contiguous = capacity - offset;
+            std::uint64_t total = need <= contiguous ? need : contiguous + need;
+            if (head + total - tail > capacity)
+                return false;
+
+            char* ring = mRegion.GetData();
+            if (need > contiguous)
+            {
+                std::memcpy(ring + offset, &ShmRingPadding, 4);
+                head += contiguous;
+                offset = 0;
+            }
+            std::uint32_t length = static_cast<std::uint32_t>(size);
+            std::memcpy(ring + offset, &length, 4);
+            std::memcpy(ring + offset + 4, data, size);
+            h->head.store(head + need, std::memory_order_release);
+
+            // Pairs with the fence of the consumer between setting the waiting flag and checking the head
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (h->consumerWaiting.load(std::memory_order_relaxed) != 0)
+                mRegion.Signal();
+            return true;
+        }
+
+        /// Appends a request to the ring, returns false if it does not fit until the consumer catches up
+        bool TryPush(const std::string& request)
+        {
+            return TryPush(request.data(), request.size());
+        }
+
+    private:
+        /// The shared memory of the ring
+        ShmRegion mRegion;
+};
+
+/// The reading side of a ring
+class ShmRingConsumer
+{
+    public:
+        /// Constructor
+        ShmRingConsumer() : mCapacity(0), mTail(0), mResets(0) {}
+
+        /// Creates the ring with the given name and capacity, a power of two
+        bool Create(const std::string& name = ShmRingDefaultName, std::uint32_t capacity = ShmRingDefaultCapacity)
+        {
+            if (!mRegion.Create(name, capacity))
+                return false;
+            mCapacity = capacity;
+            mTail = 0;
+            return true;
+        }
+
+        /// Calls f(char* data, std::size_t size) for up to max records, returns the number of records read.
+        /// The record data may be modified by f, it is handed back to the producer once Drain returns
+        template<typename F>
+        std::size_t Drain(F f, std::size_t max)
+        {
+            ShmRingHeader* h = mRegion.GetHeader();
+            std::uint64_t capacity = mCapacity;
+            std::uint64_t tail = mTail;
+            std::uint64_t head = h->head.load(std::memory_order_acquire);
+            char* ring = mRegion.GetData();
+
+            // The head must be a record boundary no more than a ring ahead of the tail
+            if (head - tail > capacity || (head & 7) != 0)
+            {
+                Reset();
+                return 0;
+            }
+
+            std::size_t n = 0;
+            while (tail != head && n < max)
+            {
+                std::uint64_t offset = tail & (capacity - 1);
+                std::uint64_t available = head - tail;
+                std::uint32_t length;
+                std::memcpy(&length, ring + offset, 4);
+                std::uint64_t size = length == ShmRingPadding ? capacity - offset : (4 + static_cast<std::uint64_t>(length) + 7) & ~static_cast<std::uint64_t>(7);
+
+                // A record that runs past the end of the ring or past the head was never written by a sane producer
+                if (size > capacity - offset || size > available)
+                {
+                    mTail = tail;
+                    Reset();
+                    return n;
+                }
+                if (length != ShmRingPadding)
+                {
+                    f(ring + offset + 4, static_cast<std::size_t>(length));
+                    ++n;
+                }
+                tail += size;
+            }
+            mTail = tail;
+            h->tail.store(tail, std::memory_order_release);
+            return n;
+        }
+
+        /// Retrieves the number of times a malformed ring was reset
+        std::uint64_t GetResetCount() const { return mResets; }
+
+        /// Announces that the consumer is about to sleep, returns false if there are records to read after all
+        bool PrepareWait()
+        {
+            ShmRingHeader* h = mRegion.GetHeader();
+            h->consumerWaiting.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (h->head.load(std::memory_order_acquire) != mTail)
+            {
+                CancelWait();
+                return false;
+            }
+            return true;
+        }
+
+        /// Announces that the consumer is awake
+        void CancelWait()
+        {
+            mRegion.GetHeader()->consumerWaiting.store(0, std::memory_order_relaxed);
+        }
+
+#if defined(__linux__)
+        /// Sleeps after PrepareWait until the producer publishes a record or Wake is called
+        void Wait()
+        {
+            mRegion.Wait();
+        }
+
+        /// Ends a Wait of another thread, whether or not the ring holds records
+        void Wake()
+        {
+            mRegion.Signal();
+        }
+#endif
+
+        /// Retrieves the shared memory of the ring
+        ShmRegion& GetRegion() { return mRegion; }
+
+    private:
+        /// Drops every record the ring holds by moving the head of the producer back to the tail
+        void Reset()
+        {
+            ShmRingHeader* h = mRegion.GetHeader();
+            h->head.store(mTail, std::memory_order_relaxed);
+            h->tail.store(mTail, std::memory_order_release);
+            ++mResets;
+        }
+
+        /// The shared memory of the ring
+        ShmRegion mRegion;
+
+        /// The capacity and the position of the consumer, kept out of the reach of the producer
+        std::uint64_t mCapacity;
+        std::uint64_t mTail;
+
+        /// The number of times a malformed ring was reset
+        std::uint64_t mResets;
+};
+
+#endif // ! _SHM_RING_HPP_
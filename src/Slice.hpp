@@ -0,0 +1,70 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _SLICE_HPP_
+#define _SLICE_HPP_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+//
+// Non owning view of a byte range, used to hand out the fields of a
+// request straight out of the receive buffer. A Slice is only valid as
+// long as the buffer it points into is not modified or freed.
+//
+
+struct Slice
+{
+    const char* data;
+    std::size_t size;
+
+    Slice() : data(nullptr), size(0) {}
+    Slice(const char* d, std::size_t s) : data(d), size(s) {}
+
+    bool Empty() const { return size == 0; }
+    const char* begin() const { return data; }
+    const char* end() const { return data + size; }
+    char operator[](std::size_t i) const { return data[i]; }
+
+    /// Retrieves the slice without its first n bytes
+    Slice Skip(std::size_t n) const { return n < size ? Slice(data + n, size - n) : Slice(end(), 0); }
+
+    /// Retrieves the first n bytes of the slice
+    Slice Take(std::size_t n) const { return Slice(data, n < size ? n : size); }
+
+    /// Compares the slice content with the given null terminated string
+    bool Equals(const char* s) const { return std::strlen(s) == size && std::memcmp(data, s, size) == 0; }
+
+    /// Copies the slice content to an owning string
+    std::string ToString() const { return std::string(data, size); }
+};
+
+#endif // ! _SLICE_HPP_
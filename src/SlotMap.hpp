@@ -0,0 +1,242 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _SLOT_MAP_HPP_
+#define _SLOT_MAP_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Stable handle to an object stored in a SlotMap, stale once the object is erased
+struct SlotHandle
+{
+    std::uint32_t index;
+    std::uint32_t generation;
+};
+
+inline bool operator==(const SlotHandle& a, const SlotHandle& b) { return a.index == b.index && a.generation == b.generation; }
+inline bool operator!=(const SlotHandle& a, const SlotHandle& b) { return !(a == b); }
+
+//
+// Slab of in place constructed objects addressed by generational handles.
+// Storage grows in fixed size chunks so object addresses never change, and
+// erased slots are recycled through a free list, so once the slab has grown
+// to the working set size no more allocations take place.
+//
+
+template<typename T, std::size_t ChunkSize = 64>
+class SlotMap
+{
+    public:
+        /// Constructor
+        SlotMap();
+
+        /// Destructor
+        ~SlotMap();
+
+        /// Disable copying
+        SlotMap(const SlotMap&) = delete;
+        SlotMap& operator=(const SlotMap&) = delete;
+
+        /// Constructs a new object in a free slot and returns its handle
+        template<typename... Args>
+        SlotHandle Emplace(Args&&... args);
+
+        /// Destroys the object pointed by the given handle, does nothing if the handle is stale
+        void Erase(SlotHandle h);
+
+        /// Retrieves the object pointed by the given handle or nullptr if the handle is stale
+        T* Get(SlotHandle h) const;
+
+        /// Preallocates slots for at least the given number of objects
+        void Reserve(std::size_t n);
+
+        /// Retrieves the number of alive objects
+        std::size_t Size() const;
+
+        /// Destroys all the alive objects, keeping the allocated slots for reuse
+        void Clear();
+
+        /// The handle value that never points to an object
+        static const SlotHandle Null;
+
+    private:
+        struct Slot
+        {
+            /// Raw storage for the object
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+            /// Bumped every time the slot is freed, invalidating the outstanding handles
+            std::uint32_t generation;
+
+            /// Index of the next free slot while this one is free
+            std::uint32_t nextFree;
+
+            /// Whether the storage holds a constructed object
+            bool alive;
+        };
+
+        /// Retrieves the slot with the given index
+        Slot& At(std::uint32_t index) const;
+
+        /// Allocates one more chunk of slots and pushes them to the free list
+        void Grow();
+
+        /// The slot chunks
+        std::vector<std::unique_ptr<Slot[]>> mChunks;
+
+        /// Head of the free slot list
+        std::uint32_t mFreeHead;
+
+        /// Number of alive objects
+        std::size_t mSize;
+
+        /// Marks the end of the free list
+        static const std::uint32_t sNoSlot = 0xFFFFFFFF;
+};
+
+template<typename T, std::size_t ChunkSize>
+const SlotHandle SlotMap<T, ChunkSize>::Null = { 0xFFFFFFFF, 0 };
+
+template<typename T, std::size_t ChunkSize>
+SlotMap<T, ChunkSize>::SlotMap() : mFreeHead(sNoSlot), mSize(0)
+{
+}
+
+template<typename T, std::size_t ChunkSize>
+SlotMap<T, ChunkSize>::~SlotMap()
+{
+    Clear();
+}
+
+template<typename T, std::size_t ChunkSize>
+template<typename... Args>
+SlotHandle SlotMap<T, ChunkSize>::Emplace(Args&&... args)
+{
+    if (mFreeHead == sNoSlot)
+        Grow();
+
+    std::uint32_t index = mFreeHead;
+    Slot& s = At(index);
+    new (&s.storage) T(std::forward<Args>(args)...);
+    mFreeHead = s.nextFree;
+    s.alive = true;
+    ++mSize;
+
+    SlotHandle h = { index, s.generation };
+    return h;
+}
+
+template<typename T, std::size_t ChunkSize>
+void SlotMap<T, ChunkSize>::Erase(SlotHandle h)
+{
+    if (!Get(h))
+        return;
+
+    // Invalidate the slot before destroying the object so that the handle is already stale if the destructor reenters
+    Slot& s = At(h.index);
+    s.alive = false;
+    ++s.generation;
+    reinterpret_cast<T*>(&s.storage)->~T();
+
+    // Return the slot to the free list
+    s.nextFree = mFreeHead;
+    mFreeHead = h.index;
+    --mSize;
+}
+
+template<typename T, std::size_t ChunkSize>
+T* SlotMap<T, ChunkSize>::Get(SlotHandle h) const
+{
+    if (h.index >= mChunks.size() * ChunkSize)
+        return nullptr;
+
+    Slot& s = At(h.index);
+    if (!s.alive || s.generation != h.generation)
+        return nullptr;
+    return reinterpret_cast<T*>(&s.storage);
+}
+
+template<typename T, std::size_t ChunkSize>
+void SlotMap<T, ChunkSize>::Reserve(std::size_t n)
+{
+    while (mChunks.size() * ChunkSize < n)
+        Grow();
+}
+
+template<typename T, std::size_t ChunkSize>
+std::size_t SlotMap<T, ChunkSize>::Size() const
+{
+    return mSize;
+}
+
+template<typename T, std::size_t ChunkSize>
+void SlotMap<T, ChunkSize>::Clear()
+{
+    for (std::uint32_t i = 0; i < mChunks.size() * ChunkSize; ++i)
+    {
+        Slot& s = At(i);
+        if (s.alive)
+        {
+            SlotHandle h = { i, s.generation };
+            Erase(h);
+        }
+    }
+}
+
+template<typename T, std::size_t ChunkSize>
+auto SlotMap<T, ChunkSize>::At(std::uint32_t index) const -> Slot&
+{
+    return mChunks[index / ChunkSize][index % ChunkSize];
+}
+
+template<typename T, std::size_t ChunkSize>
+void SlotMap<T, ChunkSize>::Grow()
+{
+    std::uint32_t base = static_cast<std::uint32_t>(mChunks.size() * ChunkSize);
+    mChunks.emplace_back(new Slot[ChunkSize]);
+
+    // Link the new slots in index order in front of the current free list
+    Slot* chunk = mChunks.back().get();
+    for (std::size_t i = 0; i < ChunkSize; ++i)
+    {
+        chunk[i].generation = 0;
+        chunk[i].alive = false;
+        chunk[i].nextFree = (i + 1 < ChunkSize) ? base + static_cast<std::uint32_t>(i) + 1 : mFreeHead;
+    }
+    mFreeHead = base;
+}
+
+#endif // ! _SLOT_MAP_HPP_
@@ -0,0 +1,94 @@
+#include "StackLayout.hpp"
+#include <algorithm>
+
+StackLayout::StackLayout()
+{
+}
+
+void StackLayout::SetDisplays(const std::vector<DisplayInfo>& displays)
+{
+    mDisplays = displays;
+    Recompute();
+}
+
+void StackLayout::SetOptions(const LayoutOptions& options)
+{
+    mOptions = options;
+    Recompute();
+}
+
+const LayoutOptions& StackLayout::GetOptions() const
+{
+    return mOptions;
+}
+
+std::size_t StackLayout::GetCapacity() const
+{
+    return mSlots.size();
+}
+
+const SlotGeometry& StackLayout::GetSlot(std::size_t slot) const
+{
+    return mSlots[slot];
+}
+
+SlotGeometry StackLayout::GetEntrySlot() const
+{
+    if (mSlots.empty())
+    {
+        SlotGeometry g = { 0, 0, mOptions.width, mOptions.height, 0 };
+        return g;
+    }
+
+    SlotGeometry g = mSlots.front();
+    g.y -= g.height + Scale(mOptions.spacing, mDisplays[g.display].dpi);
+    return g;
+}
+
+void StackLayout::Recompute()
+{
+    mSlots.clear();
+
+    for (std::size_t d = 0; d < mDisplays.size(); ++d)
+    {
+        const DisplayInfo& disp = mDisplays[d];
+        int w = Scale(mOptions.width, disp.dpi);
+        int h = Scale(mOptions.height, disp.dpi);
+        int gap = Scale(mOptions.spacing, disp.dpi);
+        int margin = Scale(mOptions.margin, disp.dpi);
+
+        // Skip the displays that cannot fit a single notification
+        int areaW = disp.workArea.right - disp.workArea.left - 2 * margin;
+        int areaH = disp.workArea.bottom - disp.workArea.top - 2 * margin;
+        if (w <= 0 || h <= 0 || areaW < w || areaH < h)
+            continue;
+
+        int rows = (areaH + gap) / (h + gap);
+        int cols = std::min(static_cast<int>(mOptions.maxColumns), (areaW + gap) / (w + gap));
+
+        // Columns grow leftwards from the right edge, rows downwards from the top edge
+        for (int c = 0; c < cols; ++c)
+        {
+            for (int r = 0; r < rows; ++r)
+            {
+                if (mOptions.maxVisible != 0 && mSlots.size() == mOptions.maxVisible)
+                    return;
+
+                SlotGeometry g;
+                g.x = disp.workArea.right - margin - w - c * (w + gap);
+                g.y = disp.workArea.top + margin + r * (h + gap);
+                g.width = w;
+                g.height = h;
+                g.display = d;
+                mSlots.push_back(g);
+            }
+        }
+    }
+}
+
+int StackLayout::Scale(int dips, unsigned int dpi)
+{
+    if (dpi == 0)
+        return dips;
+    return static_cast<int>((static_cast<long long>(dips) * dpi + 48) / 96);
+}
@@ -0,0 +1,132 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _STACK_LAYOUT_HPP_
+#define _STACK_LAYOUT_HPP_
+
+#include <cstddef>
+#include <vector>
+
+/// A screen rectangle in physical pixels
+struct LayoutRect
+{
+    int left, top, right, bottom;
+};
+
+/// A display as seen by the layout, the first one is the one the stack starts from
+struct DisplayInfo
+{
+    /// The display area not covered by taskbars and docked toolbars
+    LayoutRect workArea;
+
+    /// The display dots per inch, 96 being 100% scaling
+    unsigned int dpi;
+};
+
+/// The stack geometry settings, sizes are given in device independent pixels (1/96 inch)
+struct LayoutOptions
+{
+    /// The notification window size
+    int width = 200;
+    int height = 200;
+
+    /// The gap between two neighbour notifications
+    int spacing = 50;
+
+    /// The gap between the stack and the work area edges
+    int margin = 0;
+
+    /// The maximum number of columns per display
+    unsigned int maxColumns = 1;
+
+    /// The maximum number of visible notifications over all displays, 0 for as many as fit
+    std::size_t maxVisible = 8;
+};
+
+/// The placement of a single stack slot in physical pixels
+struct SlotGeometry
+{
+    int x, y, width, height;
+
+    /// Index of the display that the slot lies on
+    std::size_t display;
+};
+
+//
+// Computes the notification stack slots out of the displays and the layout
+// options. Slots fill the columns of the first display from its top right
+// corner downwards and then leftwards, and whatever does not fit overflows
+// to the next display. The slots are cached and only recomputed when the
+// displays or the options change, so slot lookups are plain array accesses.
+// Does not depend on any platform API.
+//
+
+class StackLayout
+{
+    public:
+        /// Constructor
+        StackLayout();
+
+        /// Sets the displays the stack spans, to be called again on every display change
+        void SetDisplays(const std::vector<DisplayInfo>& displays);
+
+        /// Sets the stack geometry settings
+        void SetOptions(const LayoutOptions& options);
+
+        /// Retrieves the stack geometry settings
+        const LayoutOptions& GetOptions() const;
+
+        /// Retrieves the number of slots, notifications past it overflow
+        std::size_t GetCapacity() const;
+
+        /// Retrieves the placement of the given slot, which must be less than the capacity
+        const SlotGeometry& GetSlot(std::size_t slot) const;
+
+        /// Retrieves the placement new notifications start from, one slot above the first one
+        SlotGeometry GetEntrySlot() const;
+
+    private:
+        /// Rebuilds the cached slots
+        void Recompute();
+
+        /// Converts device independent pixels to physical pixels for the given dpi
+        static int Scale(int dips, unsigned int dpi);
+
+        /// The displays the stack spans
+        std::vector<DisplayInfo> mDisplays;
+
+        /// The stack geometry settings
+        LayoutOptions mOptions;
+
+        /// The cached slots
+        std::vector<SlotGeometry> mSlots;
+};
+
+#endif // ! _STACK_LAYOUT_HPP_
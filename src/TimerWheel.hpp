@@ -0,0 +1,226 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _TIMER_WHEEL_HPP_
+#define _TIMER_WHEEL_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+//
+// Hashed timer wheel for the many coarse timers of the connections. Each
+// slot is an intrusive list of the timers that expire on a tick equal to
+// the slot index modulo the slot count, so arming and cancelling a timer
+// is O(1) and allocation free, and the owner of the wheel needs a single
+// periodic timer that calls Advance. Timers more than a turn away stay in
+// their slot until the turn they expire on.
+//
+
+class TimerWheel
+{
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        /// A timer embedded in its owner, cancelled when destroyed
+        class Timer
+        {
+            public:
+                /// Constructor
+                Timer() : mPrev(nullptr), mNext(nullptr), mWheel(nullptr), mTick(0) {}
+
+                /// Destructor
+                ~Timer() { Cancel(); }
+
+                /// Disable copying
+                Timer(const Timer&) = delete;
+                Timer& operator=(const Timer&) = delete;
+
+                /// Checks whether the timer is scheduled
+                bool IsArmed() const { return mWheel != nullptr; }
+
+                /// Unschedules the timer without calling its callback
+                void Cancel()
+                {
+                    if (!mWheel)
+                        return;
+                    Unlink();
+                    --mWheel->mSize;
+                    mWheel = nullptr;
+                    mCallback = nullptr;
+                }
+
+            private:
+                friend class TimerWheel;
+
+                /// Removes the timer from its list
+                void Unlink()
+                {
+                    mPrev->mNext = mNext;
+                    mNext->mPrev = mPrev;
+                    mPrev = mNext = nullptr;
+                }
+
+                /// Appends the timer to the list of the given sentinel
+                void LinkBefore(Timer& sentinel)
+                {
+                    mPrev = sentinel.mPrev;
+                    mNext = &sentinel;
+                    mPrev->mNext = this;
+                    sentinel.mPrev = this;
+                }
+
+                /// The neighbours in the list, a sentinel points to itself when empty
+                Timer* mPrev;
+                Timer* mNext;
+
+                /// The wheel the timer is scheduled on
+                TimerWheel* mWheel;
+
+                /// The tick the timer expires on
+                std::uint64_t mTick;
+
+                /// Called once the timer expires
+                std::function<void()> mCallback;
+        };
+
+        /// Constructor, takes the tick length and the number of slots of a turn
+        TimerWheel(Clock::duration resolution = std::chrono::milliseconds(10), std::size_t slots = 1024)
+            : mSlots(slots), mResolution(resolution), mStart(Clock::now()), mTick(0), mSize(0)
+        {
+            for (auto& s : mSlots)
+                s.mPrev = s.mNext = &s;
+            mExpired.mPrev = mExpired.mNext = &mExpired;
+        }
+
+        /// Destructor, the timers still scheduled are detached from the wheel
+        ~TimerWheel()
+        {
+            for (auto& s : mSlots)
+                DetachAll(s);
+            DetachAll(mExpired);
+        }
+
+        /// Disable copying
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+        /// Schedules the given timer to call cb on the first tick at or after the deadline, rescheduling it if armed
+        void Schedule(Timer& t, Clock::time_point deadline, std::function<void()> cb)
+        {
+            t.Cancel();
+
+            // Round up, a timer never fires early
+            auto ticks = (deadline - mStart + mResolution - Clock::duration(1)) / mResolution;
+            t.mTick = ticks > 0 && static_cast<std::uint64_t>(ticks) > mTick ? static_cast<std::uint64_t>(ticks) : mTick;
+            t.mCallback = std::move(cb);
+            t.mWheel = this;
+            t.LinkBefore(mSlots[t.mTick % mSlots.size()]);
+            ++mSize;
+        }
+
+        /// Fires the timers that expired up to the given time
+        void Advance(Clock::time_point now)
+        {
+            if (now < mStart)
+                return;
+            std::uint64_t target = static_cast<std::uint64_t>((now - mStart) / mResolution);
+            if (target < mTick)
+                return;
+
+            // Collect the expired timers first, the callbacks may cancel or schedule other timers.
+            // After a long pause every slot is visited once, the tick check catches all the timers that are due
+            std::uint64_t visits = std::min<std::uint64_t>(target - mTick + 1, mSlots.size());
+            for (std::uint64_t i = 0; i < visits; ++i)
+            {
+                Timer& s = mSlots[(mTick + i) % mSlots.size()];
+                for (Timer* t = s.mNext; t != &s;)
+                {
+                    Timer* next = t->mNext;
+                    if (t->mTick <= target)
+                    {
+                        t->Unlink();
+                        t->LinkBefore(mExpired);
+                    }
+                    t = next;
+                }
+            }
+            mTick = target + 1;
+
+            while (mExpired.mNext != &mExpired)
+            {
+                Timer* t = mExpired.mNext;
+                auto cb = std::move(t->mCallback);
+                t->Cancel();
+                if (cb)
+                    cb();
+            }
+        }
+
+        /// Retrieves the tick length
+        Clock::duration GetResolution() const { return mResolution; }
+
+        /// Retrieves the number of scheduled timers
+        std::size_t Size() const { return mSize; }
+
+    private:
+        /// Detaches every timer of the list of the given sentinel
+        void DetachAll(Timer& sentinel)
+        {
+            while (sentinel.mNext != &sentinel)
+            {
+                Timer* t = sentinel.mNext;
+                t->Unlink();
+                t->mWheel = nullptr;
+            }
+        }
+
+        /// The sentinels of the slot lists
+        std::vector<Timer> mSlots;
+
+        /// The sentinel of the timers that are being fired
+        Timer mExpired;
+
+        /// The tick length
+        Clock::duration mResolution;
+
+        /// The time of tick zero
+        Clock::time_point mStart;
+
+        /// The next tick to process
+        std::uint64_t mTick;
+
+        /// The number of scheduled timers
+        std::size_t mSize;
+};
+
+#endif // ! _TIMER_WHEEL_HPP_
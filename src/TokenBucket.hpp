@@ -0,0 +1,133 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _TOKEN_BUCKET_HPP_
+#define _TOKEN_BUCKET_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+//
+// Token bucket kept as a single atomic word, so that it can be shared
+// between the threads of the io_service without a lock.
+// The bucket is modeled after the generic cell rate algorithm: instead
+// of a token count it stores the theoretical arrival time of the next
+// conforming message. Every admitted message pushes it one emission
+// interval further, and a message is admitted as long as the pushed time
+// does not run ahead of the current time by more than the burst allows.
+//
+
+/// The sustained rate (messages per second) and burst (messages) of a token bucket, a zero rate means unlimited
+struct RateLimit
+{
+    double rate;
+    double burst;
+};
+
+class TokenBucket
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        /// Constructor
+        explicit TokenBucket(RateLimit limit = RateLimit{0.0, 0.0});
+
+        /// Disable copy construction
+        TokenBucket(const TokenBucket& rhs) = delete;
+        TokenBucket& operator=(const TokenBucket& rhs) = delete;
+
+        /// Changes the rate and burst, the accumulated state is kept
+        void SetLimit(RateLimit limit);
+
+        /// Takes a token, returns zero on success or the time to wait until a token is available
+        Clock::duration TryConsume(Clock::time_point now);
+
+        /// Gives back a token taken by TryConsume, used when a later check rejects the message
+        void Refund();
+
+    private:
+        /// The time between two conforming messages and the tolerated advance of the arrival time, in clock ticks
+        std::atomic<std::int64_t> mInterval;
+        std::atomic<std::int64_t> mTolerance;
+
+        /// The theoretical arrival time of the next conforming message, in clock ticks
+        std::atomic<std::int64_t> mArrival;
+};
+
+inline TokenBucket::TokenBucket(RateLimit limit)
+    : mInterval(0),
+      mTolerance(0),
+      mArrival(0)
+{
+    SetLimit(limit);
+}
+
+inline void TokenBucket::SetLimit(RateLimit limit)
+{
+    if (limit.rate <= 0.0)
+    {
+        mInterval = 0;
+        mTolerance = 0;
+        return;
+    }
+
+    auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / limit.rate));
+    std::int64_t ticks = std::max<std::int64_t>(interval.count(), 1);
+    mInterval = ticks;
+    mTolerance = static_cast<std::int64_t>(std::max(limit.burst - 1.0, 0.0) * ticks);
+}
+
+inline TokenBucket::Clock::duration TokenBucket::TryConsume(Clock::time_point now)
+{
+    std::int64_t interval = mInterval.load(std::memory_order_relaxed);
+    if (interval == 0)
+        return Clock::duration::zero();
+    std::int64_t tolerance = mTolerance.load(std::memory_order_relaxed);
+
+    std::int64_t t = now.time_since_epoch().count();
+    std::int64_t arrival = mArrival.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        std::int64_t start = std::max(arrival, t);
+        if (start - t > tolerance)
+            return Clock::duration(start - t - tolerance);
+        if (mArrival.compare_exchange_weak(arrival, start + interval, std::memory_order_relaxed))
+            return Clock::duration::zero();
+    }
+}
+
+inline void TokenBucket::Refund()
+{
+    mArrival.fetch_sub(mInterval.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+#endif // ! _TOKEN_BUCKET_HPP_
@@ -0,0 +1,217 @@
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> traceEnabled(false);
+
+// The start of the trace clock
+static const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+// The event phases of the Chrome trace format that are recorded
+enum TracePhase : std::uint8_t
+{
+    PhaseComplete = 'X',
+    PhaseFlowBegin = 's',
+    PhaseFlowEnd = 'f'
+};
+
+// A recorded event, its fields are atomics because the dump reads them while the owner thread may overwrite them
+struct TraceSlot
+{
+    std::atomic<const char*> name;
+    std::atomic<std::uint64_t> time;
+    std::atomic<std::uint64_t> value;
+    std::atomic<std::uint8_t> phase;
+};
+
+// The events of one thread. Only the owner thread writes, it claims a slot before writing it and commits it after,
+// so a reader can tell which of the events it copied may have been overwritten meanwhile
+struct TraceRing
+{
+    TraceSlot slots[TraceRingSize];
+    std::atomic<std::uint64_t> claimed;
+    std::atomic<std::uint64_t> committed;
+
+    /// The thread id in the trace and the thread name, guarded by the registry mutex
+    std::size_t tid;
+    std::string name;
+
+    TraceRing() : claimed(0), committed(0), tid(0) {}
+};
+
+// The rings of all the threads that recorded an event, they are never freed so that a dump still sees the events
+// of the threads that are gone
+struct TraceRegistry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceRing>> rings;
+};
+
+static TraceRegistry& GetRegistry()
+{
+    static TraceRegistry* registry = new TraceRegistry;
+    return *registry;
+}
+
+// The name and ring of the calling thread, the ring is created by its first event
+static thread_local std::string threadName;
+static thread_local TraceRing* threadRing = nullptr;
+
+static TraceRing& GetRing()
+{
+    if (!threadRing)
+    {
+        auto ring = std::make_unique<TraceRing>();
+        threadRing = ring.get();
+        TraceRegistry& r = GetRegistry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        ring->tid = r.rings.size() + 1;
+        ring->name = threadName;
+        r.rings.push_back(std::move(ring));
+    }
+    return *threadRing;
+}
+
+static void Record(TracePhase phase, const char* name, std::uint64_t time, std::uint64_t value)
+{
+    TraceRing& ring = GetRing();
+    std::uint64_t i = ring.claimed.load(std::memory_order_relaxed);
+    ring.claimed.store(i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    TraceSlot& s = ring.slots[i % TraceRingSize];
+    s.name.store(name, std::memory_order_relaxed);
+    s.time.store(time, std::memory_order_relaxed);
+    s.value.store(value, std::memory_order_relaxed);
+    s.phase.store(phase, std::memory_order_relaxed);
+    ring.committed.store(i + 1, std::memory_order_release);
+}
+
+void SetTracing(bool enabled)
+{
+    traceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::uint64_t GetTraceTime()
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - traceEpoch);
+    return static_cast<std::uint64_t>(ns.count()) + 1;
+}
+
+void SetTraceThreadName(const std::string& name)
+{
+    threadName = name;
+    if (threadRing)
+    {
+        std::lock_guard<std::mutex> lock(GetRegistry().mutex);
+        threadRing->name = name;
+    }
+}
+
+void TraceComplete(const char* name, std::uint64_t start, std::uint64_t end)
+{
+    Record(PhaseComplete, name, start, end - start);
+}
+
+void TraceFlowBegin(const char* name, std::uint64_t id)
+{
+    Record(PhaseFlowBegin, name, GetTraceTime(), id);
+}
+
+void TraceFlowEnd(const char* name, std::uint64_t id)
+{
+    Record(PhaseFlowEnd, name, GetTraceTime(), id);
+}
+
+// Appends the given text as a JSON string, the names are literals and thread names so only quotes need care
+static void AppendName(std::string& out, const char* name)
+{
+    out += '"';
+    for (const char* p = name; *p; ++p)
+    {
+        if (*p == '"' || *p == '\\')
+            out += '\\';
+        if (static_cast<unsigned char>(*p) >= 0x20)
+            out += *p;
+    }
+    out += '"';
+}
+
+// Appends a nanosecond time in microseconds, the unit of the trace format
+static void AppendMicros(std::string& out, std::uint64_t ns)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%llu.%03u", static_cast<unsigned long long>(ns / 1000), static_cast<unsigned>(ns % 1000));
+    out += buf;
+}
+
+std::string DumpTrace()
+{
+    std::string out = "{\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&out, &first]() { if (!first) out += ",\n"; first = false; };
+
+    TraceRegistry& r = GetRegistry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::uint8_t> phases(TraceRingSize);
+    std::vector<const char*> names(TraceRingSize);
+    std::vector<std::uint64_t> times(TraceRingSize), values(TraceRingSize);
+    for (const auto& ring : r.rings)
+    {
+        std::string tid = std::to_string(ring->tid);
+        if (!ring->name.empty())
+        {
+            separate();
+            out += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid + ",\"args\":{\"name\":";
+            AppendName(out, ring->name.c_str());
+            out += "}}";
+        }
+
+        // Copy the committed events, then drop the ones the owner may have started overwriting meanwhile
+        std::uint64_t end = ring->committed.load(std::memory_order_acquire);
+        std::uint64_t oldest = end > TraceRingSize ? end - TraceRingSize : 0;
+        for (std::uint64_t i = oldest; i < end; ++i)
+        {
+            const TraceSlot& s = ring->slots[i % TraceRingSize];
+            std::size_t k = static_cast<std::size_t>(i - oldest);
+            names[k] = s.name.load(std::memory_order_relaxed);
+            times[k] = s.time.load(std::memory_order_relaxed);
+            values[k] = s.value.load(std::memory_order_relaxed);
+            phases[k] = s.phase.load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t claimed = ring->claimed.load(std::memory_order_relaxed);
+        std::uint64_t begin = claimed > TraceRingSize ? std::max(oldest, std::min(end, claimed - TraceRingSize)) : oldest;
+
+        for (std::uint64_t i = begin; i < end; ++i)
+        {
+            std::size_t k = static_cast<std::size_t>(i - oldest);
+            separate();
+            out += "{\"name\":";
+            AppendName(out, names[k]);
+            out += ",\"cat\":\"newsflash\",\"ph\":\"";
+            out += static_cast<char>(phases[k]);
+            out += "\",\"ts\":";
+            AppendMicros(out, times[k]);
+            if (phases[k] == PhaseComplete)
+            {
+                out += ",\"dur\":";
+                AppendMicros(out, values[k]);
+            }
+            else
+            {
+                // The flow ends bind to the enclosing event rather than the next one
+                out += ",\"id\":" + std::to_string(values[k]);
+                if (phases[k] == PhaseFlowEnd)
+                    out += ",\"bp\":\"e\"";
+            }
+            out += ",\"pid\":1,\"tid\":" + tid + "}";
+        }
+    }
+    out += "],\"displayTimeUnit\":\"ms\"}";
+    return out;
+}
@@ -0,0 +1,108 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _TRACE_HPP_
+#define _TRACE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//
+// Trace points in the Chrome trace event format, for following a
+// notification from the socket to the screen in chrome://tracing or
+// Perfetto. A TRACE_SCOPE records a complete event, its name, start and
+// duration, in a ring buffer of the calling thread, so recording takes no
+// lock and the most recent events of every thread are kept. Flows join the
+// events of one notification across the threads. While tracing is off a
+// trace point costs one well predicted branch on a relaxed load.
+//
+
+/// The number of events kept per thread
+static const std::size_t TraceRingSize = 16384;
+
+/// Set while the trace points record, read by every trace point
+extern std::atomic<bool> traceEnabled;
+
+/// Checks whether the trace points record
+inline bool IsTracing()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+/// Starts or stops recording, the recorded events are kept until they are overwritten
+void SetTracing(bool enabled);
+
+/// Retrieves the time since the start of the process in nanoseconds, the timestamp of the trace events. Never zero
+std::uint64_t GetTraceTime();
+
+/// Names the calling thread in the trace
+void SetTraceThreadName(const std::string& name);
+
+/// Records a complete event of the calling thread, the name must be a string literal
+void TraceComplete(const char* name, std::uint64_t start, std::uint64_t end);
+
+/// Records the start of a flow with the given id, bound to the enclosing event of the calling thread
+void TraceFlowBegin(const char* name, std::uint64_t id);
+
+/// Records the end of a flow with the given id, bound to the enclosing event of the calling thread
+void TraceFlowEnd(const char* name, std::uint64_t id);
+
+/// Renders the recorded events of all the threads as Chrome trace JSON, may be called from any thread
+std::string DumpTrace();
+
+/// Records the time from its construction to its destruction as a complete event, if tracing is on at construction
+class TraceScope
+{
+    public:
+        explicit TraceScope(const char* name) : mName(name), mStart(IsTracing() ? GetTraceTime() : 0) {}
+        ~TraceScope() { if (mStart != 0) TraceComplete(mName, mStart, GetTraceTime()); }
+
+        TraceScope(const TraceScope&) = delete;
+        TraceScope& operator=(const TraceScope&) = delete;
+
+    private:
+        const char* mName;
+        std::uint64_t mStart;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+/// Traces the rest of the enclosing scope under the given name
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+/// Starts a flow with the given id inside the current trace scope
+#define TRACE_FLOW_BEGIN(name, id) do { if (IsTracing()) TraceFlowBegin(name, id); } while (0)
+
+/// Ends a flow with the given id inside the current trace scope
+#define TRACE_FLOW_END(name, id) do { if (IsTracing()) TraceFlowEnd(name, id); } while (0)
+
+#endif // ! _TRACE_HPP_
@@ -0,0 +1,197 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _TRANSPORT_HPP_
+#define _TRANSPORT_HPP_
+
+#include <functional>
+#include <string>
+
+#include "WarnGuard.hpp"
+WARN_GUARD_ON
+#include <asio.hpp>
+WARN_GUARD_OFF
+
+//
+// The byte stream a ClientConnection talks over, so that the same
+// connection and framing code serves TCP clients, local stream sockets
+// and named pipes. Every operation completes on the io_service of the
+// underlying stream.
+//
+
+class Transport
+{
+    public:
+        /// The completion handler of the read and write operations
+        using Handler = std::function<void(const asio::error_code&, std::size_t)>;
+
+        /// Destructor
+        virtual ~Transport() {}
+
+        /// Starts reading whatever is available into the given buffer
+        virtual void AsyncReadSome(asio::mutable_buffers_1 buf, Handler h) = 0;
+
+        /// Checks whether the stream can wait for data without a buffer, through AsyncWaitReadable and ReadSome
+        virtual bool CanWaitReadable() const = 0;
+
+        /// Starts waiting until data can be read without blocking, the handler gets zero bytes
+        virtual void AsyncWaitReadable(Handler h) = 0;
+
+        /// Reads whatever is available without blocking, fails with would_block if nothing is
+        virtual std::size_t ReadSome(asio::mutable_buffers_1 buf, asio::error_code& ec) = 0;
+
+        /// Starts writing the whole given buffer
+        virtual void AsyncWrite(asio::const_buffers_1 buf, Handler h) = 0;
+
+        /// Closes the stream, cancelling the outstanding operations
+        virtual void Close() = 0;
+
+        /// Checks whether the stream is open
+        virtual bool IsOpen() const = 0;
+
+        /// Retrieves the io_service the stream operations complete on
+        virtual asio::io_service& GetIOService() = 0;
+
+        /// Retrieves the name of the peer, the address of network clients, used for diagnostics and rate limiting
+        virtual const std::string& GetPeerName() const = 0;
+};
+
+/// Readiness operations of a stream, only sockets support them, stream handles complete their reads through IOCP
+template<typename Stream>
+struct ReadinessOps
+{
+    static const bool supported = false;
+
+    static void Prepare(Stream&) {}
+
+    static void AsyncWait(Stream& s, Transport::Handler h)
+    {
+        s.get_io_service().post(std::bind(std::move(h), asio::error_code(asio::error::operation_not_supported), 0));
+    }
+
+    static std::size_t Read(Stream&, asio::mutable_buffers_1, asio::error_code& ec)
+    {
+        ec = asio::error::operation_not_supported;
+        return 0;
+    }
+};
+
+template<typename Protocol, typename Service>
+struct ReadinessOps<asio::basic_stream_socket<Protocol, Service>>
+{
+    typedef asio::basic_stream_socket<Protocol, Service> Stream;
+
+    static const bool supported = true;
+
+    static void Prepare(Stream& s)
+    {
+        // Only the synchronous reads see the non blocking mode, the asynchronous operations behave the same
+        asio::error_code ec;
+        s.non_blocking(true, ec);
+    }
+
+    static void AsyncWait(Stream& s, Transport::Handler h)
+    {
+        s.async_read_some(asio::null_buffers(), std::move(h));
+    }
+
+    static std::size_t Read(Stream& s, asio::mutable_buffers_1 buf, asio::error_code& ec)
+    {
+        return s.read_some(buf, ec);
+    }
+};
+
+/// Transport over any asio stream, a socket or a stream handle
+template<typename Stream>
+class StreamTransport : public Transport
+{
+    public:
+        /// Constructor, takes ownership of the connected stream
+        StreamTransport(Stream stream, std::string peerName)
+            : mStream(std::move(stream)), mPeerName(std::move(peerName))
+        {
+            ReadinessOps<Stream>::Prepare(mStream);
+        }
+
+        void AsyncReadSome(asio::mutable_buffers_1 buf, Handler h) override
+        {
+            mStream.async_read_some(buf, std::move(h));
+        }
+
+        bool CanWaitReadable() const override
+        {
+            return ReadinessOps<Stream>::supported;
+        }
+
+        void AsyncWaitReadable(Handler h) override
+        {
+            ReadinessOps<Stream>::AsyncWait(mStream, std::move(h));
+        }
+
+        std::size_t ReadSome(asio::mutable_buffers_1 buf, asio::error_code& ec) override
+        {
+            return ReadinessOps<Stream>::Read(mStream, buf, ec);
+        }
+
+        void AsyncWrite(asio::const_buffers_1 buf, Handler h) override
+        {
+            asio::async_write(mStream, buf, std::move(h));
+        }
+
+        void Close() override
+        {
+            asio::error_code ec;
+            mStream.close(ec);
+        }
+
+        bool IsOpen() const override
+        {
+            return mStream.is_open();
+        }
+
+        asio::io_service& GetIOService() override
+        {
+            return mStream.get_io_service();
+        }
+
+        const std::string& GetPeerName() const override
+        {
+            return mPeerName;
+        }
+
+    private:
+        /// The connected stream
+        Stream mStream;
+
+        /// The name of the peer
+        std::string mPeerName;
+};
+
+#endif // ! _TRANSPORT_HPP_
@@ -0,0 +1,171 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _WINDOW_POOL_HPP_
+#define _WINDOW_POOL_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+//
+// Keeps a set of hidden, already created windows around, so that spawning
+// a notification does not have to go through window creation and expiring
+// one does not have to go through window destruction. The window type only
+// needs a default constructor and Show(bool), so the accounting does not
+// depend on the platform windows.
+//
+
+template<typename W>
+class WindowPool
+{
+    public:
+        /// Constructor, takes as argument the maximum number of idle windows kept
+        explicit WindowPool(std::size_t capacity = 16);
+
+        /// Disable copying
+        WindowPool(const WindowPool&) = delete;
+        WindowPool& operator=(const WindowPool&) = delete;
+
+        /// Creates idle windows until the pool is full, must be called from the UI thread
+        void WarmUp();
+
+        /// Retrieves a hidden window from the pool, creating a new one if the pool is empty
+        W* Acquire();
+
+        /// Hides and returns the given window to the pool, destroying it if the pool is full
+        void Release(W* w);
+
+        /// Changes the maximum number of idle windows kept, destroying the ones that exceed it
+        void SetCapacity(std::size_t capacity);
+
+        /// Retrieves the number of idle windows
+        std::size_t GetIdleCount() const;
+
+        /// Retrieves the number of windows created by the pool
+        std::size_t GetCreatedCount() const;
+
+        /// Retrieves the number of windows destroyed by the pool
+        std::size_t GetDestroyedCount() const;
+
+    private:
+        /// The idle windows
+        std::vector<std::unique_ptr<W>> mIdle;
+
+        /// The maximum number of idle windows kept
+        std::size_t mCapacity;
+
+        /// Counters of the window creations and destructions
+        std::size_t mCreated, mDestroyed;
+};
+
+template<typename W>
+WindowPool<W>::WindowPool(std::size_t capacity)
+    : mCapacity(capacity),
+      mCreated(0),
+      mDestroyed(0)
+{
+    mIdle.reserve(capacity);
+}
+
+template<typename W>
+void WindowPool<W>::WarmUp()
+{
+    while (mIdle.size() < mCapacity)
+    {
+        std::unique_ptr<W> w = std::make_unique<W>();
+        w->Show(false);
+        mIdle.push_back(std::move(w));
+        ++mCreated;
+    }
+}
+
+template<typename W>
+W* WindowPool<W>::Acquire()
+{
+    if (mIdle.empty())
+    {
+        ++mCreated;
+        W* w = new W();
+        w->Show(false);
+        return w;
+    }
+
+    W* w = mIdle.back().release();
+    mIdle.pop_back();
+    return w;
+}
+
+template<typename W>
+void WindowPool<W>::Release(W* w)
+{
+    std::unique_ptr<W> owned(w);
+    if (mIdle.size() < mCapacity)
+    {
+        owned->Show(false);
+        mIdle.push_back(std::move(owned));
+    }
+    else
+    {
+        // Window is destroyed when going out of scope
+        ++mDestroyed;
+    }
+}
+
+template<typename W>
+void WindowPool<W>::SetCapacity(std::size_t capacity)
+{
+    mCapacity = capacity;
+    while (mIdle.size() > mCapacity)
+    {
+        mIdle.pop_back();
+        ++mDestroyed;
+    }
+}
+
+template<typename W>
+std::size_t WindowPool<W>::GetIdleCount() const
+{
+    return mIdle.size();
+}
+
+template<typename W>
+std::size_t WindowPool<W>::GetCreatedCount() const
+{
+    return mCreated;
+}
+
+template<typename W>
+std::size_t WindowPool<W>::GetDestroyedCount() const
+{
+    return mDestroyed;
+}
+
+#endif // ! _WINDOW_POOL_HPP_
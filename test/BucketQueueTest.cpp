@@ -0,0 +1,129 @@
+#include "BucketQueue.hpp"
+#include <deque>
+#include <random>
+#include <vector>
+#include "Check.hpp"
+
+static void TestOrder()
+{
+    // The highest level goes first, each level in arrival order
+    BucketQueue<int, 4> q;
+    CHECK(q.Empty());
+    CHECK_EQ(q.HighestLevel(), -1);
+    CHECK_EQ(q.LowestLevel(), -1);
+    q.Push(1, 10);
+    q.Push(3, 30);
+    q.Push(1, 11);
+    q.Push(0, 0);
+    q.Push(3, 31);
+    CHECK_EQ(q.Size(), 5);
+    CHECK_EQ(q.HighestLevel(), 3);
+    CHECK_EQ(q.LowestLevel(), 0);
+    CHECK_EQ(q.PopHighest(), 30);
+    CHECK_EQ(q.PopHighest(), 31);
+    CHECK_EQ(q.HighestLevel(), 1);
+
+    // A value pushed to the front is the next one of its level, the last one pushed there first
+    q.PushFront(1, 9);
+    q.PushFront(1, 8);
+    q.PushFront(2, 20);
+    CHECK_EQ(q.Front(1), 8);
+    CHECK_EQ(q.Back(1), 11);
+    int expected[] = { 20, 8, 9, 10, 11, 0 };
+    for (int v : expected)
+        CHECK_EQ(q.PopHighest(), v);
+    CHECK(q.Empty());
+    CHECK_EQ(q.HighestLevel(), -1);
+
+    // Popping the front of a lower level leaves the others alone, and emptying it clears its level
+    q.Push(2, 1);
+    q.Push(0, 2);
+    q.PopFront(0);
+    CHECK_EQ(q.LowestLevel(), 2);
+    CHECK_EQ(q.Size(), 1);
+    q.Clear();
+    CHECK(q.Empty());
+    CHECK_EQ(q.LowestLevel(), -1);
+    CHECK(q.Bucket(2).empty());
+}
+
+static void TestStableEntries()
+{
+    // Pushing to either end of any level never moves the values already queued
+    BucketQueue<std::vector<int>, 3> q;
+    std::vector<const std::vector<int>*> addresses;
+    for (int i = 0; i < 3; ++i)
+    {
+        q.Push(1, std::vector<int>(1, i));
+        addresses.push_back(&q.Back(1));
+    }
+    for (int i = 0; i < 5000; ++i)
+    {
+        q.Push(i % 3, std::vector<int>(1, -1));
+        q.PushFront(i % 3, std::vector<int>(1, -2));
+    }
+    bool stable = true;
+    for (int i = 0; i < 3; ++i)
+        stable = stable && (*addresses[i])[0] == i;
+
+    // Nor does popping the values around them
+    while (q.Bucket(1).front()[0] != 0)
+        q.PopFront(1);
+    stable = stable && &q.Front(1) == addresses[0];
+    q.PopFront(1);
+    stable = stable && &q.Front(1) == addresses[1] && (*addresses[2])[0] == 2;
+    CHECK(stable);
+}
+
+static void TestAgainstModel()
+{
+    // Random pushes to both ends and pops agree with plain deques
+    std::mt19937 rng(11);
+    BucketQueue<int, 32> q;
+    std::vector<std::deque<int>> model(32);
+    std::size_t size = 0;
+    bool agree = true;
+    for (int i = 0; i < 50000; ++i)
+    {
+        std::size_t level = rng() % 32;
+        switch (rng() % 4)
+        {
+            case 0:
+                q.Push(level, i);
+                model[level].push_back(i);
+                ++size;
+                break;
+            case 1:
+                q.PushFront(level, i);
+                model[level].push_front(i);
+                ++size;
+                break;
+            default:
+            {
+                int highest = -1;
+                for (int l = 31; l >= 0 && highest < 0; --l)
+                    if (!model[l].empty())
+                        highest = l;
+                agree = agree && q.HighestLevel() == highest;
+                if (highest < 0)
+                    break;
+                agree = agree && q.PopHighest() == model[highest].front();
+                model[highest].pop_front();
+                --size;
+                break;
+            }
+        }
+        agree = agree && q.Size() == size;
+    }
+    for (std::size_t l = 0; l < 32; ++l)
+        agree = agree && q.Bucket(l) == model[l];
+    CHECK(agree);
+}
+
+int main()
+{
+    TestOrder();
+    TestStableEntries();
+    TestAgainstModel();
+    return CheckResult();
+}
@@ -0,0 +1,78 @@
+#include "BufferPool.hpp"
+#include <algorithm>
+#include "Check.hpp"
+
+static void TestReuse()
+{
+    // A buffer comes empty with room for a block, and one given back is the next one handed out
+    BufferPool pool(1024, 4);
+    ByteBuffer b = pool.Acquire();
+    CHECK(b.empty());
+    CHECK(b.capacity() >= 1024);
+    b.resize(1000);
+    const char* data = b.data();
+    pool.Release(std::move(b));
+    CHECK_EQ(pool.GetFreeCount(), 1);
+
+    ByteBuffer again = pool.Acquire();
+    CHECK(again.empty());
+    CHECK(again.data() == data);
+    CHECK_EQ(pool.GetFreeCount(), 0);
+
+    // A buffer that grew a little is kept, one grown well past the block by a large request is freed
+    again.resize(3000);
+    pool.Release(std::move(again));
+    CHECK_EQ(pool.GetFreeCount(), 1);
+    ByteBuffer large = pool.Acquire();
+    large.resize(64 * 1024);
+    pool.Release(std::move(large));
+    CHECK_EQ(pool.GetFreeCount(), 0);
+
+    // So is one too small to read a block into
+    pool.Release(ByteBuffer());
+    CHECK_EQ(pool.GetFreeCount(), 0);
+}
+
+static void TestMaxFree()
+{
+    // Past the limit the buffers given back are freed
+    BufferPool pool(512, 3);
+    std::vector<ByteBuffer> held;
+    for (int i = 0; i < 5; ++i)
+        held.push_back(pool.Acquire());
+    for (ByteBuffer& b : held)
+        pool.Release(std::move(b));
+    CHECK_EQ(pool.GetFreeCount(), 3);
+    for (int i = 0; i < 5; ++i)
+        held[i] = pool.Acquire();
+    CHECK_EQ(pool.GetFreeCount(), 0);
+    CHECK_EQ(pool.GetBlockSize(), 512);
+}
+
+static void TestDefaultInit()
+{
+    // Growing a buffer leaves the bytes as they were, growing it with a value still sets them
+    ByteBuffer b;
+    b.assign(256, 'x');
+    b.clear();
+    b.resize(256);
+    CHECK(std::count(b.begin(), b.end(), 'x') == 256);
+    b.resize(300, 'y');
+    CHECK(std::count(b.begin() + 256, b.end(), 'y') == 44);
+    b.push_back('z');
+    CHECK_EQ(b.back(), 'z');
+
+    // The allocator rebinds for other element types and copies like the standard one
+    ByteBuffer copy(b);
+    CHECK(copy == b);
+    std::vector<int, DefaultInitAllocator<int>> ints(4, 7);
+    CHECK_EQ(ints[3], 7);
+}
+
+int main()
+{
+    TestReuse();
+    TestMaxFree();
+    TestDefaultInit();
+    return CheckResult();
+}
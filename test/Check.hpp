@@ -0,0 +1,72 @@
+/*********************************************************************************************************************/
+/*                                                  /===-_---~~~~~~~~~------____                                     */
+/*                                                 |===-~___                _,-'                                     */
+/*                  -==\\                         `//~\\   ~~~~`---.___.-~~                                          */
+/*              ______-==|                         | |  \\           _-~`                                            */
+/*        __--~~~  ,-/-==\\                        | |   `\        ,'                                                */
+/*     _-~       /'    |  \\                      / /      \      /                                                  */
+/*   .'        /       |   \\                   /' /        \   /'                                                   */
+/*  /  ____  /         |    \`\.__/-~~ ~ \ _ _/'  /          \/'                                                     */
+/* /-'~    ~~~~~---__  |     ~-/~         ( )   /'        _--~`                                                      */
+/*                   \_|      /        _)   ;  ),   __--~~                                                           */
+/*                     '~~--_/      _-~/-  / \   '-~ \                                                               */
+/*                    {\__--_/}    / \\_>- )<__\      \                                                              */
+/*                    /'   (_/  _-~  | |__>--<__|      |                                                             */
+/*                   |0  0 _/) )-~     | |__>--<__|     |                                                            */
+/*                   / /~ ,_/       / /__>---<__/      |                                                             */
+/*                  o o _//        /-~_>---<__-~      /                                                              */
+/*                  (^(~          /~_>---<__-      _-~                                                               */
+/*                 ,/|           /__>--<__/     _-~                                                                  */
+/*              ,//('(          |__>--<__|     /                  .----_                                             */
+/*             ( ( '))          |__>--<__|    |                 /' _---_~\                                           */
+/*          `-)) )) (           |__>--<__|    |               /'  /     ~\`\                                         */
+/*         ,/,'//( (             \__>--<__\    \            /'  //        ||                                         */
+/*       ,( ( ((, ))              ~-__>--<_~-_  ~--____---~' _/'/        /'                                          */
+/*     `~/  )` ) ,/|                 ~-_~>--<_/-__       __-~ _/                                                     */
+/*   ._-~//( )/ )) `                    ~~-'_/_/ /~~~~~~~__--~                                                       */
+/*    ;'( ')/ ,)(                              ~~~~~~~~~~                                                            */
+/*   ' ') '( (/                                                                                                      */
+/*     '   '  `                                                                                                      */
+/*********************************************************************************************************************/
+#ifndef _CHECK_HPP_
+#define _CHECK_HPP_
+
+#include <cstdio>
+#include <string>
+
+//
+// The checks of the test programs. A failed check is reported with its
+// location and the test goes on, so one run shows every failure, and
+// CheckResult turns the failures into the exit code of the program.
+//
+
+/// The number of failed checks so far
+static int checkFailures = 0;
+
+/// Reports a failed check
+inline void CheckFailed(const char* file, int line, const std::string& what)
+{
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what.c_str());
+    ++checkFailures;
+}
+
+/// Retrieves the exit code of the test program
+inline int CheckResult()
+{
+    if (checkFailures != 0)
+        std::fprintf(stderr, "%d check(s) failed\n", checkFailures);
+    return checkFailures != 0 ? 1 : 0;
+}
+
+/// Checks that the given condition holds
+#define CHECK(cond) do { if (!(cond)) CheckFailed(__FILE__, __LINE__, #cond); } while (0)
+
+/// Checks that the given values are equal, printing both if they are not
+#define CHECK_EQ(a, b) do { if (!((a) == (b))) CheckFailed(__FILE__, __LINE__, std::string(#a " == " #b " (") + ToCheckString(a) + " vs " + ToCheckString(b) + ")"); } while (0)
+
+inline std::string ToCheckString(const std::string& s) { return "\"" + s + "\""; }
+inline std::string ToCheckString(const char* s) { return ToCheckString(std::string(s)); }
+inline std::string ToCheckString(bool b) { return b ? "true" : "false"; }
+template <typename T> std::string ToCheckString(const T& v) { return std::to_string(static_cast<long long>(v)); }
+
+#endif // ! _CHECK_HPP_
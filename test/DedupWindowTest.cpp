@@ -0,0 +1,77 @@
+#include "DedupWindow.hpp"
+#include "Check.hpp"
+
+using Clock = DedupWindow<int>::Clock;
+using std::chrono::milliseconds;
+
+static void TestWindow()
+{
+    DedupWindow<int> w(milliseconds(10000), 16);
+    Clock::time_point t0 = Clock::now();
+    w.Insert("build", 1, t0);
+    CHECK(w.Find("build", t0 + milliseconds(9999)) != nullptr);
+    CHECK(w.Find("build", t0 + milliseconds(10000)) == nullptr);
+    CHECK_EQ(w.Size(), 0);
+
+    // A zero window remembers nothing
+    DedupWindow<int> off(milliseconds(0), 16);
+    off.Insert("build", 1, t0);
+    CHECK(off.Find("build", t0) == nullptr);
+}
+
+static void TestRefresh()
+{
+    // A key that keeps being refreshed outlives its first window
+    DedupWindow<int> w(milliseconds(10000), 16);
+    Clock::time_point t0 = Clock::now();
+    w.Insert("build", 1, t0);
+    w.Insert("other", 2, t0);
+    for (int s = 5; s <= 60; s += 5)
+        w.Refresh("build", t0 + std::chrono::seconds(s));
+    int* v = w.Find("build", t0 + milliseconds(69999));
+    CHECK(v != nullptr && *v == 1);
+    CHECK(w.Find("other", t0 + milliseconds(69999)) == nullptr);
+    CHECK(w.Find("build", t0 + milliseconds(70000)) == nullptr);
+
+    // Refreshing an unknown key does nothing
+    w.Refresh("missing", t0);
+    CHECK(w.Find("missing", t0) == nullptr);
+}
+
+static void TestCapacity()
+{
+    // Over the capacity the least recently used key goes first
+    DedupWindow<int> w(milliseconds(10000), 3);
+    Clock::time_point t0 = Clock::now();
+    w.Insert("a", 1, t0);
+    w.Insert("b", 2, t0);
+    w.Insert("c", 3, t0);
+    w.Refresh("a", t0);
+    w.Insert("d", 4, t0);
+    CHECK_EQ(w.Size(), 3);
+    CHECK(w.Find("a", t0) != nullptr);
+    CHECK(w.Find("b", t0) == nullptr);
+
+    // A hot key refreshed far more often than the capacity does not push the other keys out
+    for (int i = 0; i < 1000; ++i)
+        w.Refresh("d", t0 + milliseconds(i));
+    CHECK_EQ(w.Size(), 3);
+    CHECK(w.Find("a", t0 + milliseconds(1000)) != nullptr);
+    CHECK(w.Find("c", t0 + milliseconds(1000)) != nullptr);
+
+    // Erased keys and lowered capacities
+    w.Erase("c");
+    CHECK(w.Find("c", t0) == nullptr);
+    w.Insert("e", 5, t0 + milliseconds(1000));
+    w.Configure(milliseconds(10000), 1);
+    CHECK_EQ(w.Size(), 1);
+    CHECK(w.Find("e", t0 + milliseconds(1000)) != nullptr);
+}
+
+int main()
+{
+    TestWindow();
+    TestRefresh();
+    TestCapacity();
+    return CheckResult();
+}
@@ -0,0 +1,72 @@
+#include "FlowControl.hpp"
+#include "Check.hpp"
+
+static void TestWatermarks()
+{
+    // The producer pauses once the depth reaches the high watermark and stays paused until it is down to the low one
+    FlowControl fc(4, 2);
+    int resumes = 0;
+    fc.SetResumeCallback([&resumes]() { ++resumes; });
+    for (int i = 0; i < 3; ++i)
+        fc.OnQueued();
+    CHECK(!fc.IsPaused());
+    fc.OnQueued();
+    CHECK(fc.IsPaused());
+    CHECK_EQ(fc.GetPauseCount(), 1);
+
+    // Queueing on while paused is not another pause, and draining above the low watermark does not resume
+    fc.OnQueued();
+    fc.OnQueued();
+    CHECK_EQ(fc.GetDepth(), 6);
+    CHECK_EQ(fc.GetPauseCount(), 1);
+    for (int i = 0; i < 3; ++i)
+        fc.OnDrained();
+    CHECK_EQ(fc.GetDepth(), 3);
+    CHECK(fc.IsPaused());
+    CHECK_EQ(resumes, 0);
+
+    // The resume comes once, at the low watermark
+    fc.OnDrained();
+    CHECK(!fc.IsPaused());
+    CHECK_EQ(resumes, 1);
+    fc.OnDrained();
+    fc.OnDrained();
+    CHECK_EQ(fc.GetDepth(), 0);
+    CHECK_EQ(resumes, 1);
+
+    // Between the watermarks the producer keeps going until the high one again
+    fc.OnQueued();
+    fc.OnQueued();
+    fc.OnQueued();
+    fc.OnDrained();
+    CHECK(!fc.IsPaused());
+    fc.OnQueued();
+    fc.OnQueued();
+    CHECK(fc.IsPaused());
+    CHECK_EQ(fc.GetPauseCount(), 2);
+}
+
+static void TestSetWatermarks()
+{
+    // New watermarks apply from the next item, and a flow control without a callback only tracks the state
+    FlowControl fc(100, 50);
+    for (int i = 0; i < 10; ++i)
+        fc.OnQueued();
+    CHECK(!fc.IsPaused());
+    fc.SetWatermarks(10, 0);
+    fc.OnQueued();
+    CHECK(fc.IsPaused());
+    for (int i = 0; i < 10; ++i)
+        fc.OnDrained();
+    CHECK(fc.IsPaused());
+    fc.OnDrained();
+    CHECK(!fc.IsPaused());
+    CHECK_EQ(fc.GetPauseCount(), 1);
+}
+
+int main()
+{
+    TestWatermarks();
+    TestSetWatermarks();
+    return CheckResult();
+}
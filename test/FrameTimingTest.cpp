@@ -0,0 +1,71 @@
+#include "FrameTiming.hpp"
+#include "Check.hpp"
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+// Ticks a frame at the given time with the given numbers of tweens and window updates
+static const FrameRecord& Tick(FrameTiming& timing, FrameTiming::Clock::time_point at, int tweens, int windowUpdates)
+{
+    timing.BeginFrame(at);
+    for (int i = 0; i < tweens; ++i)
+        FrameTiming::CountTween();
+    for (int i = 0; i < windowUpdates; ++i)
+        FrameTiming::CountWindowUpdate();
+    return timing.EndFrame(at + microseconds(300));
+}
+
+static void TestJank()
+{
+    // 100 frames at 60Hz, one of them 50 ms after the one before, which misses the two deadlines in between
+    FrameTiming timing;
+    FrameTiming::Clock::time_point t = FrameTiming::Clock::now();
+    for (int i = 0; i < 100; ++i)
+    {
+        t += i == 50 ? milliseconds(50) : microseconds(16667);
+        const FrameRecord& f = Tick(timing, t, 8, 4);
+        CHECK_EQ(f.tweens, 8);
+        CHECK_EQ(f.windowUpdates, 4);
+        CHECK_EQ(f.updateTime, 300);
+        CHECK_EQ(f.missedDeadlines, i == 50 ? 2 : 0);
+        CHECK_EQ(f.interval, i == 0 ? 0 : i == 50 ? 50000 : 16667);
+    }
+    CHECK_EQ(timing.GetFrameCount(), 100);
+    CHECK_EQ(timing.GetJankCount(), 1);
+
+    // Up to half a period late is still on time
+    t += microseconds(16667 + 8000);
+    CHECK_EQ(Tick(timing, t, 0, 0).missedDeadlines, 0);
+
+    // The idle time after a restart is not jank
+    timing.Restart();
+    t += std::chrono::seconds(10);
+    const FrameRecord& f = Tick(timing, t, 0, 0);
+    CHECK_EQ(f.interval, 0);
+    CHECK_EQ(f.missedDeadlines, 0);
+    CHECK_EQ(timing.GetJankCount(), 1);
+}
+
+static void TestHistory()
+{
+    // Counts outside a frame go nowhere, and only the most recent frames are kept
+    FrameTiming timing;
+    FrameTiming::CountTween();
+    FrameTiming::Clock::time_point t = FrameTiming::Clock::now();
+    for (std::size_t i = 0; i < FrameHistorySize + 10; ++i)
+        Tick(timing, t += microseconds(16667), static_cast<int>(i), 0);
+    FrameTiming::CountWindowUpdate();
+
+    std::vector<FrameRecord> frames = timing.GetRecentFrames();
+    CHECK_EQ(frames.size(), FrameHistorySize);
+    CHECK_EQ(frames.front().tweens, 10);
+    CHECK_EQ(frames.back().tweens, FrameHistorySize + 9);
+    CHECK_EQ(frames.back().windowUpdates, 0);
+}
+
+int main()
+{
+    TestJank();
+    TestHistory();
+    return CheckResult();
+}
@@ -0,0 +1,549 @@
+#include "HistoryStore.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include "Check.hpp"
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+// The smallest segments there are, so that a few hundred records with long texts fill several of them
+static const std::size_t segmentBytes = 256 * 1024;
+
+// A notification as the test recorded it
+struct Recorded
+{
+    std::int64_t time;
+    std::string source;
+    std::string dedupKey;
+    std::string msg;
+    Priority priority;
+};
+
+// Lists the segment files of the history in the given directory
+static std::vector<std::string> SegmentFiles(const std::string& directory)
+{
+    std::vector<std::string> files;
+#if !defined(_WIN32)
+    if (DIR* dir = opendir(directory.c_str()))
+    {
+        while (dirent* e = readdir(dir))
+            if (std::strncmp(e->d_name, "history-", 8) == 0)
+                files.push_back(directory + "/" + e->d_name);
+        closedir(dir);
+    }
+#endif
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// A history directory of its own for every test, empty
+static std::string HistoryDirectory(const std::string& test)
+{
+    std::string directory = "/tmp/newsflash-history-" + test + "-" + std::to_string(getpid());
+    for (const std::string& f : SegmentFiles(directory))
+        std::remove(f.c_str());
+    return directory;
+}
+
+static void RemoveHistory(const std::string& directory)
+{
+    for (const std::string& f : SegmentFiles(directory))
+        std::remove(f.c_str());
+#if !defined(_WIN32)
+    rmdir(directory.c_str());
+#endif
+}
+
+static HistoryOptions SmallSegments()
+{
+    HistoryOptions options;
+    options.segmentBytes = segmentBytes;
+    return options;
+}
+
+// The current time in ms since the epoch, records must be younger than the age limit to survive a reopen
+static std::int64_t NowMs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
+// Records the given notification and remembers it in the model
+static void Record(HistoryStore& history, std::vector<Recorded>& model, std::int64_t time, const std::string& source,
+                   const std::string& msg, const std::string& key = std::string(), Priority priority = Priority::Normal)
+{
+    NotificationData data;
+    data.msg = msg;
+    data.source = source;
+    data.dedupKey = key;
+    data.priority = priority;
+    data.lifetime = 3000;
+    history.Record(data, time);
+    model.push_back(Recorded{model.empty() ? time : std::max(time, model.back().time), source, key, msg, priority});
+}
+
+// Checks that the text or key of the record has every term, looking at all of its words
+static bool Matches(const Recorded& r, const std::vector<SearchTerm>& terms)
+{
+    std::vector<std::string> words;
+    auto add = [&words](const std::string& w) { words.push_back(w); };
+    ForEachWord(Slice(r.msg.data(), r.msg.size()), add);
+    ForEachWord(Slice(r.dedupKey.data(), r.dedupKey.size()), add);
+    for (const SearchTerm& t : terms)
+    {
+        bool found = false;
+        for (const std::string& w : words)
+            found = found || w == t.word || (t.prefix && w.compare(0, t.word.size(), t.word) == 0);
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+// Retrieves the records of the model that match the query, newest first, without the limit
+static std::vector<Recorded> Expected(const std::vector<Recorded>& model, const HistoryQuery& q)
+{
+    std::vector<SearchTerm> terms = ParseSearch(q.text);
+    std::vector<Recorded> expected;
+    for (auto it = model.rbegin(); it != model.rend(); ++it)
+        if (it->time >= q.since && it->time <= q.until && (q.source.empty() || it->source == q.source)
+            && Matches(*it, terms))
+            expected.push_back(*it);
+    return expected;
+}
+
+// Pages through all the results of the query, checking that no page is longer than the limit
+static std::vector<HistoryEntry> QueryAll(HistoryStore& history, HistoryQuery q, std::size_t* pages = nullptr)
+{
+    std::vector<HistoryEntry> all;
+    std::size_t count = 0;
+    for (;;)
+    {
+        HistoryPage page = history.Query(q);
+        CHECK(page.entries.size() <= q.limit);
+        CHECK(page.next == 0 || page.entries.size() == q.limit);
+        all.insert(all.end(), page.entries.begin(), page.entries.end());
+        ++count;
+        if (page.next == 0 || count > 100000)
+            break;
+        q.cursor = page.next;
+    }
+    if (pages)
+        *pages = count;
+    return all;
+}
+
+// Checks that the entries are the expected records in the same order
+static void CheckEntries(const std::vector<HistoryEntry>& entries, const std::vector<Recorded>& expected)
+{
+    CHECK_EQ(entries.size(), expected.size());
+    for (std::size_t i = 0; i < std::min(entries.size(), expected.size()); ++i)
+    {
+        const HistoryEntry& e = entries[i];
+        const Recorded& r = expected[i];
+        if (e.time != r.time || e.source != r.source || e.msg != r.msg || e.dedupKey != r.dedupKey || e.priority != r.priority)
+        {
+            CheckFailed(__FILE__, __LINE__, "entry " + std::to_string(i) + " is \"" + e.msg + "\" from " + e.source
+                        + " at " + std::to_string(e.time) + ", expected \"" + r.msg + "\" from " + r.source + " at "
+                        + std::to_string(r.time));
+            return;
+        }
+    }
+}
+
+static void TestNewestFirst()
+{
+    std::string directory = HistoryDirectory("newest");
+    HistoryStore history(directory, SmallSegments());
+    CHECK(history.Open());
+    CHECK(history.Query(HistoryQuery()).entries.empty());
+
+    std::vector<Recorded> model;
+    std::int64_t t0 = NowMs() - 60000;
+    Record(history, model, t0, "10.0.0.1", "first", "build", Priority::High);
+    Record(history, model, t0 + 5, "10.0.0.2", "second");
+    Record(history, model, t0 + 5, "10.0.0.1", "same time");
+
+    // A time that goes back is recorded as the time of the previous record
+    Record(history, model, t0 + 1, "local", "late", "", Priority::Critical);
+    CHECK_EQ(model.back().time, t0 + 5);
+    CHECK_EQ(history.GetRecordCount(), 4);
+
+    HistoryPage page = history.Query(HistoryQuery());
+    CHECK_EQ(page.next, 0);
+    CheckEntries(page.entries, Expected(model, HistoryQuery()));
+
+    // Both ends of the range are inclusive
+    HistoryQuery q;
+    q.since = t0 + 5;
+    q.until = t0 + 5;
+    CheckEntries(history.Query(q).entries, Expected(model, q));
+    CHECK_EQ(history.Query(q).entries.size(), 3);
+    q.since = t0;
+    q.until = t0 + 4;
+    CheckEntries(history.Query(q).entries, Expected(model, q));
+    q.since = t0 + 6;
+    q.until = std::numeric_limits<std::int64_t>::max();
+    CHECK(history.Query(q).entries.empty());
+
+    // Unknown sources have nothing
+    HistoryQuery unknown;
+    unknown.source = "10.9.9.9";
+    CHECK(history.Query(unknown).entries.empty());
+    RemoveHistory(directory);
+}
+
+static void TestRangesAndSources()
+{
+    // Several segments of records from a few sources, with runs of equal times
+    std::string directory = HistoryDirectory("ranges");
+    HistoryStore history(directory, SmallSegments());
+    CHECK(history.Open());
+
+    std::mt19937 rng(3);
+    std::vector<Recorded> model;
+    const char* sources[] = { "10.0.0.1", "10.0.0.2", "10.0.0.3", "10.0.0.4", "local" };
+    std::int64_t t = NowMs() - 3600 * 1000;
+    for (int i = 0; i < 2000; ++i)
+    {
+        t += rng() % 3;
+        std::string source = sources[rng() % 5 == 0 ? 0 : rng() % 5];
+        Record(history, model, t, source, "message " + std::to_string(i) + " " + std::string(rng() % 800, 'x'),
+               i % 7 == 0 ? "key" + std::to_string(i % 3) : std::string(), static_cast<Priority>(i % PriorityLevels));
+    }
+    CHECK(history.GetSegmentCount() >= 3);
+    CHECK_EQ(history.GetRecordCount(), model.size());
+
+    // Random ranges, with and without a source, one page each, and the whole history paged
+    for (int i = 0; i < 300; ++i)
+    {
+        HistoryQuery q;
+        q.since = model[rng() % model.size()].time - static_cast<std::int64_t>(rng() % 3);
+        q.until = q.since + static_cast<std::int64_t>(rng() % 2000);
+        if (i % 2 == 0)
+            q.source = sources[rng() % 5];
+        q.limit = 1 + rng() % 150;
+        std::vector<Recorded> expected = Expected(model, q);
+        HistoryPage page = history.Query(q);
+        if (expected.size() > q.limit)
+        {
+            CHECK(page.next != 0);
+            expected.resize(q.limit);
+        }
+        else
+        {
+            CHECK_EQ(page.next, 0);
+        }
+        CheckEntries(page.entries, expected);
+    }
+    for (const char* source : sources)
+    {
+        HistoryQuery q;
+        q.source = source;
+        q.limit = 37;
+        CheckEntries(QueryAll(history, q), Expected(model, q));
+    }
+
+    // Pages across the segment boundaries
+    HistoryQuery all;
+    all.limit = 53;
+    std::size_t pages = 0;
+    CheckEntries(QueryAll(history, all, &pages), model.size() > 0 ? Expected(model, all) : model);
+    CHECK_EQ(pages, (model.size() + 52) / 53);
+
+    // The limit is capped, and a zero limit still returns one entry
+    all.limit = 5000;
+    CHECK_EQ(history.Query(all).entries.size(), HistoryMaxQueryLimit);
+    all.limit = 0;
+    CHECK_EQ(history.Query(all).entries.size(), 1);
+    RemoveHistory(directory);
+}
+
+static void TestCursorAcrossRoll()
+{
+    // A cursor taken before the history rolls into new segments still pages through the older records
+    std::string directory = HistoryDirectory("cursor");
+    HistoryStore history(directory, SmallSegments());
+    CHECK(history.Open());
+    std::vector<Recorded> model;
+    std::int64_t t = NowMs() - 60000;
+    for (int i = 0; i < 300; ++i)
+        Record(history, model, t + i, i % 2 ? "a" : "b", "old " + std::to_string(i) + std::string(1000, 'o'));
+
+    HistoryQuery q;
+    q.limit = 40;
+    HistoryPage first = history.Query(q);
+    CheckEntries(first.entries, std::vector<Recorded>(model.rbegin(), model.rbegin() + 40));
+    std::vector<Recorded> before = Expected(model, q);
+    std::size_t segments = history.GetSegmentCount();
+
+    for (int i = 0; i < 600; ++i)
+        Record(history, model, t + 300 + i, "c", "new " + std::to_string(i) + std::string(1000, 'n'));
+    CHECK(history.GetSegmentCount() >= segments + 2);
+
+    q.cursor = first.next;
+    std::vector<HistoryEntry> rest = QueryAll(history, q);
+    CheckEntries(rest, std::vector<Recorded>(before.begin() + 40, before.end()));
+
+    // A cursor of a segment that is gone ends the query
+    q.cursor = (std::uint64_t(999) << 32) | 64;
+    CHECK(history.Query(q).entries.empty());
+    RemoveHistory(directory);
+}
+
+static void TestRetire()
+{
+    // Past the size limit the oldest segments go, the newest one always stays
+    std::string directory = HistoryDirectory("retire");
+    HistoryOptions options = SmallSegments();
+    options.maxBytes = 3 * segmentBytes;
+    std::vector<Recorded> model;
+    std::int64_t t = NowMs() - 60000;
+    {
+        HistoryStore history(directory, options);
+        CHECK(history.Open());
+        for (int i = 0; i < 3000; ++i)
+            Record(history, model, t + i, "a", std::to_string(i) + std::string(500, 'r'));
+        CHECK(history.GetSegmentCount() <= 4);
+        CHECK_EQ(SegmentFiles(directory).size(), history.GetSegmentCount());
+
+        // What is left are the newest records, all of them
+        std::vector<HistoryEntry> left = QueryAll(history, HistoryQuery());
+        CHECK_EQ(left.size(), history.GetRecordCount());
+        CHECK(left.size() > 500 && left.size() < model.size());
+        CheckEntries(left, std::vector<Recorded>(model.rbegin(), model.rbegin() + std::min(left.size(), model.size())));
+    }
+    RemoveHistory(directory);
+
+    // Past the age limit as well, when a segment rolls
+    options = SmallSegments();
+    options.maxAge = std::chrono::hours(1);
+    std::int64_t now = NowMs();
+    {
+        HistoryStore history(directory, options);
+        CHECK(history.Open());
+        int i = 0;
+        while (history.GetSegmentCount() < 2)
+            Record(history, model, now - 3 * 3600 * 1000, "old", std::to_string(i++) + std::string(1000, 'o'));
+        std::uint64_t count = 0;
+        while (history.GetRecordCount() > count)
+        {
+            count = history.GetRecordCount();
+            Record(history, model, now, "new", std::to_string(i++) + std::string(1000, 'n'));
+        }
+
+        // The segment of the old records went, the one old record in the next segment stays with it
+        CHECK_EQ(history.GetSegmentCount(), 2);
+        HistoryQuery q;
+        q.source = "old";
+        CHECK_EQ(QueryAll(history, q).size(), 1);
+        CHECK_EQ(QueryAll(history, HistoryQuery()).size(), history.GetRecordCount());
+        CHECK_EQ(SegmentFiles(directory).size(), 2);
+    }
+    RemoveHistory(directory);
+
+    // And when the history opens
+    {
+        HistoryStore history(directory, options);
+        CHECK(history.Open());
+        int i = 0;
+        while (history.GetSegmentCount() < 2)
+            Record(history, model, now - 2 * 3600 * 1000, "old", std::to_string(i++) + std::string(1000, 'o'));
+        Record(history, model, now - 60000, "new", "recent");
+        CHECK_EQ(history.GetSegmentCount(), 2);
+    }
+    {
+        HistoryStore history(directory, options);
+        CHECK(history.Open());
+        CHECK_EQ(history.GetSegmentCount(), 1);
+        CHECK_EQ(history.GetRecordCount(), 2);
+        std::vector<HistoryEntry> left = QueryAll(history, HistoryQuery());
+        CHECK(left.size() == 2 && left[0].msg == "recent" && left[1].source == "old");
+    }
+    RemoveHistory(directory);
+}
+
+static void TestReopen()
+{
+    std::string directory = HistoryDirectory("reopen");
+    std::vector<Recorded> model;
+    std::int64_t t = NowMs() - 60000;
+    {
+        HistoryStore history(directory, SmallSegments());
+        CHECK(history.Open());
+        for (int i = 0; i < 700; ++i)
+            Record(history, model, t + i / 3, "s" + std::to_string(i % 4), "msg " + std::to_string(i) + std::string(700, 'z'),
+                   i % 5 == 0 ? "k" : "", static_cast<Priority>(i % PriorityLevels));
+    }
+
+    // The indexes are rebuilt from the files, and records go to a new segment
+    {
+        HistoryStore history(directory, SmallSegments());
+        CHECK(history.Open());
+        CHECK_EQ(history.GetRecordCount(), model.size());
+        CheckEntries(QueryAll(history, HistoryQuery()), Expected(model, HistoryQuery()));
+        HistoryQuery q;
+        q.source = "s2";
+        q.since = t + 50;
+        q.until = t + 150;
+        CheckEntries(QueryAll(history, q), Expected(model, q));
+
+        std::size_t segments = history.GetSegmentCount();
+        Record(history, model, t + 1000, "s9", "after the reopen");
+        CHECK_EQ(history.GetSegmentCount(), segments + 1);
+        CheckEntries(QueryAll(history, HistoryQuery()), Expected(model, HistoryQuery()));
+    }
+
+    // A crash in the middle of the last record loses that record only
+    std::vector<std::string> files = SegmentFiles(directory);
+    std::string last = files.back();
+    std::ifstream in(last, std::ios::binary | std::ios::ate);
+    std::size_t size = static_cast<std::size_t>(in.tellg());
+    in.close();
+#if !defined(_WIN32)
+    CHECK(truncate(last.c_str(), static_cast<off_t>(size - 5)) == 0);
+#endif
+    model.pop_back();
+
+    // Files that are not segments, and segments that are not sound, are left alone
+    std::ofstream(directory + "/history-zz.seg") << "not a segment";
+    std::ofstream(directory + "/history-00000000000000ff.seg") << std::string(200, 'x');
+    {
+        HistoryStore history(directory, SmallSegments());
+        CHECK(history.Open());
+        CHECK_EQ(history.GetRecordCount(), model.size());
+        CheckEntries(QueryAll(history, HistoryQuery()), Expected(model, HistoryQuery()));
+    }
+    std::remove((directory + "/history-zz.seg").c_str());
+    RemoveHistory(directory);
+}
+
+static void TestHotSegments()
+{
+    // Only the newest and recently read segments stay mapped, queries of cold ones map them again
+    std::string directory = HistoryDirectory("hot");
+    HistoryOptions options = SmallSegments();
+    options.hotSegments = 2;
+    HistoryStore history(directory, options);
+    CHECK(history.Open());
+    std::vector<Recorded> model;
+    std::int64_t t = NowMs() - 60000;
+    for (int i = 0; i < 1500; ++i)
+        Record(history, model, t + i, "h", std::to_string(i) + std::string(1000, 'h'));
+    CHECK(history.GetSegmentCount() >= 6);
+    CHECK(history.GetHotCount() <= 2);
+
+    // Each of these reads one old segment, the written one stays mapped and the count never goes over
+    for (int i = 0; i < 1500; i += 97)
+    {
+        HistoryQuery q;
+        q.since = t + i;
+        q.until = t + i + 10;
+        CheckEntries(history.Query(q).entries, Expected(model, q));
+        CHECK(history.GetHotCount() <= 2);
+    }
+    CheckEntries(QueryAll(history, HistoryQuery()), Expected(model, HistoryQuery()));
+    CHECK(history.GetHotCount() <= 2);
+
+    // Records keep going to the written segment while the old ones are read
+    Record(history, model, t + 2000, "h", "still writing");
+    CHECK_EQ(history.Query(HistoryQuery()).entries.front().msg, "still writing");
+    RemoveHistory(directory);
+}
+
+static void TestSearch()
+{
+    // Texts of a few words over a small vocabulary, some common and some rare, padded so they fill several segments
+    std::string directory = HistoryDirectory("search");
+    std::vector<Recorded> model;
+    HistoryQuery common;
+    common.text = "deploy*";
+    common.limit = 7;
+    {
+        HistoryStore history(directory, SmallSegments());
+        CHECK(history.Open());
+        std::mt19937 rng(46);
+        const char* vocabulary[] = { "deploy", "deployed", "deployment", "Deploy", "build", "builds", "failed", "FAILED",
+                                     "passed", "server", "service", "db", "\xC3\xBC" "ber", "x86_64", "alpha", "beta" };
+        const std::size_t words = sizeof(vocabulary) / sizeof(vocabulary[0]);
+        const char* sources[] = { "10.0.0.1", "10.0.0.2", "local" };
+        std::int64_t t = NowMs() - 3600 * 1000;
+        for (int i = 0; i < 2500; ++i)
+        {
+            t += rng() % 3;
+            std::string msg = "#" + std::to_string(i);
+            for (std::uint32_t n = 1 + rng() % 5; n > 0; --n)
+                msg += std::string(rng() % 2 ? " " : ", ") + vocabulary[rng() % (rng() % 4 == 0 ? words : 4)];
+            if (rng() % 100 == 0)
+                msg += " rare";
+            msg += std::string(rng() % 600, ' ');
+            std::string key = rng() % 5 == 0 ? std::string("key-") + vocabulary[rng() % words] : std::string();
+            Record(history, model, t, sources[rng() % 3], msg, key);
+        }
+        CHECK(history.GetSegmentCount() >= 3);
+
+        // Queries over the whole history in small pages, so that the pages span segments and restart the leapfrog
+        std::size_t pages = 0;
+        CheckEntries(QueryAll(history, common, &pages), Expected(model, common));
+        CHECK(pages > 100);
+
+        // Random terms, prefixes of them, absent words, sources and ranges
+        const char* fixed[] = { "rare", "rare deploy", "deploy failed", "fail*", "f* d*", "x86", "64 x86_64*", "key",
+                                "key-beta", "\xC3\xBC*", "absent", "deploy absent", "abs*", "#1*", "10", "!!" };
+        for (int i = 0; i < 400; ++i)
+        {
+            HistoryQuery q;
+            if (i < static_cast<int>(sizeof(fixed) / sizeof(fixed[0])))
+                q.text = fixed[i];
+            else
+            {
+                for (std::uint32_t n = 1 + rng() % 3; n > 0; --n)
+                {
+                    std::string word = vocabulary[rng() % words];
+                    if (rng() % 3 == 0)
+                        word = word.substr(0, 1 + rng() % word.size()) + "*";
+                    q.text += (q.text.empty() ? "" : " ") + word;
+                }
+            }
+            if (rng() % 3 == 0)
+                q.source = sources[rng() % 3];
+            if (rng() % 3 == 0)
+            {
+                q.since = model[rng() % model.size()].time;
+                q.until = q.since + rng() % 2000;
+            }
+            q.limit = 1 + rng() % 50;
+            std::vector<HistoryEntry> entries = QueryAll(history, q);
+            int failures = checkFailures;
+            CheckEntries(entries, Expected(model, q));
+            if (checkFailures != failures)
+                std::fprintf(stderr, "query \"%s\" from %s, limit %zu\n", q.text.c_str(), q.source.c_str(), q.limit);
+        }
+    }
+
+    // The indexes of the sealed segments are built again from the files
+    HistoryStore reopened(directory, SmallSegments());
+    CHECK(reopened.Open());
+    CheckEntries(QueryAll(reopened, common), Expected(model, common));
+    HistoryQuery rare;
+    rare.text = "RARE";
+    rare.source = "local";
+    rare.limit = 3;
+    CheckEntries(QueryAll(reopened, rare), Expected(model, rare));
+    RemoveHistory(directory);
+}
+
+int main()
+{
+    TestNewestFirst();
+    TestRangesAndSources();
+    TestCursorAcrossRoll();
+    TestRetire();
+    TestReopen();
+    TestHotSegments();
+    TestSearch();
+    return CheckResult();
+}
@@ -0,0 +1,217 @@
+#include "HttpEndpoint.hpp"
+#include <cstdlib>
+#include <thread>
+#include "Check.hpp"
+
+// A response as read off the connection
+struct Response
+{
+    int status = 0;
+    std::string head;
+    std::string body;
+};
+
+// A blocking client connection that reads the responses one by one
+class Client
+{
+    public:
+        explicit Client(unsigned short port)
+            : mSocket(mIOService)
+        {
+            mSocket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port));
+        }
+
+        /// Writes the given requests in one go
+        void Send(const std::string& data)
+        {
+            asio::write(mSocket, asio::buffer(data));
+        }
+
+        /// Reads the next response, the body of a response to a HEAD request is left out. A zero status means the
+        /// server closed the connection first
+        Response Read(bool head = false)
+        {
+            Response r;
+            std::size_t end;
+            while ((end = mIn.find("\r\n\r\n")) == std::string::npos)
+                if (!Fill())
+                    return r;
+            r.head = mIn.substr(0, end + 4);
+            mIn.erase(0, end + 4);
+            r.status = std::atoi(r.head.c_str() + 9);
+
+            std::size_t length = 0;
+            std::size_t field = r.head.find("Content-Length: ");
+            if (field != std::string::npos && !head)
+                length = std::strtoul(r.head.c_str() + field + 16, nullptr, 10);
+            while (mIn.size() < length)
+                if (!Fill())
+                    return Response();
+            r.body = mIn.substr(0, length);
+            mIn.erase(0, length);
+            return r;
+        }
+
+        /// Checks whether the server closed the connection, with nothing left to read
+        bool IsClosed()
+        {
+            return mIn.empty() && !Fill();
+        }
+
+    private:
+        /// Reads more of the responses, returns false once the connection is closed or nothing came for two seconds
+        bool Fill()
+        {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+            mSocket.non_blocking(true);
+            char buf[4096];
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                asio::error_code ec;
+                std::size_t n = mSocket.read_some(asio::buffer(buf), ec);
+                if (ec == asio::error::would_block)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    continue;
+                }
+                mIn.append(buf, n);
+                return !ec;
+            }
+            return false;
+        }
+
+        asio::io_service mIOService;
+        asio::ip::tcp::socket mSocket;
+        std::string mIn;
+};
+
+static void TestPipelining(unsigned short port)
+{
+    // Requests sent in one go are answered in order, and the connection stays open for the next ones
+    Client c(port);
+    c.Send("GET /health HTTP/1.1\r\nHost: x\r\n\r\n"
+           "HEAD /health?full HTTP/1.1\r\n\r\n"
+           "GET /nothing HTTP/1.1\r\n\r\n"
+           "GET /metrics HTTP/1.1\r\nConnection: keep-alive\r\n\r\n");
+    Response health = c.Read();
+    CHECK_EQ(health.status, 200);
+    CHECK_EQ(health.body, "{\"status\":\"test\"}");
+    CHECK(health.head.find("Connection: keep-alive\r\n") != std::string::npos);
+
+    // A HEAD response has the headers of the GET one without its body
+    Response head = c.Read(true);
+    CHECK_EQ(head.status, 200);
+    CHECK(head.head.find("Content-Length: 17\r\n") != std::string::npos);
+    CHECK(head.body.empty());
+
+    CHECK_EQ(c.Read().status, 404);
+    Response metrics = c.Read();
+    CHECK_EQ(metrics.status, 200);
+    CHECK(metrics.body.find("# TYPE http_requests_total counter\n") != std::string::npos);
+
+    c.Send("GET /health HTTP/1.1\r\n\r\n");
+    CHECK_EQ(c.Read().status, 200);
+
+    // The last request may close the connection, or be an HTTP/1.0 one
+    c.Send("GET /health HTTP/1.1\r\nConnection: close\r\n\r\n");
+    CHECK_EQ(c.Read().status, 200);
+    CHECK(c.IsClosed());
+    Client old(port);
+    old.Send("GET /health HTTP/1.0\r\n\r\n");
+    CHECK_EQ(old.Read().status, 200);
+    CHECK(old.IsClosed());
+}
+
+static void TestErrors(unsigned short port)
+{
+    // Other methods are refused with the allowed ones, and the connection goes on
+    Client c(port);
+    c.Send("POST /metrics HTTP/1.1\r\n\r\nDELETE / HTTP/1.1\r\n\r\n");
+    Response post = c.Read();
+    CHECK_EQ(post.status, 405);
+    CHECK(post.head.find("Allow: GET, HEAD\r\n") != std::string::npos);
+    CHECK_EQ(c.Read().status, 405);
+    c.Send("GET /health HTTP/1.1\r\n\r\n");
+    CHECK_EQ(c.Read().status, 200);
+
+    // A request head that does not end within the limit is refused and closes the connection
+    Client large(port);
+    large.Send("GET /metrics HTTP/1.1\r\nX-Filler: " + std::string(9000, 'a'));
+    CHECK_EQ(large.Read().status, 431);
+    CHECK(large.IsClosed());
+
+    // So do a request with a body and a request line that does not parse
+    Client body(port);
+    body.Send("GET /health HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello");
+    CHECK_EQ(body.Read().status, 400);
+    CHECK(body.IsClosed());
+    Client garbage(port);
+    garbage.Send("nonsense\r\n\r\n");
+    CHECK_EQ(garbage.Read().status, 400);
+    CHECK(garbage.IsClosed());
+}
+
+// Waits until the endpoint has the given number of connections or a second passed
+static bool WaitConnections(const HttpEndpoint& endpoint, std::size_t count)
+{
+    for (int i = 0; i < 100 && endpoint.GetConnectionCount() != count; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return endpoint.GetConnectionCount() == count;
+}
+
+static void TestConnectionCap(HttpEndpoint& endpoint, unsigned short port)
+{
+    // The connections over the cap are closed as soon as they are accepted, the ones under it are served
+    CHECK(WaitConnections(endpoint, 0));
+    std::unique_ptr<Client> first(new Client(port));
+    Client second(port);
+    first->Send("GET /health HTTP/1.1\r\n\r\n");
+    second.Send("GET /health HTTP/1.1\r\n\r\n");
+    CHECK_EQ(first->Read().status, 200);
+    CHECK_EQ(second.Read().status, 200);
+    CHECK_EQ(endpoint.GetConnectionCount(), 2);
+
+    Client third(port);
+    third.Send("GET /health HTTP/1.1\r\n\r\n");
+    CHECK_EQ(third.Read().status, 0);
+    CHECK_EQ(endpoint.GetConnectionCount(), 2);
+
+    // A connection that goes makes room for another one
+    first.reset();
+    CHECK(WaitConnections(endpoint, 1));
+    Client fourth(port);
+    fourth.Send("GET /health HTTP/1.1\r\n\r\n");
+    CHECK_EQ(fourth.Read().status, 200);
+    CHECK_EQ(endpoint.GetConnectionCount(), 2);
+}
+
+static void TestAddress()
+{
+    // An address that does not parse leaves the endpoint closed, the loopback one listens
+    asio::io_service ios;
+    CHECK(!HttpEndpoint(ios, "localhost", 0, nullptr).IsOpen());
+    HttpEndpoint loopback(ios, "127.0.0.1", 0, nullptr);
+    CHECK(loopback.IsOpen());
+    CHECK(loopback.GetPort() != 0);
+}
+
+int main()
+{
+    asio::io_service ios;
+    HttpEndpoint endpoint(ios, "127.0.0.1", 0, []() { return std::string("{\"status\":\"test\"}"); });
+    CHECK(endpoint.IsOpen());
+    // The tests before the cap one never hold more than two connections at once
+    endpoint.SetMaxConnections(2);
+    endpoint.Start();
+    std::thread t([&ios]() { ios.run(); });
+
+    unsigned short port = endpoint.GetPort();
+    TestPipelining(port);
+    TestErrors(port);
+    TestConnectionCap(endpoint, port);
+    TestAddress();
+
+    ios.post([&endpoint]() { endpoint.Stop(); });
+    t.join();
+    return CheckResult();
+}
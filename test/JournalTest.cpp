@@ -0,0 +1,178 @@
+#include "Journal.hpp"
+#include <fstream>
+#include <thread>
+#include "Check.hpp"
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// A journal path of its own for every test
+static std::string JournalPath(const std::string& test)
+{
+    std::string path = "/tmp/newsflash-journal-" + test + "-" + std::to_string(getpid());
+    std::remove(path.c_str());
+    return path;
+}
+
+static NotificationData MakeNotification(const std::string& msg)
+{
+    NotificationData data;
+    data.msg = msg;
+    data.lifetime = 4000;
+    data.priority = Priority::High;
+    data.dedupKey = "key-" + msg;
+    return data;
+}
+
+// Opens the journal at the given path and returns what it replays
+static std::vector<NotificationData> Replay(const std::string& path, JournalOptions options = JournalOptions())
+{
+    std::vector<NotificationData> replay;
+    Journal j(path, options);
+    CHECK(j.Open(replay));
+    return replay;
+}
+
+static std::size_t FileSize(const std::string& path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    return f ? static_cast<std::size_t>(f.tellg()) : 0;
+}
+
+static void TestReplay()
+{
+    std::string path = JournalPath("replay");
+    {
+        std::vector<NotificationData> replay;
+        Journal j(path);
+        CHECK(j.Open(replay));
+        CHECK(replay.empty());
+        std::uint64_t a = j.Append(MakeNotification("a"));
+        std::uint64_t b = j.Append(MakeNotification("b"));
+        j.Append(MakeNotification("c"));
+        CHECK(a != 0 && b > a);
+        j.Retire(b);
+        j.Sync();
+        CHECK_EQ(j.GetLiveCount(), 2);
+        CHECK(j.GetCommitCount() >= 1);
+    }
+
+    // The notifications that were never retired come back with their fields and sequence numbers
+    std::vector<NotificationData> replay = Replay(path);
+    CHECK_EQ(replay.size(), 2);
+    if (replay.size() == 2)
+    {
+        CHECK_EQ(replay[0].msg, "a");
+        CHECK_EQ(replay[0].dedupKey, "key-a");
+        CHECK_EQ(replay[0].lifetime, 4000);
+        CHECK(replay[0].priority == Priority::High);
+        CHECK_EQ(replay[1].msg, "c");
+        CHECK(replay[1].journalSeq > replay[0].journalSeq);
+    }
+
+    // Retiring the replayed ones empties the journal for the next start
+    {
+        std::vector<NotificationData> again;
+        Journal j(path);
+        CHECK(j.Open(again));
+        for (const NotificationData& d : again)
+            j.Retire(d.journalSeq);
+    }
+    CHECK(Replay(path).empty());
+    std::remove(path.c_str());
+}
+
+static void TestTornTail()
+{
+    std::string path = JournalPath("torn");
+    {
+        std::vector<NotificationData> replay;
+        Journal j(path);
+        CHECK(j.Open(replay));
+        j.Append(MakeNotification("kept"));
+        j.Sync();
+        j.Append(MakeNotification("torn"));
+    }
+
+    // Every cut of the last record drops it and keeps the first one, so do a flipped byte
+    std::size_t size = FileSize(path);
+    std::ifstream in(path, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::size_t first = content.size() / 2;
+    for (std::size_t cut = first; cut < size; cut += 3)
+    {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(content.data(), static_cast<std::streamsize>(cut));
+        std::vector<NotificationData> replay = Replay(path);
+        CHECK_EQ(replay.size(), 1);
+        CHECK(!replay.empty() && replay[0].msg == "kept");
+    }
+    std::string flipped = content;
+    flipped[size - 2] ^= 0x40;
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(flipped.data(), static_cast<std::streamsize>(flipped.size()));
+    CHECK_EQ(Replay(path).size(), 1);
+    std::remove(path.c_str());
+}
+
+static void TestExpired()
+{
+    // A notification whose lifetime ran out while the server was down is not shown again, however young it is
+    std::string path = JournalPath("expired");
+    {
+        std::vector<NotificationData> replay;
+        Journal j(path);
+        CHECK(j.Open(replay));
+        NotificationData brief = MakeNotification("brief");
+        brief.lifetime = 50;
+        j.Append(brief);
+        j.Append(MakeNotification("long"));
+        j.Sync();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::vector<NotificationData> replay = Replay(path);
+    CHECK_EQ(replay.size(), 1);
+    CHECK(!replay.empty() && replay[0].msg == "long");
+    std::remove(path.c_str());
+}
+
+static void TestCompaction()
+{
+    // A journal that is mostly retired records is rewritten with the live ones only
+    std::string path = JournalPath("compact");
+    JournalOptions options;
+    options.compactBytes = 64 * 1024;
+    std::uint64_t live = 0;
+    {
+        std::vector<NotificationData> replay;
+        Journal j(path, options);
+        CHECK(j.Open(replay));
+        for (int i = 0; i < 5000; ++i)
+        {
+            std::uint64_t seq = j.Append(MakeNotification(std::to_string(i) + std::string(100, 'x')));
+            if (i % 1000 == 0)
+                live = seq;
+            else
+                j.Retire(seq);
+        }
+        j.Sync();
+        j.Append(MakeNotification("last"));
+        j.Sync();
+        CHECK(j.GetCompactionCount() >= 1);
+        CHECK_EQ(j.GetLiveCount(), 6);
+    }
+    CHECK(FileSize(path) < options.compactBytes);
+
+    std::vector<NotificationData> replay = Replay(path, options);
+    CHECK_EQ(replay.size(), 6);
+    CHECK(replay.size() == 6 && replay[4].journalSeq == live && replay[5].msg == "last");
+    std::remove(path.c_str());
+}
+
+int main()
+{
+    TestReplay();
+    TestTornTail();
+    TestExpired();
+    TestCompaction();
+    return CheckResult();
+}
@@ -0,0 +1,223 @@
+#include "JsonRequest.hpp"
+#include <memory>
+#include "Check.hpp"
+
+// A request parsed from a heap buffer of its exact size, so the sanitizers catch any read past its end
+struct Parsed
+{
+    std::unique_ptr<char[]> buffer;
+    std::vector<NotifyFrame> frames;
+    bool ok;
+
+    explicit Parsed(const std::string& json)
+        : buffer(new char[json.size() + 1])
+    {
+        json.copy(buffer.get(), json.size());
+        ok = ParseJsonRequest(buffer.get(), buffer.get() + json.size(), frames);
+    }
+
+    /// Retrieves the text of the single parsed notification, empty if the request failed
+    std::string Text() const { return ok && frames.size() == 1 ? frames[0].text.ToString() : std::string(); }
+};
+
+// Parses the given query from a buffer of its exact size
+static bool ParseQuery(const std::string& json, QueryKind& kind, HistoryQuery& q)
+{
+    std::unique_ptr<char[]> buffer(new char[json.size() + 1]);
+    json.copy(buffer.get(), json.size());
+    return ParseJsonQuery(buffer.get(), buffer.get() + json.size(), kind, q);
+}
+
+static void TestNotification()
+{
+    Parsed p(" {\"msg\": \"Build finished\", \"lifetime\": 5000, \"priority\": \"high\", \"key\": \"build\", \"id\": 7, \"ack\": \"displayed\"} \r\n");
+    CHECK(p.ok);
+    CHECK_EQ(p.frames.size(), 1);
+    const NotifyFrame& f = p.frames[0];
+    CHECK_EQ(f.text.ToString(), "Build finished");
+    CHECK_EQ(f.lifetime, 5000);
+    CHECK(f.priority == Priority::High);
+    CHECK_EQ(f.dedupKey.ToString(), "build");
+    CHECK(f.hasRequestId);
+    CHECK_EQ(f.requestId, 7);
+    CHECK(f.ack == AckMode::Displayed);
+
+    // The defaults, numeric priorities and skipped members of any type
+    Parsed d("{\"extra\": {\"a\": [1, -2.5e3, true, false, null, \"s\"]}, \"priority\": 3, \"msg\": \"x\"}");
+    CHECK(d.ok);
+    CHECK_EQ(d.frames[0].lifetime, 3000);
+    CHECK(d.frames[0].priority == Priority::Critical);
+    CHECK(!d.frames[0].hasRequestId);
+    CHECK(d.frames[0].ack == AckMode::Accepted);
+
+    // The message is required, the enumerations and numbers must be in range
+    CHECK(!Parsed("{}").ok);
+    CHECK(!Parsed("{\"lifetime\": 1}").ok);
+    CHECK(!Parsed("{\"msg\": \"x\", \"priority\": 4}").ok);
+    CHECK(!Parsed("{\"msg\": \"x\", \"priority\": \"urgent\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"x\", \"ack\": \"always\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"x\", \"lifetime\": 4294967296}").ok);
+    CHECK(Parsed("{\"msg\": \"x\", \"lifetime\": 4294967295}").ok);
+    CHECK(!Parsed("{\"msg\": \"x\", \"lifetime\": -1}").ok);
+    CHECK(!Parsed("{\"msg\": 5}").ok);
+}
+
+static void TestEscapes()
+{
+    CHECK_EQ(Parsed("{\"msg\": \"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"}").Text(), "a\"b\\c/d\b\f\n\r\t");
+    CHECK_EQ(Parsed("{\"msg\": \"\\u00e9\\u20AC\"}").Text(), "\xC3\xA9\xE2\x82\xAC");
+    CHECK(!Parsed("{\"msg\": \"\\x\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\u12\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\u12g4\"}").ok);
+
+    // \u0000 is a character like any other, it ends up inside the text rather than ending it
+    Parsed nul("{\"msg\": \"a\\u0000b\"}");
+    CHECK(nul.ok);
+    CHECK_EQ(nul.Text(), std::string("a\0b", 3));
+}
+
+static void TestSurrogates()
+{
+    // A pair is a single code point beyond the basic plane
+    CHECK_EQ(Parsed("{\"msg\": \"\\uD83D\\uDE00\"}").Text(), "\xF0\x9F\x98\x80");
+    CHECK_EQ(Parsed("{\"msg\": \"\\udbff\\udfff!\"}").Text(), "\xF4\x8F\xBF\xBF!");
+
+    // Lone and swapped halves have no UTF-8 encoding
+    CHECK(!Parsed("{\"msg\": \"\\uD83D\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uD83Dx\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uD83D\\n\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uD83D\\u0041\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uD83D\\uD83D\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uDE00\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uDE00\\uD83D\"}").ok);
+    CHECK(!Parsed("{\"msg\": \"\\uD83D\\uDE0").ok);
+}
+
+static void TestScanBoundaries()
+{
+    // The vector scan looks at 16 bytes at a time, so put the quote and an escape at every offset around
+    // the block boundaries, with the string closing right at the end of the buffer as well
+    for (std::size_t n = 0; n <= 50; ++n)
+    {
+        std::string plain(n, 'p');
+        CHECK_EQ(Parsed("{\"msg\":\"" + plain + "\"}").Text(), plain);
+
+        std::string value = "{\"key\":\"k\",\"msg\":\"" + plain + "\"";
+        Parsed unterminated(value);
+        CHECK(!unterminated.ok);
+        CHECK_EQ(Parsed(value + "}").Text(), plain);
+
+        for (std::size_t at = 0; at <= n; ++at)
+        {
+            std::string escaped = plain.substr(0, at) + "\\\"" + plain.substr(at);
+            std::string expected = plain.substr(0, at) + "\"" + plain.substr(at);
+            CHECK_EQ(Parsed("{\"msg\":\"" + escaped + "\"}").Text(), expected);
+        }
+
+        // A string cut right after a backslash at any offset
+        CHECK(!Parsed("{\"msg\":\"" + plain + "\\").ok);
+    }
+}
+
+static void TestBatches()
+{
+    Parsed batch("[{\"msg\": \"a\", \"id\": 1}, {\"msg\": \"b\", \"id\": 2} ,{\"msg\":\"c\"}]");
+    CHECK(batch.ok);
+    CHECK_EQ(batch.frames.size(), 3);
+    if (batch.frames.size() == 3)
+    {
+        CHECK_EQ(batch.frames[1].text.ToString(), "b");
+        CHECK_EQ(batch.frames[1].requestId, 2);
+        CHECK(!batch.frames[2].hasRequestId);
+    }
+    CHECK(Parsed("[]").ok);
+    CHECK(Parsed(" [ ] ").frames.empty());
+
+    // Trailing garbage or a bad element fails the whole batch and appends nothing
+    for (const char* bad : { "[{\"msg\": \"a\"}] x", "[{\"msg\": \"a\"}]]", "[{\"msg\": \"a\"},]", "[{\"msg\": \"a\"}",
+                             "[{\"msg\": \"a\"} {\"msg\": \"b\"}]", "[{\"msg\": \"a\"}, 5]", "[{\"msg\": \"a\"}, {}]",
+                             "{\"msg\": \"a\"}{\"msg\": \"b\"}", "{\"msg\": \"a\"},", "[" })
+    {
+        Parsed p(bad);
+        CHECK(!p.ok);
+        CHECK(p.frames.empty());
+    }
+
+    // A NUL is not whitespace
+    CHECK(!Parsed(std::string("{\"msg\": \"a\"}\0", 13)).ok);
+
+    // A failed request leaves the frames of the earlier ones alone
+    std::string good = "{\"msg\": \"kept\"}";
+    std::string bad = "[{\"msg\": \"a\"}, {\"msg\": 1}]";
+    std::vector<NotifyFrame> frames;
+    CHECK(ParseJsonRequest(&good[0], &good[0] + good.size(), frames));
+    CHECK(!ParseJsonRequest(&bad[0], &bad[0] + bad.size(), frames));
+    CHECK_EQ(frames.size(), 1);
+}
+
+static void TestDepth()
+{
+    // Skipped values may nest 33 levels deep, deeper ones are refused rather than recursed into
+    auto nested = [](std::size_t levels) { return "{\"msg\": \"x\", \"deep\": " + std::string(levels, '[') + std::string(levels, ']') + "}"; };
+    CHECK(Parsed(nested(33)).ok);
+    CHECK(!Parsed(nested(34)).ok);
+    CHECK(!Parsed(nested(100000)).ok);
+
+    std::string objects = "{\"msg\": \"x\", \"deep\": ";
+    for (int i = 0; i < 40; ++i)
+        objects += "{\"a\":";
+    objects += "1" + std::string(40, '}') + "}";
+    CHECK(!Parsed(objects).ok);
+}
+
+static void TestDetection()
+{
+    CHECK(IsJsonRequest(Slice(" {\"msg\": 1}", 11)));
+    CHECK(IsJsonRequest(Slice("[ {", 3)));
+    CHECK(IsJsonRequest(Slice("[]", 2)));
+    CHECK(!IsJsonRequest(Slice("[high] text", 11)));
+    CHECK(!IsJsonRequest(Slice("plain", 5)));
+    CHECK(!IsJsonRequest(Slice()));
+    CHECK(IsJsonQuery(Slice("{ \"query\": \"stats\"}", 19)));
+    CHECK(!IsJsonQuery(Slice("{\"msg\": \"query\"}", 16)));
+}
+
+static void TestQuery()
+{
+    QueryKind kind;
+    HistoryQuery q;
+    CHECK(ParseQuery("{\"query\": \"history\", \"since\": 1700000000000, \"until\": 1800000000000, \"source\": \"10.0.0.7\", "
+                     "\"text\": \"disk* \\u0066ull\", \"limit\": 50, \"cursor\": 18446744073709551615, \"id\": 8, \"x\": [1]}", kind, q));
+    CHECK(kind == QueryKind::History);
+    CHECK_EQ(q.since, 1700000000000LL);
+    CHECK_EQ(q.until, 1800000000000LL);
+    CHECK_EQ(q.source, "10.0.0.7");
+    CHECK_EQ(q.text, "disk* full");
+    CHECK_EQ(q.limit, 50);
+    CHECK(q.cursor == 18446744073709551615ULL);
+    CHECK(q.hasRequestId);
+    CHECK_EQ(q.requestId, 8);
+
+    CHECK(ParseQuery("{\"query\":\"stats\"}", kind, q));
+    CHECK(kind == QueryKind::Stats);
+    CHECK_EQ(q.limit, HistoryQuery().limit);
+
+    // Unknown kinds, bad numbers and anything after the query are refused
+    for (const char* bad : { "{\"query\": \"nope\"}", "{\"since\": 1}", "{\"query\": \"history\", \"limit\": -1}",
+                             "{\"query\": \"history\", \"limit\": 4294967296}", "{\"query\": \"history\", \"since\": 9223372036854775808}",
+                             "{\"query\": \"history\"} x", "{\"query\": \"history\"", "{\"query\": \"history\",}", "{}" })
+        CHECK(!ParseQuery(bad, kind, q));
+}
+
+int main()
+{
+    TestNotification();
+    TestEscapes();
+    TestSurrogates();
+    TestScanBoundaries();
+    TestBatches();
+    TestDepth();
+    TestDetection();
+    TestQuery();
+    return CheckResult();
+}
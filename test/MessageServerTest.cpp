@@ -0,0 +1,338 @@
+#include "MessageServer.hpp"
+#include "JsonRequest.hpp"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include "Check.hpp"
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The notifications delivered by the server, filled on its thread
+static std::mutex deliveredMutex;
+static std::vector<std::string> delivered;
+
+// The queue the delivered notifications go to while a flow control test runs, the test drains it
+static FlowControl queue(8, 2);
+static std::atomic<bool> queueing(false);
+
+static std::size_t DeliveredCount()
+{
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    return delivered.size();
+}
+
+// Waits until the server delivered the given number of notifications or a second passed
+static bool WaitDelivered(std::size_t count)
+{
+    for (int i = 0; i < 100 && DeliveredCount() < count; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    return DeliveredCount() == count;
+}
+
+// A client connection that writes the given parts with a pause between them
+class Client
+{
+    public:
+        explicit Client(unsigned short port)
+            : mSocket(mIOService)
+        {
+            mSocket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port));
+        }
+
+        /// Writes the given data, a connection closed by the server is left for WaitClosed to notice
+        void Send(const std::string& data)
+        {
+            asio::error_code ec;
+            asio::write(mSocket, asio::buffer(data), ec);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        }
+
+        /// Reads until the server closes the connection or the given time passes, returns whether it closed
+        bool WaitClosed(std::chrono::milliseconds timeout)
+        {
+            auto deadline = std::chrono::steady_clock::now() + timeout;
+            mSocket.non_blocking(true);
+            char buf[4096];
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                asio::error_code ec;
+                mSocket.read_some(asio::buffer(buf), ec);
+                if (ec == asio::error::eof || ec == asio::error::connection_reset)
+                    return true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return false;
+        }
+
+    private:
+        asio::io_service mIOService;
+        asio::ip::tcp::socket mSocket;
+};
+
+// Builds a JSON batch of the given number of notifications, each message padded to make the batch large
+static std::string MakeBatch(std::size_t count)
+{
+    std::string batch = "[";
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (i != 0)
+            batch += ",";
+        batch += "{\"msg\": \"batch " + std::to_string(i) + " " + std::string(100, 'x') + "\", \"ack\": \"none\"}";
+    }
+    return batch + "]";
+}
+
+static void TestSplitJsonBatch(unsigned short port)
+{
+    // A batch over a few read blocks, written in uneven parts: only its NUL ends it
+    std::string batch = MakeBatch(100);
+    CHECK(batch.size() > 3 * 4096);
+    Client c(port);
+    for (std::size_t at = 0; at < batch.size(); at += 3000)
+        c.Send(batch.substr(at, 3000));
+    CHECK_EQ(DeliveredCount(), 0);
+    c.Send(std::string(1, '\0'));
+    CHECK(WaitDelivered(100));
+
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    for (std::size_t i = 0; i < delivered.size(); ++i)
+        CHECK_EQ(delivered[i].substr(0, 6 + std::to_string(i).size()), "batch " + std::to_string(i));
+    delivered.clear();
+}
+
+static void TestLegacyText(unsigned short port)
+{
+    // Text requests may still end with the data sent in one go, and a lone [ waits to tell a batch from a tag
+    Client c(port);
+    c.Send("[high] no terminator");
+    CHECK(WaitDelivered(1));
+    c.Send("[");
+    c.Send("{\"msg\": \"late batch\"}]");
+    CHECK_EQ(DeliveredCount(), 1);
+    c.Send(std::string(1, '\0'));
+    CHECK(WaitDelivered(2));
+
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    CHECK_EQ(delivered.front(), "no terminator");
+    CHECK_EQ(delivered.back(), "late batch");
+    delivered.clear();
+}
+
+static void TestOversizedJson(unsigned short port)
+{
+    // A JSON request that never ends is dropped with its connection once it passes the limit
+    Client c(port);
+    c.Send("{\"msg\": \"");
+    std::string chunk(64 * 1024, 'x');
+    for (std::size_t sent = 0; sent <= MaxJsonRequest; sent += chunk.size())
+        c.Send(chunk);
+    CHECK(c.WaitClosed(std::chrono::milliseconds(2000)));
+    CHECK_EQ(DeliveredCount(), 0);
+}
+
+static void TestReadTimeout(unsigned short port)
+{
+    // An unterminated JSON request is a partial request, it falls under the read timeout
+    Client c(port);
+    c.Send("{\"msg\": \"never terminated\"}");
+    CHECK(c.WaitClosed(std::chrono::milliseconds(2000)));
+    CHECK_EQ(DeliveredCount(), 0);
+}
+
+static void TestIdleTimeout(MessageServer& server)
+{
+    // A connection that sends nothing is closed once the idle timeout passes, every complete request restarts it
+    std::uint64_t idleTimeouts = server.GetConnectionManager().GetIdleTimeoutCount();
+    Client silent(server.GetPort());
+    Client active(server.GetPort());
+    for (int i = 0; i < 4; ++i)
+    {
+        active.Send("[ack=none] still here" + std::string(1, '\0'));
+        std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    }
+    CHECK(silent.WaitClosed(std::chrono::milliseconds(100)));
+    CHECK(!active.WaitClosed(std::chrono::milliseconds(100)));
+    CHECK(active.WaitClosed(std::chrono::milliseconds(3000)));
+    CHECK_EQ(server.GetConnectionManager().GetIdleTimeoutCount(), idleTimeouts + 2);
+
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    CHECK_EQ(delivered.size(), 4);
+    delivered.clear();
+}
+
+static void TestSharedAddressBudget(unsigned short port, const MessageServer& server)
+{
+    // The server allows 10 messages at once per client ip and refuses the rest without pausing: a second connection
+    // from the same ip gets what the first one left, and critical messages are never limited
+    std::uint64_t throttled = server.GetConnectionManager().GetThrottledCount();
+    std::string eight;
+    for (int i = 0; i < 8; ++i)
+        eight += "[ack=none] budget " + std::to_string(i) + std::string(1, '\0');
+    Client first(port);
+    Client second(port);
+    first.Send(eight);
+    second.Send(eight);
+    second.Send("[ack=none][critical] over budget" + std::string(1, '\0'));
+    CHECK(WaitDelivered(11));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK_EQ(DeliveredCount(), 11);
+    CHECK_EQ(server.GetConnectionManager().GetThrottledCount(), throttled + 6);
+
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    CHECK_EQ(delivered.back(), "over budget");
+    delivered.clear();
+}
+
+static void TestSharedMemory(const std::string& name)
+{
+    // The listener sleeps on an empty ring, every record after a pause has to wake it up
+    ShmRingProducer producer;
+    CHECK(producer.Open(name));
+    for (int i = 0; i < 3; ++i)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        CHECK(producer.TryPush("[high] ring " + std::to_string(i)));
+        CHECK(WaitDelivered(i + 1));
+    }
+
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    CHECK_EQ(delivered.back(), "ring 2");
+    delivered.clear();
+}
+
+static void TestFlowControl(MessageServer& server)
+{
+    // Three connections send one message per read. Once the queue is at the high watermark each of them parks after
+    // its current read and leaves the rest in its socket
+    queueing = true;
+    Client a(server.GetPort()), b(server.GetPort()), c(server.GetPort());
+    Client* clients[] = { &a, &b, &c };
+    for (int round = 0; round < 5; ++round)
+        for (Client* client : clients)
+            client->Send("[ack=none] flow " + std::to_string(round) + std::string(1, '\0'));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::size_t held = DeliveredCount();
+    CHECK(held >= 8 && held <= 11);
+    CHECK(queue.IsPaused());
+    CHECK_EQ(server.GetPausedConnectionCount(), 3);
+
+    // Draining above the low watermark resumes nobody
+    while (queue.GetDepth() > 3)
+        queue.OnDrained();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CHECK_EQ(DeliveredCount(), held);
+    CHECK_EQ(server.GetPausedConnectionCount(), 3);
+
+    // At the low watermark every parked connection resumes and the rest arrives, below the high watermark again
+    queue.OnDrained();
+    CHECK(WaitDelivered(15));
+    CHECK_EQ(server.GetPausedConnectionCount(), 0);
+    CHECK(!queue.IsPaused());
+    CHECK_EQ(queue.GetPauseCount(), 1);
+
+    queueing = false;
+    while (queue.GetDepth() > 0)
+        queue.OnDrained();
+    std::lock_guard<std::mutex> lock(deliveredMutex);
+    delivered.clear();
+}
+
+static void TestPortsTaken()
+{
+    // A UDP or HTTP port held by someone else or a bad address fails the call, the server goes on without that listener
+    asio::io_service ios;
+    asio::ip::udp::socket udp(ios, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::acceptor tcp(ios, asio::ip::tcp::endpoint(asio::ip::tcp::v4(), 0), false);
+
+    MessageServer other(0);
+    CHECK(!other.ListenUdp(udp.local_endpoint().port()));
+    CHECK(!other.ServeHttp(tcp.local_endpoint().port()));
+    CHECK(!other.ServeHttp(0, "not an address"));
+    CHECK(other.ListenUdp(0));
+    CHECK(other.ServeHttp(0));
+}
+
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+static void TestLocalSocketInUse()
+{
+    std::string path = "/tmp/newsflash-test-" + std::to_string(getpid()) + ".sock";
+    std::remove(path.c_str());
+
+    // A socket another server still accepts on is left alone
+    {
+        MessageServer first(0);
+        CHECK(first.ListenLocal(path));
+        MessageServer second(0);
+        CHECK(!second.ListenLocal(path));
+        asio::io_service ios;
+        asio::local::stream_protocol::socket probe(ios);
+        asio::error_code ec;
+        probe.connect(asio::local::stream_protocol::endpoint(path), ec);
+        CHECK(!ec);
+    }
+
+    // The servers above never ran to their stop, so like a crashed server they left the socket file behind to replace
+    struct stat st;
+    CHECK(lstat(path.c_str(), &st) == 0);
+    MessageServer next(0);
+    CHECK(next.ListenLocal(path));
+
+    // Anything but a socket is never removed
+    std::string file = path + ".txt";
+    std::FILE* f = std::fopen(file.c_str(), "w");
+    std::fclose(f);
+    CHECK(!next.ListenLocal(file));
+    CHECK(std::remove(file.c_str()) == 0);
+    std::remove(path.c_str());
+}
+#endif
+
+int main()
+{
+    SetNotificationEventCallback(
+        [](const NotificationData& data)
+        {
+            std::lock_guard<std::mutex> lock(deliveredMutex);
+            delivered.push_back(data.msg);
+            if (queueing)
+                queue.OnQueued();
+        }
+    );
+
+    MessageServer server(0);
+    server.SetTimeouts(std::chrono::seconds(1), std::chrono::milliseconds(300));
+    server.SetRateLimits(RateLimit{0, 0}, RateLimit{0, 0});
+    server.SetFlowControl(queue);
+    std::string ring = "NewsFlashTestServer" + std::to_string(getpid());
+    CHECK(server.ListenSharedMemory(ring, 4096));
+    std::thread t([&server]() { server.Run(); });
+
+    // A second server with a tight limit per client ip, one token every 100 seconds after the first 10
+    MessageServer limited(0);
+    limited.SetRateLimits(RateLimit{0, 0}, RateLimit{0.01, 10});
+    limited.SetThrottleAction(ThrottleAction::Reply);
+    std::thread lt([&limited]() { limited.Run(); });
+
+    unsigned short port = server.GetPort();
+    TestSplitJsonBatch(port);
+    TestLegacyText(port);
+    TestOversizedJson(port);
+    TestReadTimeout(port);
+    TestIdleTimeout(server);
+    TestSharedMemory(ring);
+    TestFlowControl(server);
+    TestSharedAddressBudget(limited.GetPort(), limited);
+    TestPortsTaken();
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    TestLocalSocketInUse();
+#endif
+
+    std::raise(SIGTERM);
+    t.join();
+    lt.join();
+    return CheckResult();
+}
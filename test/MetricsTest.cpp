@@ -0,0 +1,92 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+#include "Check.hpp"
+
+static void TestCounter()
+{
+    // Adds from more threads than there are shards sum exactly
+    Counter c;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 20; ++t)
+        threads.emplace_back([&c]() { for (int i = 0; i < 100000; ++i) c.Add(); });
+    for (std::thread& t : threads)
+        t.join();
+    c.Add(5);
+    CHECK_EQ(c.Get(), 2000005);
+}
+
+static void TestBuckets()
+{
+    // Every value lands in a bucket that ends within 1/16 of it, past the end of the one before
+    std::mt19937_64 rng(1);
+    for (int i = 0; i < 200000; ++i)
+    {
+        std::uint64_t v = i < 100000 ? static_cast<std::uint64_t>(i) : rng() >> (rng() % 64);
+        std::size_t b = Histogram::GetBucket(v);
+        std::uint64_t limit = Histogram::GetBucketLimit(b);
+        CHECK(b < HistogramBuckets);
+        CHECK(limit >= v && limit - v <= v / 16);
+        CHECK(b == 0 || Histogram::GetBucketLimit(b - 1) < v);
+    }
+    CHECK(Histogram::GetBucket(~std::uint64_t(0)) < HistogramBuckets);
+}
+
+static void TestPercentiles()
+{
+    // Latency like values spread over six orders of magnitude, the percentiles are
+    // rounded up to the end of their bucket so they may be up to 1/16 above the exact ones
+    Histogram h;
+    std::mt19937 rng(2);
+    std::vector<std::uint64_t> values;
+    for (int i = 0; i < 800000; ++i)
+    {
+        std::uint64_t v = static_cast<std::uint64_t>(std::exp(std::uniform_real_distribution<double>(0, 14)(rng)));
+        values.push_back(v);
+        h.Record(v);
+    }
+    std::sort(values.begin(), values.end());
+
+    HistogramSnapshot s;
+    h.Read(s);
+    CHECK_EQ(s.count, values.size());
+    CHECK_EQ(s.max, values.back());
+    for (double fraction : { 0.5, 0.9, 0.99, 0.999 })
+    {
+        std::uint64_t exact = values[static_cast<std::size_t>(fraction * values.size()) - 1];
+        std::uint64_t p = s.GetPercentile(fraction);
+        CHECK(p >= exact && p - exact <= exact / 16);
+    }
+    CHECK_EQ(s.GetPercentile(1.0), values.back());
+    CHECK_EQ(HistogramSnapshot().GetPercentile(0.5), 0);
+}
+
+static void TestRegistry()
+{
+    // A name registers once, and snapshots read the metrics by name
+    MetricsRegistry r;
+    Counter& c = r.GetCounter("requests_total", "Requests");
+    CHECK(&r.GetCounter("requests_total", "Requests") == &c);
+    c.Add(3);
+    r.GetGauge("queue_depth", "Queue depth").Set(-2);
+    r.GetHistogram("latency_us", "Latency").Record(std::chrono::milliseconds(2));
+
+    MetricsSnapshot s = r.Snapshot();
+    CHECK_EQ(s.GetCounter("requests_total"), 3);
+    CHECK_EQ(s.GetCounter("missing"), 0);
+    CHECK_EQ(s.GetGauge("queue_depth"), -2);
+    const HistogramSnapshot* h = s.FindHistogram("latency_us");
+    CHECK(h != nullptr && h->count == 1 && h->sum == 2000);
+    CHECK(s.FindHistogram("missing") == nullptr);
+}
+
+int main()
+{
+    TestCounter();
+    TestBuckets();
+    TestPercentiles();
+    TestRegistry();
+    return CheckResult();
+}
@@ -0,0 +1,131 @@
+#include "NotificationStack.hpp"
+#include <vector>
+#include "Check.hpp"
+
+// A move reported by a layout pass
+struct Move
+{
+    SlotHandle handle;
+    int y;
+};
+
+// Runs a layout pass and returns the moves it made
+static std::vector<Move> Layout(NotificationStack& stack, const StackLayout& layout)
+{
+    std::vector<Move> moves;
+    std::size_t count = stack.Layout(layout,
+        [&moves](SlotHandle h, const SlotGeometry& g)
+        {
+            moves.push_back(Move{ h, g.y });
+        }
+    );
+    CHECK_EQ(count, moves.size());
+    return moves;
+}
+
+static StackLayout MakeLayout()
+{
+    // Five slots of 250 pixels, the first at the top of the display
+    StackLayout layout;
+    layout.SetDisplays({ DisplayInfo{ LayoutRect{ 0, 0, 1920, 1200 }, 96 } });
+    return layout;
+}
+
+static void TestPush()
+{
+    StackLayout layout = MakeLayout();
+    NotificationStack stack;
+    CHECK(!stack.IsDirty());
+    CHECK(Layout(stack, layout).empty());
+
+    // The latest notification is on top, and a burst of spawns is placed in a single pass
+    const SlotHandle a = { 0, 0 }, b = { 1, 0 }, c = { 2, 0 };
+    stack.PushFront(a);
+    stack.PushFront(b);
+    stack.PushFront(c);
+    CHECK(stack.IsDirty());
+    CHECK_EQ(stack.Size(), 3);
+    CHECK(stack.Get(0) == c);
+    CHECK(stack.Get(2) == a);
+    std::vector<Move> moves = Layout(stack, layout);
+    CHECK_EQ(moves.size(), 3);
+    CHECK(moves[0].handle == c);
+    CHECK_EQ(moves[0].y, 0);
+    CHECK(moves[2].handle == a);
+    CHECK_EQ(moves[2].y, 500);
+    CHECK(!stack.IsDirty());
+    CHECK(Layout(stack, layout).empty());
+
+    // Another spawn shifts every notification below it down a slot
+    const SlotHandle d = { 3, 0 };
+    stack.PushFront(d);
+    moves = Layout(stack, layout);
+    CHECK_EQ(moves.size(), 4);
+    CHECK(moves[3].handle == a);
+    CHECK_EQ(moves[3].y, 750);
+}
+
+static void TestRemove()
+{
+    StackLayout layout = MakeLayout();
+    NotificationStack stack;
+    for (std::uint32_t i = 0; i < 5; ++i)
+        stack.PushFront(SlotHandle{ i, 0 });
+    Layout(stack, layout);
+
+    // Only the notifications above the one that went move, the ones below keep their slot
+    CHECK(stack.Remove(SlotHandle{ 2, 0 }));
+    CHECK(!stack.Remove(SlotHandle{ 2, 0 }));
+    CHECK(!stack.Remove(SlotHandle{ 3, 1 }));
+    std::vector<Move> moves = Layout(stack, layout);
+    CHECK_EQ(moves.size(), 2);
+    CHECK(moves[0].handle == (SlotHandle{ 1, 0 }));
+    CHECK_EQ(moves[0].y, 500);
+    CHECK(moves[1].handle == (SlotHandle{ 0, 0 }));
+    CHECK_EQ(moves[1].y, 750);
+
+    // The oldest one going moves nothing, yet still takes a pass
+    CHECK(stack.Remove(SlotHandle{ 0, 0 }));
+    CHECK(stack.IsDirty());
+    CHECK(Layout(stack, layout).empty());
+    CHECK_EQ(stack.Size(), 3);
+    CHECK(stack.Get(0) == (SlotHandle{ 4, 0 }));
+    CHECK(stack.Get(2) == (SlotHandle{ 1, 0 }));
+}
+
+static void TestTruncate()
+{
+    StackLayout layout = MakeLayout();
+    NotificationStack stack;
+    for (std::uint32_t i = 0; i < 5; ++i)
+        stack.PushFront(SlotHandle{ i, 0 });
+    Layout(stack, layout);
+
+    // The bottom of the stack goes, the top keeps its order and its slots
+    stack.Truncate(2);
+    CHECK_EQ(stack.Size(), 2);
+    CHECK(stack.Get(0) == (SlotHandle{ 4, 0 }));
+    CHECK(stack.Get(1) == (SlotHandle{ 3, 0 }));
+    CHECK(Layout(stack, layout).empty());
+    stack.Truncate(3);
+    CHECK_EQ(stack.Size(), 2);
+    CHECK(!stack.IsDirty());
+
+    // Once the slots are forgotten, every notification is placed again
+    stack.Invalidate();
+    std::vector<Move> moves = Layout(stack, layout);
+    CHECK_EQ(moves.size(), 2);
+    CHECK_EQ(moves[1].y, 250);
+
+    stack.Clear();
+    CHECK_EQ(stack.Size(), 0);
+    CHECK(!stack.IsDirty());
+}
+
+int main()
+{
+    TestPush();
+    TestRemove();
+    TestTruncate();
+    return CheckResult();
+}
@@ -0,0 +1,267 @@
+#include "Protocol.hpp"
+#include <algorithm>
+#include <iterator>
+#include "Check.hpp"
+
+// Builds a notification with every field the frames carry
+static NotificationData MakeNotification(const std::string& msg, const std::string& key)
+{
+    NotificationData data;
+    data.msg = msg;
+    data.lifetime = 4500;
+    data.priority = Priority::High;
+    data.dedupKey = key;
+    return data;
+}
+
+// Appends a raw TLV field, the length is written as given so it can lie about the value
+static void AppendField(std::string& out, std::uint8_t tag, std::uint16_t length, const std::string& value)
+{
+    out.push_back(static_cast<char>(tag));
+    out.push_back(static_cast<char>(length & 0xFF));
+    out.push_back(static_cast<char>(length >> 8));
+    out += value;
+}
+
+// Parses the given payload and reports whether it is accepted
+static bool ParsePayload(const std::string& payload)
+{
+    NotifyFrame f;
+    return ParseNotifyFrame(Slice(payload.data(), payload.size()), f);
+}
+
+static void TestRoundTrip()
+{
+    for (const std::string& msg : { std::string(), std::string("Build finished"), std::string("\xCE\xB1\0\xCE\xB2", 5), std::string(60000, 'x') })
+    {
+        NotificationData in = MakeNotification(msg, msg.size() < 100 ? "build" : "");
+        std::string frame = EncodeNotifyFrame(in, 0xDEADBEEF);
+
+        FrameHeader h;
+        CHECK(ParseFrameHeader(Slice(frame.data(), frame.size()), h) == FrameStatus::Ready);
+        CHECK_EQ(h.version, ProtocolVersion);
+        CHECK(h.type == FrameType::Notify);
+        CHECK_EQ(h.flags, 0);
+        CHECK_EQ(h.length, frame.size() - FrameHeaderSize);
+
+        NotifyFrame f;
+        CHECK(ParseNotifyFrame(Slice(frame.data() + FrameHeaderSize, h.length), f));
+        NotificationData out = ToNotificationData(f, AckFormat::Binary);
+        CHECK_EQ(out.msg, in.msg);
+        CHECK_EQ(out.dedupKey, in.dedupKey);
+        CHECK_EQ(out.lifetime, in.lifetime);
+        CHECK(out.priority == in.priority);
+        CHECK(out.ack.hasRequestId);
+        CHECK_EQ(out.ack.requestId, 0xDEADBEEF);
+        CHECK(out.ack.mode == AckMode::Accepted);
+        CHECK(out.ack.format == AckFormat::Binary);
+
+        // The slices point into the frame, nothing is copied before ToNotificationData
+        CHECK(f.text.data >= frame.data() && f.text.end() <= frame.data() + frame.size());
+    }
+}
+
+static void TestOversizedFields()
+{
+    // Texts and keys too long for a field or a frame are cut at a character boundary, the text getting its share
+    // first, and the frame still parses. 18 bytes go to the fixed size fields and 3 to each field header
+    std::string alpha;
+    for (int i = 0; i < 40000; ++i)
+        alpha += "\xCE\xB1";
+    struct Case
+    {
+        std::string text;
+        std::string key;
+        std::size_t textSize;
+        std::size_t keySize;
+    };
+    const Case cases[] = {
+        { std::string(70000, 'x'), "", MaxFramePayload - 21, 0 },
+        { alpha, "", MaxFramePayload - 22, 0 },
+        { std::string(65000, 'x'), std::string(2000, 'k'), 65000, MaxFramePayload - 24 - 65000 },
+        { "short", alpha, 5, MaxFramePayload - 24 - 6 },
+        { alpha, alpha, MaxFramePayload - 24, 0 },
+    };
+    for (const Case& c : cases)
+    {
+        std::string frame = EncodeNotifyFrame(MakeNotification(c.text, c.key), 9);
+        FrameHeader h;
+        CHECK(ParseFrameHeader(Slice(frame.data(), frame.size()), h) == FrameStatus::Ready);
+        CHECK(h.length <= MaxFramePayload);
+        CHECK_EQ(h.length, frame.size() - FrameHeaderSize);
+
+        NotifyFrame f;
+        CHECK(ParseNotifyFrame(Slice(frame.data() + FrameHeaderSize, h.length), f));
+        CHECK_EQ(f.requestId, 9);
+        CHECK_EQ(f.lifetime, 4500);
+        CHECK_EQ(f.text.ToString(), c.text.substr(0, c.textSize));
+        CHECK_EQ(f.dedupKey.ToString(), c.key.substr(0, c.keySize));
+    }
+}
+
+static void TestFlags()
+{
+    std::string frame = EncodeNotifyFrame(MakeNotification("quiet", ""), 1, FlagNoAck);
+    FrameHeader h;
+    CHECK(ParseFrameHeader(Slice(frame.data(), frame.size()), h) == FrameStatus::Ready);
+    CHECK_EQ(h.flags, FlagNoAck);
+}
+
+static void TestAckFrame()
+{
+    AckTarget target;
+    target.requestId = 42;
+    target.hasRequestId = true;
+    std::string frame = EncodeAckFrame(target, AckStatus::Throttled);
+
+    FrameHeader h;
+    CHECK(ParseFrameHeader(Slice(frame.data(), frame.size()), h) == FrameStatus::Ready);
+    CHECK(h.type == FrameType::Ack);
+
+    // The ack fields are TLVs as well, a notification parser reads the request id and skips the status
+    NotifyFrame f;
+    CHECK(ParseNotifyFrame(Slice(frame.data() + FrameHeaderSize, h.length), f));
+    CHECK(f.hasRequestId);
+    CHECK_EQ(f.requestId, 42);
+    CHECK_EQ(static_cast<unsigned char>(frame.back()), static_cast<unsigned char>(AckStatus::Throttled));
+
+    // Without a request id only the status is sent
+    std::string bare = EncodeAckFrame(AckTarget(), AckStatus::Accepted);
+    CHECK_EQ(bare.size(), FrameHeaderSize + 4);
+}
+
+static void TestIncomplete()
+{
+    // Every prefix of a frame asks for more bytes, the whole frame is ready, and trailing bytes are left alone
+    std::string frame = EncodeNotifyFrame(MakeNotification("split across reads", "k"), 7);
+    FrameHeader h;
+    for (std::size_t i = 0; i < frame.size(); ++i)
+        CHECK(ParseFrameHeader(Slice(frame.data(), i), h) == (i == 0 ? FrameStatus::Invalid : FrameStatus::Incomplete));
+
+    std::string two = frame + frame;
+    CHECK(ParseFrameHeader(Slice(two.data(), two.size()), h) == FrameStatus::Ready);
+    CHECK_EQ(h.length, frame.size() - FrameHeaderSize);
+}
+
+static void TestInvalidHeader()
+{
+    FrameHeader h;
+    std::string frame = EncodeNotifyFrame(MakeNotification("x", ""), 1);
+
+    // Text requests and anything else that does not start with the magic
+    std::string text = "plain text request";
+    CHECK(ParseFrameHeader(Slice(text.data(), text.size()), h) == FrameStatus::Invalid);
+    CHECK(!IsFrameStart(Slice(text.data(), text.size())));
+    std::string badMagic = frame;
+    badMagic[1] = 'X';
+    CHECK(ParseFrameHeader(Slice(badMagic.data(), badMagic.size()), h) == FrameStatus::Invalid);
+    CHECK(ParseFrameHeader(Slice(badMagic.data(), 2), h) == FrameStatus::Invalid);
+
+    // Version zero was never spoken
+    std::string v0 = frame;
+    v0[2] = 0;
+    CHECK(ParseFrameHeader(Slice(v0.data(), v0.size()), h) == FrameStatus::Invalid);
+
+    // Newer versions and unknown types are left to the caller
+    std::string v9 = frame;
+    v9[2] = 9;
+    v9[3] = 77;
+    CHECK(ParseFrameHeader(Slice(v9.data(), v9.size()), h) == FrameStatus::Ready);
+    CHECK_EQ(h.version, 9);
+
+    // Oversized payloads are refused from the header alone, before any of the payload arrives
+    std::string big = frame.substr(0, FrameHeaderSize);
+    std::uint32_t length = MaxFramePayload + 1;
+    for (int i = 0; i < 4; ++i)
+        big[6 + i] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    CHECK(ParseFrameHeader(Slice(big.data(), big.size()), h) == FrameStatus::Invalid);
+    big[9] = static_cast<char>(0xFF);
+    CHECK(ParseFrameHeader(Slice(big.data(), big.size()), h) == FrameStatus::Invalid);
+}
+
+static void TestDefaults()
+{
+    NotifyFrame f;
+    CHECK(ParseNotifyFrame(Slice(), f));
+    CHECK(f.text.Empty());
+    CHECK(f.dedupKey.Empty());
+    CHECK_EQ(f.lifetime, 3000);
+    CHECK(f.priority == Priority::Normal);
+    CHECK(!f.hasRequestId);
+    CHECK(f.ack == AckMode::Accepted);
+}
+
+static void TestMalformedPayload()
+{
+    // Truncated field headers
+    CHECK(!ParsePayload(std::string(1, '\x01')));
+    CHECK(!ParsePayload(std::string("\x01\x05", 2)));
+
+    // A length that runs past the payload
+    std::string overrun;
+    AppendField(overrun, 1, 10, "short");
+    CHECK(!ParsePayload(overrun));
+
+    // Fixed size fields with the wrong size
+    for (std::uint8_t tag : { std::uint8_t(2), std::uint8_t(5) })
+    {
+        for (std::size_t size : { 0, 3, 5 })
+        {
+            std::string p;
+            AppendField(p, tag, static_cast<std::uint16_t>(size), std::string(size, '\0'));
+            CHECK(!ParsePayload(p));
+        }
+    }
+    std::string wide;
+    AppendField(wide, 3, 2, std::string(2, '\0'));
+    CHECK(!ParsePayload(wide));
+
+    // Out of range enumerations
+    std::string priority;
+    AppendField(priority, 3, 1, std::string(1, static_cast<char>(PriorityLevels)));
+    CHECK(!ParsePayload(priority));
+    std::string ack;
+    AppendField(ack, 7, 1, std::string(1, '\x03'));
+    CHECK(!ParsePayload(ack));
+
+    // Every truncation of a valid payload that does not fall on a field boundary is refused
+    std::string frame = EncodeNotifyFrame(MakeNotification("truncate me", "key"), 3);
+    std::string payload = frame.substr(FrameHeaderSize);
+    std::size_t boundaries[] = { 0, 3 + 11, 3 + 11 + 3 + 3, 3 + 11 + 3 + 3 + 7, 3 + 11 + 3 + 3 + 7 + 4 };
+    for (std::size_t i = 0; i < payload.size(); ++i)
+    {
+        bool boundary = std::find(std::begin(boundaries), std::end(boundaries), i) != std::end(boundaries);
+        CHECK_EQ(ParsePayload(payload.substr(0, i)), boundary);
+    }
+}
+
+static void TestFieldRules()
+{
+    // Unknown tags are skipped, repeated fields keep the last value
+    std::string p;
+    AppendField(p, 200, 3, "new");
+    AppendField(p, 1, 5, "first");
+    AppendField(p, 1, 6, "second");
+    AppendField(p, 3, 1, std::string(1, '\x03'));
+    AppendField(p, 7, 1, std::string(1, '\x02'));
+
+    NotifyFrame f;
+    CHECK(ParseNotifyFrame(Slice(p.data(), p.size()), f));
+    CHECK_EQ(f.text.ToString(), "second");
+    CHECK(f.priority == Priority::Critical);
+    CHECK(f.ack == AckMode::Displayed);
+}
+
+int main()
+{
+    TestRoundTrip();
+    TestOversizedFields();
+    TestFlags();
+    TestAckFrame();
+    TestIncomplete();
+    TestInvalidHeader();
+    TestDefaults();
+    TestMalformedPayload();
+    TestFieldRules();
+    return CheckResult();
+}
@@ -0,0 +1,129 @@
+#include "SearchIndex.hpp"
+#include <algorithm>
+#include <random>
+#include "Check.hpp"
+
+// Splits the given text into its words
+static std::vector<std::string> Words(const std::string& text)
+{
+    std::vector<std::string> words;
+    ForEachWord(Slice(text.data(), text.size()), [&words](const std::string& w) { words.push_back(w); });
+    return words;
+}
+
+// Joins the given terms into one string, a prefix ends with a *
+static std::string Terms(const std::vector<SearchTerm>& terms)
+{
+    std::string s;
+    for (const SearchTerm& t : terms)
+        s += (s.empty() ? "" : " ") + t.word + (t.prefix ? "*" : "");
+    return s;
+}
+
+static void TestWords()
+{
+    // Letters and digits make up the words, uppercase is folded and multibyte UTF-8 sequences belong to the word
+    CHECK_EQ(Words("Build #42 FAILED, on x86_64.").size(), 6);
+    CHECK_EQ(Words("Build #42 FAILED, on x86_64.")[2], "failed");
+    CHECK_EQ(Words("Build #42 FAILED, on x86_64.")[5], "64");
+    CHECK_EQ(Words("d\xC3\xA9j\xC3\xA0-vu").front(), "d\xC3\xA9j\xC3\xA0");
+    CHECK(Words(" \t-- !? ").empty());
+
+    // Long words are cut
+    std::vector<std::string> words = Words(std::string(40, 'A') + " b");
+    CHECK_EQ(words.size(), 2);
+    CHECK_EQ(words[0], std::string(SearchMaxWordLength, 'a'));
+
+    // A * ends a prefix, repeats go and the terms come sorted
+    CHECK_EQ(Terms(ParseSearch("Deploy* failed deploy* FAILED")), "deploy* failed");
+    CHECK_EQ(Terms(ParseSearch("deploy deploy*")), "deploy deploy*");
+    CHECK_EQ(Terms(ParseSearch("x86_64* *")), "64* x86");
+    CHECK_EQ(Terms(ParseSearch("  ")), "");
+}
+
+static void TestSeekDown()
+{
+    // Lists that end inside, at and right past a block, with gaps of one to three varint bytes
+    std::mt19937 rng(46);
+    const std::uint32_t sizes[] = { 0, 1, 63, 64, 65, 128, 1000 };
+    for (std::uint32_t size : sizes)
+    {
+        PostingList list;
+        std::vector<std::uint32_t> ids;
+        std::uint32_t id = rng() % 4;
+        for (std::uint32_t i = 0; i < size; ++i)
+        {
+            ids.push_back(id);
+            list.Add(id);
+            list.Add(id);
+            id += 1 + (rng() % 4 == 0 ? rng() % 100000 : rng() % 8);
+        }
+        list.Shrink();
+        CHECK_EQ(list.Size(), size);
+        std::uint32_t top = ids.empty() ? 100 : ids.back() + 100;
+
+        // Bounds going down the way a search does, then a fresh cursor at random bounds
+        PostingList::Cursor down(list);
+        PostingList::Cursor random(list);
+        for (std::uint32_t bound = top, step = 0; step < 5000; ++step)
+        {
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                std::uint32_t b = pass == 0 ? bound : rng() % (top + 1);
+                auto it = std::upper_bound(ids.begin(), ids.end(), b);
+                std::uint32_t found = 0;
+                bool has = (pass == 0 ? down : random).SeekDown(b, found);
+                CHECK_EQ(has, it != ids.begin());
+                if (has && it != ids.begin() && found != *(it - 1))
+                    CheckFailed(__FILE__, __LINE__, "list of " + std::to_string(size) + " seeking " + std::to_string(b)
+                                + " found " + std::to_string(found) + ", expected " + std::to_string(*(it - 1)));
+            }
+            if (bound == 0)
+                break;
+            bound -= std::min<std::uint32_t>(bound, rng() % 3 == 0 ? rng() % 5000 : rng() % 4);
+        }
+    }
+}
+
+static void TestFind()
+{
+    SearchIndex index;
+    index.Add(1, Slice("deploy started", 14));
+    index.Add(2, Slice("deployment failed", 17));
+    index.Add(3, Slice("Deploy failed again", 19));
+    index.AddWord(3, "\x01local");
+    CHECK_EQ(index.GetWordCount(), 6);
+
+    // A prefix finds the same lists before and after the words are sorted
+    for (int sealed = 0; sealed < 2; ++sealed)
+    {
+        if (sealed)
+            index.Seal();
+        CHECK_EQ(index.Find(SearchTerm{"deploy", false}).size(), 1);
+        CHECK_EQ(index.Find(SearchTerm{"deploy", false}).front()->Size(), 2);
+        CHECK_EQ(index.Find(SearchTerm{"deploy", true}).size(), 2);
+        CHECK_EQ(index.Find(SearchTerm{"deployment", true}).size(), 1);
+        CHECK_EQ(index.Find(SearchTerm{"f", true}).size(), 1);
+        CHECK_EQ(index.Find(SearchTerm{"fail", true}).front()->Size(), 2);
+        CHECK(index.Find(SearchTerm{"fail", false}).empty());
+        CHECK(index.Find(SearchTerm{"zebra", true}).empty());
+        CHECK_EQ(index.Find(SearchTerm{"\x01local", false}).size(), 1);
+    }
+
+    // Past the expansion limit the rest of the words of a prefix are ignored
+    SearchIndex many;
+    for (std::uint32_t i = 0; i < SearchMaxExpansions + 10; ++i)
+        many.AddWord(i, "w" + std::to_string(i));
+    CHECK_EQ(many.Find(SearchTerm{"w", true}).size(), SearchMaxExpansions);
+    many.Seal();
+    CHECK_EQ(many.Find(SearchTerm{"w", true}).size(), SearchMaxExpansions);
+    CHECK_EQ(many.Find(SearchTerm{"w1", true}).size(), 1111);
+}
+
+int main()
+{
+    TestWords();
+    TestSeekDown();
+    TestFind();
+    return CheckResult();
+}
@@ -0,0 +1,200 @@
+#include "ShmRing.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Check.hpp"
+#if !defined(_WIN32)
+#include <unistd.h>
+#endif
+
+// A ring name of its own for every test, so a failed run leaves nothing the next one trips over
+static std::string RingName(const std::string& test)
+{
+    return "NewsFlashTest" + test + std::to_string(getpid());
+}
+
+// Reads everything the ring holds
+static std::vector<std::string> DrainAll(ShmRingConsumer& consumer)
+{
+    std::vector<std::string> records;
+    consumer.Drain([&records](char* data, std::size_t size) { records.emplace_back(data, size); }, 1000);
+    return records;
+}
+
+// Writes a raw record at the given ring offset, the length is written as given so it can lie about the data
+static void WriteRecord(ShmRegion& region, std::uint64_t offset, std::uint32_t length)
+{
+    std::memcpy(region.GetData() + offset, &length, 4);
+}
+
+static void TestRoundTrip()
+{
+    ShmRingConsumer consumer;
+    CHECK(consumer.Create(RingName("RoundTrip"), 256));
+    ShmRingProducer producer;
+    CHECK(producer.Open(RingName("RoundTrip")));
+
+    // Records of every padded size, enough of them to wrap around the ring many times
+    for (std::size_t round = 0; round < 50; ++round)
+    {
+        std::vector<std::string> sent;
+        for (std::size_t size = 0; size < 20; ++size)
+        {
+            std::string record(size + round % 7, static_cast<char>('a' + size));
+            if (!producer.TryPush(record))
+                break;
+            sent.push_back(record);
+        }
+        CHECK(!sent.empty());
+        std::vector<std::string> received = DrainAll(consumer);
+        CHECK(received == sent);
+    }
+    CHECK_EQ(consumer.GetResetCount(), 0);
+
+    // A record over half the ring never fits, a full ring refuses until drained
+    CHECK(!producer.TryPush(std::string(125, 'x')));
+    std::size_t pushed = 0;
+    while (producer.TryPush(std::string(60, 'x')))
+        ++pushed;
+    CHECK(pushed >= 3);
+    CHECK_EQ(DrainAll(consumer).size(), pushed);
+    CHECK(producer.TryPush(std::string(60, 'x')));
+}
+
+static void TestSingleOwner()
+{
+    // A running consumer keeps its ring, another one only gets the name once it is gone
+    ShmRingConsumer first;
+    CHECK(first.Create(RingName("Owner"), 256));
+    ShmRingConsumer second;
+    CHECK(!second.Create(RingName("Owner"), 256));
+    CHECK(!ShmRingConsumer().Create(RingName("Capacity"), 4));
+    CHECK(!ShmRingConsumer().Create(RingName("Capacity"), 100));
+
+    ShmRingProducer producer;
+    CHECK(producer.Open(RingName("Owner")));
+    CHECK(producer.TryPush("still the first ring"));
+    CHECK_EQ(DrainAll(first).size(), 1);
+    producer.Close();
+
+    first.GetRegion().Close();
+    CHECK(second.Create(RingName("Owner"), 256));
+
+#if !defined(_WIN32)
+    // A shared memory object without its lock was left behind by a consumer that is gone
+    std::string stale = "/" + RingName("Stale");
+    int fd = shm_open(stale.c_str(), O_CREAT | O_RDWR, 0600);
+    CHECK(fd >= 0);
+    close(fd);
+    ShmRingConsumer next;
+    CHECK(next.Create(RingName("Stale"), 256));
+#endif
+}
+
+static void TestMalformedRecords()
+{
+    ShmRingConsumer consumer;
+    CHECK(consumer.Create(RingName("Malformed"), 256));
+    ShmRegion region;
+    CHECK(region.Open(RingName("Malformed")));
+    ShmRingHeader* h = region.GetHeader();
+
+    // A length that runs past the end of the ring
+    WriteRecord(region, 0, 0x7FFFFFFF);
+    h->head.store(8);
+    CHECK(DrainAll(consumer).empty());
+    CHECK_EQ(consumer.GetResetCount(), 1);
+    CHECK_EQ(h->head.load(), 0);
+
+    // A length that fits the ring but runs past the head, after a good record that is still delivered
+    WriteRecord(region, 0, 3);
+    std::memcpy(region.GetData() + 4, "abc", 3);
+    WriteRecord(region, 8, 100);
+    h->head.store(24);
+    CHECK_EQ(DrainAll(consumer).size(), 1);
+    CHECK_EQ(consumer.GetResetCount(), 2);
+    CHECK_EQ(h->head.load(), 8);
+    CHECK_EQ(h->tail.load(), 8);
+
+    // A padding record that claims more than was published
+    WriteRecord(region, 8, ShmRingPadding);
+    h->head.store(16);
+    CHECK(DrainAll(consumer).empty());
+    CHECK_EQ(consumer.GetResetCount(), 3);
+
+    // Heads out of reach, behind the tail or off a record boundary
+    for (std::uint64_t head : { std::uint64_t(8 + 256 + 8), std::uint64_t(0), std::uint64_t(13), ~std::uint64_t(0) })
+    {
+        h->head.store(head);
+        CHECK(DrainAll(consumer).empty());
+        CHECK_EQ(h->head.load(), 8);
+    }
+    CHECK_EQ(consumer.GetResetCount(), 7);
+
+    // The capacity and the tail in the header are not trusted either
+    h->capacity = 1u << 30;
+    h->tail.store(1u << 20);
+    WriteRecord(region, 8, 2);
+    std::memcpy(region.GetData() + 12, "ok", 2);
+    h->head.store(16);
+    std::vector<std::string> records = DrainAll(consumer);
+    CHECK(records.size() == 1 && records[0] == "ok");
+    CHECK_EQ(consumer.GetResetCount(), 7);
+    CHECK_EQ(h->tail.load(), 16);
+    h->capacity = 256;
+
+    // The ring works again for a producer after the resets
+    region.Close();
+    ShmRingProducer producer;
+    CHECK(producer.Open(RingName("Malformed")));
+    CHECK(producer.TryPush("after the resets"));
+    records = DrainAll(consumer);
+    CHECK(records.size() == 1 && records[0] == "after the resets");
+}
+
+#if defined(__linux__)
+static void TestWakeup()
+{
+    ShmRingConsumer consumer;
+    CHECK(consumer.Create(RingName("Wakeup"), 256));
+    ShmRingProducer producer;
+    CHECK(producer.Open(RingName("Wakeup")));
+
+    // A ring with records to read is not slept on
+    CHECK(producer.TryPush("early"));
+    CHECK(!consumer.PrepareWait());
+    CHECK_EQ(DrainAll(consumer).size(), 1);
+
+    // The consumer sleeps until the producer publishes, and the producer clears the waiting flag as it wakes it
+    std::atomic<bool> woken(false);
+    CHECK(consumer.PrepareWait());
+    std::thread sleeper([&]() { consumer.Wait(); woken = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!woken);
+    CHECK(producer.TryPush("late"));
+    sleeper.join();
+    CHECK_EQ(consumer.GetRegion().GetHeader()->consumerWaiting.load(), 0);
+    CHECK_EQ(DrainAll(consumer).size(), 1);
+
+    // Wake ends the sleep as well, with nothing to read
+    woken = false;
+    CHECK(consumer.PrepareWait());
+    std::thread stopped([&]() { consumer.Wait(); woken = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!woken);
+    consumer.Wake();
+    stopped.join();
+    CHECK(DrainAll(consumer).empty());
+}
+#endif
+
+int main()
+{
+    TestRoundTrip();
+    TestSingleOwner();
+    TestMalformedRecords();
+#if defined(__linux__)
+    TestWakeup();
+#endif
+    return CheckResult();
+}
@@ -0,0 +1,148 @@
+#include "SlotMap.hpp"
+#include <map>
+#include <random>
+#include "Check.hpp"
+
+// An object that counts its live instances
+struct Counted
+{
+    static int alive;
+
+    explicit Counted(int v) : value(v) { ++alive; }
+    ~Counted() { --alive; }
+
+    int value;
+};
+
+int Counted::alive = 0;
+
+static void TestGenerations()
+{
+    SlotMap<Counted, 4> map;
+    SlotHandle a = map.Emplace(1);
+    SlotHandle b = map.Emplace(2);
+    CHECK(a != b);
+    CHECK_EQ(map.Size(), 2);
+    CHECK(map.Get(a) && map.Get(a)->value == 1);
+    CHECK(map.Get(b) && map.Get(b)->value == 2);
+
+    // An erased object is gone and its handle stale, erasing it again changes nothing
+    map.Erase(a);
+    CHECK(map.Get(a) == nullptr);
+    CHECK_EQ(map.Size(), 1);
+    CHECK_EQ(Counted::alive, 1);
+    map.Erase(a);
+    CHECK_EQ(map.Size(), 1);
+    CHECK_EQ(Counted::alive, 1);
+
+    // The slot is reused under a new generation, the old handle does not reach the new object
+    SlotHandle c = map.Emplace(3);
+    CHECK_EQ(c.index, a.index);
+    CHECK(c.generation != a.generation);
+    CHECK(map.Get(a) == nullptr);
+    CHECK(map.Get(c) && map.Get(c)->value == 3);
+    map.Erase(a);
+    CHECK(map.Get(c) != nullptr);
+
+    // Handles that never pointed to anything
+    CHECK(map.Get(SlotMap<Counted, 4>::Null) == nullptr);
+    CHECK(map.Get(SlotHandle{ 1000, 0 }) == nullptr);
+    CHECK(map.Get(SlotHandle{ 3, 0 }) == nullptr);
+}
+
+static void TestStableAddresses()
+{
+    // Growing by whole chunks never moves the objects already stored
+    SlotMap<Counted, 4> map;
+    std::vector<SlotHandle> handles;
+    std::vector<Counted*> addresses;
+    for (int i = 0; i < 100; ++i)
+    {
+        handles.push_back(map.Emplace(i));
+        addresses.push_back(map.Get(handles.back()));
+    }
+    for (int i = 0; i < 100; ++i)
+        CHECK(map.Get(handles[i]) == addresses[i] && addresses[i]->value == i);
+
+    // Clear destroys every object and leaves every handle stale, the slots are reused afterwards
+    map.Clear();
+    CHECK_EQ(map.Size(), 0);
+    CHECK_EQ(Counted::alive, 0);
+    for (const SlotHandle& h : handles)
+        CHECK(map.Get(h) == nullptr);
+    SlotHandle again = map.Emplace(7);
+    CHECK(again.index < 100);
+}
+
+// An object that looks itself up from its destructor
+struct Reentrant
+{
+    Reentrant(SlotMap<Reentrant>& m, SlotHandle* h) : map(m), self(h) {}
+    ~Reentrant() { foundSelf = map.Get(*self) != nullptr; }
+
+    SlotMap<Reentrant>& map;
+    SlotHandle* self;
+    static bool foundSelf;
+};
+
+bool Reentrant::foundSelf = true;
+
+static void TestReentrantErase()
+{
+    // The handle is already stale while the object is being destroyed
+    SlotMap<Reentrant> map;
+    SlotHandle h = SlotMap<Reentrant>::Null;
+    h = map.Emplace(map, &h);
+    map.Erase(h);
+    CHECK(!Reentrant::foundSelf);
+}
+
+static void TestAgainstModel()
+{
+    // Random emplaces and erases, with stale handles kept around, agree with a map of the live ones
+    std::mt19937 rng(7);
+    {
+        SlotMap<Counted, 8> map;
+        std::map<std::uint64_t, int> model;
+        std::vector<SlotHandle> seen;
+        for (int i = 0; i < 20000; ++i)
+        {
+            if (seen.empty() || rng() % 3 != 0)
+            {
+                SlotHandle h = map.Emplace(i);
+                std::uint64_t key = (static_cast<std::uint64_t>(h.index) << 32) | h.generation;
+                CHECK(model.count(key) == 0);
+                model[key] = i;
+                seen.push_back(h);
+            }
+            else
+            {
+                SlotHandle h = seen[rng() % seen.size()];
+                map.Erase(h);
+                model.erase((static_cast<std::uint64_t>(h.index) << 32) | h.generation);
+            }
+        }
+        CHECK_EQ(map.Size(), model.size());
+        CHECK_EQ(Counted::alive, static_cast<int>(model.size()));
+        bool consistent = true;
+        for (const SlotHandle& h : seen)
+        {
+            auto it = model.find((static_cast<std::uint64_t>(h.index) << 32) | h.generation);
+            Counted* c = map.Get(h);
+            consistent = consistent && (it == model.end() ? c == nullptr : c != nullptr && c->value == it->second);
+        }
+        CHECK(consistent);
+    }
+
+    // The destructor destroys the objects that are left
+    CHECK_EQ(Counted::alive, 0);
+}
+
+int main()
+{
+    TestGenerations();
+    TestStableAddresses();
+    TestReentrantErase();
+    TestAgainstModel();
+    return CheckResult();
+}
@@ -0,0 +1,186 @@
+#include "StackLayout.hpp"
+#include <algorithm>
+#include <cstdint>
+#include "Check.hpp"
+
+// A small deterministic generator, so that every run checks the same layouts
+class Random
+{
+    public:
+        explicit Random(std::uint64_t seed) : mState(seed) {}
+
+        /// Retrieves a number in [lo, hi]
+        int Next(int lo, int hi)
+        {
+            mState = mState * 6364136223846793005ULL + 1442695040888963407ULL;
+            return lo + static_cast<int>((mState >> 33) % static_cast<std::uint64_t>(hi - lo + 1));
+        }
+
+    private:
+        std::uint64_t mState;
+};
+
+// Converts device independent pixels the way the layout does, a zero dpi being taken as 96
+static int Scale(int dips, unsigned int dpi)
+{
+    if (dpi == 0)
+        return dips;
+    return static_cast<int>((static_cast<long long>(dips) * dpi + 48) / 96);
+}
+
+static void TestSingleDisplay()
+{
+    StackLayout layout;
+    layout.SetDisplays({ DisplayInfo{ LayoutRect{ 0, 0, 1920, 1200 }, 96 } });
+    CHECK_EQ(layout.GetCapacity(), 5);
+    CHECK_EQ(layout.GetSlot(0).x, 1720);
+    CHECK_EQ(layout.GetSlot(0).y, 0);
+    CHECK_EQ(layout.GetSlot(4).y, 4 * 250);
+    CHECK_EQ(layout.GetEntrySlot().y, -250);
+
+    // Twice the dpi makes everything twice as large in physical pixels
+    layout.SetDisplays({ DisplayInfo{ LayoutRect{ 0, 0, 3840, 2400 }, 192 } });
+    CHECK_EQ(layout.GetCapacity(), 5);
+    CHECK_EQ(layout.GetSlot(0).width, 400);
+    CHECK_EQ(layout.GetSlot(1).y, 500);
+
+    // Nothing fits a display smaller than a notification, the entry slot is still usable
+    layout.SetDisplays({ DisplayInfo{ LayoutRect{ 0, 0, 100, 100 }, 96 } });
+    CHECK_EQ(layout.GetCapacity(), 0);
+    CHECK_EQ(layout.GetEntrySlot().width, 200);
+}
+
+// Checks the properties every layout must have
+static void CheckLayout(const std::vector<DisplayInfo>& displays, const LayoutOptions& o, const StackLayout& layout)
+{
+    std::size_t capacity = layout.GetCapacity();
+    bool limited = o.maxVisible != 0 && capacity == o.maxVisible;
+    CHECK(o.maxVisible == 0 || capacity <= o.maxVisible);
+
+    for (std::size_t i = 0; i < capacity; ++i)
+    {
+        const SlotGeometry& s = layout.GetSlot(i);
+        CHECK(s.display < displays.size());
+        if (s.display >= displays.size())
+            return;
+        const DisplayInfo& d = displays[s.display];
+        int margin = Scale(o.margin, d.dpi);
+        int gap = Scale(o.spacing, d.dpi);
+
+        // Slots fill the displays in order, with the size scaled by their dpi, inside the work area and its margin
+        CHECK(i == 0 || layout.GetSlot(i - 1).display <= s.display);
+        CHECK_EQ(s.width, Scale(o.width, d.dpi));
+        CHECK_EQ(s.height, Scale(o.height, d.dpi));
+        CHECK(s.x >= d.workArea.left + margin && s.x + s.width <= d.workArea.right - margin);
+        CHECK(s.y >= d.workArea.top + margin && s.y + s.height <= d.workArea.bottom - margin);
+
+        // The columns start at the right edge and the rows at the top edge, with the spacing between them
+        int column = (d.workArea.right - margin - s.width - s.x) / (s.width + gap);
+        int row = (s.y - d.workArea.top - margin) / (s.height + gap);
+        CHECK_EQ(s.x, d.workArea.right - margin - s.width - column * (s.width + gap));
+        CHECK_EQ(s.y, d.workArea.top + margin + row * (s.height + gap));
+        CHECK(column < static_cast<int>(o.maxColumns));
+
+        // No two slots overlap
+        for (std::size_t j = 0; j < i; ++j)
+        {
+            const SlotGeometry& t = layout.GetSlot(j);
+            bool apart = t.display != s.display || t.x + t.width <= s.x || s.x + s.width <= t.x ||
+                         t.y + t.height <= s.y || s.y + s.height <= t.y;
+            CHECK(apart);
+        }
+
+        // A column is filled from the top down before the next one starts, until nothing more fits
+        bool last = i + 1 == capacity || layout.GetSlot(i + 1).display != s.display || layout.GetSlot(i + 1).x != s.x;
+        if (last && !limited)
+            CHECK(s.y + 2 * s.height + gap > d.workArea.bottom - margin);
+    }
+
+    // Unless the limit was reached, every display that can fit a notification holds as many columns as it can
+    if (limited)
+        return;
+    for (std::size_t d = 0; d < displays.size(); ++d)
+    {
+        const DisplayInfo& disp = displays[d];
+        int w = Scale(o.width, disp.dpi);
+        int h = Scale(o.height, disp.dpi);
+        int gap = Scale(o.spacing, disp.dpi);
+        int margin = Scale(o.margin, disp.dpi);
+        int areaW = disp.workArea.right - disp.workArea.left - 2 * margin;
+        int areaH = disp.workArea.bottom - disp.workArea.top - 2 * margin;
+
+        std::vector<int> columns;
+        for (std::size_t i = 0; i < capacity; ++i)
+            if (layout.GetSlot(i).display == d && std::find(columns.begin(), columns.end(), layout.GetSlot(i).x) == columns.end())
+                columns.push_back(layout.GetSlot(i).x);
+        if (o.maxColumns == 0 || w <= 0 || h <= 0 || areaW < w || areaH < h)
+        {
+            CHECK(columns.empty());
+            continue;
+        }
+        CHECK(!columns.empty());
+        int leftmost = columns.empty() ? 0 : *std::min_element(columns.begin(), columns.end());
+        CHECK(columns.size() == o.maxColumns || leftmost - gap - w < disp.workArea.left + margin);
+    }
+}
+
+static void TestProperties()
+{
+    Random rnd(20240611);
+    StackLayout layout;
+    for (int round = 0; round < 2000; ++round)
+    {
+        std::vector<DisplayInfo> displays(static_cast<std::size_t>(rnd.Next(0, 4)));
+        int x = 0;
+        for (DisplayInfo& d : displays)
+        {
+            static const unsigned int dpis[] = { 0, 96, 120, 144, 168, 192, 288 };
+            d.dpi = dpis[rnd.Next(0, 6)];
+            d.workArea.left = x + rnd.Next(-50, 50);
+            d.workArea.top = rnd.Next(-500, 100);
+            d.workArea.right = d.workArea.left + rnd.Next(0, 4000);
+            d.workArea.bottom = d.workArea.top + rnd.Next(0, 3000);
+            x = d.workArea.right;
+        }
+
+        LayoutOptions o;
+        o.width = rnd.Next(-10, 600);
+        o.height = rnd.Next(-10, 600);
+        o.spacing = rnd.Next(0, 80);
+        o.margin = rnd.Next(0, 60);
+        o.maxColumns = static_cast<unsigned int>(rnd.Next(0, 5));
+        o.maxVisible = static_cast<std::size_t>(rnd.Next(0, 40));
+
+        // The order of the setters does not matter
+        layout.SetOptions(o);
+        layout.SetDisplays(displays);
+        CheckLayout(displays, o, layout);
+        std::size_t capacity = layout.GetCapacity();
+        layout.SetDisplays(displays);
+        layout.SetOptions(o);
+        CHECK_EQ(layout.GetCapacity(), capacity);
+
+        // The entry slot is one slot above the first
+        if (capacity != 0)
+        {
+            SlotGeometry entry = layout.GetEntrySlot();
+            const SlotGeometry& first = layout.GetSlot(0);
+            CHECK_EQ(entry.x, first.x);
+            CHECK_EQ(entry.y, first.y - first.height - Scale(o.spacing, displays[first.display].dpi));
+        }
+
+        // Lifting the limit never loses a slot
+        LayoutOptions unlimited = o;
+        unlimited.maxVisible = 0;
+        layout.SetOptions(unlimited);
+        CheckLayout(displays, unlimited, layout);
+        CHECK(layout.GetCapacity() >= capacity);
+    }
+}
+
+int main()
+{
+    TestSingleDisplay();
+    TestProperties();
+    return CheckResult();
+}
@@ -0,0 +1,167 @@
+#include "TimerWheel.hpp"
+#include <memory>
+#include <random>
+#include "Check.hpp"
+
+using std::chrono::milliseconds;
+using Clock = TimerWheel::Clock;
+
+static void TestNeverEarly()
+{
+    // Deadlines up to a dozen turns away, the time moving in steps of up to two turns and in a few long pauses.
+    // Every timer fires at the first Advance at or past its deadline that is a tick late at most
+    std::mt19937 rng(42);
+    TimerWheel wheel(milliseconds(10), 16);
+    Clock::time_point t0 = Clock::now();
+
+    const int count = 2000;
+    std::vector<Clock::time_point> deadlines(count);
+    std::vector<Clock::time_point> fired(count);
+    std::vector<int> calls(count);
+    std::unique_ptr<TimerWheel::Timer[]> timers(new TimerWheel::Timer[count]);
+    Clock::time_point now = t0;
+    for (int i = 0; i < count; ++i)
+    {
+        deadlines[i] = t0 + std::chrono::microseconds(rng() % 2000000);
+        wheel.Schedule(timers[i], deadlines[i], [&, i]() { ++calls[i]; fired[i] = now; });
+    }
+    CHECK_EQ(wheel.Size(), count);
+
+    for (int step = 0; wheel.Size() != 0 && step < 10000; ++step)
+    {
+        now += step % 50 == 49 ? milliseconds(500) : std::chrono::microseconds(rng() % 320000);
+        wheel.Advance(now);
+        for (int i = 0; i < count; ++i)
+        {
+            if (calls[i] != 0 && fired[i] < deadlines[i])
+                CheckFailed(__FILE__, __LINE__, "timer " + std::to_string(i) + " fired early");
+            if (calls[i] == 0 && now >= deadlines[i] + wheel.GetResolution())
+                CheckFailed(__FILE__, __LINE__, "timer " + std::to_string(i) + " is more than a tick late");
+            if (calls[i] == 0 && !timers[i].IsArmed())
+                CheckFailed(__FILE__, __LINE__, "timer " + std::to_string(i) + " is not armed");
+        }
+    }
+    CHECK_EQ(wheel.Size(), 0);
+    for (int i = 0; i < count; ++i)
+        CHECK_EQ(calls[i], 1);
+
+    // A deadline in the past fires on the next tick, and the wheel keeps time after the pauses
+    TimerWheel::Timer late;
+    int lateCalls = 0;
+    wheel.Schedule(late, t0, [&lateCalls]() { ++lateCalls; });
+    CHECK(late.IsArmed());
+    wheel.Advance(now);
+    CHECK_EQ(lateCalls, 0);
+    now += wheel.GetResolution();
+    wheel.Advance(now);
+    CHECK_EQ(lateCalls, 1);
+    CHECK(!late.IsArmed());
+    wheel.Schedule(late, now + milliseconds(25), [&lateCalls]() { ++lateCalls; });
+    wheel.Advance(now + milliseconds(24));
+    CHECK_EQ(lateCalls, 1);
+    wheel.Advance(now + milliseconds(35));
+    CHECK_EQ(lateCalls, 2);
+}
+
+static void TestLongPause()
+{
+    // After a pause of many turns every slot is visited once: the due timers fire, the ones further away stay
+    TimerWheel wheel(milliseconds(10), 8);
+    Clock::time_point t0 = Clock::now();
+    TimerWheel::Timer soon, due, later;
+    int fired = 0;
+    wheel.Schedule(soon, t0 + milliseconds(15), [&fired]() { fired |= 1; });
+    wheel.Schedule(due, t0 + milliseconds(995), [&fired]() { fired |= 2; });
+    wheel.Schedule(later, t0 + milliseconds(1095), [&fired]() { fired |= 4; });
+
+    wheel.Advance(t0 + milliseconds(1000) + milliseconds(5));
+    CHECK_EQ(fired, 3);
+    CHECK(later.IsArmed());
+    CHECK_EQ(wheel.Size(), 1);
+
+    // Going back in time does nothing
+    wheel.Advance(t0);
+    CHECK_EQ(fired, 3);
+    wheel.Advance(t0 + milliseconds(1115));
+    CHECK_EQ(fired, 7);
+    CHECK_EQ(wheel.Size(), 0);
+}
+
+static void TestCallbacks()
+{
+    // The timers that expire together are collected first, a callback may cancel or move the others
+    TimerWheel wheel(milliseconds(10), 16);
+    Clock::time_point t0 = Clock::now();
+    TimerWheel::Timer a, b, c, self;
+    std::vector<char> order;
+    wheel.Schedule(a, t0 + milliseconds(5),
+        [&]()
+        {
+            order.push_back('a');
+            b.Cancel();
+            wheel.Schedule(c, t0, [&]() { order.push_back('C'); });
+        }
+    );
+    wheel.Schedule(b, t0 + milliseconds(5), [&]() { order.push_back('b'); });
+    wheel.Schedule(c, t0 + milliseconds(5), [&]() { order.push_back('c'); });
+    wheel.Schedule(self, t0 + milliseconds(5),
+        [&]()
+        {
+            order.push_back('s');
+            wheel.Schedule(self, t0, [&]() { order.push_back('S'); });
+        }
+    );
+
+    // The timer moved to a past deadline waits for the next Advance, so a callback never keeps one Advance going
+    wheel.Advance(t0 + milliseconds(20));
+    CHECK_EQ(std::string(order.begin(), order.end()), "as");
+    CHECK(!b.IsArmed());
+    CHECK(c.IsArmed());
+    CHECK_EQ(wheel.Size(), 2);
+    wheel.Advance(t0 + milliseconds(30));
+    CHECK_EQ(std::string(order.begin(), order.end()), "asCS");
+    CHECK_EQ(wheel.Size(), 0);
+
+    // Cancelling an unarmed timer does nothing, rescheduling an armed one replaces its callback
+    b.Cancel();
+    wheel.Schedule(b, t0 + milliseconds(45), [&]() { order.push_back('x'); });
+    wheel.Schedule(b, t0 + milliseconds(45), [&]() { order.push_back('y'); });
+    CHECK_EQ(wheel.Size(), 1);
+    wheel.Advance(t0 + milliseconds(60));
+    CHECK_EQ(order.back(), 'y');
+    CHECK_EQ(order.size(), 5);
+}
+
+static void TestLifetimes()
+{
+    // A timer destroyed while armed leaves its slot
+    TimerWheel::Timer outlives;
+    {
+        TimerWheel wheel(milliseconds(10), 4);
+        Clock::time_point t0 = Clock::now();
+        bool fired = false;
+        {
+            TimerWheel::Timer gone;
+            wheel.Schedule(gone, t0 + milliseconds(5), [&fired]() { fired = true; });
+            CHECK_EQ(wheel.Size(), 1);
+        }
+        CHECK_EQ(wheel.Size(), 0);
+        wheel.Advance(t0 + milliseconds(50));
+        CHECK(!fired);
+
+        // The ones still armed when the wheel goes are detached from it
+        wheel.Schedule(outlives, t0 + milliseconds(500), []() {});
+        CHECK(outlives.IsArmed());
+    }
+    CHECK(!outlives.IsArmed());
+    outlives.Cancel();
+}
+
+int main()
+{
+    TestNeverEarly();
+    TestLongPause();
+    TestCallbacks();
+    TestLifetimes();
+    return CheckResult();
+}
@@ -0,0 +1,107 @@
+#include "TokenBucket.hpp"
+#include <thread>
+#include <vector>
+#include "Check.hpp"
+
+using std::chrono::milliseconds;
+using Clock = TokenBucket::Clock;
+
+// A time far from the clock epoch, the buckets only ever see the times the tests give them
+static const Clock::time_point t0 = Clock::time_point(std::chrono::hours(1000));
+
+// Takes tokens at the given time until one is refused, returns the number taken
+static int Drain(TokenBucket& bucket, Clock::time_point now)
+{
+    int taken = 0;
+    while (bucket.TryConsume(now) == Clock::duration::zero() && taken < 1000)
+        ++taken;
+    return taken;
+}
+
+static void TestBurst()
+{
+    // 10 messages per second with a burst of 5: five at once, then one every 100 ms
+    TokenBucket bucket(RateLimit{10.0, 5.0});
+    CHECK_EQ(Drain(bucket, t0), 5);
+    CHECK(bucket.TryConsume(t0) == milliseconds(100));
+    CHECK(bucket.TryConsume(t0 + milliseconds(40)) == milliseconds(60));
+    CHECK(bucket.TryConsume(t0 + milliseconds(100)) == Clock::duration::zero());
+    CHECK(bucket.TryConsume(t0 + milliseconds(100)) == milliseconds(100));
+
+    // Messages at the sustained rate always conform, slightly faster ones are held to it once the burst is used
+    Clock::time_point t = t0 + milliseconds(200);
+    for (int i = 0; i < 1000; ++i, t += milliseconds(100))
+        CHECK(bucket.TryConsume(t) == Clock::duration::zero());
+    int admitted = 0;
+    for (int i = 0; i < 100; ++i, t += milliseconds(90))
+        admitted += bucket.TryConsume(t) == Clock::duration::zero() ? 1 : 0;
+    CHECK(admitted >= 89 && admitted <= 91);
+
+    // An idle bucket fills up to the burst only
+    CHECK_EQ(Drain(bucket, t + std::chrono::hours(1)), 5);
+}
+
+static void TestLimits()
+{
+    // A zero rate is no limit, and a burst under one still lets a message through
+    TokenBucket unlimited;
+    CHECK_EQ(Drain(unlimited, t0), 1000);
+    TokenBucket strict(RateLimit{2.0, 0.0});
+    CHECK_EQ(Drain(strict, t0), 1);
+    CHECK(strict.TryConsume(t0) == milliseconds(500));
+
+    // A new limit applies to the next message, the messages already admitted still count
+    TokenBucket bucket(RateLimit{1.0, 3.0});
+    CHECK_EQ(Drain(bucket, t0), 3);
+    bucket.SetLimit(RateLimit{10.0, 3.0});
+    CHECK(bucket.TryConsume(t0) == milliseconds(2800));
+    bucket.SetLimit(RateLimit{0.0, 0.0});
+    CHECK(bucket.TryConsume(t0) == Clock::duration::zero());
+}
+
+static void TestRefund()
+{
+    // A refunded token can be taken again, so a message refused by a later check costs nothing
+    TokenBucket bucket(RateLimit{10.0, 3.0});
+    CHECK_EQ(Drain(bucket, t0), 3);
+    bucket.Refund();
+    CHECK(bucket.TryConsume(t0) == Clock::duration::zero());
+    CHECK(bucket.TryConsume(t0) != Clock::duration::zero());
+    bucket.Refund();
+    bucket.Refund();
+    CHECK_EQ(Drain(bucket, t0), 2);
+}
+
+static void TestShared()
+{
+    // Threads taking from one bucket at the same time get the burst between them, never more
+    TokenBucket bucket(RateLimit{1.0, 1000.0});
+    std::vector<int> taken(4);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < taken.size(); ++i)
+    {
+        threads.emplace_back(
+            [&bucket, &taken, i]()
+            {
+                for (int k = 0; k < 2000; ++k)
+                    taken[i] += bucket.TryConsume(t0) == Clock::duration::zero() ? 1 : 0;
+            }
+        );
+    }
+    int total = 0;
+    for (std::size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+        total += taken[i];
+    }
+    CHECK_EQ(total, 1000);
+}
+
+int main()
+{
+    TestBurst();
+    TestLimits();
+    TestRefund();
+    TestShared();
+    return CheckResult();
+}
@@ -0,0 +1,248 @@
+#include "Trace.hpp"
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Check.hpp"
+
+// A value of the trace JSON, enough of the grammar for what the dump writes
+struct JsonValue
+{
+    enum Type { Null, Number, String, Array, Object } type = Null;
+    double number = 0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::map<std::string, JsonValue> object;
+
+    /// Retrieves the given member, a null value if there is none
+    const JsonValue& operator[](const std::string& name) const
+    {
+        static const JsonValue none;
+        auto it = object.find(name);
+        return it != object.end() ? it->second : none;
+    }
+};
+
+// A strict recursive descent parser, so that anything the dump gets wrong fails the parse
+class JsonParser
+{
+    public:
+        explicit JsonParser(const std::string& text) : mP(text.data()), mEnd(text.data() + text.size()) {}
+
+        /// Parses the document, returns false if it is malformed
+        bool Parse(JsonValue& v)
+        {
+            return ParseValue(v) && (SkipSpace(), mP == mEnd);
+        }
+
+    private:
+        void SkipSpace()
+        {
+            while (mP != mEnd && (*mP == ' ' || *mP == '\n' || *mP == '\r' || *mP == '\t'))
+                ++mP;
+        }
+
+        bool Expect(char c)
+        {
+            SkipSpace();
+            if (mP == mEnd || *mP != c)
+                return false;
+            ++mP;
+            return true;
+        }
+
+        bool ParseValue(JsonValue& v)
+        {
+            SkipSpace();
+            if (mP == mEnd)
+                return false;
+            if (*mP == '{')
+            {
+                ++mP;
+                v.type = JsonValue::Object;
+                if (Expect('}'))
+                    return true;
+                do
+                {
+                    std::string name;
+                    SkipSpace();
+                    if (!ParseString(name) || !Expect(':') || v.object.count(name) != 0 || !ParseValue(v.object[name]))
+                        return false;
+                }
+                while (Expect(','));
+                return Expect('}');
+            }
+            if (*mP == '[')
+            {
+                ++mP;
+                v.type = JsonValue::Array;
+                if (Expect(']'))
+                    return true;
+                do
+                {
+                    v.array.emplace_back();
+                    if (!ParseValue(v.array.back()))
+                        return false;
+                }
+                while (Expect(','));
+                return Expect(']');
+            }
+            if (*mP == '"')
+            {
+                v.type = JsonValue::String;
+                return ParseString(v.string);
+            }
+            return ParseNumber(v);
+        }
+
+        bool ParseString(std::string& out)
+        {
+            if (mP == mEnd || *mP++ != '"')
+                return false;
+            while (mP != mEnd)
+            {
+                char c = *mP++;
+                if (c == '"')
+                    return true;
+                if (static_cast<unsigned char>(c) < 0x20)
+                    return false;
+                if (c == '\\')
+                {
+                    if (mP == mEnd || (*mP != '"' && *mP != '\\'))
+                        return false;
+                    c = *mP++;
+                }
+                out += c;
+            }
+            return false;
+        }
+
+        bool ParseNumber(JsonValue& v)
+        {
+            const char* start = mP;
+            while (mP != mEnd && ((*mP >= '0' && *mP <= '9') || *mP == '.'))
+                ++mP;
+            if (mP == start || *start == '.' || mP[-1] == '.')
+                return false;
+            v.type = JsonValue::Number;
+            v.number = std::strtod(std::string(start, mP).c_str(), nullptr);
+            return true;
+        }
+
+        const char* mP;
+        const char* mEnd;
+};
+
+// The events of the dump with the given name and phase
+static std::vector<const JsonValue*> FindEvents(const JsonValue& trace, const std::string& name, const std::string& phase)
+{
+    std::vector<const JsonValue*> events;
+    for (const JsonValue& e : trace["traceEvents"].array)
+        if (e["name"].string == name && e["ph"].string == phase)
+            events.push_back(&e);
+    return events;
+}
+
+// The trace thread id that was given the name
+static double FindThread(const JsonValue& trace, const std::string& name)
+{
+    for (const JsonValue* e : FindEvents(trace, "thread_name", "M"))
+        if ((*e)["args"]["name"].string == name)
+            return (*e)["tid"].number;
+    return 0;
+}
+
+static void TestDump()
+{
+    // A notification posted on one thread and spawned on another, joined by a flow
+    SetTracing(true);
+    std::thread producer(
+        []()
+        {
+            SetTraceThreadName("producer \"one\"");
+            TRACE_SCOPE("Post");
+            TRACE_FLOW_BEGIN("Notification", 42);
+        }
+    );
+    producer.join();
+    std::thread consumer(
+        []()
+        {
+            SetTraceThreadName("consumer");
+            TRACE_SCOPE("Spawn");
+            TRACE_FLOW_END("Notification", 42);
+        }
+    );
+    consumer.join();
+
+    // While tracing is off nothing is recorded
+    SetTracing(false);
+    std::thread idle([]() { TRACE_SCOPE("Idle"); TRACE_FLOW_BEGIN("Idle", 1); });
+    idle.join();
+
+    JsonValue trace;
+    CHECK(JsonParser(DumpTrace()).Parse(trace));
+    CHECK_EQ(trace["displayTimeUnit"].string, "ms");
+    double producerTid = FindThread(trace, "producer \"one\"");
+    double consumerTid = FindThread(trace, "consumer");
+    CHECK(producerTid != 0 && consumerTid != 0 && producerTid != consumerTid);
+
+    std::vector<const JsonValue*> post = FindEvents(trace, "Post", "X");
+    std::vector<const JsonValue*> spawn = FindEvents(trace, "Spawn", "X");
+    std::vector<const JsonValue*> begin = FindEvents(trace, "Notification", "s");
+    std::vector<const JsonValue*> end = FindEvents(trace, "Notification", "f");
+    CHECK(post.size() == 1 && spawn.size() == 1 && begin.size() == 1 && end.size() == 1);
+    CHECK(FindEvents(trace, "Idle", "X").empty());
+    if (post.size() != 1 || spawn.size() != 1 || begin.size() != 1 || end.size() != 1)
+        return;
+
+    // Every event is on the thread that recorded it, the flow points are inside their scopes
+    const JsonValue& p = *post[0];
+    const JsonValue& s = *spawn[0];
+    const JsonValue& b = *begin[0];
+    const JsonValue& f = *end[0];
+    CHECK(p["tid"].number == producerTid && b["tid"].number == producerTid);
+    CHECK(s["tid"].number == consumerTid && f["tid"].number == consumerTid);
+    CHECK(p["ts"].number <= b["ts"].number && b["ts"].number <= p["ts"].number + p["dur"].number);
+    CHECK(s["ts"].number <= f["ts"].number && f["ts"].number <= s["ts"].number + s["dur"].number);
+    CHECK(p["ts"].number + p["dur"].number <= s["ts"].number);
+    CHECK(b["id"].number == 42 && f["id"].number == 42);
+    CHECK(b["bp"].type == JsonValue::Null);
+    CHECK_EQ(f["bp"].string, "e");
+    CHECK_EQ(p["cat"].string, "newsflash");
+    CHECK(p["pid"].number == 1 && b["dur"].type == JsonValue::Null);
+}
+
+static void TestWrap()
+{
+    // A thread that recorded more than its ring holds has its latest events in the dump, oldest first
+    SetTracing(true);
+    std::thread busy(
+        []()
+        {
+            SetTraceThreadName("busy");
+            for (std::size_t i = 0; i < TraceRingSize + 1000; ++i)
+                TRACE_SCOPE("Tick");
+        }
+    );
+    busy.join();
+    SetTracing(false);
+
+    JsonValue trace;
+    CHECK(JsonParser(DumpTrace()).Parse(trace));
+    std::vector<const JsonValue*> ticks = FindEvents(trace, "Tick", "X");
+    CHECK_EQ(ticks.size(), TraceRingSize);
+    double tid = FindThread(trace, "busy");
+    bool ordered = true;
+    for (std::size_t i = 0; i < ticks.size(); ++i)
+        ordered = ordered && (*ticks[i])["tid"].number == tid && (i == 0 || (*ticks[i - 1])["ts"].number <= (*ticks[i])["ts"].number);
+    CHECK(ordered);
+}
+
+int main()
+{
+    TestDump();
+    TestWrap();
+    return CheckResult();
+}
@@ -0,0 +1,82 @@
+#include "WindowPool.hpp"
+#include "Check.hpp"
+
+// A window that counts its instances and remembers whether it is shown
+struct FakeWindow
+{
+    static int alive;
+
+    FakeWindow() : shown(true) { ++alive; }
+    ~FakeWindow() { --alive; }
+
+    void Show(bool s) { shown = s; }
+
+    bool shown;
+};
+
+int FakeWindow::alive = 0;
+
+// Every window the pool created is either destroyed, idle in the pool or held by the caller
+static bool Balanced(const WindowPool<FakeWindow>& pool, std::size_t held)
+{
+    return pool.GetCreatedCount() - pool.GetDestroyedCount() == pool.GetIdleCount() + held
+        && FakeWindow::alive == static_cast<int>(pool.GetIdleCount() + held);
+}
+
+static void TestAccounting()
+{
+    {
+        // Warming up fills the pool with hidden windows, acquiring takes them before creating any
+        WindowPool<FakeWindow> pool(3);
+        pool.WarmUp();
+        CHECK_EQ(pool.GetCreatedCount(), 3);
+        CHECK_EQ(pool.GetIdleCount(), 3);
+        std::vector<FakeWindow*> held;
+        for (int i = 0; i < 5; ++i)
+        {
+            held.push_back(pool.Acquire());
+            CHECK(!held.back()->shown);
+        }
+        CHECK_EQ(pool.GetCreatedCount(), 5);
+        CHECK_EQ(pool.GetIdleCount(), 0);
+        CHECK(Balanced(pool, 5));
+
+        // Released windows are hidden and kept up to the capacity, the rest are destroyed
+        for (FakeWindow* w : held)
+            w->Show(true);
+        for (FakeWindow* w : held)
+            pool.Release(w);
+        CHECK_EQ(pool.GetIdleCount(), 3);
+        CHECK_EQ(pool.GetDestroyedCount(), 2);
+        CHECK(Balanced(pool, 0));
+        FakeWindow* again = pool.Acquire();
+        CHECK(!again->shown);
+        CHECK_EQ(pool.GetCreatedCount(), 5);
+
+        // Shrinking destroys the idle windows over the new capacity, a warm up only tops up to it
+        pool.SetCapacity(1);
+        CHECK_EQ(pool.GetIdleCount(), 1);
+        CHECK_EQ(pool.GetDestroyedCount(), 3);
+        pool.WarmUp();
+        CHECK_EQ(pool.GetCreatedCount(), 5);
+        pool.Release(again);
+        CHECK_EQ(pool.GetDestroyedCount(), 4);
+        CHECK(Balanced(pool, 0));
+
+        // A pool without capacity keeps nothing
+        pool.SetCapacity(0);
+        FakeWindow* w = pool.Acquire();
+        pool.Release(w);
+        CHECK_EQ(pool.GetIdleCount(), 0);
+        CHECK(Balanced(pool, 0));
+    }
+
+    // The idle windows go with the pool
+    CHECK_EQ(FakeWindow::alive, 0);
+}
+
+int main()
+{
+    TestAccounting();
+    return CheckResult();
+}
@@ -0,0 +1,168 @@
+#include "HistoryStore.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+//
+// History ingest, reopen and query times: notifications from 2000
+// sources with texts of 3 to 12 words are recorded 1 ms apart, the
+// history is reopened, which rebuilds its indexes from the segments, and
+// one second range queries with and without a source are timed, then
+// text searches over the whole history.
+//
+//   HistoryBench [directory, /tmp/newsflash-bench-history by default] [millions of records, 10 by default]
+//
+
+using Clock = std::chrono::steady_clock;
+
+// Deletes the segment files of the history in the given directory and the directory
+static void RemoveHistory(const std::string& directory)
+{
+#if !defined(_WIN32)
+    if (DIR* dir = opendir(directory.c_str()))
+    {
+        while (dirent* e = readdir(dir))
+            if (std::strncmp(e->d_name, "history-", 8) == 0)
+                std::remove((directory + "/" + e->d_name).c_str());
+        closedir(dir);
+    }
+    rmdir(directory.c_str());
+#endif
+}
+
+// Runs the given query the given number of times and prints the p50 and p99 of its time
+static void TimeQuery(const char* name, std::size_t runs, const std::function<std::size_t()>& query)
+{
+    std::vector<double> us;
+    std::size_t entries = 0;
+    for (std::size_t i = 0; i < runs; ++i)
+    {
+        auto start = Clock::now();
+        entries += query();
+        us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    std::sort(us.begin(), us.end());
+    std::printf("%-40s p50 %8.1f us, p99 %8.1f us, %.1f entries per query\n",
+        name, us[us.size() / 2], us[us.size() * 99 / 100], static_cast<double>(entries) / runs);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string directory = argc > 1 ? argv[1] : "/tmp/newsflash-bench-history";
+    std::size_t records = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10) * 1000000;
+    RemoveHistory(directory);
+
+    // Keep every record, the default limits would start deleting segments halfway
+    HistoryOptions options;
+    options.maxBytes = std::uint64_t(1) << 40;
+
+    std::mt19937 rng(1);
+    std::vector<std::string> words;
+    for (int i = 0; i < 5000; ++i)
+        words.push_back("w" + std::to_string(i));
+    std::vector<std::string> sources;
+    for (int i = 0; i < 2000; ++i)
+        sources.push_back("10.0." + std::to_string(i / 250) + "." + std::to_string(i % 250));
+
+    std::int64_t first = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+        - static_cast<std::int64_t>(records);
+    {
+        HistoryStore history(directory, options);
+        if (!history.Open())
+        {
+            std::fprintf(stderr, "could not open %s\n", directory.c_str());
+            return 1;
+        }
+
+        NotificationData data;
+        auto start = Clock::now();
+        for (std::size_t i = 0; i < records; ++i)
+        {
+            // Word frequencies fall off like in real text, a few words are in most notifications
+            data.msg.clear();
+            int count = std::uniform_int_distribution<int>(3, 12)(rng);
+            for (int w = 0; w < count; ++w)
+            {
+                double r = std::uniform_real_distribution<double>(0, 1)(rng);
+                data.msg += words[static_cast<std::size_t>(r * r * r * words.size())] + " ";
+            }
+            data.source = sources[rng() % sources.size()];
+            data.dedupKey = i % 4 == 0 ? "build-" + std::to_string(i % 100) : std::string();
+            history.Record(data, first + static_cast<std::int64_t>(i));
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        std::printf("ingested %zu records in %.2f s, %.0fk records/s, %zu segments\n",
+            records, seconds, records / seconds / 1e3, history.GetSegmentCount());
+    }
+
+    auto start = Clock::now();
+    HistoryStore history(directory, options);
+    if (!history.Open() || history.GetRecordCount() != records)
+    {
+        std::fprintf(stderr, "reopened with %llu of %zu records\n", static_cast<unsigned long long>(history.GetRecordCount()), records);
+        return 1;
+    }
+    std::printf("reopened in %.2f s, search index %.1f MB\n",
+        std::chrono::duration<double>(Clock::now() - start).count(), history.GetSearchMemoryUsage() / 1e6);
+
+    // Queries over the whole history, so most of them reach segments that are not mapped any more
+    auto randomSecond = [&](HistoryQuery& q)
+    {
+        q.since = first + static_cast<std::int64_t>(rng() % (records - 1000));
+        q.until = q.since + 999;
+    };
+    TimeQuery("one second range, 100 entries", 2000,
+        [&]()
+        {
+            HistoryQuery q;
+            randomSecond(q);
+            return history.Query(q).entries.size();
+        });
+    TimeQuery("one second range of a source", 2000,
+        [&]()
+        {
+            HistoryQuery q;
+            randomSecond(q);
+            q.source = sources[rng() % sources.size()];
+            return history.Query(q).entries.size();
+        });
+    TimeQuery("latest 100 of a source", 2000,
+        [&]()
+        {
+            HistoryQuery q;
+            q.source = sources[rng() % sources.size()];
+            return history.Query(q).entries.size();
+        });
+
+    // The words are drawn with a cubed uniform, so w0 is in about one notification
+    // of three and each word past w4000 in about one of 2000
+    auto word = [&](std::size_t from, std::size_t to) { return words[from + rng() % (to - from)]; };
+    auto search = [&](const char* name, const std::function<std::string()>& text, bool source)
+    {
+        TimeQuery(name, 500,
+            [&]()
+            {
+                HistoryQuery q;
+                q.text = text();
+                if (source)
+                    q.source = sources[rng() % sources.size()];
+                return history.Query(q).entries.size();
+            });
+    };
+    search("rare two word AND", [&]() { return word(4000, 5000) + " " + word(4000, 5000); }, false);
+    search("common two word AND", [&]() { return word(0, 10) + " " + word(0, 10); }, false);
+    search("two prefixes", [&]() { return word(10, 100) + "* " + word(100, 1000) + "*"; }, false);
+    search("common word of a source", [&]() { return word(0, 10); }, true);
+    search("absent word", [&]() { return "absent" + std::to_string(rng()); }, false);
+
+    RemoveHistory(directory);
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include "MessageServer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+#if !defined(_WIN32)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+//
+// Memory cost of an idle connection: the given number of TCP connections
+// is opened to the message server and left silent, and the growth of the
+// resident set of the process is divided by their number. The clients
+// are plain descriptors whose array is allocated up front, so the growth
+// is the server side: the connection objects, their transports and the
+// reactor state of the sockets. The kernel socket buffers do not show in
+// the resident set. Both ends of every connection live in this process,
+// so the open file limit is raised as far as allowed, and the connection
+// count is cut to what it leaves room for.
+//
+//   IdleConnectionBench [connections, 50000 by default]
+//
+
+#if !defined(_WIN32)
+
+using Clock = std::chrono::steady_clock;
+
+// Reads the resident set size in bytes from /proc, zero where there is none
+static std::size_t ResidentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::size_t size = 0;
+    std::size_t resident = 0;
+    if (!(statm >> size >> resident))
+        return 0;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// Raises the open file limit to the hard one, returns the number of connections it leaves room for
+static std::size_t ConnectionRoom()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return 0;
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    getrlimit(RLIMIT_NOFILE, &limit);
+    return limit.rlim_cur > 64 ? static_cast<std::size_t>(limit.rlim_cur - 64) / 2 : 0;
+}
+
+// Opens a connection to the given port from the given loopback source address, returns -1 on failure
+static int Connect(unsigned short port, std::uint32_t source)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    // Every source address has its own ephemeral ports, so the connections spread over a few of them
+    sockaddr_in from = sockaddr_in();
+    from.sin_family = AF_INET;
+    from.sin_addr.s_addr = htonl(source);
+    sockaddr_in to = sockaddr_in();
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    to.sin_port = htons(port);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&from), sizeof(from)) != 0
+     || connect(fd, reinterpret_cast<sockaddr*>(&to), sizeof(to)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Waits until the server has the given number of connections or ten seconds pass without a change
+static bool WaitConnections(const MessageServer& server, std::size_t count)
+{
+    std::size_t last = server.GetConnectionManager().GetConnectionCount();
+    auto progress = Clock::now();
+    while (last != count && Clock::now() - progress < std::chrono::seconds(10))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::size_t now = server.GetConnectionManager().GetConnectionCount();
+        if (now != last)
+        {
+            last = now;
+            progress = Clock::now();
+        }
+    }
+    return last == count;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t wanted = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+    std::size_t count = std::min(wanted, ConnectionRoom());
+    if (count != wanted)
+        std::printf("the open file limit leaves room for %zu of %zu connections\n", count, wanted);
+    std::cout.setstate(std::ios::badbit);
+
+    MessageServer server(0);
+    server.SetMaxConnections(0);
+    server.SetRateLimits(RateLimit{0, 0}, RateLimit{0, 0});
+    std::thread t([&server]() { server.Run(); });
+
+    // A first round of connections that come and go, so that what the server allocates once is not counted
+    std::vector<int> fds;
+    fds.reserve(count);
+    for (int i = 0; i < 100; ++i)
+        fds.push_back(Connect(server.GetPort(), INADDR_LOOPBACK));
+    WaitConnections(server, fds.size());
+    for (int fd : fds)
+        close(fd);
+    fds.clear();
+    WaitConnections(server, 0);
+
+    std::size_t before = ResidentBytes();
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        int fd = Connect(server.GetPort(), INADDR_LOOPBACK + static_cast<std::uint32_t>(i / 20000));
+        if (fd < 0)
+        {
+            std::fprintf(stderr, "connection %zu failed\n", i);
+            break;
+        }
+        fds.push_back(fd);
+    }
+    bool accepted = WaitConnections(server, fds.size());
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::size_t after = ResidentBytes();
+
+    int result = 0;
+    if (!accepted || fds.empty())
+    {
+        std::fprintf(stderr, "the server has %zu of %zu connections\n", server.GetConnectionManager().GetConnectionCount(),
+            fds.size());
+        result = 1;
+    }
+    else if (before == 0)
+        std::printf("%zu idle connections in %.2f s, the resident set size is not available\n", fds.size(), seconds);
+    else
+    {
+        std::printf("%zu idle connections in %.2f s: %.1f MB resident, %.0f bytes per connection\n", fds.size(), seconds,
+            after / 1e6, (static_cast<double>(after) - static_cast<double>(before)) / fds.size());
+    }
+
+    for (int fd : fds)
+        close(fd);
+    std::raise(SIGTERM);
+    t.join();
+    return result;
+}
+
+#else
+
+int main()
+{
+    std::fprintf(stderr, "the benchmark needs POSIX sockets\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "Journal.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+//
+// Journal append throughput: notifications with 100 byte texts are
+// appended as fast as one thread can, each one retired again 64 appends
+// later the way expiring notifications are, and the rate counts until
+// everything is committed to the disk. The journal is created in the
+// given directory.
+//
+//   JournalBench [directory, /tmp by default] [thousands of appends, 1000 by default]
+//
+
+int main(int argc, char* argv[])
+{
+    std::string path = std::string(argc > 1 ? argv[1] : "/tmp") + "/newsflash-bench.journal";
+    std::size_t appends = (argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000) * 1000;
+    std::remove(path.c_str());
+
+    std::vector<NotificationData> replay;
+    Journal journal(path);
+    if (!journal.Open(replay))
+    {
+        std::fprintf(stderr, "could not open %s\n", path.c_str());
+        return 1;
+    }
+
+    NotificationData data;
+    data.msg.assign(100, 'm');
+    data.dedupKey = "build";
+    std::vector<std::uint64_t> recent(64, 0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < appends; ++i)
+    {
+        std::uint64_t& slot = recent[i % recent.size()];
+        if (slot != 0)
+            journal.Retire(slot);
+        slot = journal.Append(data);
+    }
+    journal.Sync();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%zu appends: %.0fk appends/s, %llu group commits, %llu compactions, %zu live\n",
+        appends, appends / seconds / 1e3, static_cast<unsigned long long>(journal.GetCommitCount()),
+        static_cast<unsigned long long>(journal.GetCompactionCount()), journal.GetLiveCount());
+    std::remove(path.c_str());
+    return 0;
+}
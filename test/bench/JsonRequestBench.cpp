@@ -0,0 +1,440 @@
+#include "JsonRequest.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+
+//
+// The in place JSON request parser against a conventional DOM parser, the
+// kind that builds a tree of values with an allocated string, array or
+// map behind each of them and is then walked for the members. Both turn
+// the same requests into NotificationData: single notifications and
+// batches of up to 20, with texts of 20 to 300 bytes, some escapes and
+// \u sequences, numeric and named priorities, and unknown members with
+// nested values. Every request is copied into a receive buffer first, the
+// way a connection reads it. The best of a few passes is reported.
+//
+//   JsonRequestBench [megabytes of requests, 16 by default]
+//
+
+// A value of the DOM, the containers are allocated the way a general purpose DOM allocates them
+struct JsonValue
+{
+    enum Type { Null, Bool, Number, String, Array, Object } type = Null;
+    bool boolean = false;
+    double number = 0;
+    std::unique_ptr<std::string> string;
+    std::unique_ptr<std::vector<JsonValue>> array;
+    std::unique_ptr<std::map<std::string, JsonValue>> object;
+};
+
+// A recursive descent parser of the whole JSON grammar into a JsonValue
+class DomParser
+{
+    public:
+        DomParser(const char* begin, const char* end) : mP(begin), mEnd(end) {}
+
+        /// Parses the document, returns false if it is malformed
+        bool Parse(JsonValue& v)
+        {
+            if (!ParseValue(v, 0))
+                return false;
+            SkipSpace();
+            return mP == mEnd;
+        }
+
+    private:
+        void SkipSpace()
+        {
+            while (mP != mEnd && (*mP == ' ' || *mP == '\n' || *mP == '\r' || *mP == '\t'))
+                ++mP;
+        }
+
+        bool Expect(char c)
+        {
+            SkipSpace();
+            if (mP == mEnd || *mP != c)
+                return false;
+            ++mP;
+            return true;
+        }
+
+        bool ParseValue(JsonValue& v, int depth)
+        {
+            SkipSpace();
+            if (mP == mEnd || depth > 64)
+                return false;
+            switch (*mP)
+            {
+                case '{':
+                    return ParseObject(v, depth);
+                case '[':
+                    return ParseArray(v, depth);
+                case '"':
+                    v.type = JsonValue::String;
+                    v.string.reset(new std::string());
+                    return ParseString(*v.string);
+                case 't':
+                    v.type = JsonValue::Bool;
+                    v.boolean = true;
+                    return ParseLiteral("true");
+                case 'f':
+                    v.type = JsonValue::Bool;
+                    return ParseLiteral("false");
+                case 'n':
+                    return ParseLiteral("null");
+                default:
+                    return ParseNumber(v);
+            }
+        }
+
+        bool ParseObject(JsonValue& v, int depth)
+        {
+            ++mP;
+            v.type = JsonValue::Object;
+            v.object.reset(new std::map<std::string, JsonValue>());
+            if (Expect('}'))
+                return true;
+            for (;;)
+            {
+                std::string name;
+                SkipSpace();
+                if (!ParseString(name) || !Expect(':') || !ParseValue((*v.object)[name], depth + 1))
+                    return false;
+                if (Expect('}'))
+                    return true;
+                if (!Expect(','))
+                    return false;
+            }
+        }
+
+        bool ParseArray(JsonValue& v, int depth)
+        {
+            ++mP;
+            v.type = JsonValue::Array;
+            v.array.reset(new std::vector<JsonValue>());
+            if (Expect(']'))
+                return true;
+            for (;;)
+            {
+                v.array->emplace_back();
+                if (!ParseValue(v.array->back(), depth + 1))
+                    return false;
+                if (Expect(']'))
+                    return true;
+                if (!Expect(','))
+                    return false;
+            }
+        }
+
+        bool ParseHex4(unsigned int& cp)
+        {
+            if (mEnd - mP < 4)
+                return false;
+            cp = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                char c = *mP++;
+                cp <<= 4;
+                if (c >= '0' && c <= '9')
+                    cp |= c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    cp |= c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    cp |= c - 'A' + 10;
+                else
+                    return false;
+            }
+            return true;
+        }
+
+        static void AppendUtf8(std::string& out, unsigned int cp)
+        {
+            if (cp < 0x80)
+                out += static_cast<char>(cp);
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+
+        bool ParseString(std::string& out)
+        {
+            if (mP == mEnd || *mP++ != '"')
+                return false;
+            while (mP != mEnd)
+            {
+                char c = *mP++;
+                if (c == '"')
+                    return true;
+                if (c != '\\')
+                {
+                    out += c;
+                    continue;
+                }
+                if (mP == mEnd)
+                    return false;
+                switch (*mP++)
+                {
+                    case '"': out += '"'; break;
+                    case '\\': out += '\\'; break;
+                    case '/': out += '/'; break;
+                    case 'b': out += '\b'; break;
+                    case 'f': out += '\f'; break;
+                    case 'n': out += '\n'; break;
+                    case 'r': out += '\r'; break;
+                    case 't': out += '\t'; break;
+                    case 'u':
+                    {
+                        unsigned int cp;
+                        if (!ParseHex4(cp))
+                            return false;
+                        unsigned int low;
+                        if (cp >= 0xD800 && cp < 0xDC00 && mEnd - mP >= 6 && mP[0] == '\\' && mP[1] == 'u')
+                        {
+                            mP += 2;
+                            if (!ParseHex4(low))
+                                return false;
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        AppendUtf8(out, cp);
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+            }
+            return false;
+        }
+
+        bool ParseLiteral(const char* lit)
+        {
+            for (; *lit; ++lit, ++mP)
+                if (mP == mEnd || *mP != *lit)
+                    return false;
+            return true;
+        }
+
+        bool ParseNumber(JsonValue& v)
+        {
+            // strtod wants a terminated string, the digits are copied out first
+            char digits[64];
+            std::size_t n = 0;
+            while (mP != mEnd && n < sizeof(digits) - 1 && std::strchr("+-0123456789.eE", *mP))
+                digits[n++] = *mP++;
+            digits[n] = '\0';
+            char* stop;
+            v.type = JsonValue::Number;
+            v.number = std::strtod(digits, &stop);
+            return n != 0 && stop == digits + n;
+        }
+
+        const char* mP;
+        const char* mEnd;
+};
+
+// Walks the DOM of a notification object into a NotificationData, returns false if it is not one
+static bool FromDom(const JsonValue& v, NotificationData& data)
+{
+    if (v.type != JsonValue::Object)
+        return false;
+    data = NotificationData();
+    data.lifetime = 3000;
+    data.priority = Priority::Normal;
+    data.ack.mode = AckMode::Accepted;
+    data.ack.format = AckFormat::Json;
+
+    const std::map<std::string, JsonValue>& o = *v.object;
+    auto msg = o.find("msg");
+    if (msg == o.end() || msg->second.type != JsonValue::String)
+        return false;
+    data.msg = *msg->second.string;
+    auto lifetime = o.find("lifetime");
+    if (lifetime != o.end() && lifetime->second.type == JsonValue::Number)
+        data.lifetime = static_cast<unsigned int>(lifetime->second.number);
+    auto priority = o.find("priority");
+    if (priority != o.end())
+    {
+        if (priority->second.type == JsonValue::String)
+            ParsePriority(*priority->second.string, data.priority);
+        else if (priority->second.type == JsonValue::Number && priority->second.number < PriorityLevels)
+            data.priority = static_cast<Priority>(static_cast<int>(priority->second.number));
+    }
+    auto key = o.find("key");
+    if (key != o.end() && key->second.type == JsonValue::String)
+        data.dedupKey = *key->second.string;
+    auto id = o.find("id");
+    if (id != o.end() && id->second.type == JsonValue::Number)
+    {
+        data.ack.requestId = static_cast<std::uint32_t>(id->second.number);
+        data.ack.hasRequestId = true;
+    }
+    auto ack = o.find("ack");
+    if (ack != o.end() && ack->second.type == JsonValue::String)
+        ParseAckMode(*ack->second.string, data.ack.mode);
+    return true;
+}
+
+// Parses a request with the DOM parser, appending its notifications
+static bool ParseDom(const char* begin, const char* end, std::vector<NotificationData>& out)
+{
+    JsonValue root;
+    if (!DomParser(begin, end).Parse(root))
+        return false;
+    NotificationData data;
+    if (root.type != JsonValue::Array)
+    {
+        if (!FromDom(root, data))
+            return false;
+        out.push_back(std::move(data));
+        return true;
+    }
+    for (const JsonValue& v : *root.array)
+    {
+        if (!FromDom(v, data))
+            return false;
+        out.push_back(std::move(data));
+    }
+    return true;
+}
+
+// Parses a request in place, appending its notifications
+static bool ParseInPlace(char* begin, char* end, std::vector<NotifyFrame>& frames, std::vector<NotificationData>& out)
+{
+    frames.clear();
+    if (!ParseJsonRequest(begin, end, frames))
+        return false;
+    for (const NotifyFrame& f : frames)
+        out.push_back(ToNotificationData(f, AckFormat::Json));
+    return true;
+}
+
+// Builds a notification object the way the scripts and CI jobs that send them do
+static std::string MakeNotification(std::mt19937& rng, std::uint32_t id)
+{
+    static const char* const words[] = { "build", "deploy", "of", "newsflash", "finished", "failed", "on", "runner",
+                                         "in", "3m", "12s", "tests", "passed", "warning:", "disk", "/var/log", "94%" };
+    std::string text;
+    std::size_t length = 20 + rng() % 280;
+    while (text.size() < length)
+    {
+        switch (rng() % 40)
+        {
+            case 0: text += "\\\"quoted\\\" "; break;
+            case 1: text += "line\\nbreak "; break;
+            case 2: text += "caf\\u00e9 "; break;
+            case 3: text += "C:\\\\builds\\\\out "; break;
+            case 4: text += "\\ud83d\\ude80 "; break;
+            default: text += std::string(words[rng() % (sizeof(words) / sizeof(words[0]))]) + " "; break;
+        }
+    }
+
+    std::string n = "{\"msg\": \"" + text + "\"";
+    if (rng() % 2)
+        n += ", \"priority\": " + (rng() % 2 ? "\"high\"" : std::to_string(rng() % PriorityLevels));
+    if (rng() % 3 == 0)
+        n += ", \"key\": \"build-" + std::to_string(rng() % 100) + "\"";
+    if (rng() % 2)
+        n += ", \"lifetime\": " + std::to_string(1000 + rng() % 9000);
+    if (rng() % 4 == 0)
+        n += ", \"meta\": {\"job\": " + std::to_string(rng() % 100000) + ", \"ok\": true, \"tags\": [\"ci\", \"nightly\"]}";
+    n += ", \"id\": " + std::to_string(id);
+    if (rng() % 3 == 0)
+        n += ", \"ack\": \"none\"";
+    return n + "}";
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 16;
+
+    // Two thirds single notifications, the rest batches
+    std::mt19937 rng(37);
+    std::vector<std::string> requests;
+    std::size_t bytes = 0;
+    std::size_t notifications = 0;
+    std::size_t longest = 0;
+    while (bytes < megabytes << 20)
+    {
+        std::string r;
+        if (rng() % 3 != 0)
+        {
+            r = MakeNotification(rng, static_cast<std::uint32_t>(notifications++));
+        }
+        else
+        {
+            r = "[";
+            for (std::uint32_t n = 2 + rng() % 19; n > 0; --n)
+                r += MakeNotification(rng, static_cast<std::uint32_t>(notifications++)) + (n > 1 ? ",\n " : "");
+            r += "]";
+        }
+        bytes += r.size();
+        longest = std::max(longest, r.size());
+        requests.push_back(std::move(r));
+    }
+
+    std::vector<char> buffer(longest);
+    std::vector<NotifyFrame> frames;
+    std::vector<NotificationData> out;
+    out.reserve(notifications);
+    double best[2] = { 0, 0 };
+    std::size_t textBytes[2] = { 0, 0 };
+    for (int pass = 0; pass < 10; ++pass)
+    {
+        int parser = pass % 2;
+        out.clear();
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& r : requests)
+        {
+            std::copy(r.begin(), r.end(), buffer.begin());
+            bool ok = parser == 0 ? ParseInPlace(buffer.data(), buffer.data() + r.size(), frames, out)
+                                  : ParseDom(buffer.data(), buffer.data() + r.size(), out);
+            if (!ok)
+            {
+                std::fprintf(stderr, "could not parse %s\n", r.c_str());
+                return 1;
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best[parser] = std::max(best[parser], bytes / seconds);
+
+        textBytes[parser] = 0;
+        for (const NotificationData& n : out)
+            textBytes[parser] += n.msg.size() + n.dedupKey.size();
+        if (out.size() != notifications)
+        {
+            std::fprintf(stderr, "parsed %zu of %zu notifications\n", out.size(), notifications);
+            return 1;
+        }
+    }
+
+    // Both parsers must have read the same texts for the comparison to mean anything
+    if (textBytes[0] != textBytes[1])
+    {
+        std::fprintf(stderr, "the parsers disagree: %zu and %zu text bytes\n", textBytes[0], textBytes[1]);
+        return 1;
+    }
+    std::printf("%zu requests, %zu notifications, %.1f MB\n", requests.size(), notifications, bytes / 1e6);
+    std::printf("in place  %.0f MB/s, %.2fM notifications/s\n", best[0] / 1e6, best[0] / bytes * notifications / 1e6);
+    std::printf("DOM       %.0f MB/s, %.2fM notifications/s\n", best[1] / 1e6, best[1] / bytes * notifications / 1e6);
+    std::printf("in place is %.1fx faster\n", best[0] / best[1]);
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "Protocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+//
+// Parse throughput of the binary protocol: a buffer of back to back
+// notification frames with 20 to 200 byte texts, half of them keyed, is
+// walked the way a connection walks its receive buffer.
+//
+//   ProtocolBench [megabytes of frames, 64 by default]
+//
+
+int main(int argc, char* argv[])
+{
+    std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+
+    std::mt19937 rng(1);
+    std::string buffer;
+    std::size_t frames = 0;
+    while (buffer.size() < megabytes << 20)
+    {
+        NotificationData data;
+        data.msg.assign(std::uniform_int_distribution<std::size_t>(20, 200)(rng), 'm');
+        data.lifetime = 3000;
+        data.priority = Priority::Normal;
+        if (rng() & 1)
+            data.dedupKey = "build-" + std::to_string(rng() % 100);
+        buffer += EncodeNotifyFrame(data, static_cast<std::uint32_t>(frames++));
+    }
+
+    // The best of a few passes, each one over the whole buffer
+    double best = 0;
+    std::size_t textBytes = 0;
+    for (int pass = 0; pass < 5; ++pass)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Slice in(buffer.data(), buffer.size());
+        FrameHeader h;
+        NotifyFrame f;
+        std::size_t parsed = 0;
+        textBytes = 0;
+        while (ParseFrameHeader(in, h) == FrameStatus::Ready)
+        {
+            if (ParseNotifyFrame(Slice(in.data + FrameHeaderSize, h.length), f))
+            {
+                textBytes += f.text.size + f.dedupKey.size;
+                ++parsed;
+            }
+            in = in.Skip(FrameHeaderSize + h.length);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (parsed != frames)
+        {
+            std::fprintf(stderr, "parsed %zu of %zu frames\n", parsed, frames);
+            return 1;
+        }
+        best = std::max(best, buffer.size() / seconds);
+    }
+
+    std::printf("%zu frames, %.1f MB: %.2f GB/s, %.1fM frames/s (%zu text bytes)\n",
+        frames, buffer.size() / 1e6, best / 1e9, best / buffer.size() * frames / 1e6, textBytes);
+    return 0;
+}
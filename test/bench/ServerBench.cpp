@@ -0,0 +1,250 @@
+#include "MessageServer.hpp"
+#include "Protocol.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+//
+// Message server throughput with and without metrics scraping: one TCP
+// client writes binary notification frames without acks as fast as the
+// server takes them, while the main thread scrapes /metrics over HTTP at
+// the given period, and the notifications the server delivers in the
+// time are counted. Every mode runs twice. The log of every read goes
+// nowhere, so the console does not set the pace.
+//
+// Where there are local sockets, the client blasts through one of those
+// as well, without scraping.
+//
+// Then datagrams are sent to the UDP listener with up to 128 of them
+// not yet delivered at any time, and the ones that never arrive counted.
+//
+//   ServerBench [seconds per run, 5 by default]
+//
+
+using Clock = std::chrono::steady_clock;
+
+// The notifications delivered by the server
+static std::atomic<std::uint64_t> delivered(0);
+
+// Waits until the server delivered everything the previous run left in the socket buffers
+static void WaitIdle()
+{
+    std::uint64_t last;
+    do
+    {
+        last = delivered.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    while (delivered.load() != last);
+}
+
+// Scrapes the metrics once on a connection of its own, returns false if the response is not complete
+static bool Scrape(unsigned short port)
+{
+    asio::io_service ios;
+    asio::ip::tcp::socket socket(ios);
+    asio::error_code ec;
+    socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port), ec);
+    std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    if (!ec)
+        asio::write(socket, asio::buffer(request), ec);
+
+    std::string response;
+    char buf[16384];
+    while (!ec)
+        response.append(buf, socket.read_some(asio::buffer(buf), ec));
+    return ec == asio::error::eof && response.compare(0, 15, "HTTP/1.1 200 OK") == 0;
+}
+
+// Writes the given batch to the given socket until the flag is set or the server closes the connection
+template<typename Socket>
+static void Blast(Socket& socket, const std::string& batch, const std::atomic<bool>& done)
+{
+    asio::error_code ec;
+    while (!done.load(std::memory_order_relaxed) && !ec)
+        asio::write(socket, asio::buffer(batch), ec);
+}
+
+// Blasts notifications at the server for the given time, scraping at the given period unless it is zero.
+// The client connects to the given local socket unless its path is empty, to the TCP port otherwise.
+// Returns the delivered notifications per second and the longest scrape
+static std::pair<double, Clock::duration> Run(unsigned short port, const std::string& localPath, unsigned short httpPort,
+    Clock::duration length, Clock::duration scrapePeriod)
+{
+    // Batches of 1000 notifications with 60 byte texts, written back to back
+    std::string batch;
+    NotificationData data;
+    data.lifetime = 3000;
+    data.priority = Priority::Normal;
+    for (std::uint32_t i = 0; i < 1000; ++i)
+    {
+        data.msg = "notification " + std::to_string(1000 + i) + " " + std::string(43, 'x');
+        batch += EncodeNotifyFrame(data, i, FlagNoAck);
+    }
+
+    WaitIdle();
+    std::atomic<bool> done(false);
+    std::thread client(
+        [&]()
+        {
+            asio::io_service ios;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+            if (!localPath.empty())
+            {
+                asio::local::stream_protocol::socket socket(ios);
+                socket.connect(asio::local::stream_protocol::endpoint(localPath));
+                Blast(socket, batch, done);
+                return;
+            }
+#endif
+            asio::ip::tcp::socket socket(ios);
+            socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), port));
+            Blast(socket, batch, done);
+        }
+    );
+
+    std::uint64_t first = delivered.load();
+    auto start = Clock::now();
+    Clock::duration worst(0);
+    while (Clock::now() - start < length)
+    {
+        if (scrapePeriod == Clock::duration(0))
+        {
+            std::this_thread::sleep_for(length);
+            continue;
+        }
+        auto scrapeStart = Clock::now();
+        if (!Scrape(httpPort))
+            std::fprintf(stderr, "a scrape failed\n");
+        worst = std::max(worst, Clock::now() - scrapeStart);
+        std::this_thread::sleep_until(scrapeStart + scrapePeriod);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::uint64_t count = delivered.load() - first;
+
+    // The server keeps reading, so the client sees the flag once its write in progress completes
+    done.store(true);
+    client.join();
+    return std::make_pair(count / seconds, worst);
+}
+
+// Sends the given number of datagrams, keeping up to the given number of them in flight.
+// Returns the delivered datagrams per second and the number of lost ones
+static std::pair<double, std::uint64_t> RunUdp(unsigned short udpPort, std::uint64_t count, std::uint64_t window)
+{
+    asio::io_service ios;
+    asio::ip::udp::socket socket(ios, asio::ip::udp::v4());
+    asio::ip::udp::endpoint server(asio::ip::address_v4::loopback(), udpPort);
+    std::string text = "[ack=none] notification " + std::string(40, 'x');
+
+    // A datagram that is not delivered within a second of the last delivery is lost
+    WaitIdle();
+    std::uint64_t first = delivered.load();
+    auto start = Clock::now();
+    auto progress = start;
+    std::uint64_t last = 0;
+    for (std::uint64_t sent = 0; sent < count; ++sent)
+    {
+        std::uint64_t done;
+        while (sent - (done = delivered.load() - first) >= window && Clock::now() - progress < std::chrono::seconds(1))
+        {
+            if (done != last)
+            {
+                last = done;
+                progress = Clock::now();
+            }
+            std::this_thread::yield();
+        }
+        progress = Clock::now();
+        socket.send_to(asio::buffer(text), server);
+    }
+    while (delivered.load() - first < count && Clock::now() - progress < std::chrono::seconds(1))
+        std::this_thread::yield();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::uint64_t received = delivered.load() - first;
+    return std::make_pair(received / seconds, count - received);
+}
+
+int main(int argc, char* argv[])
+{
+    Clock::duration length = std::chrono::seconds(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5);
+    std::cout.setstate(std::ios::badbit);
+    SetNotificationEventCallback([](const NotificationData&) { delivered.fetch_add(1, std::memory_order_relaxed); });
+
+    // The server has no accessors for the HTTP and UDP ports, ports the system just handed out are free enough
+    unsigned short httpPort;
+    unsigned short udpPort;
+    {
+        asio::io_service ios;
+        asio::ip::tcp::acceptor tcpProbe(ios, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        asio::ip::udp::socket udpProbe(ios, asio::ip::udp::endpoint(asio::ip::address_v4::loopback(), 0));
+        httpPort = tcpProbe.local_endpoint().port();
+        udpPort = udpProbe.local_endpoint().port();
+    }
+
+    MessageServer server(0);
+    server.SetRateLimits(RateLimit{0, 0}, RateLimit{0, 0});
+    if (!server.ServeHttp(httpPort))
+    {
+        std::fprintf(stderr, "could not serve HTTP on port %u\n", httpPort);
+        return 1;
+    }
+    if (!server.ListenUdp(udpPort, RateLimit{0, 0}))
+    {
+        std::fprintf(stderr, "could not listen on UDP port %u\n", udpPort);
+        return 1;
+    }
+    std::string localPath;
+#if defined(ASIO_HAS_LOCAL_SOCKETS)
+    localPath = "/tmp/newsflash-bench-" + std::to_string(Clock::now().time_since_epoch().count()) + ".sock";
+    if (!server.ListenLocal(localPath))
+    {
+        std::fprintf(stderr, "could not listen on %s\n", localPath.c_str());
+        return 1;
+    }
+#endif
+    std::thread t([&server]() { server.Run(); });
+
+    struct Mode
+    {
+        const char* name;
+        Clock::duration scrapePeriod;
+        bool local;
+    };
+    const Mode modes[] = {
+        { "no scraping", Clock::duration(0), false },
+        { "scraping every second", std::chrono::seconds(1), false },
+        { "scraping every 10 ms", std::chrono::milliseconds(10), false },
+        { "local socket", Clock::duration(0), true },
+    };
+    for (const Mode& m : modes)
+    {
+        if (m.local && localPath.empty())
+            continue;
+        for (int run = 0; run < 2; ++run)
+        {
+            auto result = Run(server.GetPort(), m.local ? localPath : std::string(), httpPort, length, m.scrapePeriod);
+            std::printf("%-24s %.2fM notifications/s", m.name, result.first / 1e6);
+            if (m.scrapePeriod != Clock::duration(0))
+                std::printf(", worst scrape %.2f ms", std::chrono::duration<double, std::milli>(result.second).count());
+            std::printf("\n");
+        }
+    }
+
+    for (int run = 0; run < 2; ++run)
+    {
+        auto result = RunUdp(udpPort, 100000, 128);
+        std::printf("%-24s %.2fM notifications/s, %llu of 100000 lost\n", "udp, 128 in flight", result.first / 1e6,
+            static_cast<unsigned long long>(result.second));
+    }
+
+    std::raise(SIGTERM);
+    t.join();
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "ShmRing.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+//
+// Cost of a shared memory ring push. First uncontended: one thread fills
+// the ring with 100 byte text requests and drains it again, and only the
+// pushes are timed. Then one producer thread pushes as fast as it can
+// while a consumer thread drains, the producer yielding when the ring is
+// full and the consumer when it is empty.
+//
+//   ShmRingBench [millions of records, 20 by default]
+//
+
+int main(int argc, char* argv[])
+{
+    std::size_t records = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20) * 1000000;
+    std::string name = "NewsFlashBench" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+    std::string request = "[high] " + std::string(93, 'x');
+
+    ShmRingConsumer consumer;
+    ShmRingProducer producer;
+    if (!consumer.Create(name) || !producer.Open(name))
+    {
+        std::fprintf(stderr, "could not create the ring %s\n", name.c_str());
+        return 1;
+    }
+
+    // Uncontended, the pushes of each fill are timed and the drains are not
+    std::chrono::steady_clock::duration pushTime(0);
+    std::size_t pushed = 0;
+    std::size_t bytes = 0;
+    while (pushed < records)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::size_t fill = 0;
+        while (pushed + fill < records && producer.TryPush(request))
+            ++fill;
+        pushTime += std::chrono::steady_clock::now() - start;
+        pushed += fill;
+        consumer.Drain([&bytes](char*, std::size_t size) { bytes += size; }, fill);
+    }
+    if (bytes != records * request.size())
+    {
+        std::fprintf(stderr, "drained %zu of %zu bytes\n", bytes, records * request.size());
+        return 1;
+    }
+    std::printf("%zu records of %zu bytes, uncontended: %.1f ns per push\n",
+        records, request.size(), std::chrono::duration<double>(pushTime).count() * 1e9 / records);
+
+    // A producer and a consumer thread
+    std::atomic<bool> done(false);
+    std::size_t drained = 0;
+    bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::thread reader(
+        [&]()
+        {
+            while (!done.load(std::memory_order_acquire) || drained < records)
+            {
+                std::size_t n = consumer.Drain([&bytes](char*, std::size_t size) { bytes += size; }, 256);
+                drained += n;
+                if (n == 0)
+                    std::this_thread::yield();
+            }
+        }
+    );
+    std::size_t full = 0;
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        while (!producer.TryPush(request))
+        {
+            ++full;
+            std::this_thread::yield();
+        }
+    }
+    done.store(true, std::memory_order_release);
+    reader.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (drained != records || bytes != records * request.size() || consumer.GetResetCount() != 0)
+    {
+        std::fprintf(stderr, "drained %zu of %zu records\n", drained, records);
+        return 1;
+    }
+    std::printf("producer and consumer threads: %.1fM records/s, %zu pushes found the ring full\n", records / seconds / 1e6, full);
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "NotificationStack.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+//
+// Cost of the slot bookkeeping for a burst of spawns: the given number of
+// notifications arrive at once on a display with room for all of them.
+// The drawer lays out once for the whole burst; for comparison the same
+// burst is laid out after every spawn, which moves every notification
+// below the new one each time. Only the bookkeeping is measured, a move
+// records where the window would go. The best of a few passes is reported.
+//
+//   SpawnBurstBench [notifications, 1000 by default]
+//
+
+using Clock = std::chrono::steady_clock;
+
+// Where the notifications were moved to, read back at the end so the moves are not optimized away
+struct Placement
+{
+    int x, y;
+};
+
+int main(int argc, char* argv[])
+{
+    std::size_t notifications = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+
+    LayoutOptions options;
+    options.width = 40;
+    options.height = 30;
+    options.spacing = 2;
+    options.maxColumns = 1000;
+    options.maxVisible = notifications;
+
+    StackLayout layout;
+    layout.SetOptions(options);
+    layout.SetDisplays({ DisplayInfo{ LayoutRect{ 0, 0, 3840, 2160 }, 96 } });
+    if (layout.GetCapacity() != notifications)
+    {
+        std::fprintf(stderr, "the display fits %zu of %zu notifications\n", layout.GetCapacity(), notifications);
+        return 1;
+    }
+
+    std::vector<Placement> placements(notifications);
+    auto move = [&placements](SlotHandle h, const SlotGeometry& g)
+    {
+        placements[h.index] = Placement{ g.x, g.y };
+    };
+
+    NotificationStack stack;
+    stack.Reserve(notifications);
+    double best[2] = { 0, 0 };
+    std::size_t moves[2] = { 0, 0 };
+    for (int pass = 0; pass < 5; ++pass)
+    {
+        for (int eager = 0; eager < 2; ++eager)
+        {
+            stack.Clear();
+            moves[eager] = 0;
+            auto start = Clock::now();
+            for (std::size_t i = 0; i < notifications; ++i)
+            {
+                stack.PushFront(SlotHandle{ static_cast<std::uint32_t>(i), 0 });
+                if (eager)
+                    moves[eager] += stack.Layout(layout, move);
+            }
+            moves[eager] += stack.Layout(layout, move);
+            double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+            if (pass == 0 || us < best[eager])
+                best[eager] = us;
+        }
+    }
+
+    // The first notification ends up at the bottom of the stack, in the last slot
+    if (placements[0].y != layout.GetSlot(notifications - 1).y || moves[0] != notifications)
+    {
+        std::fprintf(stderr, "the burst was not laid out\n");
+        return 1;
+    }
+    std::printf("%zu spawns: one pass %.1f us (%zu moves), a pass per spawn %.1f us (%zu moves)\n",
+        notifications, best[0], moves[0], best[1], moves[1]);
+    return 0;
+}
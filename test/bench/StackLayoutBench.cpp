@@ -0,0 +1,87 @@
+#include "StackLayout.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+//
+// Cost of laying out a large stack: small notifications on two displays
+// of different dpi, capped at the given number of visible ones, so that
+// the slots fill the first display and overflow to the second. Every
+// round is a display change, the taskbar moving between the bottom and
+// the right edge, followed by a full layout pass that moves every
+// notification to its slot. The recompute and the pass are timed apart,
+// and the best of a few passes is reported.
+//
+//   StackLayoutBench [notifications, 10000 by default]
+//
+
+using Clock = std::chrono::steady_clock;
+
+// Where the notifications were moved to, read back at the end so the moves are not optimized away
+struct Placement
+{
+    int x, y, width, height;
+};
+
+int main(int argc, char* argv[])
+{
+    std::size_t notifications = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000;
+
+    LayoutOptions options;
+    options.width = 40;
+    options.height = 30;
+    options.spacing = 2;
+    options.maxColumns = 1000;
+    options.maxVisible = notifications;
+
+    // The work areas with the taskbar at the bottom and at the right of the first display
+    const std::vector<DisplayInfo> layouts[] = {
+        { DisplayInfo{ LayoutRect{ 0, 0, 3840, 2120 }, 96 }, DisplayInfo{ LayoutRect{ 3840, 0, 11520, 4320 }, 192 } },
+        { DisplayInfo{ LayoutRect{ 0, 0, 3780, 2160 }, 96 }, DisplayInfo{ LayoutRect{ 3840, 0, 11520, 4320 }, 192 } },
+    };
+
+    StackLayout layout;
+    layout.SetOptions(options);
+    std::vector<Placement> placements(notifications);
+    const int rounds = 200;
+    double bestRecompute = 0;
+    double bestPass = 0;
+    for (int pass = 0; pass < 5; ++pass)
+    {
+        Clock::duration recompute(0);
+        Clock::duration place(0);
+        for (int round = 0; round < rounds; ++round)
+        {
+            auto start = Clock::now();
+            layout.SetDisplays(layouts[round % 2]);
+            auto computed = Clock::now();
+            for (std::size_t i = 0; i < layout.GetCapacity(); ++i)
+            {
+                const SlotGeometry& g = layout.GetSlot(i);
+                placements[i] = Placement{ g.x, g.y, g.width, g.height };
+            }
+            auto placed = Clock::now();
+            recompute += computed - start;
+            place += placed - computed;
+        }
+
+        double us = std::chrono::duration<double, std::micro>(recompute).count() / rounds;
+        if (pass == 0 || us < bestRecompute)
+            bestRecompute = us;
+        us = std::chrono::duration<double, std::micro>(place).count() / rounds;
+        if (pass == 0 || us < bestPass)
+            bestPass = us;
+    }
+
+    if (layout.GetCapacity() != notifications || placements.back().width == 0)
+    {
+        std::fprintf(stderr, "the displays fit %zu of %zu notifications\n", layout.GetCapacity(), notifications);
+        return 1;
+    }
+    std::size_t onSecond = 0;
+    for (std::size_t i = 0; i < notifications; ++i)
+        onSecond += layout.GetSlot(i).display;
+    std::printf("%zu notifications, %zu on the second display: recompute %.1f us, layout pass %.1f us (%.2f ns per notification)\n",
+        notifications, onSecond, bestRecompute, bestPass, bestPass * 1000 / notifications);
+    return 0;
+}
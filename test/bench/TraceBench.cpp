@@ -0,0 +1,64 @@
+#include "Trace.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+//
+// Cost of a trace point: a function with a TRACE_SCOPE is called with
+// tracing off and on, and an empty function for comparison. The calls go
+// through a volatile function pointer, so none of them is inlined. The
+// best of a few passes is reported.
+//
+//   TraceBench [millions of calls, 100 by default]
+//
+
+// Keeps the bodies of the functions from being optimized away
+static volatile std::uint64_t sink;
+
+static void Empty(std::uint64_t i)
+{
+    sink = i;
+}
+
+static void Traced(std::uint64_t i)
+{
+    TRACE_SCOPE("TraceBench::Traced");
+    sink = i;
+}
+
+// Calls the given function the given number of times in a few passes, returns the best time of a call in nanoseconds
+static double Time(void (*volatile fn)(std::uint64_t), std::size_t calls)
+{
+    double best = 0;
+    for (int pass = 0; pass < 5; ++pass)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < calls; ++i)
+            fn(i);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+        if (pass == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t calls = (argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100) * 1000000;
+
+    double empty = Time(Empty, calls);
+    SetTracing(false);
+    double disabled = Time(Traced, calls);
+    SetTracing(true);
+    double enabled = Time(Traced, calls / 10);
+    SetTracing(false);
+
+    // The recording must have happened for its time to mean anything
+    if (DumpTrace().find("TraceBench::Traced") == std::string::npos)
+    {
+        std::fprintf(stderr, "the trace has no events\n");
+        return 1;
+    }
+    std::printf("empty call %.2f ns, disabled trace point %.2f ns, enabled trace point %.2f ns\n", empty, disabled, enabled);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "Fuzz.hpp"
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+
+//
+// The standalone driver of the fuzz targets, for compilers without
+// libFuzzer and for ctest. It replays the files given on the command line,
+// then runs the target on random mutations of its seeds:
+//
+//   ProtocolFuzz [-runs=N] [-seed=N] [crash-file...]
+//
+
+// The bytes that tend to matter to the parsers: NULs, escapes, structure and the frame magic
+static const unsigned char interestingBytes[] = { 0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF, '"', '\\', '{', '}', '[', ']', ',', ':', 'u', 'N' };
+
+// The input currently running, printed when an invariant aborts the run
+static std::string currentInput;
+
+static void Run(const std::string& input)
+{
+    currentInput = input;
+    LLVMFuzzerTestOneInput(reinterpret_cast<const std::uint8_t*>(input.data()), input.size());
+}
+
+// Applies a few random edits to the given input, splicing from the other seeds now and then
+static std::string Mutate(std::string s, const std::vector<std::string>& seeds, std::mt19937& rng)
+{
+    auto pick = [&rng](std::size_t n) { return n == 0 ? 0 : std::uniform_int_distribution<std::size_t>(0, n - 1)(rng); };
+    std::size_t edits = 1 + pick(8);
+    for (std::size_t i = 0; i < edits; ++i)
+    {
+        switch (pick(8))
+        {
+            case 0:
+                if (!s.empty())
+                    s[pick(s.size())] ^= static_cast<char>(1 << pick(8));
+                break;
+            case 1:
+                if (!s.empty())
+                    s[pick(s.size())] = static_cast<char>(interestingBytes[pick(sizeof(interestingBytes))]);
+                break;
+            case 2:
+                s.insert(pick(s.size() + 1), 1, static_cast<char>(pick(256)));
+                break;
+            case 3:
+                if (!s.empty())
+                {
+                    std::size_t at = pick(s.size());
+                    s.erase(at, 1 + pick(s.size() - at));
+                }
+                break;
+            case 4:
+                if (!s.empty())
+                {
+                    std::size_t at = pick(s.size());
+                    s.insert(pick(s.size() + 1), s.substr(at, 1 + pick(s.size() - at)));
+                }
+                break;
+            case 5:
+                s.resize(pick(s.size() + 1));
+                break;
+            case 6:
+            {
+                const std::string& other = seeds[pick(seeds.size())];
+                std::size_t at = pick(other.size() + 1);
+                s.insert(pick(s.size() + 1), other.substr(at, pick(other.size() - at + 1)));
+                break;
+            }
+            default:
+                if (s.size() >= 4)
+                {
+                    // Overwrite a little endian length sized run with an extreme value
+                    std::uint32_t v = pick(2) ? 0xFFFFFFFFu : static_cast<std::uint32_t>(pick(1 << 17));
+                    std::size_t at = pick(s.size() - 3);
+                    for (int b = 0; b < 4; ++b)
+                        s[at + b] = static_cast<char>((v >> (8 * b)) & 0xFF);
+                }
+                break;
+        }
+    }
+    return s;
+}
+
+static void OnAbort(int)
+{
+    std::fprintf(stderr, "failing input (%zu bytes):", currentInput.size());
+    for (unsigned char c : currentInput)
+        std::fprintf(stderr, " %02x", c);
+    std::fprintf(stderr, "\n");
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned long runs = 200000;
+    unsigned long seed = 1;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "-runs=", 6) == 0)
+            runs = std::strtoul(argv[i] + 6, nullptr, 10);
+        else if (std::strncmp(argv[i], "-seed=", 6) == 0)
+            seed = std::strtoul(argv[i] + 6, nullptr, 10);
+        else
+            files.push_back(argv[i]);
+    }
+    std::signal(SIGABRT, OnAbort);
+
+    for (const auto& f : files)
+    {
+        std::ifstream in(f, std::ios::binary);
+        Run(std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()));
+    }
+    if (!files.empty())
+        return 0;
+
+    std::vector<std::string> seeds = GetFuzzSeeds();
+    for (const auto& s : seeds)
+        Run(s);
+
+    std::mt19937 rng(static_cast<std::mt19937::result_type>(seed));
+    for (unsigned long i = 0; i < runs; ++i)
+        Run(Mutate(seeds[i % seeds.size()], seeds, rng));
+    std::printf("%lu runs, no invariant failed\n", runs);
+    return 0;
+}
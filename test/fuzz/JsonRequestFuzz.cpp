@@ -0,0 +1,46 @@
+#include "Fuzz.hpp"
+#include <algorithm>
+#include <memory>
+#include "JsonRequest.hpp"
+
+std::vector<std::string> GetFuzzSeeds()
+{
+    return {
+        "{\"msg\": \"Build finished\", \"lifetime\": 5000, \"priority\": \"high\", \"key\": \"build\", \"id\": 7, \"ack\": \"displayed\"}",
+        "[{\"msg\": \"a\\u00e9\\uD83D\\uDE00\\n\", \"id\": 1}, {\"msg\": \"b\", \"priority\": 2, \"x\": [1, {\"y\": null}, -2.5e3]}]",
+        "{\"query\": \"history\", \"since\": 1700000000000, \"source\": \"10.0.0.7\", \"text\": \"disk* full\", \"limit\": 50, \"cursor\": 42}",
+        "{\"query\": \"stats\", \"id\": 9}",
+        std::string(40, '[') + std::string(40, ']'),
+    };
+}
+
+// Checks that the given slice is empty or inside the buffer
+static bool Inside(Slice s, const char* begin, const char* end)
+{
+    return s.Empty() || (s.begin() >= begin && s.end() <= end);
+}
+
+// Parses the input as a request and as a query, each from a copy of its exact size so that overreads are caught
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    std::unique_ptr<char[]> buffer(new char[size + 1]);
+    std::copy(data, data + size, buffer.get());
+    char* begin = buffer.get();
+    char* end = begin + size;
+
+    std::vector<NotifyFrame> frames(1);
+    bool ok = ParseJsonRequest(begin, end, frames);
+    FUZZ_CHECK(ok || frames.size() == 1);
+    for (std::size_t i = 1; i < frames.size(); ++i)
+    {
+        FUZZ_CHECK(Inside(frames[i].text, begin, end) && Inside(frames[i].dedupKey, begin, end));
+        FUZZ_CHECK(static_cast<std::size_t>(frames[i].priority) < PriorityLevels);
+    }
+
+    std::copy(data, data + size, buffer.get());
+    QueryKind kind;
+    HistoryQuery q;
+    if (ParseJsonQuery(begin, end, kind, q))
+        FUZZ_CHECK(q.source.size() <= size && q.text.size() <= size);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "Fuzz.hpp"
+#include "Protocol.hpp"
+
+std::vector<std::string> GetFuzzSeeds()
+{
+    NotificationData data;
+    data.msg = "Build finished";
+    data.lifetime = 5000;
+    data.priority = Priority::High;
+    data.dedupKey = "build";
+    std::string keyed = EncodeNotifyFrame(data, 7);
+    data.dedupKey.clear();
+    data.msg = std::string(300, 'x');
+    std::string plain = EncodeNotifyFrame(data, 8, FlagNoAck);
+
+    AckTarget target;
+    target.requestId = 9;
+    target.hasRequestId = true;
+    return { keyed, plain, keyed + plain, EncodeAckFrame(target, AckStatus::Displayed), "plain text" };
+}
+
+// Walks the input frame by frame the way a connection does, and checks that every accepted frame survives a round trip
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, std::size_t size)
+{
+    Slice in(reinterpret_cast<const char*>(data), size);
+    FrameHeader h;
+    while (ParseFrameHeader(in, h) == FrameStatus::Ready)
+    {
+        FUZZ_CHECK(h.length <= MaxFramePayload && FrameHeaderSize + h.length <= in.size);
+        Slice payload(in.data + FrameHeaderSize, h.length);
+        in = in.Skip(FrameHeaderSize + h.length);
+
+        NotifyFrame f;
+        if (!ParseNotifyFrame(payload, f))
+            continue;
+        FUZZ_CHECK(f.text.Empty() || (f.text.begin() >= payload.begin() && f.text.end() <= payload.end()));
+        FUZZ_CHECK(f.dedupKey.Empty() || (f.dedupKey.begin() >= payload.begin() && f.dedupKey.end() <= payload.end()));
+        FUZZ_CHECK(static_cast<std::size_t>(f.priority) < PriorityLevels);
+
+        // The encoder writes what the parser read, so decoding the encoding gives the same fields
+        NotificationData n = ToNotificationData(f, AckFormat::Binary);
+        if (n.msg.size() > 0xFFFF || n.dedupKey.size() > 0xFFFF)
+            continue;
+        std::string again = EncodeNotifyFrame(n, f.requestId);
+        if (again.size() - FrameHeaderSize > MaxFramePayload)
+            continue;
+        FrameHeader h2;
+        NotifyFrame f2;
+        FUZZ_CHECK(ParseFrameHeader(Slice(again.data(), again.size()), h2) == FrameStatus::Ready);
+        FUZZ_CHECK(ParseNotifyFrame(Slice(again.data() + FrameHeaderSize, h2.length), f2));
+        FUZZ_CHECK(f2.text.ToString() == n.msg && f2.dedupKey.ToString() == n.dedupKey);
+        FUZZ_CHECK(f2.lifetime == f.lifetime && f2.priority == f.priority && f2.requestId == f.requestId);
+    }
+    return 0;
+}